@@ -0,0 +1,79 @@
+#ifndef INFERENCE_QUEUE_H_
+#define INFERENCE_QUEUE_H_
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+
+// Fila limitada entre a tarefa de rede (produtor) e a tarefa de inferência
+// (consumidor).
+//
+// A fila só controla índices de slots; cada aplicação mantém um array com a
+// entrada já quantizada e o resultado de cada slot, alocado uma vez na
+// inicialização. O ciclo de um slot é:
+//
+//   rede:       acquire() -> preenche a entrada -> submit()
+//   inferência: take() -> copia a entrada e roda o modelo -> complete()
+//   rede:       done() -> lê o resultado -> release()
+//
+// acquire() devolve -1 quando todos os slots estão em uso; a aplicação
+// responde 503 e chama reject() para contar a recusa. release() pode ser
+// chamado antes do complete() (conexão fechada no meio); o slot volta a
+// ficar livre quando a inferência acabar.
+//
+// Usa std::mutex e std::condition_variable, que o ESP-IDF implementa sobre
+// FreeRTOS, então o mesmo código roda no ESP32 e no Linux com std::thread.
+class InferenceQueue {
+ public:
+  static constexpr int kMaxSlots = 8;
+
+  struct Stats {
+    int slots;
+    int depth;           // slots na fila ou em execução agora
+    int max_depth;
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t rejected;   // requisições recusadas com 503
+    uint64_t total_wait_us;  // submit() -> take()
+    uint32_t max_wait_us;
+    uint64_t total_run_us;   // take() -> complete()
+    uint32_t max_run_us;
+  };
+
+  explicit InferenceQueue(int slots);
+
+  // Produtor.
+  int acquire();
+  void reject();
+  void submit(int slot);
+  bool done(int slot) const;
+  void release(int slot);
+
+  // Consumidor. take() bloqueia até haver um slot na fila.
+  int take();
+  void complete(int slot);
+
+  Stats stats() const;
+
+ private:
+  enum SlotState : uint8_t { kFree, kFilling, kQueued, kRunning, kDone };
+
+  static uint32_t now_us();
+
+  const int slots_;
+  mutable std::mutex mutex_;
+  std::condition_variable queued_;
+
+  SlotState state_[kMaxSlots];
+  bool orphaned_[kMaxSlots];
+  uint32_t submit_us_[kMaxSlots];
+  uint32_t start_us_[kMaxSlots];
+  int fifo_[kMaxSlots];
+  int fifo_head_;
+  int fifo_count_;
+
+  Stats stats_;
+};
+
+#endif  // INFERENCE_QUEUE_H_
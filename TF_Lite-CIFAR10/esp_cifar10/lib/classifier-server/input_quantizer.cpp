@@ -0,0 +1,71 @@
+#include "input_quantizer.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+// Quatro leituras da tabela por palavra: uma leitura e uma escrita de 32 bits
+// na memória em vez de quatro de 8. Cada byte volta para a mesma posição da
+// palavra, então não depende da ordem dos bytes.
+inline uint32_t gather4(const int8_t* table, uint32_t word) {
+  return static_cast<uint32_t>(static_cast<uint8_t>(table[word & 0xff])) |
+         static_cast<uint32_t>(static_cast<uint8_t>(table[(word >> 8) & 0xff]))
+             << 8 |
+         static_cast<uint32_t>(static_cast<uint8_t>(table[(word >> 16) & 0xff]))
+             << 16 |
+         static_cast<uint32_t>(static_cast<uint8_t>(table[word >> 24])) << 24;
+}
+
+}  // namespace
+
+InputQuantizer::InputQuantizer() { memset(table_, 0, sizeof(table_)); }
+
+int8_t InputQuantizer::quantize(uint8_t pixel, Normalization normalization,
+                                float scale, int32_t zero_point) {
+  float normalized_pixel;
+  if (normalization == kSymmetricRange) {
+    normalized_pixel = (static_cast<float>(pixel) - 127.5f) / 127.5f;
+  } else {
+    normalized_pixel = pixel / 255.0f;
+  }
+  int32_t quantized_value =
+      static_cast<int32_t>(roundf(normalized_pixel / scale) + zero_point);
+  if (quantized_value < -128) quantized_value = -128;
+  if (quantized_value > 127) quantized_value = 127;
+  return static_cast<int8_t>(quantized_value);
+}
+
+void InputQuantizer::build(Normalization normalization, float scale,
+                           int32_t zero_point) {
+  for (int pixel = 0; pixel < 256; ++pixel) {
+    table_[pixel] = quantize(pixel, normalization, scale, zero_point);
+  }
+}
+
+void InputQuantizer::apply(int8_t* data, size_t count) const {
+  apply(reinterpret_cast<const uint8_t*>(data), data, count);
+}
+
+void InputQuantizer::apply(const uint8_t* input, int8_t* output,
+                           size_t count) const {
+  size_t i = 0;
+  // O Xtensa não faz leitura de 32 bits desalinhada; só usa palavras quando
+  // entrada e saída se alinham juntas, que é o caso do buffer único.
+  if ((reinterpret_cast<uintptr_t>(input) & 3) ==
+      (reinterpret_cast<uintptr_t>(output) & 3)) {
+    while (i < count && (reinterpret_cast<uintptr_t>(input + i) & 3) != 0) {
+      output[i] = table_[input[i]];
+      ++i;
+    }
+    for (; i + 8 <= count; i += 8) {
+      const uint32_t* in = reinterpret_cast<const uint32_t*>(input + i);
+      uint32_t* out = reinterpret_cast<uint32_t*>(output + i);
+      const uint32_t w0 = in[0];
+      const uint32_t w1 = in[1];
+      out[0] = gather4(table_, w0);
+      out[1] = gather4(table_, w1);
+    }
+  }
+  for (; i < count; ++i) output[i] = table_[input[i]];
+}
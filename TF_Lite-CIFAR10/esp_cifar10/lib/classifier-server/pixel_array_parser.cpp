@@ -0,0 +1,190 @@
+#include "pixel_array_parser.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace {
+
+const char kKey[] = "\"pixels\"";
+const int kKeyLength = sizeof(kKey) - 1;
+
+// Acima disso o valor já vai virar 255; parar de acumular evita overflow
+// com números muito longos.
+const int kValueSaturation = 1000;
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+}  // namespace
+
+PixelArrayParser::PixelArrayParser(int8_t* output, int expected_values,
+                                   const int8_t* quant_table)
+    : output_(output), quant_table_(quant_table), expected_(expected_values) {
+  reset();
+}
+
+void PixelArrayParser::reset() {
+  state_ = kSeekKey;
+  status_ = kNeedMore;
+  count_ = 0;
+  key_matched_ = 0;
+  negative_ = false;
+  value_ = 0;
+  offset_ = 0;
+  error_[0] = '\0';
+}
+
+void PixelArrayParser::reset(int8_t* output) {
+  output_ = output;
+  reset();
+}
+
+void PixelArrayParser::reset(int8_t* output, int expected_values,
+                             const int8_t* quant_table) {
+  output_ = output;
+  expected_ = expected_values;
+  quant_table_ = quant_table;
+  reset();
+}
+
+PixelArrayParser::Status PixelArrayParser::fail(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vsnprintf(error_, sizeof(error_), format, args);
+  va_end(args);
+  status_ = kError;
+  return status_;
+}
+
+void PixelArrayParser::store_value() {
+  int pixel = value_ > 255 ? 255 : value_;
+  if (negative_) pixel = 0;
+  output_[count_++] = quant_table_ != nullptr ? quant_table_[pixel]
+                                              : static_cast<int8_t>(pixel);
+  negative_ = false;
+}
+
+PixelArrayParser::Status PixelArrayParser::feed(const char* data,
+                                                size_t size) {
+  if (status_ != kNeedMore) return status_;
+
+  size_t i = 0;
+  while (i < size) {
+    const char c = data[i];
+    switch (state_) {
+      case kSeekKey:
+        if (c == kKey[key_matched_]) {
+          if (++key_matched_ == kKeyLength) {
+            state_ = kSeekColon;
+          }
+        } else {
+          key_matched_ = (c == '"') ? 1 : 0;
+        }
+        ++i;
+        break;
+
+      case kSeekColon:
+        if (c == ':') {
+          state_ = kSeekBracket;
+        } else if (!is_space(c)) {
+          // Era o texto "pixels" como valor, não como chave.
+          state_ = kSeekKey;
+          key_matched_ = (c == '"') ? 1 : 0;
+        }
+        ++i;
+        break;
+
+      case kSeekBracket:
+        if (c == '[') {
+          state_ = kSeekValue;
+        } else if (!is_space(c)) {
+          return fail("Array de pixels não encontrado (byte %u)",
+                      (unsigned)(offset_ + i));
+        }
+        ++i;
+        break;
+
+      case kSeekValue:
+        if (is_digit(c)) {
+          value_ = c - '0';
+          state_ = kNumber;
+        } else if (c == '-' || c == '+') {
+          negative_ = (c == '-');
+          state_ = kSign;
+        } else if (c == ']' && count_ == 0) {
+          return fail("Array deve ter %d valores, recebido: 0", expected_);
+        } else if (!is_space(c)) {
+          return fail("Valor inválido no índice %d (byte %u): '%c'", count_,
+                      (unsigned)(offset_ + i), c);
+        }
+        ++i;
+        break;
+
+      case kSign:
+        if (!is_digit(c)) {
+          return fail("Valor inválido no índice %d (byte %u): '%c'", count_,
+                      (unsigned)(offset_ + i), c);
+        }
+        value_ = c - '0';
+        state_ = kNumber;
+        ++i;
+        break;
+
+      case kNumber:
+        // Laço interno para os dígitos, que são a maior parte do corpo.
+        while (i < size && is_digit(data[i])) {
+          if (value_ < kValueSaturation) {
+            value_ = value_ * 10 + (data[i] - '0');
+          }
+          ++i;
+        }
+        if (i == size) break;
+        if (data[i] == '.' || data[i] == 'e' || data[i] == 'E') {
+          return fail("Valor não inteiro no índice %d (byte %u)", count_,
+                      (unsigned)(offset_ + i));
+        }
+        if (count_ == expected_) {
+          return fail("Array com mais de %d valores", expected_);
+        }
+        store_value();
+        state_ = kAfterValue;
+        break;
+
+      case kAfterValue:
+        if (c == ',') {
+          state_ = kSeekValue;
+        } else if (c == ']') {
+          if (count_ != expected_) {
+            return fail("Array deve ter %d valores, recebido: %d", expected_,
+                        count_);
+          }
+          status_ = kDone;
+          return status_;
+        } else if (!is_space(c)) {
+          return fail("Esperado ',' ou ']' depois do índice %d (byte %u): "
+                      "'%c'",
+                      count_ - 1, (unsigned)(offset_ + i), c);
+        }
+        ++i;
+        break;
+    }
+  }
+  offset_ += size;
+  return status_;
+}
+
+PixelArrayParser::Status PixelArrayParser::finish() {
+  if (status_ != kNeedMore) return status_;
+  switch (state_) {
+    case kSeekKey:
+    case kSeekColon:
+      return fail("Campo 'pixels' não encontrado");
+    case kSeekBracket:
+      return fail("Array de pixels não encontrado");
+    default:
+      return fail("Fim do array não encontrado (%d valores lidos)", count_);
+  }
+}
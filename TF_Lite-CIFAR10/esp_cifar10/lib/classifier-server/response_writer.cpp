@@ -0,0 +1,264 @@
+#include "response_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "http_request_parser.h"
+
+namespace {
+
+const char kOverflowBody[] =
+    "{\n  \"success\": false,\n"
+    "  \"error_message\": \"Resposta maior que o buffer\"\n}";
+
+}  // namespace
+
+ResponseWriter::ResponseWriter(char* buffer, size_t capacity,
+                               const char* extra_headers)
+    : buffer_(buffer), capacity_(capacity), extra_headers_(extra_headers) {
+  reset();
+}
+
+void ResponseWriter::reset() {
+  start_ = kHeaderSpace;
+  body_end_ = kHeaderSpace;
+  overflow_ = false;
+  depth_ = 0;
+}
+
+void ResponseWriter::put(char c) {
+  if (body_end_ < capacity_) {
+    buffer_[body_end_++] = c;
+  } else {
+    overflow_ = true;
+  }
+}
+
+void ResponseWriter::put(const char* text, size_t length) {
+  if (length > capacity_ - body_end_) {
+    overflow_ = true;
+    return;
+  }
+  memcpy(buffer_ + body_end_, text, length);
+  body_end_ += length;
+}
+
+// Escapa aspas, barras e caracteres de controle; o resto (inclusive UTF-8)
+// passa como está.
+void ResponseWriter::put_string(const char* text) {
+  static const char kHex[] = "0123456789abcdef";
+  put('"');
+  for (const char* p = text; *p != '\0'; ++p) {
+    const unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '"' || c == '\\') {
+      put('\\');
+      put(static_cast<char>(c));
+    } else if (c == '\n') {
+      put("\\n", 2);
+    } else if (c < 0x20) {
+      put("\\u00", 4);
+      put(kHex[c >> 4]);
+      put(kHex[c & 0xf]);
+    } else {
+      put(static_cast<char>(c));
+    }
+  }
+  put('"');
+}
+
+void ResponseWriter::put_uint(unsigned long value) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (n > 0) put(digits[--n]);
+}
+
+void ResponseWriter::put_fixed(float value, int decimals) {
+  static const uint32_t kPow10[] = {1,      10,      100,      1000,
+                                    10000,  100000,  1000000,  10000000,
+                                    100000000};
+  if (decimals < 0) decimals = 0;
+  if (decimals > 8) decimals = 8;
+  double magnitude = value < 0 ? -static_cast<double>(value) : value;
+  // NaN falha a primeira comparação; infinito e valores enormes, a segunda.
+  if (!(magnitude == magnitude) || magnitude * kPow10[decimals] > 1e18) {
+    put("null", 4);
+    return;
+  }
+
+  const uint64_t scaled =
+      static_cast<uint64_t>(magnitude * kPow10[decimals] + 0.5);
+  const uint64_t integer = scaled / kPow10[decimals];
+  uint32_t fraction = static_cast<uint32_t>(scaled % kPow10[decimals]);
+  if (value < 0 && scaled != 0) put('-');
+
+  char digits[20];
+  int n = 0;
+  uint64_t rest = integer;
+  do {
+    digits[n++] = static_cast<char>('0' + rest % 10);
+    rest /= 10;
+  } while (rest != 0);
+  while (n > 0) put(digits[--n]);
+
+  if (decimals == 0) return;
+  put('.');
+  for (int i = decimals - 1; i >= 0; --i) {
+    digits[i] = static_cast<char>('0' + fraction % 10);
+    fraction /= 10;
+  }
+  put(digits, decimals);
+}
+
+void ResponseWriter::indent(int depth) {
+  for (int i = 0; i < depth; ++i) put("  ", 2);
+}
+
+void ResponseWriter::member(const char* key) {
+  if (depth_ > 0) {
+    const int level = depth_ - 1;
+    if (inline_[level]) {
+      if (members_[level] > 0) put(", ", 2);
+    } else {
+      if (members_[level] > 0) put(',');
+      put('\n');
+      indent(depth_);
+    }
+    members_[level]++;
+  }
+  if (key != nullptr) {
+    put_string(key);
+    put(": ", 2);
+  }
+}
+
+void ResponseWriter::close(char bracket) {
+  if (depth_ == 0) return;
+  const int level = --depth_;
+  if (!inline_[level] && members_[level] > 0) {
+    put('\n');
+    indent(level);
+  }
+  put(bracket);
+}
+
+void ResponseWriter::append(const char* text) { put(text, strlen(text)); }
+
+void ResponseWriter::append(const char* text, size_t length) {
+  put(text, length);
+}
+
+void ResponseWriter::append_uint(unsigned long value) { put_uint(value); }
+
+void ResponseWriter::begin_object(const char* key, bool inline_members) {
+  member(key);
+  put('{');
+  if (depth_ == kMaxDepth) {
+    overflow_ = true;
+    return;
+  }
+  members_[depth_] = 0;
+  inline_[depth_] = inline_members;
+  depth_++;
+}
+
+void ResponseWriter::end_object() { close('}'); }
+
+void ResponseWriter::begin_array(const char* key, bool inline_members) {
+  member(key);
+  put('[');
+  if (depth_ == kMaxDepth) {
+    overflow_ = true;
+    return;
+  }
+  members_[depth_] = 0;
+  inline_[depth_] = inline_members;
+  depth_++;
+}
+
+void ResponseWriter::end_array() { close(']'); }
+
+void ResponseWriter::field_string(const char* key, const char* value) {
+  member(key);
+  put_string(value);
+}
+
+void ResponseWriter::field_bool(const char* key, bool value) {
+  member(key);
+  if (value) {
+    put("true", 4);
+  } else {
+    put("false", 5);
+  }
+}
+
+void ResponseWriter::field_int(const char* key, long value) {
+  member(key);
+  if (value < 0) {
+    put('-');
+    put_uint(0UL - static_cast<unsigned long>(value));
+  } else {
+    put_uint(static_cast<unsigned long>(value));
+  }
+}
+
+void ResponseWriter::field_uint(const char* key, unsigned long value) {
+  member(key);
+  put_uint(value);
+}
+
+void ResponseWriter::field_float(const char* key, float value, int decimals) {
+  member(key);
+  put_fixed(value, decimals);
+}
+
+void ResponseWriter::field_top_k(const char* key, const char* class_key,
+                                 const int* classes, const float* scores,
+                                 int count, int decimals) {
+  // Dentro de um objeto inline (um item de lote) o array também fica na
+  // mesma linha.
+  begin_array(key, depth_ > 0 && inline_[depth_ - 1]);
+  for (int i = 0; i < count; ++i) {
+    begin_object(nullptr, true);
+    field_int(class_key, classes[i]);
+    field_float("score", scores[i], decimals);
+    end_object();
+  }
+  end_array();
+}
+
+void ResponseWriter::finish(int status, const char* content_type,
+                            bool keep_alive) {
+  if (overflow_ || depth_ != 0) {
+    body_end_ = kHeaderSpace;
+    overflow_ = false;
+    depth_ = 0;
+    put(kOverflowBody, sizeof(kOverflowBody) - 1);
+    status = 500;
+    content_type = "application/json";
+  }
+
+  char header[kHeaderSpace];
+  int length = snprintf(header, sizeof(header),
+                        "HTTP/1.1 %d %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "Access-Control-Allow-Origin: *\r\n"
+                        "%s"
+                        "Connection: %s\r\n"
+                        "Content-Length: %u\r\n"
+                        "\r\n",
+                        status, http_status_text(status), content_type,
+                        extra_headers_, keep_alive ? "keep-alive" : "close",
+                        static_cast<unsigned>(body_size()));
+  if (length < 0 || length >= static_cast<int>(sizeof(header))) {
+    // Não acontece com os headers fixos dos servidores; sem espaço, a
+    // resposta sai vazia e o cliente vê a conexão fechar.
+    start_ = body_end_;
+    return;
+  }
+  start_ = kHeaderSpace - length;
+  memcpy(buffer_ + start_, header, length);
+}
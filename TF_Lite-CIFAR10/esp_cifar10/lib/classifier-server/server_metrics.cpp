@@ -0,0 +1,136 @@
+#include "server_metrics.h"
+
+#include <string.h>
+
+namespace {
+
+const char* const kStageNames[ServerMetrics::kStageCount] = {
+    "receive", "parse", "queue", "preprocess", "invoke", "postprocess", "send",
+};
+
+const char* const kOutcomeNames[ServerMetrics::kOutcomeCount] = {
+    "ok", "error", "rejected", "failed",
+};
+
+// kBucketBoundsUs em segundos, como o Prometheus espera no label "le".
+const char* const kBucketLabels[ServerMetrics::kBuckets] = {
+    "0.0001", "0.0005", "0.001", "0.005", "0.01", "0.025",
+    "0.05",   "0.1",    "0.25",  "0.5",   "1",    "5",
+};
+
+// Microssegundos como segundos com seis casas, sem passar por float.
+void append_seconds(ResponseWriter& out, uint64_t us) {
+  out.append_uint(static_cast<unsigned long>(us / 1000000));
+  char fraction[8];
+  uint32_t rest = static_cast<uint32_t>(us % 1000000);
+  fraction[0] = '.';
+  for (int i = 6; i >= 1; --i) {
+    fraction[i] = static_cast<char>('0' + rest % 10);
+    rest /= 10;
+  }
+  out.append(fraction, 7);
+}
+
+void append_stage_series(ResponseWriter& out, const char* suffix,
+                         const char* stage) {
+  out.append("classifier_stage_seconds");
+  out.append(suffix);
+  out.append("{stage=\"");
+  out.append(stage);
+  out.append("\"");
+}
+
+}  // namespace
+
+const uint32_t ServerMetrics::kBucketBoundsUs[kBuckets] = {
+    100, 500, 1000, 5000, 10000, 25000,
+    50000, 100000, 250000, 500000, 1000000, 5000000,
+};
+
+ServerMetrics::ServerMetrics() {
+  memset(stages_, 0, sizeof(stages_));
+  memset(requests_, 0, sizeof(requests_));
+}
+
+void ServerMetrics::record(Stage stage, uint32_t duration_us) {
+  if (stage < 0 || stage >= kStageCount) return;
+  int bucket = 0;
+  while (bucket < kBuckets && duration_us > kBucketBoundsUs[bucket]) ++bucket;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Histogram& histogram = stages_[stage];
+  histogram.buckets[bucket]++;
+  histogram.count++;
+  histogram.sum_us += duration_us;
+}
+
+void ServerMetrics::count_request(Outcome outcome) {
+  if (outcome < 0 || outcome >= kOutcomeCount) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  requests_[outcome]++;
+}
+
+void ServerMetrics::write_metric(ResponseWriter& out, const char* name,
+                                 const char* type, const char* help,
+                                 unsigned long value) {
+  out.append("# HELP ");
+  out.append(name);
+  out.append(" ");
+  out.append(help);
+  out.append("\n# TYPE ");
+  out.append(name);
+  out.append(" ");
+  out.append(type);
+  out.append("\n");
+  out.append(name);
+  out.append(" ");
+  out.append_uint(value);
+  out.append("\n");
+}
+
+void ServerMetrics::write(ResponseWriter& out) const {
+  Histogram stages[kStageCount];
+  uint32_t requests[kOutcomeCount];
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memcpy(stages, stages_, sizeof(stages));
+    memcpy(requests, requests_, sizeof(requests));
+  }
+
+  out.append(
+      "# HELP classifier_requests_total Requisições respondidas, por "
+      "resultado.\n"
+      "# TYPE classifier_requests_total counter\n");
+  for (int i = 0; i < kOutcomeCount; ++i) {
+    out.append("classifier_requests_total{outcome=\"");
+    out.append(kOutcomeNames[i]);
+    out.append("\"} ");
+    out.append_uint(requests[i]);
+    out.append("\n");
+  }
+
+  out.append(
+      "# HELP classifier_stage_seconds Duração de cada etapa do pipeline.\n"
+      "# TYPE classifier_stage_seconds histogram\n");
+  for (int s = 0; s < kStageCount; ++s) {
+    const Histogram& histogram = stages[s];
+    uint32_t cumulative = 0;
+    for (int b = 0; b <= kBuckets; ++b) {
+      cumulative += histogram.buckets[b];
+      append_stage_series(out, "_bucket", kStageNames[s]);
+      out.append(",le=\"");
+      out.append(b < kBuckets ? kBucketLabels[b] : "+Inf");
+      out.append("\"} ");
+      out.append_uint(cumulative);
+      out.append("\n");
+    }
+    append_stage_series(out, "_sum", kStageNames[s]);
+    out.append("} ");
+    append_seconds(out, histogram.sum_us);
+    out.append("\n");
+    append_stage_series(out, "_count", kStageNames[s]);
+    out.append("} ");
+    out.append_uint(histogram.count);
+    out.append("\n");
+  }
+}
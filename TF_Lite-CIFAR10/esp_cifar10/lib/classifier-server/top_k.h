@@ -0,0 +1,22 @@
+#ifndef TOP_K_H_
+#define TOP_K_H_
+
+#include <stdint.h>
+
+// Maior k aceito por requisição (?top_k=N).
+constexpr int kMaxTopK = 10;
+
+// Seleciona as `k` maiores saídas int8 do modelo numa passada só e
+// desquantiza apenas elas: scores[i] = (valor - zero_point) * scale, a
+// probabilidade quando a saída é um softmax.
+//
+// Guarda um ranking parcial de até k entradas; cada valor é comparado com o
+// último do ranking e só os que entram pagam a inserção, então o custo fica
+// perto de uma leitura por classe mesmo com milhares de classes e nada é
+// ordenado além dos k escolhidos. Empates ficam com o menor índice primeiro,
+// como no argmax antigo. Devolve quantas entradas foram escritas em
+// `classes` e `scores` (min(k, count), com k limitado a 1..kMaxTopK).
+int select_top_k(const int8_t* values, int count, int k, float scale,
+                 int32_t zero_point, int* classes, float* scores);
+
+#endif  // TOP_K_H_
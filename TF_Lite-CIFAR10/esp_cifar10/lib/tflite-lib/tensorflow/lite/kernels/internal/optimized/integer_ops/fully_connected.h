@@ -0,0 +1,164 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/requantize.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Number of output channels computed per pass over the input vector, and
+// number of batch rows sharing each weight load when batches > 1.
+constexpr int kFullyConnectedRowBlock = 4;
+constexpr int kFullyConnectedBatchBlock = 2;
+
+// Weights are symmetric (zero_point == 0), so
+//   sum_d w[c][d] * (x[d] + input_offset)
+//     == sum_d w[c][d] * x[d] + input_offset * sum_d w[c][d].
+// Folding the second term into the bias once at Prepare time leaves a plain
+// int8 x int8 product (a 16-bit multiply) in the inner loop.
+inline void FullyConnectedPrecomputeBias(const int8_t* filter_data,
+                                         const int32_t* bias_data,
+                                         int32_t input_offset,
+                                         int output_depth, int accum_depth,
+                                         int32_t* effective_bias) {
+  for (int out_c = 0; out_c < output_depth; ++out_c) {
+    const int8_t* filter_row = filter_data + out_c * accum_depth;
+    int32_t filter_sum = 0;
+    for (int d = 0; d < accum_depth; ++d) {
+      filter_sum += filter_row[d];
+    }
+    effective_bias[out_c] = (bias_data ? bias_data[out_c] : 0) +
+                            filter_sum * input_offset;
+  }
+}
+
+// Accumulates kRows x kBatches dot products. Each input value is loaded once
+// per row block and each weight once per batch block.
+template <int kRows, int kBatches>
+inline void FullyConnectedTile(const int8_t* input_data,
+                               const int8_t* filter_data, int accum_depth,
+                               int32_t acc[kBatches][kRows]) {
+  for (int d = 0; d < accum_depth; ++d) {
+    int16_t input_val[kBatches];
+    for (int b = 0; b < kBatches; ++b) {
+      input_val[b] = input_data[b * accum_depth + d];
+    }
+    for (int r = 0; r < kRows; ++r) {
+      const int16_t filter_val = filter_data[r * accum_depth + d];
+      for (int b = 0; b < kBatches; ++b) {
+        acc[b][r] += input_val[b] * filter_val;
+      }
+    }
+  }
+}
+
+template <int kRows, int kBatches>
+inline void FullyConnectedBlock(const FullyConnectedParams& params,
+                                const int32_t* effective_bias,
+                                const int8_t* input_data,
+                                const int8_t* filter_data, int accum_depth,
+                                int output_depth, int8_t* output_data) {
+  int32_t acc[kBatches][kRows];
+  for (int b = 0; b < kBatches; ++b) {
+    for (int r = 0; r < kRows; ++r) {
+      acc[b][r] = effective_bias[r];
+    }
+  }
+  FullyConnectedTile<kRows, kBatches>(input_data, filter_data, accum_depth,
+                                      acc);
+  for (int b = 0; b < kBatches; ++b) {
+    RequantizeRow(acc[b], nullptr, params.output_multiplier,
+                  params.output_shift, params.output_offset,
+                  params.quantized_activation_min,
+                  params.quantized_activation_max, kRows,
+                  output_data + b * output_depth);
+  }
+}
+
+// Computes the first num_rows outputs of kBatches rows of output_depth
+// values.
+template <int kBatches>
+inline void FullyConnectedBatchRows(const FullyConnectedParams& params,
+                                    const int32_t* effective_bias,
+                                    const int8_t* input_data,
+                                    const int8_t* filter_data, int accum_depth,
+                                    int num_rows, int output_depth,
+                                    int8_t* output_data) {
+  int out_c = 0;
+  for (; out_c + kFullyConnectedRowBlock <= num_rows;
+       out_c += kFullyConnectedRowBlock) {
+    FullyConnectedBlock<kFullyConnectedRowBlock, kBatches>(
+        params, effective_bias + out_c, input_data,
+        filter_data + out_c * accum_depth, accum_depth, output_depth,
+        output_data + out_c);
+  }
+  for (; out_c < num_rows; ++out_c) {
+    FullyConnectedBlock<1, kBatches>(
+        params, effective_bias + out_c, input_data,
+        filter_data + out_c * accum_depth, accum_depth, output_depth,
+        output_data + out_c);
+  }
+}
+
+// Int8 fully-connected with per-tensor quantization. `effective_bias` must
+// come from FullyConnectedPrecomputeBias with the same filter and
+// params.input_offset; params.weights_offset must be zero.
+// With batches > 1 the kernel runs as a GEMM over kFullyConnectedBatchBlock
+// input rows at a time instead of repeating the matrix-vector product.
+inline void FullyConnected(const FullyConnectedParams& params,
+                           const int32_t* effective_bias,
+                           const RuntimeShape& input_shape,
+                           const int8_t* input_data,
+                           const RuntimeShape& filter_shape,
+                           const int8_t* filter_data,
+                           const RuntimeShape& output_shape,
+                           int8_t* output_data) {
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  TFLITE_DCHECK_GE(filter_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_GE(output_shape.DimensionsCount(), 1);
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+
+  int b = 0;
+  for (; b + kFullyConnectedBatchBlock <= batches;
+       b += kFullyConnectedBatchBlock) {
+    FullyConnectedBatchRows<kFullyConnectedBatchBlock>(
+        params, effective_bias, input_data + b * accum_depth, filter_data,
+        accum_depth, output_depth, output_depth,
+        output_data + b * output_depth);
+  }
+  for (; b < batches; ++b) {
+    FullyConnectedBatchRows<1>(params, effective_bias,
+                               input_data + b * accum_depth, filter_data,
+                               accum_depth, output_depth, output_depth,
+                               output_data + b * output_depth);
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_FULLY_CONNECTED_H_
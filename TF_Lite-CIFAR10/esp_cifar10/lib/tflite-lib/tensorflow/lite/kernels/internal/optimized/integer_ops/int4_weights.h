@@ -0,0 +1,312 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_INT4_WEIGHTS_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_INT4_WEIGHTS_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/requantize.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Kernels for kTfLiteInt4 filters, packed densely over the flattened tensor
+// with the even element in the low nibble (see
+// tensor_utils::UnpackDenseInt4IntoInt8). The nibbles are sign-extended in
+// registers inside the inner loops instead of unpacking the whole filter into
+// a scratch tensor. Arithmetic is the same as the int8 reference kernels with
+// the unpacked filter.
+
+inline int32_t Int4Low(int8_t byte) {
+  return static_cast<int8_t>(byte << 4) >> 4;
+}
+
+inline int32_t Int4High(int8_t byte) { return byte >> 4; }
+
+// Element `index` of a packed int4 tensor.
+inline int32_t Int4At(const int8_t* packed, int index) {
+  const int8_t byte = packed[index >> 1];
+  return (index & 1) ? Int4High(byte) : Int4Low(byte);
+}
+
+// sum_i filter[start + i] * (input[i] + input_offset) for i < count.
+inline int32_t DotInt4(const int8_t* input, int32_t input_offset,
+                       const int8_t* packed_filter, int start, int count) {
+  const int8_t* filter = packed_filter + (start >> 1);
+  int32_t acc = 0;
+  int i = 0;
+  if ((start & 1) && count > 0) {
+    acc += Int4High(*filter++) * (input[0] + input_offset);
+    i = 1;
+  }
+  for (; i + 2 <= count; i += 2) {
+    const int8_t pair = *filter++;
+    acc += Int4Low(pair) * (input[i] + input_offset) +
+           Int4High(pair) * (input[i + 1] + input_offset);
+  }
+  if (i < count) {
+    acc += Int4Low(*filter) * (input[i] + input_offset);
+  }
+  return acc;
+}
+
+// reference_integer_ops::ConvPerChannel with an int4 filter.
+inline void ConvPerChannelInt4(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* packed_filter, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data) {
+  const int32_t input_offset = params.input_offset;
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = input_shape.Dims(3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int filter_input_depth = filter_shape.Dims(3);
+  const int groups = input_depth / filter_input_depth;
+  TFLITE_DCHECK_EQ(input_depth % filter_input_depth, 0);
+  const int filters_per_group = output_depth / groups;
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int filter_row_length =
+      filter_height * filter_width * filter_input_depth;
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+        int8_t* output_pixel =
+            output_data + Offset(output_shape, batch, out_y, out_x, 0);
+        for (int first_channel = 0; first_channel < output_depth;
+             first_channel += kRequantizeBlockSize) {
+          const int num_channels =
+              std::min(kRequantizeBlockSize, output_depth - first_channel);
+          int32_t acc[kRequantizeBlockSize];
+          for (int c = 0; c < num_channels; ++c) {
+            const int out_channel = first_channel + c;
+            const int group = out_channel / filters_per_group;
+            acc[c] = 0;
+            for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+              const int in_y = in_y_origin + dilation_height_factor * filter_y;
+              if (in_y < 0 || in_y >= input_height) {
+                continue;
+              }
+              for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+                const int in_x =
+                    in_x_origin + dilation_width_factor * filter_x;
+                if (in_x < 0 || in_x >= input_width) {
+                  continue;
+                }
+                acc[c] += DotInt4(
+                    input_data + Offset(input_shape, batch, in_y, in_x,
+                                        group * filter_input_depth),
+                    input_offset, packed_filter,
+                    out_channel * filter_row_length +
+                        (filter_y * filter_width + filter_x) *
+                            filter_input_depth,
+                    filter_input_depth);
+              }
+            }
+          }
+          RequantizeRowPerChannel(
+              acc, bias_data ? bias_data + first_channel : nullptr,
+              output_multiplier + first_channel, output_shift + first_channel,
+              output_offset, output_activation_min, output_activation_max,
+              num_channels, output_pixel + first_channel);
+        }
+      }
+    }
+  }
+}
+
+// reference_integer_ops::DepthwiseConvPerChannel with an int4 filter. For a
+// filter tap the output channels are consecutive nibbles, so each tap is
+// applied to the whole pixel at once into `acc_buffer` (output_depth values).
+inline void DepthwiseConvPerChannelInt4(
+    const DepthwiseParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* packed_filter, const RuntimeShape& bias_shape,
+    const int32_t* bias_data, const RuntimeShape& output_shape,
+    int8_t* output_data, int32_t* acc_buffer) {
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int depth_multiplier = params.depth_multiplier;
+  const int32_t input_offset = params.input_offset;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int output_depth = MatchingDim(filter_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  TFLITE_DCHECK_EQ(output_depth, input_depth * depth_multiplier);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+        std::fill(acc_buffer, acc_buffer + output_depth, 0);
+        for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+          const int in_y = in_y_origin + dilation_height_factor * filter_y;
+          if (in_y < 0 || in_y >= input_height) {
+            continue;
+          }
+          for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+            const int in_x = in_x_origin + dilation_width_factor * filter_x;
+            if (in_x < 0 || in_x >= input_width) {
+              continue;
+            }
+            const int8_t* input_pixel =
+                input_data + Offset(input_shape, batch, in_y, in_x, 0);
+            const int tap_start =
+                (filter_y * filter_width + filter_x) * output_depth;
+            if (depth_multiplier == 1 && (tap_start & 1) == 0) {
+              const int8_t* filter = packed_filter + (tap_start >> 1);
+              int c = 0;
+              for (; c + 2 <= output_depth; c += 2) {
+                const int8_t pair = *filter++;
+                acc_buffer[c] +=
+                    Int4Low(pair) * (input_pixel[c] + input_offset);
+                acc_buffer[c + 1] +=
+                    Int4High(pair) * (input_pixel[c + 1] + input_offset);
+              }
+              if (c < output_depth) {
+                acc_buffer[c] +=
+                    Int4Low(*filter) * (input_pixel[c] + input_offset);
+              }
+            } else {
+              for (int c = 0; c < output_depth; ++c) {
+                acc_buffer[c] += Int4At(packed_filter, tap_start + c) *
+                                 (input_pixel[c / depth_multiplier] +
+                                  input_offset);
+              }
+            }
+          }
+        }
+        int8_t* output_pixel =
+            output_data + Offset(output_shape, batch, out_y, out_x, 0);
+        RequantizeRowPerChannel(acc_buffer, bias_data, output_multiplier,
+                                output_shift, output_offset,
+                                output_activation_min, output_activation_max,
+                                output_depth, output_pixel);
+      }
+    }
+  }
+}
+
+// FullyConnectedPrecomputeBias for an int4 filter.
+inline void FullyConnectedPrecomputeBiasInt4(const int8_t* packed_filter,
+                                             const int32_t* bias_data,
+                                             int32_t input_offset,
+                                             int output_depth, int accum_depth,
+                                             int32_t* effective_bias) {
+  for (int out_c = 0; out_c < output_depth; ++out_c) {
+    int32_t filter_sum = 0;
+    for (int d = 0; d < accum_depth; ++d) {
+      filter_sum += Int4At(packed_filter, out_c * accum_depth + d);
+    }
+    effective_bias[out_c] = (bias_data ? bias_data[out_c] : 0) +
+                            filter_sum * input_offset;
+  }
+}
+
+// optimized_integer_ops::FullyConnected with an int4 filter. `effective_bias`
+// must come from FullyConnectedPrecomputeBiasInt4.
+inline void FullyConnectedInt4(const FullyConnectedParams& params,
+                               const int32_t* effective_bias,
+                               const RuntimeShape& input_shape,
+                               const int8_t* input_data,
+                               const RuntimeShape& filter_shape,
+                               const int8_t* packed_filter,
+                               const RuntimeShape& output_shape,
+                               int8_t* output_data) {
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  TFLITE_DCHECK_GE(filter_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_GE(output_shape.DimensionsCount(), 1);
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+
+  for (int b = 0; b < batches; ++b) {
+    const int8_t* input_row = input_data + b * accum_depth;
+    int8_t* output_row = output_data + b * output_depth;
+    for (int first_c = 0; first_c < output_depth;
+         first_c += kRequantizeBlockSize) {
+      const int num_rows =
+          std::min(kRequantizeBlockSize, output_depth - first_c);
+      int32_t acc[kRequantizeBlockSize];
+      for (int r = 0; r < num_rows; ++r) {
+        acc[r] = DotInt4(input_row, 0, packed_filter,
+                         (first_c + r) * accum_depth, accum_depth);
+      }
+      RequantizeRow(acc, effective_bias + first_c, params.output_multiplier,
+                    params.output_shift, params.output_offset,
+                    params.quantized_activation_min,
+                    params.quantized_activation_max, num_rows,
+                    output_row + first_c);
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_INT4_WEIGHTS_H_
@@ -0,0 +1,166 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_REDUCE_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_REDUCE_H_
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/reference/reduce.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// A reduction over a contiguous run of axes views the input as
+// [outer, reduced, inner]: Mean over H,W of an NHWC tensor is
+// [N, H * W, C], a reduction over the last axis is [..., C, 1]. The output,
+// with or without keep_dims, is then [outer, inner] in the same order.
+struct ContiguousReduceShape {
+  int outer;
+  int reduced;
+  int inner;
+};
+
+// Fills `shape` and returns true when the resolved axes form one contiguous
+// run over a non-empty input. `resolved_axis` needs room for num_axis ints.
+inline bool GetContiguousReduceShape(const int* input_dims, int num_dims,
+                                     const int* axis, int num_axis,
+                                     int* resolved_axis,
+                                     ContiguousReduceShape* shape) {
+  int num_resolved_axis = 0;
+  if (!reference_ops::ResolveAxis(num_dims, axis, num_axis, resolved_axis,
+                                  &num_resolved_axis) ||
+      num_resolved_axis == 0) {
+    return false;
+  }
+  int first_axis = num_dims;
+  int last_axis = -1;
+  for (int i = 0; i < num_resolved_axis; ++i) {
+    first_axis = std::min(first_axis, resolved_axis[i]);
+    last_axis = std::max(last_axis, resolved_axis[i]);
+  }
+  // ResolveAxis drops duplicates, so the run is contiguous iff it has no
+  // holes.
+  if (last_axis - first_axis + 1 != num_resolved_axis) {
+    return false;
+  }
+  shape->outer = 1;
+  shape->reduced = 1;
+  shape->inner = 1;
+  for (int i = 0; i < num_dims; ++i) {
+    if (input_dims[i] == 0) {
+      return false;
+    }
+    if (i < first_axis) {
+      shape->outer *= input_dims[i];
+    } else if (i <= last_axis) {
+      shape->reduced *= input_dims[i];
+    } else {
+      shape->inner *= input_dims[i];
+    }
+  }
+  return true;
+}
+
+// Sums `reduced` rows of `inner` values into `sums`, vectorized across the
+// inner dimension.
+inline void SumRows(const int8_t* input_data, int reduced, int inner,
+                    int32_t* sums) {
+  if (inner == 1) {
+    int32_t sum = 0;
+    for (int r = 0; r < reduced; ++r) {
+      sum += input_data[r];
+    }
+    sums[0] = sum;
+    return;
+  }
+  std::fill(sums, sums + inner, 0);
+  for (int r = 0; r < reduced; ++r) {
+    for (int i = 0; i < inner; ++i) {
+      sums[i] += input_data[i];
+    }
+    input_data += inner;
+  }
+}
+
+// Int8 Mean or Sum over a contiguous run of axes with int32 accumulators
+// and one requantization per output. `output_multiplier`/`output_shift`
+// encode input_scale / output_scale; for Mean 1 / reduced is folded in the
+// same way as reference_ops::QuantizedMeanOrSum, which this matches
+// bit-exactly. `sums` needs room for `shape.inner` int32 values.
+inline void QuantizedMeanOrSum(const ContiguousReduceShape& shape,
+                               const int8_t* input_data,
+                               int32_t input_zero_point,
+                               int32_t output_multiplier, int output_shift,
+                               int32_t output_zero_point, bool compute_sum,
+                               int8_t* output_data, int32_t* sums) {
+  if (!compute_sum) {
+    int shift = 63 - CountLeadingZeros(static_cast<uint64_t>(shape.reduced));
+    shift = std::min(shift, 32);
+    shift = std::min(shift, 31 + output_shift);
+    output_multiplier = static_cast<int32_t>(
+        (static_cast<int64_t>(output_multiplier) << shift) / shape.reduced);
+    output_shift = output_shift - shift;
+  }
+  const int32_t zero_point_sum = input_zero_point * shape.reduced;
+  for (int o = 0; o < shape.outer; ++o) {
+    SumRows(input_data, shape.reduced, shape.inner, sums);
+    for (int i = 0; i < shape.inner; ++i) {
+      int32_t output = MultiplyByQuantizedMultiplier(sums[i] - zero_point_sum,
+                                                     output_multiplier,
+                                                     output_shift) +
+                       output_zero_point;
+      output = std::min<int32_t>(
+          std::max<int32_t>(output, std::numeric_limits<int8_t>::min()),
+          std::numeric_limits<int8_t>::max());
+      output_data[i] = static_cast<int8_t>(output);
+    }
+    input_data += shape.reduced * shape.inner;
+    output_data += shape.inner;
+  }
+}
+
+// ReduceMax over a contiguous run of axes. The int8 kernel requires equal
+// input and output quantization, so this is a plain max.
+inline void ReduceMax(const ContiguousReduceShape& shape,
+                      const int8_t* input_data, int8_t* output_data) {
+  for (int o = 0; o < shape.outer; ++o) {
+    if (shape.inner == 1) {
+      int8_t max = std::numeric_limits<int8_t>::lowest();
+      for (int r = 0; r < shape.reduced; ++r) {
+        max = std::max(max, input_data[r]);
+      }
+      output_data[0] = max;
+    } else {
+      std::fill(output_data, output_data + shape.inner,
+                std::numeric_limits<int8_t>::lowest());
+      const int8_t* row = input_data;
+      for (int r = 0; r < shape.reduced; ++r) {
+        for (int i = 0; i < shape.inner; ++i) {
+          output_data[i] = std::max(output_data[i], row[i]);
+        }
+        row += shape.inner;
+      }
+    }
+    input_data += shape.reduced * shape.inner;
+    output_data += shape.inner;
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_REDUCE_H_
@@ -0,0 +1,210 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_SPARSE_WEIGHTS_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_SPARSE_WEIGHTS_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/requantize.h"
+#include "tensorflow/lite/kernels/internal/portable_tensor_utils.h"
+
+namespace tflite {
+
+// Int8 weights pruned in 1 x block_size blocks along their last dimension,
+// in the TFLite block-sparse layout: every dimension but the last is dense and
+// flattened into num_rows rows, and the tensor data holds only the nonzero
+// blocks, row by row.
+struct BlockSparseWeightsParams {
+  // Row r owns blocks [segments[r], segments[r + 1]); num_rows + 1 entries.
+  // nullptr for dense weights.
+  const int32_t* segments;
+  // Column of each nonzero block, in units of block_size.
+  const int32_t* indices;
+  int block_size;
+  int num_rows;
+  int row_length;
+};
+
+namespace optimized_integer_ops {
+
+template <int kBlockSize>
+inline void ConvPerChannelBlockSparseImpl(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const BlockSparseWeightsParams& weights, const int8_t* filter_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data) {
+  const int32_t input_offset = params.input_offset;
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = input_shape.Dims(3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int filter_input_depth = filter_shape.Dims(3);
+  const int groups = input_depth / filter_input_depth;
+  TFLITE_DCHECK_EQ(input_depth % filter_input_depth, 0);
+  const int filters_per_group = output_depth / groups;
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  TFLITE_DCHECK_EQ(weights.num_rows,
+                   output_depth * filter_height * filter_width);
+  TFLITE_DCHECK_EQ(weights.row_length, filter_input_depth);
+  const int32_t* segments = weights.segments;
+  const int32_t* indices = weights.indices;
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+        int8_t* output_pixel =
+            output_data + Offset(output_shape, batch, out_y, out_x, 0);
+        for (int first_channel = 0; first_channel < output_depth;
+             first_channel += kRequantizeBlockSize) {
+          const int num_channels =
+              std::min(kRequantizeBlockSize, output_depth - first_channel);
+          int32_t acc[kRequantizeBlockSize];
+          for (int oc = 0; oc < num_channels; ++oc) {
+            const int out_channel = first_channel + oc;
+            const int group = out_channel / filters_per_group;
+            acc[oc] = 0;
+            for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+              const int in_y = in_y_origin + dilation_height_factor * filter_y;
+              if (in_y < 0 || in_y >= input_height) {
+                continue;
+              }
+              for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+                const int in_x =
+                    in_x_origin + dilation_width_factor * filter_x;
+                if (in_x < 0 || in_x >= input_width) {
+                  continue;
+                }
+                // One row per filter tap, covering its input channels.
+                const int row =
+                    (out_channel * filter_height + filter_y) * filter_width +
+                    filter_x;
+                const int8_t* input_ptr =
+                    input_data + Offset(input_shape, batch, in_y, in_x,
+                                        group * filter_input_depth);
+                const int8_t* filter_ptr =
+                    filter_data + segments[row] * kBlockSize;
+                for (int i = segments[row]; i < segments[row + 1]; ++i) {
+                  const int8_t* input_block =
+                      input_ptr + indices[i] * kBlockSize;
+                  for (int c = 0; c < kBlockSize; ++c) {
+                    acc[oc] += filter_ptr[c] * (input_block[c] + input_offset);
+                  }
+                  filter_ptr += kBlockSize;
+                }
+              }
+            }
+          }
+          RequantizeRowPerChannel(
+              acc, bias_data ? bias_data + first_channel : nullptr,
+              output_multiplier + first_channel, output_shift + first_channel,
+              output_offset, output_activation_min, output_activation_max,
+              num_channels, output_pixel + first_channel);
+        }
+      }
+    }
+  }
+}
+
+// reference_integer_ops::ConvPerChannel with block-sparse filter rows, one
+// per output channel and filter tap. Only the nonzero blocks are multiplied;
+// filter taps falling into the padding are skipped as in the reference.
+inline void ConvPerChannelBlockSparse(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const BlockSparseWeightsParams& weights, const int8_t* filter_data,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data) {
+  if (weights.block_size == 16) {
+    ConvPerChannelBlockSparseImpl<16>(
+        params, output_multiplier, output_shift, input_shape, input_data,
+        filter_shape, weights, filter_data, bias_shape, bias_data,
+        output_shape, output_data);
+  } else {
+    TFLITE_DCHECK_EQ(weights.block_size, 4);
+    ConvPerChannelBlockSparseImpl<4>(
+        params, output_multiplier, output_shift, input_shape, input_data,
+        filter_shape, weights, filter_data, bias_shape, bias_data,
+        output_shape, output_data);
+  }
+}
+
+// reference_integer_ops::FullyConnected with block-sparse filter rows, through
+// the tensor_utils sparse matrix-vector kernels.
+inline void FullyConnectedBlockSparse(const FullyConnectedParams& params,
+                                      const RuntimeShape& input_shape,
+                                      const int8_t* input_data,
+                                      const BlockSparseWeightsParams& weights,
+                                      const int8_t* filter_data,
+                                      const int32_t* bias_data,
+                                      const RuntimeShape& output_shape,
+                                      int8_t* output_data) {
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  TFLITE_DCHECK_GE(output_shape.DimensionsCount(), 1);
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_EQ(output_depth, weights.num_rows);
+  if (weights.block_size == 16) {
+    tensor_utils::SparseMatrixBatchVectorMultiplyAccumulate1x16(
+        filter_data, weights.segments, weights.indices, output_depth,
+        weights.row_length, input_data, bias_data, batches,
+        params.input_offset, params.output_multiplier, params.output_shift,
+        nullptr, nullptr, params.output_offset,
+        params.quantized_activation_min, params.quantized_activation_max,
+        output_data);
+  } else {
+    TFLITE_DCHECK_EQ(weights.block_size, 4);
+    tensor_utils::SparseMatrixBatchVectorMultiplyAccumulate1x4(
+        filter_data, weights.segments, weights.indices, output_depth,
+        weights.row_length, input_data, bias_data, batches,
+        params.input_offset, params.output_multiplier, params.output_shift,
+        nullptr, nullptr, params.output_offset,
+        params.quantized_activation_min, params.quantized_activation_max,
+        output_data);
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_SPARSE_WEIGHTS_H_
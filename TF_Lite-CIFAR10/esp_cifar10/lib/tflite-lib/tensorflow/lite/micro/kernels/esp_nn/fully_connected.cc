@@ -18,6 +18,12 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int16_activations.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int4_weights.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/palettized_weights.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/sparse_weights.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
@@ -37,10 +43,25 @@ long long fc_total_time = 0;
 namespace tflite {
 namespace {
 
+struct NodeData {
+  OpDataFullyConnected op_data;
+  // Bias with the input zero point folded in, one entry per output channel.
+  // Only set for int8 layers with constant weights, and with ESP_NN only for
+  // palettized or int4 ones. The block-sparse kernels apply the zero point
+  // themselves.
+  int32_t* effective_bias;
+  // Set when the filter is palettized. Rows are decoded tile_rows at a time
+  // into the tile_buffer_idx scratch buffer.
+  PalettizedWeightsParams palettized_filter;
+  int tile_rows;
+  int tile_buffer_idx;
+  // Set when the filter is block sparse.
+  BlockSparseWeightsParams sparse_filter;
+};
+
 void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   TFLITE_DCHECK(context->AllocatePersistentBuffer != nullptr);
-  return context->AllocatePersistentBuffer(context,
-                                           sizeof(OpDataFullyConnected));
+  return context->AllocatePersistentBuffer(context, sizeof(NodeData));
 }
 
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
@@ -49,7 +70,8 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TFLITE_DCHECK(node->user_data != nullptr);
   TFLITE_DCHECK(node->builtin_data != nullptr);
 
-  auto* data = static_cast<OpDataFullyConnected*>(node->user_data);
+  auto* node_data = static_cast<NodeData*>(node->user_data);
+  OpDataFullyConnected* data = &node_data->op_data;
   const auto params =
       static_cast<const TfLiteFullyConnectedParams*>(node->builtin_data);
 
@@ -66,13 +88,91 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE(context, output != nullptr);
 
   TF_LITE_ENSURE_TYPES_EQ(context, input->type, output->type);
-  TF_LITE_ENSURE_MSG(context, input->type == filter->type,
-                     "Hybrid models are not supported on TFLite Micro.");
+  TF_LITE_ENSURE_MSG(
+      context,
+      input->type == filter->type ||
+          (input->type == kTfLiteInt8 && filter->type == kTfLiteInt4) ||
+          (input->type == kTfLiteInt16 && filter->type == kTfLiteInt8),
+      "Hybrid models are not supported on TFLite Micro.");
 
   TF_LITE_ENSURE_OK(context, CalculateOpDataFullyConnected(
                                  context, params->activation, input->type,
                                  input, filter, bias, output, data));
 
+  node_data->effective_bias = nullptr;
+  PalettizedWeightsParams& palettized_filter = node_data->palettized_filter;
+  TF_LITE_ENSURE_STATUS(micro_context->GetInputPalettizedWeights(
+      node, kFullyConnectedWeightsTensor, &palettized_filter));
+  BlockSparseWeightsParams& sparse_filter = node_data->sparse_filter;
+  TF_LITE_ENSURE_STATUS(micro_context->GetInputBlockSparseWeights(
+      node, kFullyConnectedWeightsTensor, &sparse_filter));
+  if (sparse_filter.segments != nullptr) {
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE(context, palettized_filter.palette == nullptr);
+    // The tensor_utils sparse kernels take no filter offset.
+    TF_LITE_ENSURE_EQ(context, data->filter_zero_point, 0);
+    TF_LITE_ENSURE_EQ(context, sparse_filter.num_rows,
+                      output->dims->data[output->dims->size - 1]);
+  } else if (palettized_filter.palette != nullptr) {
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, data->filter_zero_point, 0);
+    TF_LITE_ENSURE(context, bias == nullptr || IsConstantTensor(bias));
+    const int output_depth = palettized_filter.num_rows;
+    const int accum_depth = palettized_filter.row_length;
+    node_data->effective_bias =
+        static_cast<int32_t*>(context->AllocatePersistentBuffer(
+            context, output_depth * sizeof(int32_t)));
+    TF_LITE_ENSURE(context, node_data->effective_bias != nullptr);
+    uint8_t* row =
+        micro_context->AllocateTempBuffer(accum_depth, alignof(int8_t));
+    TF_LITE_ENSURE(context, row != nullptr);
+    optimized_integer_ops::FullyConnectedPrecomputeBiasPalettized(
+        palettized_filter, GetTensorData<uint8_t>(filter),
+        bias != nullptr ? GetTensorData<int32_t>(bias) : nullptr,
+        -data->input_zero_point, reinterpret_cast<int8_t*>(row),
+        node_data->effective_bias);
+    micro_context->DeallocateTempBuffer(row);
+
+    node_data->tile_rows =
+        optimized_integer_ops::PalettizedWeightsTileRows(palettized_filter);
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, node_data->tile_rows * accum_depth,
+        &node_data->tile_buffer_idx));
+  } else if (filter->type == kTfLiteInt4) {
+    TF_LITE_ENSURE_EQ(context, data->filter_zero_point, 0);
+    TF_LITE_ENSURE(context, IsConstantTensor(filter));
+    TF_LITE_ENSURE(context, bias == nullptr || IsConstantTensor(bias));
+    const int filter_dim_count = NumDimensions(filter);
+    const int output_depth = filter->dims->data[filter_dim_count - 2];
+    const int accum_depth = filter->dims->data[filter_dim_count - 1];
+    node_data->effective_bias =
+        static_cast<int32_t*>(context->AllocatePersistentBuffer(
+            context, output_depth * sizeof(int32_t)));
+    TF_LITE_ENSURE(context, node_data->effective_bias != nullptr);
+    optimized_integer_ops::FullyConnectedPrecomputeBiasInt4(
+        GetTensorData<int8_t>(filter),
+        bias != nullptr ? GetTensorData<int32_t>(bias) : nullptr,
+        -data->input_zero_point, output_depth, accum_depth,
+        node_data->effective_bias);
+  }
+#if !ESP_NN
+  else if (input->type == kTfLiteInt8 && IsConstantTensor(filter) &&
+           (bias == nullptr || IsConstantTensor(bias))) {
+    const int filter_dim_count = NumDimensions(filter);
+    const int output_depth = filter->dims->data[filter_dim_count - 2];
+    const int accum_depth = filter->dims->data[filter_dim_count - 1];
+    node_data->effective_bias =
+        static_cast<int32_t*>(context->AllocatePersistentBuffer(
+            context, output_depth * sizeof(int32_t)));
+    TF_LITE_ENSURE(context, node_data->effective_bias != nullptr);
+    optimized_integer_ops::FullyConnectedPrecomputeBias(
+        GetTensorData<int8_t>(filter),
+        bias != nullptr ? GetTensorData<int32_t>(bias) : nullptr,
+        -data->input_zero_point, output_depth, accum_depth,
+        node_data->effective_bias);
+  }
+#endif
+
   micro_context->DeallocateTempTfLiteTensor(input);
   micro_context->DeallocateTempTfLiteTensor(filter);
   if (bias != nullptr) {
@@ -97,14 +197,15 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       tflite::micro::GetEvalOutput(context, node, kFullyConnectedOutputTensor);
 
   TFLITE_DCHECK(node->user_data != nullptr);
-  const auto& data =
-      *(static_cast<const OpDataFullyConnected*>(node->user_data));
+  const auto& node_data = *(static_cast<const NodeData*>(node->user_data));
+  const auto& data = node_data.op_data;
 
   long long start_time = esp_timer_get_time();
-  // Checks in Prepare ensure input, output and filter types are all the same.
+  // Checks in Prepare ensure input, output and filter types are all the same,
+  // except for int4 filters of int8 layers and int8 filters of int16 layers.
   switch (input->type) {
     case kTfLiteFloat32: {
-      tflite::reference_ops::FullyConnected(
+      tflite::optimized_ops::FullyConnected(
           FullyConnectedParamsFloat(params->activation),
           tflite::micro::GetTensorShape(input),
           tflite::micro::GetTensorData<float>(input),
@@ -121,6 +222,42 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       const int32_t* bias_data =
           nullptr != bias ? tflite::micro::GetTensorData<int32_t>(bias)
                           : nullptr;
+      if (node_data.palettized_filter.palette != nullptr) {
+        optimized_integer_ops::FullyConnectedPalettized(
+            FullyConnectedParamsQuantized(data), node_data.effective_bias,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            node_data.palettized_filter,
+            tflite::micro::GetTensorData<uint8_t>(filter),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output),
+            static_cast<int8_t*>(context->GetScratchBuffer(
+                context, node_data.tile_buffer_idx)),
+            node_data.tile_rows);
+        break;
+      }
+      if (node_data.sparse_filter.segments != nullptr) {
+        optimized_integer_ops::FullyConnectedBlockSparse(
+            FullyConnectedParamsQuantized(data),
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            node_data.sparse_filter,
+            tflite::micro::GetTensorData<int8_t>(filter), bias_data,
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output));
+        break;
+      }
+      if (filter->type == kTfLiteInt4) {
+        optimized_integer_ops::FullyConnectedInt4(
+            FullyConnectedParamsQuantized(data), node_data.effective_bias,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output));
+        break;
+      }
 #if ESP_NN
       const RuntimeShape& filter_shape = tflite::micro::GetTensorShape(filter);
       const RuntimeShape& output_shape = tflite::micro::GetTensorShape(output);
@@ -147,6 +284,17 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
         output_data += output_depth;
       }
 #else
+      if (node_data.effective_bias != nullptr) {
+        optimized_integer_ops::FullyConnected(
+            FullyConnectedParamsQuantized(data), node_data.effective_bias,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output));
+        break;
+      }
       tflite::reference_integer_ops::FullyConnected(
           FullyConnectedParamsQuantized(data),
           tflite::micro::GetTensorShape(input),
@@ -160,6 +308,32 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       break;
     }
 
+    case kTfLiteInt16: {
+      if (data.input_zero_point == 0 && data.filter_zero_point == 0) {
+        optimized_integer_ops::FullyConnected16x8(
+            FullyConnectedParamsQuantized(data),
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int16_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetOptionalTensorData<int64_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int16_t>(output));
+        break;
+      }
+      tflite::reference_integer_ops::FullyConnected(
+          FullyConnectedParamsQuantized(data),
+          tflite::micro::GetTensorShape(input),
+          tflite::micro::GetTensorData<int16_t>(input),
+          tflite::micro::GetTensorShape(filter),
+          tflite::micro::GetTensorData<int8_t>(filter),
+          tflite::micro::GetTensorShape(bias),
+          tflite::micro::GetOptionalTensorData<int64_t>(bias),
+          tflite::micro::GetTensorShape(output),
+          tflite::micro::GetTensorData<int16_t>(output));
+      break;
+    }
+
     case kTfLiteUInt8: {
       tflite::reference_ops::FullyConnected(
           FullyConnectedParamsQuantized(data),
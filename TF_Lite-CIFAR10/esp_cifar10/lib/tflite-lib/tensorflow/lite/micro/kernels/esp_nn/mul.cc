@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/lite/micro/kernels/mul.h"
 
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/mul.h"
 #include "tensorflow/lite/kernels/internal/reference/mul.h"
@@ -35,26 +36,60 @@ limitations under the License.
 long long mul_total_time = 0;
 
 namespace tflite {
-#if ESP_NN
+namespace {
+
+void SetMulQuantizedParams(const OpDataMul* data,
+                           tflite::ArithmeticParams* op_params) {
+  op_params->quantized_activation_min = data->output_activation_min;
+  op_params->quantized_activation_max = data->output_activation_max;
+  op_params->float_activation_max = data->output_activation_max_f32;
+  op_params->input1_offset = -data->input1_zero_point;
+  op_params->input2_offset = -data->input2_zero_point;
+  op_params->output_offset = data->output_zero_point;
+  op_params->output_multiplier = data->output_multiplier;
+  op_params->output_shift = data->output_shift;
+}
+
+// Int8 Mul through the shared binary-elementwise engine. Returns false when
+// the shapes need the generic broadcast.
+bool EvalMulInt8Optimized(const ArithmeticParams& op_params,
+                          bool need_broadcast, const TfLiteEvalTensor* input1,
+                          const TfLiteEvalTensor* input2,
+                          TfLiteEvalTensor* output) {
+  if (!optimized_integer_ops::BinaryElementwiseSupported(op_params,
+                                                         need_broadcast)) {
+    return false;
+  }
+  optimized_integer_ops::BinaryElementwise(
+      op_params, need_broadcast, tflite::micro::GetTensorShape(input1),
+      tflite::micro::GetTensorData<int8_t>(input1),
+      tflite::micro::GetTensorShape(input2),
+      tflite::micro::GetTensorData<int8_t>(input2),
+      tflite::micro::GetTensorShape(output),
+      tflite::micro::GetTensorData<int8_t>(output),
+      optimized_integer_ops::MulOp(op_params));
+  return true;
+}
+
+}  // namespace
+
 void MulEvalQuantized(TfLiteContext* context, TfLiteNode* node,
                       const OpDataMul* data, const TfLiteEvalTensor* input1,
                       const TfLiteEvalTensor* input2,
                       TfLiteEvalTensor* output) {
   tflite::ArithmeticParams op_params = {};
-  op_params.quantized_activation_min = data->output_activation_min;
-  op_params.quantized_activation_max = data->output_activation_max;
-  op_params.float_activation_max = data->output_activation_max_f32;
-  op_params.input1_offset = -data->input1_zero_point;
-  op_params.input2_offset = -data->input2_zero_point;
-  op_params.output_offset = data->output_zero_point;
-  op_params.output_multiplier = data->output_multiplier;
-  op_params.output_shift = data->output_shift;
+  SetMulQuantizedParams(data, &op_params);
 
   bool need_broadcast = reference_ops::ProcessBroadcastShapes(
       tflite::micro::GetTensorShape(input1),
       tflite::micro::GetTensorShape(input2), &op_params);
 
+#if ESP_NN
   if (need_broadcast) {
+    if (EvalMulInt8Optimized(op_params, need_broadcast, input1, input2,
+                             output)) {
+      return;
+    }
     reference_integer_ops::BroadcastMul4DSlow(
         op_params, tflite::micro::GetTensorShape(input1),
         tflite::micro::GetTensorData<int8_t>(input1),
@@ -75,8 +110,13 @@ void MulEvalQuantized(TfLiteContext* context, TfLiteNode* node,
                                                     tflite::micro::GetTensorShape(input2),
                                                     tflite::micro::GetTensorShape(output)));
   }
-}
+#else
+  if (!EvalMulInt8Optimized(op_params, need_broadcast, input1, input2,
+                            output)) {
+    EvalMulQuantizedReference(context, node, data, input1, input2, output);
+  }
 #endif
+}
 
 TfLiteStatus MulEval(TfLiteContext* context, TfLiteNode* node) {
   TFLITE_DCHECK(node->builtin_data != nullptr);
@@ -95,11 +135,7 @@ TfLiteStatus MulEval(TfLiteContext* context, TfLiteNode* node) {
   long long start_time = esp_timer_get_time();
   switch (input1->type) {
     case kTfLiteInt8:
-#if ESP_NN
       MulEvalQuantized(context, node, data, input1, input2, output);
-#else
-      EvalMulQuantizedReference(context, node, data, input1, input2, output);
-#endif
       break;
     case kTfLiteInt32:
       EvalMulQuantizedReference(context, node, data, input1, input2, output);
@@ -21,6 +21,10 @@ limitations under the License.
 #include "tensorflow/lite/micro/micro_graph.h"
 
 namespace tflite {
+
+struct BlockSparseWeightsParams;
+struct PalettizedWeightsParams;
+
 // MicroContext is eventually going to become the API between TFLM and the
 // kernels, replacing all the functions in TfLiteContext. The end state is code
 // kernels to have code like:
@@ -89,6 +93,21 @@ class MicroContext {
   virtual TfLiteTensor* AllocateTempIntermediateTensor(const TfLiteNode* node,
                                                        int index);
 
+  // Fills `params` from the model's palettized weights metadata for the
+  // specified input tensor of a given node. params->palette is left null when
+  // the tensor holds plain values. This API is only valid from the kernel's
+  // Prepare function.
+  // Virtual so that it can be faked for kernel tests.
+  virtual TfLiteStatus GetInputPalettizedWeights(
+      const TfLiteNode* node, int index, PalettizedWeightsParams* params);
+
+  // Fills `params` from the sparsity parameters of the specified input tensor
+  // of a given node. params->segments is left null when the tensor is dense.
+  // This API is only valid from the kernel's Prepare function.
+  // Virtual so that it can be faked for kernel tests.
+  virtual TfLiteStatus GetInputBlockSparseWeights(
+      const TfLiteNode* node, int index, BlockSparseWeightsParams* params);
+
   // Deallocates a temp TfLiteTensor.
   // Virtual so that it can be faked for kernel tests.
   virtual void DeallocateTempTfLiteTensor(TfLiteTensor* tensor);
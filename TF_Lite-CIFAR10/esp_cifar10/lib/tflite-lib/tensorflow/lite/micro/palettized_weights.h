@@ -0,0 +1,51 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_PALETTIZED_WEIGHTS_H_
+#define TENSORFLOW_LITE_MICRO_PALETTIZED_WEIGHTS_H_
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/palettized_weights.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+
+// Name of the model metadata listing the palettized weight tensors, as written
+// by micro/tools/palettize_weights.py. The metadata buffer holds uint32 words:
+//
+//   [0] version (kPalettizedWeightsVersion)
+//   [1] number of entries
+//   then per entry:
+//   [0] subgraph index
+//   [1] tensor index
+//   [2] index bits, 1 to 8
+//   [3] palette size, always 1 << index bits
+//   [4] palette channels, 1 or the tensor's dimension 0
+//   [5] index of the buffer holding the int8 palettes
+//
+// The buffer of a listed tensor holds its packed indices instead of int8
+// values; its type and shape are unchanged.
+constexpr char kPalettizedWeightsMetadata[] = "PalettizedWeights";
+constexpr uint32_t kPalettizedWeightsVersion = 1;
+
+// Fills `params` for tensor `tensor_index` of subgraph `subgraph_index`.
+// params->palette is left null if the tensor holds plain values. Returns an
+// error if the metadata entry does not match the tensor.
+TfLiteStatus GetPalettizedWeightsParams(const Model* model, int subgraph_index,
+                                        int tensor_index,
+                                        PalettizedWeightsParams* params);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_PALETTIZED_WEIGHTS_H_
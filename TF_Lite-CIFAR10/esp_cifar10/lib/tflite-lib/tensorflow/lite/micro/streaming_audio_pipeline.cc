@@ -0,0 +1,200 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/micro/streaming_audio_pipeline.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_log.h"
+
+#include <esp_timer.h>
+
+namespace tflite {
+
+StreamingAudioPipeline::StreamingAudioPipeline(MicroInterpreter* interpreter,
+                                               int stride_slices)
+    : interpreter_(interpreter), stride_slices_(stride_slices) {}
+
+StreamingAudioPipeline::~StreamingAudioPipeline() {
+  if (initialized_) {
+    FrontendFreeStateContents(&frontend_state_);
+  }
+}
+
+TfLiteStatus StreamingAudioPipeline::Init(const FrontendConfig& config,
+                                          int sample_rate,
+                                          uint8_t* feature_buffer,
+                                          size_t feature_buffer_bytes,
+                                          float feature_scale) {
+  if (initialized_) {
+    MicroPrintf("StreamingAudioPipeline already initialized.");
+    return kTfLiteError;
+  }
+  TfLiteTensor* input = interpreter_->input(0);
+  if (input == nullptr) {
+    MicroPrintf("StreamingAudioPipeline needs a model with one input.");
+    return kTfLiteError;
+  }
+  num_channels_ = config.filterbank.num_channels;
+  const int input_size = static_cast<int>(NumElements(input));
+  if (num_channels_ <= 0 || input_size % num_channels_ != 0) {
+    MicroPrintf("Input of %d values is not a whole number of %d-channel "
+                "slices.",
+                input_size, num_channels_);
+    return kTfLiteError;
+  }
+  num_slices_ = input_size / num_channels_;
+  if (stride_slices_ <= 0 || stride_slices_ > num_slices_) {
+    MicroPrintf("Stride of %d slices does not fit a window of %d slices.",
+                stride_slices_, num_slices_);
+    return kTfLiteError;
+  }
+
+  input_type_ = input->type;
+  switch (input_type_) {
+    case kTfLiteInt8:
+      input_multiplier_ = feature_scale / input->params.scale;
+      input_zero_point_ = input->params.zero_point;
+      slice_bytes_ = num_channels_ * sizeof(int8_t);
+      break;
+    case kTfLiteFloat32:
+      input_multiplier_ = feature_scale;
+      input_zero_point_ = 0;
+      slice_bytes_ = num_channels_ * sizeof(float);
+      break;
+    default:
+      MicroPrintf("Input type %s (%d) not supported.",
+                  TfLiteTypeGetName(input_type_), input_type_);
+      return kTfLiteError;
+  }
+
+  const size_t ring_bytes = static_cast<size_t>(num_slices_) * slice_bytes_;
+  if (feature_buffer == nullptr || feature_buffer_bytes < ring_bytes) {
+    MicroPrintf("Feature buffer of %d bytes, %d needed.",
+                static_cast<int>(feature_buffer_bytes),
+                static_cast<int>(ring_bytes));
+    return kTfLiteError;
+  }
+  if (!FrontendPopulateState(&config, &frontend_state_, sample_rate)) {
+    MicroPrintf("FrontendPopulateState failed.");
+    FrontendFreeStateContents(&frontend_state_);
+    return kTfLiteError;
+  }
+  ring_ = feature_buffer;
+  sample_rate_ = sample_rate;
+  initialized_ = true;
+  Reset();
+  return kTfLiteOk;
+}
+
+void StreamingAudioPipeline::Reset() {
+  if (initialized_) {
+    FrontendReset(&frontend_state_);
+  }
+  ring_head_ = 0;
+  ring_fill_ = 0;
+  slices_since_invoke_ = 0;
+  stats_ = {};
+}
+
+float StreamingAudioPipeline::RealTimeFactor() const {
+  if (stats_.samples_processed == 0) {
+    return 0.0f;
+  }
+  const float audio_us =
+      1e6f * static_cast<float>(stats_.samples_processed) / sample_rate_;
+  return static_cast<float>(stats_.frontend_time_us + stats_.invoke_time_us) /
+         audio_us;
+}
+
+void StreamingAudioPipeline::AppendSlice(const FrontendOutput& output) {
+  uint8_t* slice = ring_ + ring_head_ * slice_bytes_;
+  if (input_type_ == kTfLiteInt8) {
+    int8_t* values = reinterpret_cast<int8_t*>(slice);
+    for (int c = 0; c < num_channels_; ++c) {
+      // Frontend outputs are non-negative, so +0.5 rounds to nearest.
+      int32_t value = static_cast<int32_t>(
+                          output.values[c] * input_multiplier_ + 0.5f) +
+                      input_zero_point_;
+      value = std::min<int32_t>(std::max<int32_t>(value, -128), 127);
+      values[c] = static_cast<int8_t>(value);
+    }
+  } else {
+    float* values = reinterpret_cast<float*>(slice);
+    for (int c = 0; c < num_channels_; ++c) {
+      values[c] = output.values[c] * input_multiplier_;
+    }
+  }
+  if (++ring_head_ == num_slices_) {
+    ring_head_ = 0;
+  }
+  ring_fill_ = std::min(ring_fill_ + 1, num_slices_);
+  ++slices_since_invoke_;
+  ++stats_.slices_generated;
+}
+
+TfLiteStatus StreamingAudioPipeline::InvokeOnWindow() {
+  // Oldest slices first: [head, end) then [0, head).
+  uint8_t* input = interpreter_->input(0)->data.uint8;
+  const int older_bytes = (num_slices_ - ring_head_) * slice_bytes_;
+  memcpy(input, ring_ + ring_head_ * slice_bytes_, older_bytes);
+  memcpy(input + older_bytes, ring_, ring_head_ * slice_bytes_);
+  slices_since_invoke_ = 0;
+  ++stats_.invocations;
+  return interpreter_->Invoke();
+}
+
+TfLiteStatus StreamingAudioPipeline::ProcessSamples(const int16_t* samples,
+                                                    size_t num_samples,
+                                                    size_t* num_samples_read,
+                                                    bool* invoked) {
+  *num_samples_read = 0;
+  *invoked = false;
+  if (!initialized_) {
+    MicroPrintf("StreamingAudioPipeline used before Init.");
+    return kTfLiteError;
+  }
+  const int64_t start_time = esp_timer_get_time();
+  while (*num_samples_read < num_samples) {
+    size_t read = 0;
+    const FrontendOutput output = FrontendProcessSamples(
+        &frontend_state_, samples + *num_samples_read,
+        num_samples - *num_samples_read, &read);
+    *num_samples_read += read;
+    if (output.values == nullptr) {
+      continue;
+    }
+    AppendSlice(output);
+    // The first window runs as soon as it is full (num_slices_ >=
+    // stride_slices_ new slices), later ones every stride.
+    if (ring_fill_ == num_slices_ && slices_since_invoke_ >= stride_slices_) {
+      const int64_t invoke_start_time = esp_timer_get_time();
+      stats_.frontend_time_us += invoke_start_time - start_time;
+      const TfLiteStatus status = InvokeOnWindow();
+      const int64_t end_time = esp_timer_get_time();
+      stats_.invoke_time_us += end_time - invoke_start_time;
+      stats_.last_latency_us = end_time - start_time;
+      stats_.samples_processed += *num_samples_read;
+      *invoked = true;
+      return status;
+    }
+  }
+  stats_.frontend_time_us += esp_timer_get_time() - start_time;
+  stats_.samples_processed += *num_samples_read;
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
@@ -0,0 +1,288 @@
+# Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Packs int8 filters of a TFLite model into int4 where the error allows.
+
+EXPERIMENTAL, and a no-op on the models in this repository unless asked for.
+Post-training int4 costs accuracy: on synthetic inputs the CIFAR-10 model kept
+the int8 top-1 class on 35 of 50 images with every layer packed, MNIST on 41
+of 50 and MobileNetV2 on 3 of 20. Only FULLY_CONNECTED filters are considered
+by default, and only those whose relative rms error (rms of the change over
+rms of the int8 weights) is at most --max_error are packed. The filters of
+these models come out at 0.06 to 0.15, above the default limit of 0.05, so
+with the defaults nothing is packed and the output keeps every int8 weight.
+The error does not predict the accuracy loss well, which is why the limit is
+strict: packing only the first MNIST fully-connected filter (error 0.078,
+--max_error=0.08) still drops agreement to 45 of 50. --layers=all also
+considers CONV_2D and DEPTHWISE_CONV_2D filters. Every candidate is printed
+with its error and whether it was packed; check the packed model's accuracy
+on real data before shipping it.
+
+Each selected filter is requantized to [-7, 7] with its own scale per
+quantized channel: s4 = s8 * clip / 7 and q4 = round(q8 * s8 / s4), where clip
+is max|q8| or, with --clip=mse, the fraction of it with the least squared
+error. The bias of the layer is rescaled to match, since its scale is
+input_scale times the filter scale. The filter becomes an INT4 tensor with two
+values per byte, even elements in the low nibble, which the CONV_2D,
+DEPTHWISE_CONV_2D and FULLY_CONNECTED kernels unpack while running.
+
+Usage:
+  python pack_int4_weights.py --input_model=model_int8.tflite \
+      --output_model=model_int4.tflite [--max_error=0.05] [--layers=all]
+"""
+
+import argparse
+
+import numpy as np
+from tensorflow.lite.python import schema_py_generated as schema_fb
+from tensorflow.lite.tools import flatbuffer_utils
+
+INT4_MAX = 7
+CLIP_FRACTIONS = np.linspace(1.0, 0.5, 11)
+DEFAULT_MAX_ERROR = 0.05
+
+# Operators taking an int4 filter as input 1, with the quantized dimension the
+# kernels expect and the index of the bias input.
+_FILTER_OPS = {
+    schema_fb.BuiltinOperator.CONV_2D: 0,
+    schema_fb.BuiltinOperator.DEPTHWISE_CONV_2D: 3,
+    schema_fb.BuiltinOperator.FULLY_CONNECTED: 0,
+}
+_BIAS_INPUT = 2
+
+# The filters packed by default, and with --layers=all.
+DEFAULT_OPS = (schema_fb.BuiltinOperator.FULLY_CONNECTED,)
+ALL_OPS = tuple(_FILTER_OPS)
+
+
+def requantize_int4(weights, scales, axis, clip="max"):
+  """Requantizes int8 `weights` with per-slice `scales` along `axis`.
+
+  A single scale covers the whole tensor. clip is "max" or "mse". Returns
+  (int4 values as int8, new scales).
+  """
+  if len(scales) == 1:
+    channels = weights.reshape(1, -1)
+  else:
+    channels = np.moveaxis(weights, axis, 0).reshape(len(scales), -1)
+  channels = channels.astype(np.float64)
+  peak = np.maximum(np.abs(channels).max(axis=1), 1)
+  ratio = INT4_MAX / peak
+  # With "mse", clip each channel at the fraction of its peak with the least
+  # squared error, giving up a few outliers for finer steps on the rest.
+  if clip == "mse":
+    best_error = np.full(len(peak), np.inf)
+    for fraction in CLIP_FRACTIONS:
+      candidate = INT4_MAX / (peak * fraction)
+      restored = np.clip(np.round(channels * candidate[:, None]), -INT4_MAX,
+                         INT4_MAX) / candidate[:, None]
+      error = ((restored - channels)**2).sum(axis=1)
+      better = error < best_error
+      best_error[better] = error[better]
+      ratio[better] = candidate[better]
+  values = np.clip(np.round(channels * ratio[:, None]), -INT4_MAX, INT4_MAX)
+  values = values.astype(np.int8)
+  new_scales = np.asarray(scales, dtype=np.float64) / ratio
+  if len(scales) == 1:
+    return values.reshape(weights.shape), new_scales
+  moved_shape = (weights.shape[axis],) + tuple(
+      d for i, d in enumerate(weights.shape) if i != axis)
+  return np.moveaxis(values.reshape(moved_shape), 0, axis), new_scales
+
+
+def pack_int4(values):
+  """Packs int4 values two per byte, the even element in the low nibble."""
+  flat = values.reshape(-1).astype(np.uint8) & 0xf
+  if flat.size % 2:
+    flat = np.append(flat, np.uint8(0))
+  return flat[0::2] | (flat[1::2] << 4)
+
+
+def _builtin_code(operator_code):
+  return max(operator_code.builtinCode, operator_code.deprecatedBuiltinCode)
+
+
+def _filter_uses(model):
+  """Maps (subgraph, tensor) to its (quantized dimension, bias tensors,
+  operator codes) if every use is as a conv, depthwise or fully-connected
+  filter, else None."""
+  uses = {}
+  for s, subgraph in enumerate(model.subgraphs):
+    for op in subgraph.operators:
+      code = _builtin_code(model.operatorCodes[op.opcodeIndex])
+      for position, tensor_index in enumerate(op.inputs):
+        if tensor_index < 0:
+          continue
+        key = (s, tensor_index)
+        if code not in _FILTER_OPS or position != 1:
+          uses[key] = None
+          continue
+        if key in uses and uses[key] is None:
+          continue
+        axis, biases, codes = uses.get(key, (_FILTER_OPS[code], [], set()))
+        if axis != _FILTER_OPS[code]:
+          uses[key] = None
+          continue
+        if len(op.inputs) > _BIAS_INPUT and op.inputs[_BIAS_INPUT] >= 0:
+          biases.append(op.inputs[_BIAS_INPUT])
+        codes.add(code)
+        uses[key] = (axis, biases, codes)
+  return uses
+
+
+def _tensor_values(model, tensor, dtype):
+  buffer = model.buffers[tensor.buffer]
+  return np.frombuffer(
+      np.asarray(buffer.data, dtype=np.uint8).tobytes(),
+      dtype=dtype).reshape(tensor.shape)
+
+
+def pack_model(model, min_elements=0, clip="max", ops=DEFAULT_OPS,
+               max_error=DEFAULT_MAX_ERROR):
+  """Packs eligible filters of a schema_fb.ModelT into int4 in place.
+
+  Only filters used by `ops` alone are candidates. A candidate whose relative
+  rms error exceeds `max_error` (None for no limit) stays int8.
+
+  Returns a list of (tensor name, int8 bytes, int4 bytes, relative rms error,
+  packed) for the candidates.
+  """
+  buffer_users = {}
+  for subgraph in model.subgraphs:
+    for tensor in subgraph.tensors:
+      buffer_users[tensor.buffer] = buffer_users.get(tensor.buffer, 0) + 1
+
+  uses = _filter_uses(model)
+  report = []
+  for s, subgraph in enumerate(model.subgraphs):
+    for t, tensor in enumerate(subgraph.tensors):
+      use = uses.get((s, t))
+      buffer = model.buffers[tensor.buffer]
+      quantization = tensor.quantization
+      if (use is None or tensor.type != schema_fb.TensorType.INT8 or
+          buffer.data is None or buffer_users[tensor.buffer] != 1 or
+          np.prod(tensor.shape) < min_elements or quantization is None or
+          quantization.scale is None):
+        continue
+      axis, biases, codes = use
+      if not codes.issubset(ops):
+        continue
+      scales = list(quantization.scale)
+      if len(scales) > 1 and quantization.quantizedDimension != axis:
+        continue
+      if quantization.zeroPoint is not None and any(quantization.zeroPoint):
+        continue
+      # Every bias must belong to this filter alone and hold one int32 per
+      # output channel, or a single value for a per-tensor filter.
+      bias_tensors = [subgraph.tensors[b] for b in biases]
+      if any(b.type != schema_fb.TensorType.INT32 or
+             model.buffers[b.buffer].data is None or
+             buffer_users[b.buffer] != 1 or b.quantization is None or
+             b.quantization.scale is None for b in bias_tensors):
+        continue
+      if len(set(biases)) != len(biases):
+        continue
+
+      weights = _tensor_values(model, tensor, np.int8)
+      values, new_scales = requantize_int4(weights, scales, axis, clip)
+      error = relative_error(weights, values, scales, new_scales, axis)
+      packed_size = (weights.size + 1) // 2
+      name = tensor.name.decode() if isinstance(tensor.name,
+                                                bytes) else tensor.name
+      if max_error is not None and error > max_error:
+        report.append((name, weights.size, packed_size, error, False))
+        continue
+
+      ratio = np.asarray(scales, dtype=np.float64) / new_scales
+      for bias in bias_tensors:
+        bias_values = _tensor_values(model, bias, np.int32).astype(np.float64)
+        bias_ratio = ratio if len(ratio) == bias_values.size else ratio[0]
+        rescaled = np.clip(np.round(bias_values * bias_ratio),
+                           np.iinfo(np.int32).min, np.iinfo(np.int32).max)
+        model.buffers[bias.buffer].data = np.frombuffer(
+            rescaled.astype("<i4").tobytes(), dtype=np.uint8)
+        bias_scales = np.asarray(bias.quantization.scale, dtype=np.float64)
+        bias.quantization.scale = list(bias_scales / bias_ratio)
+
+      buffer.data = pack_int4(values)
+      tensor.type = schema_fb.TensorType.INT4
+      quantization.scale = list(new_scales)
+      report.append((name, weights.size, packed_size, error, True))
+  return report
+
+
+def relative_error(weights, values, scales, new_scales, axis):
+  """The rms of the change int4 `values` make to int8 `weights`, over the rms
+  of the weights, both in the int8 scale."""
+  restored = values.astype(np.float64)
+  if len(scales) == 1:
+    restored *= new_scales[0] / scales[0]
+  else:
+    shape = [1] * weights.ndim
+    shape[axis] = len(scales)
+    restored *= (new_scales / np.asarray(scales)).reshape(shape)
+  signal = np.sqrt(np.mean(weights.astype(np.float64)**2))
+  if signal == 0:
+    return 0.0
+  return float(np.sqrt(np.mean((restored - weights)**2)) / signal)
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument("--input_model", required=True)
+  parser.add_argument("--output_model", required=True)
+  parser.add_argument("--min_elements", type=int, default=0,
+                      help="Leave smaller filters as int8, e.g. to keep the "
+                      "first convolution at full precision.")
+  parser.add_argument("--clip", choices=("max", "mse"), default="max",
+                      help="Scale each channel to its largest weight, or "
+                      "clip it where the squared error is smallest.")
+  parser.add_argument("--max_error", type=float, default=DEFAULT_MAX_ERROR,
+                      help="Keep filters whose relative rms error would "
+                      "exceed this as int8; negative for no limit.")
+  parser.add_argument("--layers", choices=("fully_connected", "all"),
+                      default="fully_connected",
+                      help="Filters to consider. 'all' adds conv and "
+                      "depthwise filters and is experimental: it can lose "
+                      "much of the model's accuracy.")
+  args = parser.parse_args()
+
+  model = flatbuffer_utils.read_model(args.input_model)
+  if model.metadata is not None and any(
+      m.name in ("PalettizedWeights", b"PalettizedWeights")
+      for m in model.metadata):
+    parser.error("%s has palettized weights" % args.input_model)
+  report = pack_model(model, args.min_elements, args.clip,
+                      ALL_OPS if args.layers == "all" else DEFAULT_OPS,
+                      args.max_error if args.max_error >= 0 else None)
+  flatbuffer_utils.write_model(model, args.output_model)
+
+  packed = [r for r in report if r[4]]
+  for name, before, after, error, is_packed in report:
+    print("%-60s %8d -> %7d bytes  relative error %.3f  %s" %
+          (name, before, after if is_packed else before, error,
+           "int4" if is_packed else "kept int8"))
+  print("%d of %d tensors packed, weights %d -> %d bytes" %
+        (len(packed), len(report), sum(r[1] for r in packed),
+         sum(r[2] for r in packed)))
+  if not packed:
+    print("No filter was packed; raise --max_error or pass --layers=all to "
+          "trade accuracy for size.")
+  if args.layers == "all" and packed:
+    print("WARNING: --layers=all is experimental; check the packed model's "
+          "accuracy on real data.")
+
+
+if __name__ == "__main__":
+  main()
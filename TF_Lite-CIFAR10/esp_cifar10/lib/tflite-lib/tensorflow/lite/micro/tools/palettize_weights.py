@@ -0,0 +1,239 @@
+# Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Palettizes the int8 conv and fully-connected weights of a TFLite model.
+
+Each selected weight tensor is replaced by a palette of 2**index_bits int8
+values (one per output channel, or one for the whole tensor when per-channel
+palettes would cost more than an eighth of the weights) and a packed index per
+weight. The quantization parameters are unchanged: palette entries
+are ordinary int8 weights picked by 1-D k-means over the original values, so
+channels with at most 2**index_bits distinct values are stored losslessly.
+
+The layout is described by the "PalettizedWeights" model metadata, see
+tensorflow/lite/micro/palettized_weights.h. The CONV_2D and FULLY_CONNECTED
+kernels decode the weights tile by tile while running.
+
+Usage:
+  python palettize_weights.py --input_model=model_int8.tflite \
+      --output_model=model_pal4.tflite --index_bits=4
+"""
+
+import argparse
+
+import numpy as np
+from tensorflow.lite.python import schema_py_generated as schema_fb
+from tensorflow.lite.tools import flatbuffer_utils
+
+METADATA_NAME = "PalettizedWeights"
+METADATA_VERSION = 1
+
+_LEVELS = np.arange(-128, 128)
+
+
+def cluster_int8(values, palette_size, iterations=20):
+  """Returns palette_size int8 values approximating `values` (1-D k-means)."""
+  counts = np.bincount(values.astype(np.int32).ravel() + 128, minlength=256)
+  present = _LEVELS[counts > 0]
+  if len(present) <= palette_size:
+    palette = np.full(palette_size, present[-1])
+    palette[:len(present)] = present
+    return palette.astype(np.int8)
+
+  # Start from quantiles of the distribution, topped up with evenly spaced
+  # unused levels where quantiles coincide.
+  cdf = np.cumsum(counts) / counts.sum()
+  quantiles = (np.arange(palette_size) + 0.5) / palette_size
+  centroids = np.unique(_LEVELS[np.searchsorted(cdf, quantiles)])
+  if len(centroids) < palette_size:
+    unused = np.setdiff1d(present, centroids)
+    picks = np.linspace(0, len(unused) - 1, palette_size - len(centroids))
+    centroids = np.sort(
+        np.concatenate([centroids, unused[np.round(picks).astype(int)]]))
+  centroids = centroids.astype(np.float64)
+
+  # Lloyd iterations over the histogram of the 256 possible values.
+  for _ in range(iterations):
+    assignment = np.argmin(
+        np.abs(_LEVELS[:, None] - centroids[None, :]), axis=1)
+    totals = np.bincount(assignment, weights=counts * _LEVELS,
+                         minlength=palette_size)
+    sizes = np.bincount(assignment, weights=counts, minlength=palette_size)
+    used = sizes > 0
+    centroids[used] = totals[used] / sizes[used]
+  return np.clip(np.round(centroids), -128, 127).astype(np.int8)
+
+
+def palettize(weights, index_bits, per_channel=True):
+  """Splits int8 `weights` into (palettes, indices).
+
+  Returns palettes of shape [channels, 2**index_bits], channels being 1 or
+  weights.shape[0], and indices of shape [weights.shape[0], row_length].
+  """
+  palette_size = 1 << index_bits
+  rows = weights.reshape(weights.shape[0], -1).astype(np.int16)
+  groups = rows if per_channel else rows.reshape(1, -1)
+  palettes = np.stack([cluster_int8(g, palette_size) for g in groups])
+  indices = np.empty(rows.shape, dtype=np.uint8)
+  for r in range(rows.shape[0]):
+    palette = palettes[r if per_channel else 0].astype(np.int16)
+    indices[r] = np.argmin(np.abs(rows[r][:, None] - palette[None, :]), axis=1)
+  return palettes, indices
+
+
+def depalettize(palettes, indices):
+  """Inverse of palettize(), as decoded by the kernels."""
+  if len(palettes) == 1:
+    return palettes[0][indices]
+  return np.take_along_axis(palettes, indices.astype(np.intp), axis=1)
+
+
+def pack_indices(indices, index_bits):
+  """Packs [rows, row_length] indices LSB first, each row byte aligned."""
+  rows = indices.shape[0]
+  bits = (indices[:, :, None] >> np.arange(index_bits)) & 1
+  bits = bits.reshape(rows, -1).astype(np.uint8)
+  return np.packbits(bits, axis=1, bitorder="little").reshape(-1)
+
+
+def _builtin_code(operator_code):
+  return max(operator_code.builtinCode, operator_code.deprecatedBuiltinCode)
+
+
+def _weight_tensor_uses(model):
+  """Maps (subgraph, tensor) to whether every use is a conv/FC filter."""
+  supported = (schema_fb.BuiltinOperator.CONV_2D,
+               schema_fb.BuiltinOperator.FULLY_CONNECTED)
+  uses = {}
+  for s, subgraph in enumerate(model.subgraphs):
+    for op in subgraph.operators:
+      code = _builtin_code(model.operatorCodes[op.opcodeIndex])
+      for position, tensor_index in enumerate(op.inputs):
+        if tensor_index < 0:
+          continue
+        is_filter = code in supported and position == 1
+        key = (s, tensor_index)
+        uses[key] = uses.get(key, True) and is_filter
+  return uses
+
+
+def palettize_model(model, index_bits, granularity="auto", min_elements=1024):
+  """Palettizes eligible weights of a schema_fb.ModelT in place.
+
+  granularity is "channel", "tensor" or "auto" (per channel for rows of at
+  least 8 palette sizes).
+
+  Returns a list of (tensor name, original bytes, palettized bytes, rms error)
+  for the converted tensors.
+  """
+  buffer_users = {}
+  for subgraph in model.subgraphs:
+    for tensor in subgraph.tensors:
+      buffer_users[tensor.buffer] = buffer_users.get(tensor.buffer, 0) + 1
+
+  uses = _weight_tensor_uses(model)
+  entries = []
+  report = []
+  for s, subgraph in enumerate(model.subgraphs):
+    for t, tensor in enumerate(subgraph.tensors):
+      buffer = model.buffers[tensor.buffer]
+      if (not uses.get((s, t), False) or
+          tensor.type != schema_fb.TensorType.INT8 or
+          buffer.data is None or buffer_users[tensor.buffer] != 1 or
+          len(tensor.shape) < 2 or
+          np.prod(tensor.shape) < min_elements):
+        continue
+      quantization = tensor.quantization
+      if (quantization is not None and quantization.scale is not None and
+          len(quantization.scale) > 1 and
+          quantization.quantizedDimension != 0):
+        continue
+
+      weights = np.frombuffer(
+          np.asarray(buffer.data, dtype=np.uint8).tobytes(),
+          dtype=np.int8).reshape(tensor.shape)
+      row_length = weights.size // weights.shape[0]
+      per_channel = (granularity == "channel" or
+                     (granularity == "auto" and
+                      row_length >= 8 * (1 << index_bits)))
+      palettes, indices = palettize(weights, index_bits, per_channel)
+      packed = pack_indices(indices, index_bits)
+      if packed.size + palettes.size >= weights.size:
+        continue
+
+      error = (depalettize(palettes, indices).astype(np.float64) -
+               weights.reshape(weights.shape[0], -1))
+      palette_buffer = schema_fb.BufferT()
+      palette_buffer.data = palettes.astype(np.int8).view(np.uint8).reshape(-1)
+      model.buffers.append(palette_buffer)
+      buffer.data = packed
+      entries.append([s, t, index_bits, 1 << index_bits, len(palettes),
+                      len(model.buffers) - 1])
+      name = tensor.name.decode() if isinstance(tensor.name,
+                                                bytes) else tensor.name
+      report.append((name, weights.size, packed.size + palettes.size,
+                     float(np.sqrt(np.mean(error**2)))))
+
+  if entries:
+    words = np.array([METADATA_VERSION, len(entries)] + sum(entries, []),
+                     dtype="<u4")
+    metadata_buffer = schema_fb.BufferT()
+    metadata_buffer.data = np.frombuffer(words.tobytes(), dtype=np.uint8)
+    model.buffers.append(metadata_buffer)
+    metadata = schema_fb.MetadataT()
+    metadata.name = METADATA_NAME
+    metadata.buffer = len(model.buffers) - 1
+    if model.metadata is None:
+      model.metadata = []
+    model.metadata.append(metadata)
+  return report
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument("--input_model", required=True)
+  parser.add_argument("--output_model", required=True)
+  parser.add_argument("--index_bits", type=int, default=4,
+                      help="Bits per index, 4 (16 entries) to 6 (64 entries) "
+                      "keep int8 accuracy on most models.")
+  parser.add_argument("--granularity", choices=("auto", "channel", "tensor"),
+                      default="auto",
+                      help="One palette per output channel or per tensor; "
+                      "auto uses per-channel palettes where they are cheap.")
+  parser.add_argument("--min_elements", type=int, default=1024,
+                      help="Leave smaller weight tensors as plain int8.")
+  args = parser.parse_args()
+  # 8-bit indices plus a palette are never smaller than the int8 weights.
+  if not 1 <= args.index_bits <= 7:
+    parser.error("--index_bits must be between 1 and 7")
+
+  model = flatbuffer_utils.read_model(args.input_model)
+  if model.metadata is not None and any(
+      m.name in (METADATA_NAME, METADATA_NAME.encode())
+      for m in model.metadata):
+    parser.error("%s is already palettized" % args.input_model)
+  report = palettize_model(model, args.index_bits, args.granularity,
+                           args.min_elements)
+  flatbuffer_utils.write_model(model, args.output_model)
+
+  original = sum(r[1] for r in report)
+  compressed = sum(r[2] for r in report)
+  for name, before, after, rms in report:
+    print("%-60s %8d -> %7d bytes  rms error %.3f" % (name, before, after, rms))
+  print("%d tensors, weights %d -> %d bytes" % (len(report), original,
+                                                compressed))
+
+
+if __name__ == "__main__":
+  main()
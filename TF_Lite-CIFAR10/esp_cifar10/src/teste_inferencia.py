@@ -1,5 +1,7 @@
+import argparse
 import requests
 import json
+import time
 import numpy as np
 import matplotlib.pyplot as plt
 import tensorflow as tf
@@ -13,6 +15,7 @@ logging.getLogger('tensorflow').setLevel(logging.ERROR)
 
 ESP32_IP = "192.168.0.111"
 PREDICT_URL = f"http://{ESP32_IP}/predict"
+PREDICT_RAW_URL = f"http://{ESP32_IP}/predict_raw"
 REQUEST_TIMEOUT = 10
 
 CLASS_NAMES = [
@@ -50,6 +53,57 @@ def send_image_for_inference(url, image_data):
         print(f"An unexpected error occurred: {e}")
         return None
 
+def send_image_raw(url, image_data):
+    """Sends one uint8 HWC image, or a batch of them stacked on axis 0, as
+    raw bytes to /predict_raw."""
+    try:
+        payload = np.ascontiguousarray(image_data, dtype=np.uint8).tobytes()
+        headers = {"Content-Type": "application/octet-stream"}
+
+        response = requests.post(
+            url,
+            data=payload,
+            headers=headers,
+            timeout=REQUEST_TIMEOUT
+        )
+
+        response.raise_for_status()
+        return response.json()
+
+    except requests.exceptions.RequestException as e:
+        print(f"Error connecting to ESP32: {e}")
+        return None
+    except Exception as e:
+        print(f"An unexpected error occurred: {e}")
+        return None
+
+def compare_latency(image, runs):
+    """Times the same image through /predict (JSON) and /predict_raw."""
+    json_size = len(json.dumps({"pixels": image.flatten().tolist()}))
+    raw_size = image.size
+    endpoints = [
+        ("/predict (JSON)", PREDICT_URL, send_image_for_inference, json_size),
+        ("/predict_raw", PREDICT_RAW_URL, send_image_raw, raw_size),
+    ]
+
+    print(f"Comparing request latency over {runs} runs per endpoint...")
+    for name, url, send, payload_size in endpoints:
+        latencies = []
+        for _ in range(runs):
+            start = time.perf_counter()
+            result = send(url, image)
+            elapsed_ms = (time.perf_counter() - start) * 1000
+            if result and result.get("success"):
+                latencies.append(elapsed_ms)
+        if not latencies:
+            print(f"{name:18s} all requests failed")
+            continue
+        print(f"{name:18s} payload {payload_size:6d} bytes | "
+              f"mean {np.mean(latencies):7.1f} ms | "
+              f"median {np.median(latencies):7.1f} ms | "
+              f"min {np.min(latencies):7.1f} ms | "
+              f"ok {len(latencies)}/{runs}")
+
 def plot_prediction(image, true_name, predicted_name, confidence):
     plt.figure(figsize=(4, 4))
     plt.imshow(image)
@@ -58,13 +112,27 @@ def plot_prediction(image, true_name, predicted_name, confidence):
     plt.show()
 
 def main():
-    image_index = 10
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--index", type=int, default=10, help="CIFAR-10 test image index")
+    parser.add_argument("--json", action="store_true", help="use /predict (JSON) instead of /predict_raw")
+    parser.add_argument("--compare", type=int, metavar="RUNS", help="compare /predict and /predict_raw latency")
+    args = parser.parse_args()
+
+    image_index = args.index
     
     image, true_label_index, true_label_name = get_cifar10_sample(image_index)
 
-    print(f"Sending image {image_index} ({true_label_name}) to {PREDICT_URL}...")
+    if args.compare:
+        compare_latency(image, args.compare)
+        return
+
+    url = PREDICT_URL if args.json else PREDICT_RAW_URL
+    print(f"Sending image {image_index} ({true_label_name}) to {url}...")
     
-    result = send_image_for_inference(PREDICT_URL, image)
+    if args.json:
+        result = send_image_for_inference(url, image)
+    else:
+        result = send_image_raw(url, image)
 
     if not result:
         print("Inference failed.")
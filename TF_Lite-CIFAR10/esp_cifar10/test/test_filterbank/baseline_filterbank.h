@@ -0,0 +1,57 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TEST_FILTERBANK_BASELINE_FILTERBANK_H_
+#define TEST_FILTERBANK_BASELINE_FILTERBANK_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tensorflow/lite/experimental/microfrontend/lib/filterbank_util.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The FilterbankState of the padded layout: each channel points at a block of
+// weights padded to 4 bins, and empty channels at a block of zeros.
+struct BaselineFilterbankState {
+  int num_channels;
+  int start_index;
+  int end_index;
+  int16_t* channel_frequency_starts;
+  int16_t* channel_weight_starts;
+  int16_t* channel_widths;
+  int16_t* weights;
+  int16_t* unweights;
+  uint64_t* work;
+};
+
+int BaselineFilterbankPopulateState(const struct FilterbankConfig* config,
+                                    struct BaselineFilterbankState* state,
+                                    int sample_rate, int spectrum_size);
+void BaselineFilterbankFreeStateContents(struct BaselineFilterbankState* state);
+void BaselineFilterbankAccumulateChannels(
+    struct BaselineFilterbankState* state, const int32_t* energy);
+uint32_t* BaselineFilterbankSqrt(struct BaselineFilterbankState* state,
+                                 int scale_down_shift);
+uint16_t* BaselineLogScaleApply(struct LogScaleState* state, uint32_t* signal,
+                                int signal_size, int correction_bits);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // TEST_FILTERBANK_BASELINE_FILTERBANK_H_
@@ -0,0 +1,348 @@
+// microfrontend FilterbankAccumulateChannels, FilterbankSqrt and
+// LogScaleApply against the padded-layout, 64-bit versions they replaced,
+// kept in baseline_filterbank.c, plus a timing comparison on the default
+// 16 kHz band config.
+//
+// The baseline reads energies as int32_t and sign-extends them, so energies
+// of 2^31 and above (only 2^31 itself comes out of the FFT, for a bin of
+// -32768 + -32768i) wrap around in its 64-bit sums. The current code reads
+// them as the uint32_t squared magnitudes they are. Below 2^31 both must
+// agree bit for bit; over the full uint32_t range the current code is checked
+// against the baseline layout summed with uint32_t energies.
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "baseline_filterbank.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale_util.h"
+
+namespace {
+
+std::mt19937 rng(35);
+
+uint32_t RandomUint32(uint32_t low, uint32_t high) {
+  return std::uniform_int_distribution<uint32_t>(low, high)(rng);
+}
+
+struct BandConfig {
+  FilterbankConfig config;
+  int sample_rate;
+  int spectrum_size;
+};
+
+// The band config FrontendPopulateState builds for `num_channels` at 16 kHz
+// with a `window_ms` window, the FFT size setting the spectrum size.
+BandConfig FrontendBandConfig(int num_channels, int window_ms) {
+  FrontendConfig config;
+  FrontendFillConfigWithDefaults(&config);
+  config.window.size_ms = window_ms;
+  config.filterbank.num_channels = num_channels;
+  FrontendState state;
+  TEST_ASSERT_TRUE(FrontendPopulateState(&config, &state, 16000));
+  const BandConfig band = {config.filterbank, 16000,
+                           static_cast<int>(state.fft.fft_size / 2 + 1)};
+  FrontendFreeStateContents(&state);
+  return band;
+}
+
+// The frontend defaults (32 channels, 25 ms), the 40-channel 30 ms config of
+// the TFLM speech examples and the 28-channel one of
+// test_streaming_audio_pipeline in the MNIST project.
+std::vector<BandConfig> FrontendBandConfigs() {
+  return {FrontendBandConfig(32, 25), FrontendBandConfig(40, 30),
+          FrontendBandConfig(28, 25)};
+}
+
+// Spectrum sizes, sample rates, channel counts and lower band limits around
+// the frontend's, including channel counts high enough to leave some mel
+// bands without a bin.
+std::vector<BandConfig> SweepBandConfigs() {
+  std::vector<BandConfig> configs;
+  for (int spectrum_size : {129, 257, 513}) {
+    for (int sample_rate : {8000, 16000, 44100}) {
+      for (int num_channels : {1, 8, 20, 40, 64, 80}) {
+        for (float lower_band_limit : {0.0f, 125.0f, 300.0f}) {
+          BandConfig band;
+          FilterbankFillConfigWithDefaults(&band.config);
+          band.config.num_channels = num_channels;
+          band.config.lower_band_limit = lower_band_limit;
+          band.config.upper_band_limit = sample_rate * 0.45f;
+          band.sample_rate = sample_rate;
+          band.spectrum_size = spectrum_size;
+          configs.push_back(band);
+        }
+      }
+    }
+  }
+  return configs;
+}
+
+// Both filterbank states for one band config.
+class Filterbanks {
+ public:
+  explicit Filterbanks(const BandConfig& band) : band_(band) {
+    ok_ = FilterbankPopulateState(&band.config, &current_, band.sample_rate,
+                                  band.spectrum_size);
+    const int baseline_ok = BaselineFilterbankPopulateState(
+        &band.config, &baseline_, band.sample_rate, band.spectrum_size);
+    TEST_ASSERT_EQUAL(baseline_ok, ok_);
+    if (ok_) {
+      TEST_ASSERT_EQUAL(baseline_.start_index, current_.start_index);
+      TEST_ASSERT_EQUAL(baseline_.end_index, current_.end_index);
+    }
+  }
+
+  ~Filterbanks() {
+    FilterbankFreeStateContents(&current_);
+    BaselineFilterbankFreeStateContents(&baseline_);
+  }
+
+  Filterbanks(const Filterbanks&) = delete;
+  Filterbanks& operator=(const Filterbanks&) = delete;
+
+  bool ok() const { return ok_; }
+  int spectrum_size() const { return band_.spectrum_size; }
+  int num_channels() const { return current_.num_channels; }
+  FilterbankState* current() { return &current_; }
+  BaselineFilterbankState* baseline() { return &baseline_; }
+
+  // The baseline's accumulation with the energies read as uint32_t.
+  void AccumulateExact(const uint32_t* energy, uint64_t* work) const {
+    uint64_t weight_accumulator = 0;
+    uint64_t unweight_accumulator = 0;
+    for (int i = 0; i <= baseline_.num_channels; ++i) {
+      const uint32_t* magnitudes =
+          energy + baseline_.channel_frequency_starts[i];
+      const int16_t* weights =
+          baseline_.weights + baseline_.channel_weight_starts[i];
+      const int16_t* unweights =
+          baseline_.unweights + baseline_.channel_weight_starts[i];
+      for (int j = 0; j < baseline_.channel_widths[i]; ++j) {
+        weight_accumulator += weights[j] * static_cast<uint64_t>(magnitudes[j]);
+        unweight_accumulator +=
+            unweights[j] * static_cast<uint64_t>(magnitudes[j]);
+      }
+      work[i] = weight_accumulator;
+      weight_accumulator = unweight_accumulator;
+      unweight_accumulator = 0;
+    }
+  }
+
+ private:
+  BandConfig band_;
+  bool ok_;
+  FilterbankState current_;
+  BaselineFilterbankState baseline_;
+};
+
+// Accumulates `energy` with both filterbanks and checks the work values and
+// the square roots at a few scale-down shifts. With `exact`, the baseline
+// work is replaced by AccumulateExact's before taking its square roots.
+void CheckFrame(Filterbanks& filterbanks, const std::vector<uint32_t>& energy,
+                bool exact) {
+  const int num_work = filterbanks.num_channels() + 1;
+  const int32_t* signed_energy =
+      reinterpret_cast<const int32_t*>(energy.data());
+  for (int shift : {0, 3, 7}) {
+    FilterbankAccumulateChannels(filterbanks.current(), signed_energy);
+    BaselineFilterbankAccumulateChannels(filterbanks.baseline(),
+                                         signed_energy);
+    if (exact) {
+      filterbanks.AccumulateExact(energy.data(), filterbanks.baseline()->work);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(filterbanks.baseline()->work,
+                             filterbanks.current()->work,
+                             num_work * sizeof(uint64_t));
+    const uint32_t* expected =
+        BaselineFilterbankSqrt(filterbanks.baseline(), shift);
+    const uint32_t* actual = FilterbankSqrt(filterbanks.current(), shift);
+    TEST_ASSERT_EQUAL_MEMORY(expected, actual,
+                             filterbanks.num_channels() * sizeof(uint32_t));
+  }
+}
+
+void FillEnergy(std::vector<uint32_t>& energy, uint32_t low, uint32_t high) {
+  for (uint32_t& value : energy) value = RandomUint32(low, high);
+}
+
+// Returns false, having checked nothing, when the config is rejected by both.
+bool CheckBandConfig(const BandConfig& band, int frames) {
+  Filterbanks filterbanks(band);
+  if (!filterbanks.ok()) return false;
+  std::vector<uint32_t> energy(filterbanks.spectrum_size());
+  for (int frame = 0; frame < frames; ++frame) {
+    // Below 2^31: random over the whole range, small, and saturated.
+    FillEnergy(energy, 0, 0x7fffffff);
+    CheckFrame(filterbanks, energy, /*exact=*/false);
+    FillEnergy(energy, 0, 1000);
+    CheckFrame(filterbanks, energy, /*exact=*/false);
+    // Full uint32_t range.
+    FillEnergy(energy, 0, 0xffffffff);
+    CheckFrame(filterbanks, energy, /*exact=*/true);
+    FillEnergy(energy, 0x7fffff00, 0xffffffff);
+    CheckFrame(filterbanks, energy, /*exact=*/true);
+  }
+  for (uint32_t value : {0u, 1u, 0x7fffffffu}) {
+    energy.assign(energy.size(), value);
+    CheckFrame(filterbanks, energy, /*exact=*/false);
+  }
+  for (uint32_t value : {0x80000000u, 0xffffffffu}) {
+    energy.assign(energy.size(), value);
+    CheckFrame(filterbanks, energy, /*exact=*/true);
+  }
+  return true;
+}
+
+void CheckLogScale(LogScaleState state, const uint32_t* values, int count,
+                   int correction_bits) {
+  std::vector<uint32_t> expected(values, values + count);
+  std::vector<uint32_t> actual(values, values + count);
+  const uint16_t* expected_output = BaselineLogScaleApply(
+      &state, expected.data(), count, correction_bits);
+  const uint16_t* actual_output =
+      LogScaleApply(&state, actual.data(), count, correction_bits);
+  TEST_ASSERT_EQUAL_MEMORY(expected_output, actual_output,
+                           count * sizeof(uint16_t));
+}
+
+template <typename Body>
+double MicrosPerCall(int iterations, Body body) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) body();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_filterbank_matches_baseline_on_frontend_configs() {
+  for (const BandConfig& band : FrontendBandConfigs()) {
+    TEST_ASSERT_TRUE(CheckBandConfig(band, 500));
+  }
+}
+
+void test_filterbank_matches_baseline_on_config_sweep() {
+  for (const BandConfig& band : SweepBandConfigs()) {
+    CheckBandConfig(band, 10);
+  }
+}
+
+// Every uint32_t input with the frontend's settings (log on, scale_shift 6,
+// correction_bits 3 for a 512-point FFT), in frontend-sized calls.
+void test_log_scale_matches_baseline_on_every_input() {
+  LogScaleConfig config;
+  LogScaleFillConfigWithDefaults(&config);
+  LogScaleState state;
+  TEST_ASSERT_TRUE(LogScalePopulateState(&config, &state));
+  const int correction_bits =
+      MostSignificantBit32(512) - 1 - (kFilterbankBits / 2);
+#ifdef ARDUINO
+  // Every 4099th input, to keep the run to a few seconds on the chip.
+  const uint64_t step = 4099;
+#else
+  const uint64_t step = 1;
+#endif
+  uint32_t values[40];
+  int count = 0;
+  for (uint64_t value = 0; value <= 0xffffffffull; value += step) {
+    values[count++] = static_cast<uint32_t>(value);
+    if (count == 40) {
+      CheckLogScale(state, values, count, correction_bits);
+      count = 0;
+    }
+  }
+  CheckLogScale(state, values, count, correction_bits);
+}
+
+void test_log_scale_matches_baseline_on_random_settings() {
+  std::vector<uint32_t> values(40);
+  for (int trial = 0; trial < 20000; ++trial) {
+    LogScaleState state;
+    state.enable_log = RandomUint32(0, 3) != 0;
+    state.scale_shift = RandomUint32(0, 8);
+    const int correction_bits = static_cast<int>(RandomUint32(0, 12)) - 6;
+    const int magnitude_bits = RandomUint32(1, 32);
+    for (uint32_t& value : values) {
+      value = RandomUint32(0, 0xffffffffu >> (32 - magnitude_bits));
+    }
+    CheckLogScale(state, values.data(), values.size(), correction_bits);
+  }
+}
+
+void test_benchmark_against_baseline() {
+  const BandConfig band = FrontendBandConfig(40, 30);
+  Filterbanks filterbanks(band);
+  TEST_ASSERT_TRUE(filterbanks.ok());
+  std::vector<uint32_t> energy(filterbanks.spectrum_size());
+  FillEnergy(energy, 0, 1 << 24);
+  const int32_t* signed_energy =
+      reinterpret_cast<const int32_t*>(energy.data());
+  const int iterations = 200000;
+  const double baseline_filterbank_us = MicrosPerCall(iterations, [&]() {
+    BaselineFilterbankAccumulateChannels(filterbanks.baseline(),
+                                         signed_energy);
+    BaselineFilterbankSqrt(filterbanks.baseline(), 0);
+  });
+  const double filterbank_us = MicrosPerCall(iterations, [&]() {
+    FilterbankAccumulateChannels(filterbanks.current(), signed_energy);
+    FilterbankSqrt(filterbanks.current(), 0);
+  });
+
+  LogScaleState state = {1, 6};
+  std::vector<uint32_t> signal(40);
+  std::vector<uint32_t> values(40);
+  for (uint32_t& value : values) value = RandomUint32(0, 1 << 20);
+  const double baseline_log_us = MicrosPerCall(iterations, [&]() {
+    memcpy(signal.data(), values.data(), values.size() * sizeof(uint32_t));
+    BaselineLogScaleApply(&state, signal.data(), signal.size(), 3);
+  });
+  const double log_us = MicrosPerCall(iterations, [&]() {
+    memcpy(signal.data(), values.data(), values.size() * sizeof(uint32_t));
+    LogScaleApply(&state, signal.data(), signal.size(), 3);
+  });
+
+  char line[128];
+  snprintf(line, sizeof(line),
+           "Filterbank 40 channels, 257 bins: baseline %.3f us, current "
+           "%.3f us (%.2fx)",
+           baseline_filterbank_us, filterbank_us,
+           baseline_filterbank_us / filterbank_us);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line),
+           "LogScaleApply 40 values: baseline %.3f us, current %.3f us "
+           "(%.2fx)",
+           baseline_log_us, log_us, baseline_log_us / log_us);
+  TEST_MESSAGE(line);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_filterbank_matches_baseline_on_frontend_configs);
+  RUN_TEST(test_filterbank_matches_baseline_on_config_sweep);
+  RUN_TEST(test_log_scale_matches_baseline_on_every_input);
+  RUN_TEST(test_log_scale_matches_baseline_on_random_settings);
+  RUN_TEST(test_benchmark_against_baseline);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
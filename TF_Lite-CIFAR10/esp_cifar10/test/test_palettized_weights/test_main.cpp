@@ -0,0 +1,390 @@
+// CONV_2D and FULLY_CONNECTED with palettized filters (PalettizedWeights
+// metadata, micro/palettized_weights.h) against the same layers with the
+// filters stored as the int8 values they decode to: outputs bit-exact for
+// 1 to 8 index bits, one palette per output channel or per tensor, on
+// strided, dilated and padded convolutions and on layers whose rows span
+// one, several or a partial decode tile. The packing is written here from
+// the format description, independently of the kernels' decoder.
+// DEPTHWISE_CONV_2D must refuse a palettized filter in Prepare.
+#include <unity.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/palettized_weights.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+std::mt19937 rng(36);
+
+constexpr size_t kArenaSize = 512 * 1024;
+constexpr float kInputScale = 0.05f;
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// One layer: input, filter, bias and output tensors. Shapes follow TFLite:
+// NHWC input with an OHWI conv filter or a [1, H, W, O] depthwise filter,
+// or [batches, depth] input with an [O, depth] fully-connected filter.
+struct LayerCase {
+  tflite::BuiltinOperator op;
+  std::vector<int32_t> input_shape;
+  std::vector<int32_t> filter_shape;
+  tflite::Padding padding;
+  int stride;
+  int dilation;
+  tflite::ActivationFunctionType activation;
+};
+
+int OutputSize(int input_size, int filter_size, const LayerCase& layer) {
+  const int effective = (filter_size - 1) * layer.dilation + 1;
+  if (layer.padding == tflite::Padding_SAME) {
+    return (input_size + layer.stride - 1) / layer.stride;
+  }
+  return (input_size - effective + layer.stride) / layer.stride;
+}
+
+std::vector<int32_t> OutputShape(const LayerCase& layer) {
+  if (layer.op == tflite::BuiltinOperator_FULLY_CONNECTED) {
+    return {layer.input_shape[0], layer.filter_shape[0]};
+  }
+  const int channels = layer.op == tflite::BuiltinOperator_CONV_2D
+                           ? layer.filter_shape[0]
+                           : layer.filter_shape[3];
+  return {layer.input_shape[0],
+          OutputSize(layer.input_shape[1], layer.filter_shape[1], layer),
+          OutputSize(layer.input_shape[2], layer.filter_shape[2], layer),
+          channels};
+}
+
+int ElementCount(const std::vector<int32_t>& shape) {
+  int count = 1;
+  for (int32_t dim : shape) count *= dim;
+  return count;
+}
+
+// A palettized filter: the palettes, one index per weight and the int8
+// values they stand for.
+struct Palettized {
+  int index_bits;
+  int palette_channels;
+  std::vector<int8_t> palettes;
+  std::vector<uint8_t> packed;
+  std::vector<int8_t> decoded;
+};
+
+// Random palettes and indices for `rows` rows of `row_length` weights,
+// packed LSB first with every row starting on a byte boundary.
+Palettized MakePalettized(int rows, int row_length, int index_bits,
+                          int palette_channels) {
+  Palettized filter;
+  filter.index_bits = index_bits;
+  filter.palette_channels = palette_channels;
+  const int palette_size = 1 << index_bits;
+  filter.palettes.resize(palette_channels * palette_size);
+  for (int8_t& value : filter.palettes) {
+    value = static_cast<int8_t>(RandomInt(-127, 127));
+  }
+  const int row_bytes = (row_length * index_bits + 7) / 8;
+  filter.packed.assign(rows * row_bytes, 0);
+  filter.decoded.resize(rows * row_length);
+  for (int row = 0; row < rows; ++row) {
+    const int8_t* palette =
+        &filter.palettes[palette_channels == 1 ? 0 : row * palette_size];
+    uint8_t* packed_row = &filter.packed[row * row_bytes];
+    for (int i = 0; i < row_length; ++i) {
+      const int index = RandomInt(0, palette_size - 1);
+      for (int bit = 0; bit < index_bits; ++bit) {
+        if (index & (1 << bit)) {
+          const int position = i * index_bits + bit;
+          packed_row[position / 8] |= 1 << (position % 8);
+        }
+      }
+      filter.decoded[row * row_length + i] = palette[index];
+    }
+  }
+  return filter;
+}
+
+// The layer as a one-op model. With `palettized` set, the filter buffer
+// holds its packed indices and the model carries the metadata entry;
+// otherwise it holds `filter_values`.
+std::vector<uint8_t> BuildModel(const LayerCase& layer,
+                                const std::vector<int8_t>& filter_values,
+                                const Palettized* palettized) {
+  using flatbuffers::Offset;
+  // This flatbuffers has no implicit default allocator.
+  flatbuffers::DefaultAllocator allocator;
+  flatbuffers::FlatBufferBuilder fbb(1024, &allocator);
+  std::mt19937 model_rng(ElementCount(layer.filter_shape));
+
+  const bool fully_connected =
+      layer.op == tflite::BuiltinOperator_FULLY_CONNECTED;
+  const bool depthwise = layer.op == tflite::BuiltinOperator_DEPTHWISE_CONV_2D;
+  const std::vector<int32_t> output_shape = OutputShape(layer);
+  const int channels = output_shape.back();
+  const int row_length = ElementCount(layer.filter_shape) /
+                         (depthwise ? channels : layer.filter_shape[0]);
+
+  // Fully connected filters are per-tensor in TFLM, convolutions per channel.
+  std::vector<float> filter_scales(fully_connected ? 1 : channels);
+  for (size_t i = 0; i < filter_scales.size(); ++i) {
+    filter_scales[i] = 0.002f + 0.0004f * (i % 7);
+  }
+  std::vector<float> bias_scales(channels);
+  for (int i = 0; i < channels; ++i) {
+    bias_scales[i] = kInputScale * filter_scales[i % filter_scales.size()];
+  }
+  // Roughly the spread of a random dot product, so few outputs saturate.
+  const float output_scale =
+      kInputScale * 0.003f * 40.0f * std::sqrt(static_cast<float>(row_length));
+
+  std::vector<int32_t> bias(channels);
+  for (int32_t& value : bias) {
+    value = static_cast<int32_t>(model_rng() % 20001) - 10000;
+  }
+  const std::vector<uint8_t> filter_bytes =
+      palettized != nullptr
+          ? palettized->packed
+          : std::vector<uint8_t>(filter_values.begin(), filter_values.end());
+  std::vector<Offset<tflite::Buffer>> buffers = {
+      tflite::CreateBuffer(fbb),
+      tflite::CreateBufferDirect(fbb, &filter_bytes),
+      tflite::CreateBuffer(
+          fbb, fbb.CreateVector(reinterpret_cast<const uint8_t*>(bias.data()),
+                                bias.size() * sizeof(int32_t))),
+  };
+  std::vector<Offset<tflite::Metadata>> metadata;
+  if (palettized != nullptr) {
+    const std::vector<uint8_t> palettes(palettized->palettes.begin(),
+                                        palettized->palettes.end());
+    const uint32_t words[] = {
+        tflite::kPalettizedWeightsVersion,
+        1,
+        0,
+        1,
+        static_cast<uint32_t>(palettized->index_bits),
+        1u << palettized->index_bits,
+        static_cast<uint32_t>(palettized->palette_channels),
+        3};
+    buffers.push_back(tflite::CreateBufferDirect(fbb, &palettes));
+    buffers.push_back(tflite::CreateBuffer(
+        fbb, fbb.CreateVector(reinterpret_cast<const uint8_t*>(words),
+                              sizeof(words))));
+    metadata.push_back(tflite::CreateMetadataDirect(
+        fbb, tflite::kPalettizedWeightsMetadata, 4));
+  }
+
+  auto quantization = [&](const std::vector<float>& scale, int64_t zero_point,
+                          int quantized_dimension) {
+    const std::vector<int64_t> zero_points(scale.size(), zero_point);
+    return tflite::CreateQuantizationParametersDirect(
+        fbb, nullptr, nullptr, &scale, &zero_points,
+        tflite::QuantizationDetails_NONE, 0, quantized_dimension);
+  };
+  const std::vector<int32_t> bias_shape = {channels};
+  const std::vector<Offset<tflite::Tensor>> tensors = {
+      tflite::CreateTensorDirect(fbb, &layer.input_shape,
+                                 tflite::TensorType_INT8, 0, "input",
+                                 quantization({kInputScale}, -7, 0)),
+      tflite::CreateTensorDirect(fbb, &layer.filter_shape,
+                                 tflite::TensorType_INT8, 1, "filter",
+                                 quantization(filter_scales, 0,
+                                              depthwise ? 3 : 0)),
+      tflite::CreateTensorDirect(fbb, &bias_shape, tflite::TensorType_INT32,
+                                 2, "bias", quantization(bias_scales, 0, 0)),
+      tflite::CreateTensorDirect(fbb, &output_shape, tflite::TensorType_INT8,
+                                 0, "output",
+                                 quantization({output_scale}, 5, 0)),
+  };
+
+  Offset<void> options;
+  tflite::BuiltinOptions options_type;
+  if (fully_connected) {
+    options_type = tflite::BuiltinOptions_FullyConnectedOptions;
+    options = tflite::CreateFullyConnectedOptions(fbb, layer.activation).Union();
+  } else if (depthwise) {
+    options_type = tflite::BuiltinOptions_DepthwiseConv2DOptions;
+    options = tflite::CreateDepthwiseConv2DOptions(
+                  fbb, layer.padding, layer.stride, layer.stride,
+                  channels / layer.input_shape[3], layer.activation,
+                  layer.dilation, layer.dilation)
+                  .Union();
+  } else {
+    options_type = tflite::BuiltinOptions_Conv2DOptions;
+    options = tflite::CreateConv2DOptions(fbb, layer.padding, layer.stride,
+                                          layer.stride, layer.activation,
+                                          layer.dilation, layer.dilation)
+                  .Union();
+  }
+  const std::vector<Offset<tflite::OperatorCode>> operator_codes = {
+      tflite::CreateOperatorCode(fbb, static_cast<int8_t>(layer.op), 0, 1,
+                                 layer.op)};
+  const std::vector<int32_t> op_inputs = {0, 1, 2};
+  const std::vector<int32_t> op_outputs = {3};
+  const std::vector<Offset<tflite::Operator>> operators = {
+      tflite::CreateOperatorDirect(fbb, 0, &op_inputs, &op_outputs,
+                                   options_type, options)};
+  const std::vector<int32_t> graph_inputs = {0};
+  const std::vector<int32_t> graph_outputs = {3};
+  const std::vector<Offset<tflite::SubGraph>> subgraphs = {
+      tflite::CreateSubGraphDirect(fbb, &tensors, &graph_inputs,
+                                   &graph_outputs, &operators)};
+  fbb.Finish(tflite::CreateModelDirect(
+      fbb, TFLITE_SCHEMA_VERSION, &operator_codes, &subgraphs, nullptr,
+      &buffers, nullptr, metadata.empty() ? nullptr : &metadata));
+  return std::vector<uint8_t>(fbb.GetBufferPointer(),
+                              fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+// A one-op model with its own arena.
+class Layer {
+ public:
+  explicit Layer(const std::vector<uint8_t>& model)
+      : model_(model),
+        arena_(kArenaSize),
+        interpreter_(tflite::GetModel(model_.data()), resolver(),
+                     arena_.data(), arena_.size()) {}
+
+  TfLiteStatus AllocateTensors() { return interpreter_.AllocateTensors(); }
+
+  const int8_t* Invoke(const std::vector<int8_t>& input) {
+    memcpy(interpreter_.input(0)->data.int8, input.data(), input.size());
+    TEST_ASSERT_EQUAL(kTfLiteOk, interpreter_.Invoke());
+    return interpreter_.output(0)->data.int8;
+  }
+
+  size_t output_size() { return interpreter_.output(0)->bytes; }
+
+ private:
+  const tflite::MicroOpResolver& resolver() {
+    resolver_.AddConv2D();
+    resolver_.AddDepthwiseConv2D();
+    resolver_.AddFullyConnected();
+    return resolver_;
+  }
+
+  const std::vector<uint8_t> model_;
+  std::vector<uint8_t> arena_;
+  tflite::MicroMutableOpResolver<3> resolver_;
+  tflite::MicroInterpreter interpreter_;
+};
+
+// Runs `layer` palettized at every index width, with per-channel and
+// per-tensor palettes, and dense with the decoded values, on a few random
+// inputs.
+void CheckMatchesDense(const LayerCase& layer) {
+  const int rows = layer.filter_shape[0];
+  const int row_length = ElementCount(layer.filter_shape) / rows;
+  for (int index_bits = 1; index_bits <= 8; ++index_bits) {
+    for (int palette_channels : {rows, 1}) {
+      const Palettized filter =
+          MakePalettized(rows, row_length, index_bits, palette_channels);
+      Layer palettized(BuildModel(layer, {}, &filter));
+      Layer dense(BuildModel(layer, filter.decoded, nullptr));
+      TEST_ASSERT_EQUAL(kTfLiteOk, palettized.AllocateTensors());
+      TEST_ASSERT_EQUAL(kTfLiteOk, dense.AllocateTensors());
+      TEST_ASSERT_EQUAL(dense.output_size(), palettized.output_size());
+
+      std::vector<int8_t> input(ElementCount(layer.input_shape));
+      for (int trial = 0; trial < 3; ++trial) {
+        for (int8_t& value : input) {
+          value = static_cast<int8_t>(RandomInt(-128, 127));
+        }
+        const int8_t* expected = dense.Invoke(input);
+        const int8_t* actual = palettized.Invoke(input);
+        char message[96];
+        snprintf(message, sizeof(message), "%d-bit indices, %d palette(s)",
+                 index_bits, palette_channels);
+        TEST_ASSERT_EQUAL_INT8_ARRAY_MESSAGE(expected, actual,
+                                             dense.output_size(), message);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Rows of 27 to 2700 weights: one tile of all output channels, several
+// tiles, and one channel per tile once a row passes the 2 KB tile.
+void test_conv_matches_dense() {
+  using tflite::ActivationFunctionType_NONE;
+  using tflite::ActivationFunctionType_RELU6;
+  const LayerCase layers[] = {
+      {tflite::BuiltinOperator_CONV_2D, {1, 8, 8, 3}, {8, 3, 3, 3},
+       tflite::Padding_SAME, 1, 1, ActivationFunctionType_NONE},
+      {tflite::BuiltinOperator_CONV_2D, {1, 9, 9, 16}, {24, 3, 3, 16},
+       tflite::Padding_VALID, 2, 1, ActivationFunctionType_RELU6},
+      {tflite::BuiltinOperator_CONV_2D, {1, 10, 10, 8}, {6, 3, 3, 8},
+       tflite::Padding_SAME, 1, 2, ActivationFunctionType_NONE},
+      {tflite::BuiltinOperator_CONV_2D, {2, 5, 5, 64}, {40, 1, 1, 64},
+       tflite::Padding_SAME, 1, 1, ActivationFunctionType_NONE},
+      {tflite::BuiltinOperator_CONV_2D, {1, 4, 4, 300}, {5, 3, 3, 300},
+       tflite::Padding_SAME, 2, 1, ActivationFunctionType_NONE},
+  };
+  for (const LayerCase& layer : layers) CheckMatchesDense(layer);
+}
+
+// Row lengths around the tile size and the optimized row blocks, with
+// several batches.
+void test_fully_connected_matches_dense() {
+  using tflite::ActivationFunctionType_NONE;
+  using tflite::ActivationFunctionType_RELU;
+  const LayerCase layers[] = {
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {1, 64}, {10, 64},
+       tflite::Padding_VALID, 1, 1, ActivationFunctionType_NONE},
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {3, 256}, {40, 256},
+       tflite::Padding_VALID, 1, 1, ActivationFunctionType_NONE},
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {1, 1024}, {100, 1024},
+       tflite::Padding_VALID, 1, 1, ActivationFunctionType_RELU},
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {2, 3001}, {7, 3001},
+       tflite::Padding_VALID, 1, 1, ActivationFunctionType_NONE},
+  };
+  for (const LayerCase& layer : layers) CheckMatchesDense(layer);
+}
+
+// Depthwise does not decode palettes, so a palettized filter must fail
+// Prepare instead of being read as int8 weights.
+void test_depthwise_rejects_palettized_filter() {
+  const LayerCase layer = {tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                           {1, 6, 6, 8},
+                           {1, 3, 3, 8},
+                           tflite::Padding_SAME,
+                           1,
+                           1,
+                           tflite::ActivationFunctionType_NONE};
+  const Palettized filter = MakePalettized(1, 72, 4, 1);
+  Layer dense(BuildModel(layer, filter.decoded, nullptr));
+  TEST_ASSERT_EQUAL(kTfLiteOk, dense.AllocateTensors());
+  Layer palettized(BuildModel(layer, {}, &filter));
+  TEST_ASSERT_NOT_EQUAL(kTfLiteOk, palettized.AllocateTensors());
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_conv_matches_dense);
+  RUN_TEST(test_fully_connected_matches_dense);
+  RUN_TEST(test_depthwise_rejects_palettized_filter);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
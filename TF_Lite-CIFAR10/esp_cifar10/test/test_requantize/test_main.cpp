@@ -0,0 +1,347 @@
+// optimized_integer_ops RequantizeRow / RequantizeRowPerChannel
+// (requantize.h) against MultiplyByQuantizedMultiplier, and the int8
+// DepthwiseConvPerChannel that requantizes in blocks of kRequantizeBlockSize
+// channels, used by the esp_nn shim when ESP_NN is off, against
+// reference_integer_ops, plus a timing comparison.
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <initializer_list>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/requantize.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+
+namespace {
+
+using tflite::optimized_integer_ops::kRequantizeBlockSize;
+
+std::mt19937 rng(40);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+tflite::RuntimeShape Shape(std::initializer_list<int32_t> dims) {
+  return tflite::RuntimeShape(dims.size(), dims.begin());
+}
+
+void FillRandom(std::vector<int8_t>& values) {
+  for (int8_t& value : values) value = static_cast<int8_t>(RandomInt(-128, 127));
+}
+
+// A multiplier over the whole non-negative range, mostly in the
+// [2^30, 2^31) that QuantizeMultiplier produces, and a shift in the
+// [-31, 7] MultiplyByQuantizedMultiplier accepts.
+void RandomMultiplier(int32_t* multiplier, int* shift) {
+  *multiplier = RandomInt(0, 3) ? RandomInt(1 << 30, 0x7fffffff)
+                                : RandomInt(0, 0x7fffffff);
+  *shift = RandomInt(-31, 7);
+}
+
+// An accumulator for which x * 2^shift does not overflow, at the extremes
+// one time in eight.
+int32_t RandomAccumulator(int shift) {
+  const int32_t limit =
+      std::numeric_limits<int32_t>::max() >> std::max(0, shift);
+  switch (RandomInt(0, 7)) {
+    case 0:
+      return -limit - 1;
+    case 1:
+      return limit;
+    default:
+      return RandomInt(-limit - 1, limit);
+  }
+}
+
+// The scalar formula RequantizeRow* replaces.
+int32_t ReferenceRequantize(int32_t x, int32_t multiplier, int shift,
+                            int32_t output_offset, int32_t activation_min,
+                            int32_t activation_max) {
+  int32_t value = tflite::MultiplyByQuantizedMultiplier(x, multiplier, shift);
+  value += output_offset;
+  value = std::max(value, activation_min);
+  value = std::min(value, activation_max);
+  return value;
+}
+
+struct DepthwiseCase {
+  int batches, input_height, input_width, input_depth, depth_multiplier;
+  int filter_height, filter_width;
+  int output_height, output_width;
+  tflite::DepthwiseParams params;
+  std::vector<int8_t> input;
+  std::vector<int8_t> filter;
+  std::vector<int32_t> bias;
+  std::vector<int32_t> multiplier;
+  std::vector<int32_t> shift;
+
+  DepthwiseCase(int batches, int height, int width, int input_depth,
+                int depth_multiplier, int filter_height, int filter_width,
+                int stride, int dilation, bool same_padding)
+      : batches(batches),
+        input_height(height),
+        input_width(width),
+        input_depth(input_depth),
+        depth_multiplier(depth_multiplier),
+        filter_height(filter_height),
+        filter_width(filter_width),
+        params(),
+        input(batches * height * width * input_depth),
+        filter(filter_height * filter_width * OutputDepth()),
+        bias(OutputDepth()),
+        multiplier(OutputDepth()),
+        shift(OutputDepth()) {
+    FillRandom(input);
+    FillRandom(filter);
+    for (int c = 0; c < OutputDepth(); ++c) {
+      bias[c] = RandomInt(-40000, 40000);
+      multiplier[c] = RandomInt(1 << 30, 0x7fffffff);
+      shift[c] = RandomInt(-10, 1);
+    }
+    const int effective_height = (filter_height - 1) * dilation + 1;
+    const int effective_width = (filter_width - 1) * dilation + 1;
+    output_height = same_padding ? (height + stride - 1) / stride
+                                 : (height - effective_height) / stride + 1;
+    output_width = same_padding ? (width + stride - 1) / stride
+                                : (width - effective_width) / stride + 1;
+    params.stride_height = params.stride_width = stride;
+    params.dilation_height_factor = params.dilation_width_factor = dilation;
+    params.depth_multiplier = depth_multiplier;
+    params.padding_values.height = std::max(
+        0, ((output_height - 1) * stride + effective_height - height) / 2);
+    params.padding_values.width = std::max(
+        0, ((output_width - 1) * stride + effective_width - width) / 2);
+    params.input_offset = RandomInt(-127, 128);
+    params.output_offset = RandomInt(-128, 127);
+    params.quantized_activation_min = RandomInt(-128, 0);
+    params.quantized_activation_max = RandomInt(0, 127);
+  }
+
+  int OutputDepth() const { return input_depth * depth_multiplier; }
+  int OutputSize() const {
+    return batches * output_height * output_width * OutputDepth();
+  }
+
+  void RunReference(int8_t* output) const {
+    tflite::reference_integer_ops::DepthwiseConvPerChannel(
+        params, multiplier.data(), shift.data(),
+        Shape({batches, input_height, input_width, input_depth}),
+        input.data(), Shape({1, filter_height, filter_width, OutputDepth()}),
+        filter.data(), Shape({OutputDepth()}), bias.data(),
+        Shape({batches, output_height, output_width, OutputDepth()}), output);
+  }
+
+  void RunOptimized(int8_t* output) const {
+    tflite::optimized_integer_ops::DepthwiseConvPerChannel(
+        params, multiplier.data(), shift.data(),
+        Shape({batches, input_height, input_width, input_depth}),
+        input.data(), Shape({1, filter_height, filter_width, OutputDepth()}),
+        filter.data(), Shape({OutputDepth()}), bias.data(),
+        Shape({batches, output_height, output_width, OutputDepth()}), output);
+  }
+};
+
+template <typename Case>
+void CheckCase(const Case& op) {
+  std::vector<int8_t> expected(op.OutputSize());
+  std::vector<int8_t> actual(op.OutputSize());
+  op.RunReference(expected.data());
+  op.RunOptimized(actual.data());
+  TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(),
+                               expected.size());
+}
+
+template <typename Case>
+double MicrosPerCall(const Case& op, bool optimized, int8_t* output) {
+  const int iterations = 50;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    if (optimized) {
+      op.RunOptimized(output);
+    } else {
+      op.RunReference(output);
+    }
+  }
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+template <typename Case>
+void ReportTiming(const char* name, const Case& op) {
+  std::vector<int8_t> output(op.OutputSize());
+  const double reference_us = MicrosPerCall(op, false, output.data());
+  const double optimized_us = MicrosPerCall(op, true, output.data());
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%s: reference %.1f us, optimized %.1f us (%.2fx)", name,
+           reference_us, optimized_us, reference_us / optimized_us);
+  TEST_MESSAGE(line);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_multiply_split_matches_multiply_by_quantized_multiplier() {
+  for (int trial = 0; trial < 200000; ++trial) {
+    int32_t multiplier;
+    int shift;
+    RandomMultiplier(&multiplier, &shift);
+    const int32_t x = RandomAccumulator(shift);
+    const int32_t expected =
+        tflite::MultiplyByQuantizedMultiplier(x, multiplier, shift);
+    const int32_t actual =
+        tflite::optimized_integer_ops::MultiplyByQuantizedMultiplierSplit(
+            x, multiplier, std::max(shift, 0), std::max(-shift, 0));
+    if (expected != actual) {
+      char line[128];
+      snprintf(line, sizeof(line), "x %ld multiplier %ld shift %d",
+               static_cast<long>(x), static_cast<long>(multiplier), shift);
+      TEST_FAIL_MESSAGE(line);
+    }
+  }
+}
+
+// Row lengths around kRequantizeBlockSize, with and without a bias, into
+// int8 and int16 outputs.
+void test_requantize_row_matches_scalar() {
+  for (int trial = 0; trial < 2000; ++trial) {
+    const int size = RandomInt(0, 2 * kRequantizeBlockSize + 1);
+    const bool with_bias = RandomInt(0, 1);
+    int32_t multiplier;
+    int shift;
+    RandomMultiplier(&multiplier, &shift);
+    std::vector<int32_t> acc(size);
+    std::vector<int32_t> bias(size);
+    for (int i = 0; i < size; ++i) {
+      // acc + bias stays within the accumulator range for the shift.
+      acc[i] = RandomAccumulator(shift) / 2;
+      bias[i] = with_bias ? RandomAccumulator(shift) / 2 : 0;
+    }
+    const int32_t output_offset = RandomInt(-128, 127);
+    const int32_t activation_min = RandomInt(-32768, 0);
+    const int32_t activation_max = RandomInt(0, 32767);
+
+    std::vector<int16_t> expected(size);
+    for (int i = 0; i < size; ++i) {
+      expected[i] = static_cast<int16_t>(
+          ReferenceRequantize(acc[i] + bias[i], multiplier, shift,
+                              output_offset, activation_min, activation_max));
+    }
+    std::vector<int16_t> actual(size + 1, 0x5a5a);
+    tflite::optimized_integer_ops::RequantizeRow(
+        acc.data(), with_bias ? bias.data() : nullptr, multiplier, shift,
+        output_offset, activation_min, activation_max, size, actual.data());
+    if (size > 0) {
+      TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), actual.data(), size);
+    }
+    TEST_ASSERT_EQUAL_INT16(0x5a5a, actual[size]);
+
+    std::vector<int8_t> expected8(size);
+    std::vector<int8_t> actual8(size);
+    for (int i = 0; i < size; ++i) {
+      expected8[i] = static_cast<int8_t>(ReferenceRequantize(
+          acc[i] + bias[i], multiplier, shift, output_offset, -128, 127));
+    }
+    tflite::optimized_integer_ops::RequantizeRow(
+        acc.data(), with_bias ? bias.data() : nullptr, multiplier, shift,
+        output_offset, -128, 127, size, actual8.data());
+    if (size > 0) {
+      TEST_ASSERT_EQUAL_INT8_ARRAY(expected8.data(), actual8.data(), size);
+    }
+  }
+}
+
+void test_requantize_row_per_channel_matches_scalar() {
+  for (int trial = 0; trial < 2000; ++trial) {
+    const int size = RandomInt(0, 2 * kRequantizeBlockSize + 1);
+    const bool with_bias = RandomInt(0, 1);
+    std::vector<int32_t> acc(size);
+    std::vector<int32_t> bias(size);
+    std::vector<int32_t> multiplier(size);
+    std::vector<int32_t> shift(size);
+    for (int i = 0; i < size; ++i) {
+      int channel_shift;
+      RandomMultiplier(&multiplier[i], &channel_shift);
+      shift[i] = channel_shift;
+      acc[i] = RandomAccumulator(channel_shift) / 2;
+      bias[i] = with_bias ? RandomAccumulator(channel_shift) / 2 : 0;
+    }
+    const int32_t output_offset = RandomInt(-128, 127);
+    const int32_t activation_min = RandomInt(-128, 0);
+    const int32_t activation_max = RandomInt(0, 127);
+
+    std::vector<int8_t> expected(size);
+    for (int i = 0; i < size; ++i) {
+      expected[i] = static_cast<int8_t>(
+          ReferenceRequantize(acc[i] + bias[i], multiplier[i], shift[i],
+                              output_offset, activation_min, activation_max));
+    }
+    std::vector<int8_t> actual(size);
+    tflite::optimized_integer_ops::RequantizeRowPerChannel(
+        acc.data(), with_bias ? bias.data() : nullptr, multiplier.data(),
+        shift.data(), output_offset, activation_min, activation_max, size,
+        actual.data());
+    if (size > 0) {
+      TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), size);
+    }
+  }
+}
+
+// depth_multiplier 1 and above, with output depths on both sides of
+// multiples of kRequantizeBlockSize.
+void test_depthwise_matches_reference() {
+  const int depths[] = {1, kRequantizeBlockSize - 1, kRequantizeBlockSize,
+                        kRequantizeBlockSize + 1, 3 * kRequantizeBlockSize - 5};
+  for (int trial = 0; trial < 300; ++trial) {
+    const int dilation = RandomInt(1, 3);
+    const int filter_size = RandomInt(1, 5);
+    const bool same_padding = RandomInt(0, 1);
+    const int min_size = same_padding ? 1 : (filter_size - 1) * dilation + 1;
+    const int depth_multiplier = trial % 2 ? 1 : RandomInt(2, 4);
+    const int input_depth =
+        trial % 3 ? depths[RandomInt(0, 4)] : RandomInt(1, 40);
+    const DepthwiseCase depthwise(
+        RandomInt(1, 2), RandomInt(min_size, min_size + 6),
+        RandomInt(min_size, min_size + 6), input_depth, depth_multiplier,
+        filter_size, filter_size, RandomInt(1, 2), dilation, same_padding);
+    CheckCase(depthwise);
+  }
+}
+
+void test_benchmark_against_reference() {
+  const DepthwiseCase depthwise(1, 16, 16, 96, 1, 3, 3, 1, 1, true);
+  ReportTiming("Depthwise 16x16x96 3x3", depthwise);
+  const DepthwiseCase strided(1, 16, 16, 144, 1, 3, 3, 2, 1, true);
+  ReportTiming("Depthwise 16x16x144 3x3 /2", strided);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_multiply_split_matches_multiply_by_quantized_multiplier);
+  RUN_TEST(test_requantize_row_matches_scalar);
+  RUN_TEST(test_requantize_row_per_channel_matches_scalar);
+  RUN_TEST(test_depthwise_matches_reference);
+  RUN_TEST(test_benchmark_against_reference);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
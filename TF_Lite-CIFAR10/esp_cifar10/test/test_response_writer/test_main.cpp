@@ -0,0 +1,507 @@
+// ResponseWriter contra a montagem antiga das respostas (um String do
+// Arduino concatenado campo a campo e um client.println() por header), com
+// o String emulado pela política do WString do arduino-esp32: buffer
+// interno de 11 caracteres e realloc do tamanho exato a cada concatenação
+// que não cabe. Confere que o JSON sai byte a byte igual ao antigo, o
+// escape das strings, NaN e infinito como null, o 500 quando o corpo não
+// cabe no buffer, e mede alocações, escritas e tempo por resposta.
+#include <unity.h>
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+
+#include "http_request_parser.h"
+#include "response_writer.h"
+
+// Conta as alocações do processo, para conferir que o ResponseWriter não
+// faz nenhuma.
+static size_t new_count = 0;
+
+void* operator new(size_t size) {
+  ++new_count;
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+std::mt19937 rng(45);
+
+size_t string_allocs = 0;
+
+// O suficiente do String do arduino-esp32 para as respostas antigas.
+class String {
+ public:
+  String(const char* text = "") { copy(text, strlen(text)); }
+  String(const String& other) { copy(other.c_str(), other.len_); }
+  explicit String(int value) {
+    char text[16];
+    copy(text, snprintf(text, sizeof(text), "%d", value));
+  }
+  explicit String(unsigned value) {
+    char text[16];
+    copy(text, snprintf(text, sizeof(text), "%u", value));
+  }
+  String(float value, int decimals) {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    copy(text, strlen(text));
+  }
+  ~String() {
+    if (heap_ != nullptr) free(heap_);
+  }
+  String& operator=(const String&) = delete;
+
+  String& operator+=(const String& other) {
+    concat(other.c_str(), other.len_);
+    return *this;
+  }
+  String& operator+=(const char* text) {
+    concat(text, strlen(text));
+    return *this;
+  }
+  const char* c_str() const { return heap_ != nullptr ? heap_ : sso_; }
+  size_t length() const { return len_; }
+
+ private:
+  static constexpr size_t kSsoSize = 11;
+
+  char* buffer() { return heap_ != nullptr ? heap_ : sso_; }
+  size_t capacity() const { return heap_ != nullptr ? capacity_ : kSsoSize; }
+
+  void reserve(size_t size) {
+    if (size <= capacity()) return;
+    char* grown = static_cast<char*>(realloc(heap_, size + 1));
+    ++string_allocs;
+    if (heap_ == nullptr) memcpy(grown, sso_, len_ + 1);
+    heap_ = grown;
+    capacity_ = size;
+  }
+  void copy(const char* text, size_t length) {
+    reserve(length);
+    memcpy(buffer(), text, length);
+    len_ = length;
+    buffer()[len_] = '\0';
+  }
+  void concat(const char* text, size_t length) {
+    reserve(len_ + length);
+    memmove(buffer() + len_, text, length);
+    len_ += length;
+    buffer()[len_] = '\0';
+  }
+
+  char sso_[kSsoSize + 1] = {};
+  char* heap_ = nullptr;
+  size_t capacity_ = 0;
+  size_t len_ = 0;
+};
+
+// "literal" + String(...) + ",\n" como no WString: o literal vira um
+// StringSumHelper e as somas seguintes concatenam nele.
+class StringSumHelper : public String {
+ public:
+  StringSumHelper(const char* text) : String(text) {}
+};
+
+StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs) {
+  StringSumHelper& out = const_cast<StringSumHelper&>(lhs);
+  out += rhs;
+  return out;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, const char* rhs) {
+  StringSumHelper& out = const_cast<StringSumHelper&>(lhs);
+  out += rhs;
+  return out;
+}
+
+// O WiFiClient: concatena o que foi enviado e conta as chamadas de write().
+struct FakeClient {
+  std::string sent;
+  int writes = 0;
+  void print(const String& text) { write(text.c_str(), text.length()); }
+  void println(const String& text) {
+    print(text);
+    println();
+  }
+  void println() { write("\r\n", 2); }
+  void write(const char* data, size_t size) {
+    sent.append(data, size);
+    ++writes;
+  }
+};
+
+struct Result {
+  bool success;
+  int predicted_class;
+  float confidence;
+  String error_message;
+};
+
+const unsigned kHeapFree = 187424;
+
+// create_json_response() e send_response() antes do ResponseWriter.
+String old_json_response(const Result& result) {
+  String response = "{\n";
+  response += "  \"success\": " + String(result.success ? "true" : "false") + ",\n";
+  response += "  \"predicted_class\": " + String(result.predicted_class) + ",\n";
+  response += "  \"confidence\": " + String(result.confidence, 6) + ",\n";
+  response += "  \"error_message\": \"" + result.error_message + "\",\n";
+  response += "  \"heap_free\": " + String(kHeapFree) + ",\n";
+  response += "  \"model_initialized\": " + String("true") + "\n";
+  response += "}";
+  return response;
+}
+
+String old_batch_json_response(const Result* results, int count) {
+  bool all_success = true;
+  for (int i = 0; i < count; ++i) all_success = all_success && results[i].success;
+
+  String response = "{\n";
+  response += "  \"success\": " + String(all_success ? "true" : "false") + ",\n";
+  response += "  \"count\": " + String(count) + ",\n";
+  response += "  \"results\": [\n";
+  for (int i = 0; i < count; ++i) {
+    response += "    {\"success\": " + String(results[i].success ? "true" : "false") +
+                ", \"predicted_class\": " + String(results[i].predicted_class) +
+                ", \"confidence\": " + String(results[i].confidence, 6) +
+                ", \"error_message\": \"" + results[i].error_message + "\"}";
+    response += (i + 1 < count) ? ",\n" : "\n";
+  }
+  response += "  ],\n";
+  response += "  \"heap_free\": " + String(kHeapFree) + ",\n";
+  response += "  \"model_initialized\": " + String("true") + "\n";
+  response += "}";
+  return response;
+}
+
+void old_send_response(FakeClient& client, int status, const String& content_type,
+                       const String& body, bool keep_alive) {
+  client.println("HTTP/1.1 " + String(status) + " " + http_status_text(status));
+  client.println("Content-Type: " + content_type);
+  client.println("Access-Control-Allow-Origin: *");
+  client.println(keep_alive ? "Connection: keep-alive" : "Connection: close");
+  client.println("Content-Length: " + String(static_cast<unsigned>(body.length())));
+  client.println();
+  client.print(body);
+}
+
+// write_json_response() e write_batch_json_response() com os campos que
+// as respostas antigas tinham.
+void write_result_fields(ResponseWriter& out, const Result& result) {
+  out.field_bool("success", result.success);
+  out.field_int("predicted_class", result.predicted_class);
+  out.field_float("confidence", result.confidence, 6);
+  out.field_string("error_message", result.error_message.c_str());
+}
+
+void write_json_response(ResponseWriter& out, const Result& result) {
+  out.begin_object();
+  write_result_fields(out, result);
+  out.field_uint("heap_free", kHeapFree);
+  out.field_bool("model_initialized", true);
+  out.end_object();
+}
+
+void write_batch_json_response(ResponseWriter& out, const Result* results, int count) {
+  bool all_success = true;
+  for (int i = 0; i < count; ++i) all_success = all_success && results[i].success;
+
+  out.begin_object();
+  out.field_bool("success", all_success);
+  out.field_int("count", count);
+  out.begin_array("results");
+  for (int i = 0; i < count; ++i) {
+    out.begin_object(nullptr, true);
+    write_result_fields(out, results[i]);
+    out.end_object();
+  }
+  out.end_array();
+  out.field_uint("heap_free", kHeapFree);
+  out.field_bool("model_initialized", true);
+  out.end_object();
+}
+
+Result random_result(bool with_error) {
+  std::uniform_real_distribution<float> confidence(0.0f, 1.0f);
+  return {!with_error, static_cast<int>(rng() % 10), confidence(rng),
+          with_error ? "Corpo incompleto" : ""};
+}
+
+// Corpo da resposta montada por `writer` (depois do finish()).
+std::string body_of(const ResponseWriter& writer) {
+  return std::string(writer.data() + writer.size() - writer.body_size(),
+                     writer.body_size());
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Resposta única e lote de 8, sucesso e erro: status, headers e corpo
+// iguais byte a byte aos da montagem antiga.
+void test_matches_old_responses() {
+  char buffer[4096];
+  ResponseWriter writer(buffer, sizeof(buffer));
+  for (int trial = 0; trial < 50; ++trial) {
+    const Result result = random_result(trial % 5 == 0);
+    FakeClient client;
+    old_send_response(client, 200, "application/json", old_json_response(result),
+                      trial % 2 == 0);
+    writer.reset();
+    write_json_response(writer, result);
+    writer.finish(200, "application/json", trial % 2 == 0);
+    TEST_ASSERT_EQUAL_STRING(client.sent.c_str(),
+                             std::string(writer.data(), writer.size()).c_str());
+
+    Result batch[8] = {random_result(false), random_result(false), random_result(true),
+                       random_result(false), random_result(false), random_result(false),
+                       random_result(false), random_result(trial % 3 == 0)};
+    const int count = 1 + trial % 8;
+    client = FakeClient();
+    old_send_response(client, 200, "application/json",
+                      old_batch_json_response(batch, count), true);
+    writer.reset();
+    write_batch_json_response(writer, batch, count);
+    writer.finish(200, "application/json", true);
+    TEST_ASSERT_EQUAL_STRING(client.sent.c_str(),
+                             std::string(writer.data(), writer.size()).c_str());
+  }
+}
+
+// Aspas, barras, quebras de linha e controles são escapados (a resposta
+// antiga saía com JSON inválido); UTF-8 passa como está.
+void test_string_escaping() {
+  char buffer[1024];
+  ResponseWriter writer(buffer, sizeof(buffer));
+  writer.begin_object(nullptr, true);
+  writer.field_string("a\"b", "aspas \" barra \\ fim");
+  writer.field_string("c", "linha\nnova\r\ttab\x01\x1f");
+  writer.field_string("d", "inválido: ç");
+  writer.field_string("e", "");
+  writer.end_object();
+  writer.finish(200, "application/json", true);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"a\\\"b\": \"aspas \\\" barra \\\\ fim\", "
+      "\"c\": \"linha\\nnova\\u000d\\u0009tab\\u0001\\u001f\", "
+      "\"d\": \"inválido: ç\", \"e\": \"\"}",
+      body_of(writer).c_str());
+}
+
+// field_float() igual ao snprintf("%.*f") (o String(value, decimals)
+// antigo) para valores finitos, salvo nos empates exatos, que o writer
+// arredonda para longe do zero, e nos negativos que arredondam para zero,
+// que saem sem o "-"; null para NaN, infinito e valores que não cabem em
+// 64 bits com as casas pedidas.
+void test_float_formatting() {
+  char buffer[ResponseWriter::kHeaderSpace + 64];
+  ResponseWriter writer(buffer, sizeof(buffer));
+  std::uniform_real_distribution<float> value(-1000.0f, 1000.0f);
+  char expected[64];
+  int compared = 0;
+  for (int i = 0; i < 20000; ++i) {
+    const int decimals = i % 7;
+    // Metade dos valores em [0, 1], como as confianças.
+    const float v = i % 2 == 0 ? value(rng) : fabsf(value(rng)) / 1000.0f;
+    const double scaled = fabs(static_cast<double>(v)) * pow(10.0, decimals);
+    if (scaled - floor(scaled) == 0.5 || (v < 0 && scaled < 0.5)) continue;
+    ++compared;
+    snprintf(expected, sizeof(expected), "%.*f", decimals, v);
+    writer.reset();
+    writer.field_float(nullptr, v, decimals);
+    TEST_ASSERT_EQUAL_STRING(expected, body_of(writer).c_str());
+  }
+  TEST_ASSERT_TRUE(compared > 19000);
+
+  const struct {
+    float value;
+    int decimals;
+    const char* text;
+  } kCases[] = {
+      {NAN, 6, "null"},           {-NAN, 2, "null"},          {INFINITY, 3, "null"},
+      {-INFINITY, 0, "null"},     {1e30f, 0, "null"},         {-3e10f, 9, "null"},
+      {0.0f, 0, "0"},             {-0.0f, 3, "0.000"},        {-0.0004f, 3, "0.000"},
+      {-0.0006f, 3, "-0.001"},    {0.5f, 0, "1"},             {2.5f, 0, "3"},
+      {123.456f, 2, "123.46"},    {1e9f, 8, "1000000000.00000000"},
+      {0.1f, -1, "0"},            {0.125f, 12, "0.12500000"},
+  };
+  for (const auto& c : kCases) {
+    writer.reset();
+    writer.field_float(nullptr, c.value, c.decimals);
+    TEST_ASSERT_EQUAL_STRING(c.text, body_of(writer).c_str());
+  }
+
+  writer.reset();
+  writer.field_int(nullptr, LONG_MIN);
+  snprintf(expected, sizeof(expected), "%ld", LONG_MIN);
+  TEST_ASSERT_EQUAL_STRING(expected, body_of(writer).c_str());
+}
+
+// Objetos e arrays aninhados, vazios, inline e field_top_k no formato de
+// um item de lote.
+void test_layout() {
+  char buffer[1024];
+  ResponseWriter writer(buffer, sizeof(buffer));
+  const int classes[] = {3, 5};
+  const float scores[] = {0.75f, 0.125f};
+  writer.begin_object();
+  writer.begin_array("vazio");
+  writer.end_array();
+  writer.begin_object("timings_ms", true);
+  writer.field_float("queue", 0.25f, 3);
+  writer.end_object();
+  writer.field_top_k("top_k", "class", classes, scores, 2, 2);
+  writer.begin_array("results");
+  writer.begin_object(nullptr, true);
+  writer.field_top_k("top_k", "class", classes, scores, 1, 2);
+  writer.end_object();
+  writer.end_array();
+  writer.end_object();
+  writer.finish(200, "application/json", true);
+  TEST_ASSERT_FALSE(writer.overflow());
+  TEST_ASSERT_EQUAL_STRING(
+      "{\n"
+      "  \"vazio\": [],\n"
+      "  \"timings_ms\": {\"queue\": 0.250},\n"
+      "  \"top_k\": [\n"
+      "    {\"class\": 3, \"score\": 0.75},\n"
+      "    {\"class\": 5, \"score\": 0.13}\n"
+      "  ],\n"
+      "  \"results\": [\n"
+      "    {\"top_k\": [{\"class\": 3, \"score\": 0.75}]}\n"
+      "  ]\n"
+      "}",
+      body_of(writer).c_str());
+}
+
+// Corpo maior que o buffer, objeto não fechado e aninhamento acima de
+// kMaxDepth: o finish() troca a resposta por um 500 completo, com o
+// Content-Length certo, e o writer volta a funcionar depois do reset().
+void test_overflow_fallback() {
+  const char kExpected[] =
+      "HTTP/1.1 500 Internal Server Error\r\n"
+      "Content-Type: application/json\r\n"
+      "Access-Control-Allow-Origin: *\r\n"
+      "X-Extra: 1\r\n"
+      "Connection: keep-alive\r\n"
+      "Content-Length: 72\r\n"
+      "\r\n"
+      "{\n  \"success\": false,\n"
+      "  \"error_message\": \"Resposta maior que o buffer\"\n}";
+  char buffer[ResponseWriter::kHeaderSpace + 96];
+  ResponseWriter writer(buffer, sizeof(buffer), "X-Extra: 1\r\n");
+
+  for (int scenario = 0; scenario < 3; ++scenario) {
+    writer.reset();
+    writer.begin_object();
+    if (scenario == 0) {
+      for (int i = 0; i < 20; ++i) writer.field_string("campo", "valor longo");
+      TEST_ASSERT_TRUE(writer.overflow());
+      writer.end_object();
+    } else if (scenario == 2) {
+      for (int i = 0; i < ResponseWriter::kMaxDepth; ++i) writer.begin_array(nullptr, true);
+      TEST_ASSERT_TRUE(writer.overflow());
+    }
+    writer.finish(200, "text/html", true);
+    TEST_ASSERT_EQUAL_STRING(kExpected, std::string(writer.data(), writer.size()).c_str());
+  }
+
+  // Um corpo que ocupa o buffer exatamente não é overflow.
+  writer.reset();
+  const std::string fill(sizeof(buffer) - ResponseWriter::kHeaderSpace, 'x');
+  writer.append(fill.c_str());
+  TEST_ASSERT_FALSE(writer.overflow());
+  writer.finish(200, "text/plain", true);
+  TEST_ASSERT_EQUAL(fill.size(), writer.body_size());
+  TEST_ASSERT_EQUAL_STRING(fill.c_str(), body_of(writer).c_str());
+  TEST_ASSERT_EQUAL(0, strncmp(writer.data(), "HTTP/1.1 200 OK\r\n", 17));
+}
+
+void test_benchmark_against_old_responses() {
+  char buffer[4096];
+  ResponseWriter writer(buffer, sizeof(buffer));
+  Result batch[8];
+  for (Result& result : batch) {
+    const Result random = random_result(false);
+    result.success = random.success;
+    result.predicted_class = random.predicted_class;
+    result.confidence = random.confidence;
+  }
+  const int kIterations = 20000;
+  for (int count : {1, 8}) {
+    string_allocs = 0;
+    int old_writes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      FakeClient client;
+      old_send_response(client, 200, "application/json",
+                        count == 1 ? old_json_response(batch[0])
+                                   : old_batch_json_response(batch, count),
+                        true);
+      old_writes = client.writes;
+    }
+    const double old_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          kIterations;
+    const double old_allocs = static_cast<double>(string_allocs) / kIterations;
+
+    const size_t news_before = new_count;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+      writer.reset();
+      if (count == 1) {
+        write_json_response(writer, batch[0]);
+      } else {
+        write_batch_json_response(writer, batch, count);
+      }
+      writer.finish(200, "application/json", true);
+    }
+    const double new_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          kIterations;
+    TEST_ASSERT_EQUAL(news_before, new_count);
+
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%d resultado(s): antigo %.2f us, %.0f alocações, %d writes; "
+             "writer %.2f us, 0 alocações, 1 write",
+             count, old_us, old_allocs, old_writes, new_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_old_responses);
+  RUN_TEST(test_string_escaping);
+  RUN_TEST(test_float_formatting);
+  RUN_TEST(test_layout);
+  RUN_TEST(test_overflow_fallback);
+  RUN_TEST(test_benchmark_against_old_responses);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
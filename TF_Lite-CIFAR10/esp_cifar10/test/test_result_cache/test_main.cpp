@@ -0,0 +1,252 @@
+// ResultCache contra um LRU de referência (std::list, do mais recente ao
+// mais antigo) em milhares de consultas aleatórias com o cache cheio; uma
+// colisão real do MurmurHash64A, montada invertendo a mistura das duas
+// primeiras palavras, tem que dar falha e não o resultado da outra
+// imagem; clear() invalida tudo; capacidade 0 desliga o cache.
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <list>
+#include <random>
+#include <vector>
+
+#include "result_cache.h"
+
+namespace {
+
+std::mt19937 rng(49);
+
+// A entrada da MNIST: 28x28 int8.
+const size_t kInputSize = 28 * 28;
+
+const uint64_t kMurmurM = 0xc6a4a7935bd1e995ULL;
+
+std::vector<int8_t> random_input() {
+  std::vector<int8_t> input(kInputSize);
+  for (int8_t& value : input) value = static_cast<int8_t>(rng());
+  return input;
+}
+
+CachedPrediction prediction_for(int id) {
+  CachedPrediction prediction = {};
+  prediction.count = 2;
+  prediction.classes[0] = id;
+  prediction.classes[1] = id + 1000;
+  prediction.scores[0] = id * 0.5f;
+  prediction.scores[1] = 0.25f;
+  return prediction;
+}
+
+void expect_prediction(int id, const CachedPrediction& prediction) {
+  const CachedPrediction expected = prediction_for(id);
+  TEST_ASSERT_EQUAL(expected.count, prediction.count);
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected.classes, prediction.classes,
+                              expected.count);
+  TEST_ASSERT_EQUAL_FLOAT(expected.scores[0], prediction.scores[0]);
+}
+
+// Consulta e, numa falha, insere o resultado de `id`, como
+// run_inference_on_input(). Devolve se acertou.
+bool classify(ResultCache& cache, const std::vector<int8_t>& input, int id) {
+  ResultCache::Key key = {};
+  CachedPrediction prediction = {};
+  if (cache.lookup(input.data(), input.size(), &key, &prediction)) {
+    expect_prediction(id, prediction);
+    return true;
+  }
+  cache.insert(key, prediction_for(id), 1000);
+  return false;
+}
+
+// A mistura de cada palavra do MurmurHash64A e a sua inversa.
+uint64_t mix(uint64_t k) {
+  k *= kMurmurM;
+  k ^= k >> 47;
+  return k * kMurmurM;
+}
+
+uint64_t unmix(uint64_t k) {
+  uint64_t inverse = kMurmurM;  // Newton: inverse * m == 1 mod 2^64.
+  for (int i = 0; i < 5; ++i) inverse *= 2 - kMurmurM * inverse;
+  k *= inverse;
+  k ^= k >> 47;  // 47 * 2 >= 64: a mesma operação desfaz.
+  return k * inverse;
+}
+
+// Outra entrada do mesmo tamanho e com o mesmo MurmurHash64A: troca a
+// primeira palavra e escolhe a segunda para o estado voltar a ser o mesmo.
+std::vector<int8_t> colliding_input(const std::vector<int8_t>& input) {
+  uint64_t words[2];
+  memcpy(words, input.data(), sizeof(words));
+  // O estado inicial de ResultCache::hash().
+  const uint64_t seed = 0x5f3759df9e3779b9ULL ^ (input.size() * kMurmurM);
+  const uint64_t state = (seed ^ mix(words[0])) * kMurmurM;
+  const uint64_t other_first = words[0] ^ 0x0123456789abcdefULL;
+  const uint64_t other_state = (seed ^ mix(other_first)) * kMurmurM;
+  const uint64_t other_words[2] = {
+      other_first, unmix(state ^ mix(words[1]) ^ other_state)};
+  std::vector<int8_t> other = input;
+  memcpy(other.data(), other_words, sizeof(other_words));
+  return other;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Falha, insert e acerto com o resultado guardado; outra imagem falha.
+void test_hit_after_insert() {
+  ResultCache cache(4);
+  const std::vector<int8_t> first = random_input();
+  std::vector<int8_t> second = first;
+  second[kInputSize / 2] ^= 1;
+  TEST_ASSERT_FALSE(classify(cache, first, 1));
+  TEST_ASSERT_TRUE(classify(cache, first, 1));
+  TEST_ASSERT_FALSE(classify(cache, second, 2));
+  TEST_ASSERT_TRUE(classify(cache, second, 2));
+  TEST_ASSERT_TRUE(classify(cache, first, 1));
+
+  const ResultCache::Stats stats = cache.stats();
+  TEST_ASSERT_EQUAL(4, stats.capacity);
+  TEST_ASSERT_EQUAL(2, stats.entries);
+  TEST_ASSERT_EQUAL(3, stats.hits);
+  TEST_ASSERT_EQUAL(2, stats.misses);
+  TEST_ASSERT_EQUAL(0, stats.evictions);
+  TEST_ASSERT_EQUAL(2000, stats.total_invoke_us);
+}
+
+// Com o cache cheio sai sempre a entrada usada há mais tempo, contando os
+// acertos como uso: as mesmas falhas e acertos que o LRU de referência.
+void test_lru_order_at_capacity() {
+  for (int capacity : {1, 2, 5, 8, ResultCache::kMaxEntries}) {
+    ResultCache cache(capacity);
+    std::vector<std::vector<int8_t>> inputs;
+    for (int i = 0; i < capacity * 2 + 3; ++i) inputs.push_back(random_input());
+    std::list<int> reference;
+    uint32_t evictions = 0;
+    for (int step = 0; step < 5000; ++step) {
+      // Metade das consultas nas entradas recentes, para haver acertos.
+      const int id = rng() % 2 == 0 && !reference.empty()
+                         ? *std::next(reference.begin(),
+                                      rng() % reference.size())
+                         : static_cast<int>(rng() % inputs.size());
+      const auto found = std::find(reference.begin(), reference.end(), id);
+      const bool expected_hit = found != reference.end();
+      TEST_ASSERT_EQUAL(expected_hit, classify(cache, inputs[id], id));
+      if (expected_hit) reference.erase(found);
+      reference.push_front(id);
+      if (static_cast<int>(reference.size()) > capacity) {
+        reference.pop_back();
+        evictions++;
+      }
+    }
+    const ResultCache::Stats stats = cache.stats();
+    TEST_ASSERT_EQUAL(capacity, stats.entries);
+    TEST_ASSERT_EQUAL(evictions, stats.evictions);
+    TEST_ASSERT_EQUAL(5000, stats.hits + stats.misses);
+  }
+
+  // O caso pequeno à mão: A, B, C, acerto em A, D expulsa B.
+  ResultCache cache(3);
+  std::vector<std::vector<int8_t>> inputs;
+  for (int i = 0; i < 4; ++i) inputs.push_back(random_input());
+  for (int i = 0; i < 3; ++i) TEST_ASSERT_FALSE(classify(cache, inputs[i], i));
+  TEST_ASSERT_TRUE(classify(cache, inputs[0], 0));
+  TEST_ASSERT_FALSE(classify(cache, inputs[3], 3));
+  TEST_ASSERT_TRUE(classify(cache, inputs[0], 0));
+  TEST_ASSERT_TRUE(classify(cache, inputs[2], 2));
+  TEST_ASSERT_TRUE(classify(cache, inputs[3], 3));
+  TEST_ASSERT_FALSE(classify(cache, inputs[1], 1));
+  TEST_ASSERT_EQUAL(2, cache.stats().evictions);
+}
+
+// Mesmo MurmurHash, outra imagem: falha (não o resultado da primeira),
+// conta em collisions, e depois do insert as duas convivem.
+void test_hash_collision_is_a_miss() {
+  ResultCache cache(4);
+  for (int trial = 0; trial < 20; ++trial) {
+    const std::vector<int8_t> first = random_input();
+    const std::vector<int8_t> second = colliding_input(first);
+    TEST_ASSERT_FALSE(first == second);
+    TEST_ASSERT_EQUAL_HEX64(ResultCache::hash(first.data(), kInputSize),
+                            ResultCache::hash(second.data(), kInputSize));
+    TEST_ASSERT_NOT_EQUAL(ResultCache::check(first.data(), kInputSize),
+                          ResultCache::check(second.data(), kInputSize));
+
+    cache.clear();
+    const uint32_t collisions = cache.stats().collisions;
+    TEST_ASSERT_FALSE(classify(cache, first, 10));
+    TEST_ASSERT_FALSE(classify(cache, second, 20));
+    TEST_ASSERT_EQUAL(collisions + 1, cache.stats().collisions);
+    TEST_ASSERT_TRUE(classify(cache, first, 10));
+    TEST_ASSERT_TRUE(classify(cache, second, 20));
+    TEST_ASSERT_EQUAL(collisions + 1, cache.stats().collisions);
+    TEST_ASSERT_EQUAL(2, cache.stats().entries);
+  }
+}
+
+// clear() (modelo recarregado) faz tudo falhar de novo; só conta como
+// invalidação com o cache não vazio.
+void test_clear_invalidates() {
+  ResultCache cache(8);
+  std::vector<std::vector<int8_t>> inputs;
+  for (int i = 0; i < 5; ++i) {
+    inputs.push_back(random_input());
+    TEST_ASSERT_FALSE(classify(cache, inputs[i], i));
+  }
+  cache.clear();
+  ResultCache::Stats stats = cache.stats();
+  TEST_ASSERT_EQUAL(0, stats.entries);
+  TEST_ASSERT_EQUAL(1, stats.invalidations);
+  cache.clear();
+  TEST_ASSERT_EQUAL(1, cache.stats().invalidations);
+
+  // Depois do clear() o resultado novo (outro modelo) é o que vale.
+  for (int i = 0; i < 5; ++i) {
+    TEST_ASSERT_FALSE(classify(cache, inputs[i], i + 100));
+  }
+  for (int i = 0; i < 5; ++i) {
+    TEST_ASSERT_TRUE(classify(cache, inputs[i], i + 100));
+  }
+  stats = cache.stats();
+  TEST_ASSERT_EQUAL(5, stats.entries);
+  TEST_ASSERT_EQUAL(0, stats.evictions);
+}
+
+// Capacidade 0 nunca acerta nem guarda; acima de kMaxEntries é limitada.
+void test_capacity_limits() {
+  ResultCache disabled(0);
+  const std::vector<int8_t> input = random_input();
+  TEST_ASSERT_FALSE(classify(disabled, input, 1));
+  TEST_ASSERT_FALSE(classify(disabled, input, 1));
+  TEST_ASSERT_EQUAL(0, disabled.stats().entries);
+  TEST_ASSERT_EQUAL(0, disabled.stats().misses);
+  TEST_ASSERT_EQUAL(0, ResultCache(-3).stats().capacity);
+  TEST_ASSERT_EQUAL(ResultCache::kMaxEntries,
+                    ResultCache(ResultCache::kMaxEntries + 1).stats().capacity);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_hit_after_insert);
+  RUN_TEST(test_lru_order_at_capacity);
+  RUN_TEST(test_hash_collision_is_a_miss);
+  RUN_TEST(test_clear_invalidates);
+  RUN_TEST(test_capacity_limits);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,237 @@
+// select_top_k contra uma ordenação completa estável (std::stable_sort por
+// valor decrescente, que deixa o menor índice na frente nos empates) e,
+// com k == 1, contra o argmax antigo das aplicações. Cobre saídas com
+// muitos empates, k maior que o número de classes e o limite de k a
+// 1..kMaxTopK, e mede o custo contra a ordenação completa.
+#include <unity.h>
+
+#include <limits.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "top_k.h"
+
+namespace {
+
+std::mt19937 rng(48);
+
+const float kScale = 1.0f / 256.0f;
+const int32_t kZeroPoint = -128;
+
+// O laço de run_inference_on_input() antes do top_k.
+int old_argmax(const int8_t* values, int count, int8_t* max_score) {
+  int best_index = 0;
+  *max_score = SCHAR_MIN;
+  for (int i = 0; i < count; ++i) {
+    if (values[i] > *max_score) {
+      *max_score = values[i];
+      best_index = i;
+    }
+  }
+  return best_index;
+}
+
+std::vector<int> stable_order(const std::vector<int8_t>& values) {
+  std::vector<int> order(values.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int a, int b) { return values[a] > values[b]; });
+  return order;
+}
+
+// Valores int8 aleatórios; com `levels` pequeno quase tudo empata.
+std::vector<int8_t> random_values(int count, int levels) {
+  std::vector<int8_t> values(count);
+  for (int8_t& value : values) {
+    value = static_cast<int8_t>(SCHAR_MIN + static_cast<int>(rng() % levels));
+  }
+  return values;
+}
+
+void expect_top_k(const std::vector<int8_t>& values, int k) {
+  int classes[kMaxTopK + 1];
+  float scores[kMaxTopK + 1];
+  // Sentinelas: nada além do que foi devolvido pode ser escrito.
+  std::fill(classes, classes + kMaxTopK + 1, -7);
+  std::fill(scores, scores + kMaxTopK + 1, -7.0f);
+  const int count = static_cast<int>(values.size());
+  const int written = select_top_k(values.data(), count, k, kScale,
+                                   kZeroPoint, classes, scores);
+
+  const int expected_k = std::min(std::max(k, 1), std::min(kMaxTopK, count));
+  TEST_ASSERT_EQUAL(expected_k, written);
+  const std::vector<int> order = stable_order(values);
+  for (int i = 0; i < written; ++i) {
+    TEST_ASSERT_EQUAL(order[i], classes[i]);
+    TEST_ASSERT_EQUAL_FLOAT((values[order[i]] - kZeroPoint) * kScale, scores[i]);
+  }
+  for (int i = written; i <= kMaxTopK; ++i) {
+    TEST_ASSERT_EQUAL(-7, classes[i]);
+  }
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Saídas de 1 a 1.000 classes com valores aleatórios e cheias de empates,
+// para todo k de 1 a kMaxTopK: as mesmas classes, na mesma ordem, que a
+// ordenação estável.
+void test_matches_stable_sort() {
+  const int kCounts[] = {1, 2, 3, 9, 10, 11, 43, 100, 1000};
+  const int kLevels[] = {256, 16, 2, 1};
+  for (int count : kCounts) {
+    for (int levels : kLevels) {
+      for (int trial = 0; trial < 20; ++trial) {
+        const std::vector<int8_t> values = random_values(count, levels);
+        for (int k = 1; k <= kMaxTopK; ++k) expect_top_k(values, k);
+      }
+    }
+  }
+  // Crescente e decrescente: o pior e o melhor caso da inserção.
+  std::vector<int8_t> ascending(256);
+  std::iota(ascending.begin(), ascending.end(), SCHAR_MIN);
+  expect_top_k(ascending, kMaxTopK);
+  std::vector<int8_t> descending(ascending.rbegin(), ascending.rend());
+  expect_top_k(descending, kMaxTopK);
+}
+
+// Empates resolvidos a favor do menor índice, inclusive quando o empate
+// está na fronteira do ranking.
+void test_ties_keep_lower_index() {
+  const std::vector<int8_t> values = {5, 9, 9, 3, 9, 5, 5, 9};
+  int classes[kMaxTopK];
+  float scores[kMaxTopK];
+  TEST_ASSERT_EQUAL(3, select_top_k(values.data(), 8, 3, kScale, kZeroPoint,
+                                    classes, scores));
+  const int expected[] = {1, 2, 4};
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected, classes, 3);
+  TEST_ASSERT_EQUAL(6, select_top_k(values.data(), 8, 6, kScale, kZeroPoint,
+                                    classes, scores));
+  const int expected_six[] = {1, 2, 4, 7, 0, 5};
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected_six, classes, 6);
+
+  const std::vector<int8_t> all_equal(10, SCHAR_MIN);
+  TEST_ASSERT_EQUAL(4, select_top_k(all_equal.data(), 10, 4, kScale,
+                                    kZeroPoint, classes, scores));
+  const int expected_first[] = {0, 1, 2, 3};
+  TEST_ASSERT_EQUAL_INT_ARRAY(expected_first, classes, 4);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, scores[0]);
+}
+
+// k == 1 dá a classe e a confiança do argmax antigo, inclusive com todas
+// as saídas em -128.
+void test_k1_matches_old_argmax() {
+  for (int trial = 0; trial < 2000; ++trial) {
+    const int count = 1 + static_cast<int>(rng() % 100);
+    const std::vector<int8_t> values =
+        random_values(count, trial % 3 == 0 ? 4 : 256);
+    int8_t max_score = 0;
+    const int best_index = old_argmax(values.data(), count, &max_score);
+    int top_class = -1;
+    float top_score = 0.0f;
+    TEST_ASSERT_EQUAL(1, select_top_k(values.data(), count, 1, kScale,
+                                      kZeroPoint, &top_class, &top_score));
+    TEST_ASSERT_EQUAL(best_index, top_class);
+    TEST_ASSERT_EQUAL_FLOAT((static_cast<float>(max_score) - kZeroPoint) * kScale,
+                            top_score);
+  }
+  const std::vector<int8_t> floor_values(10, SCHAR_MIN);
+  int8_t max_score = 0;
+  int top_class = -1;
+  float top_score = 1.0f;
+  select_top_k(floor_values.data(), 10, 1, kScale, kZeroPoint, &top_class, &top_score);
+  TEST_ASSERT_EQUAL(old_argmax(floor_values.data(), 10, &max_score), top_class);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, top_score);
+}
+
+// k maior que o número de classes devolve todas; k <= 0 vira 1 e k acima
+// de kMaxTopK vira kMaxTopK; sem classes não escreve nada.
+void test_k_limits() {
+  const std::vector<int8_t> three = {10, -20, 30};
+  for (int k : {3, 4, kMaxTopK, kMaxTopK + 5}) expect_top_k(three, k);
+  for (int k : {0, -1, INT_MIN}) expect_top_k(three, k);
+  const std::vector<int8_t> many = random_values(50, 256);
+  for (int k : {kMaxTopK + 1, 100, INT_MAX, 0, -5}) expect_top_k(many, k);
+
+  int classes[kMaxTopK] = {-7};
+  float scores[kMaxTopK] = {-7.0f};
+  TEST_ASSERT_EQUAL(0, select_top_k(three.data(), 0, 5, kScale, kZeroPoint,
+                                    classes, scores));
+  TEST_ASSERT_EQUAL(0, select_top_k(nullptr, 0, 1, kScale, kZeroPoint,
+                                    classes, scores));
+  TEST_ASSERT_EQUAL(-7, classes[0]);
+  TEST_ASSERT_EQUAL_FLOAT(-7.0f, scores[0]);
+}
+
+void test_benchmark_against_full_sort() {
+  int classes[kMaxTopK];
+  float scores[kMaxTopK];
+  volatile int sink = 0;
+  for (int count : {10, 1000}) {
+    const std::vector<int8_t> values = random_values(count, 256);
+    const int iterations = 2000000 / count;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+      sink = sink + select_top_k(values.data(), count, kMaxTopK, kScale,
+                                 kZeroPoint, classes, scores);
+    }
+    const double top_k_us = std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - start)
+                                .count() /
+                            iterations;
+
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+      sink = sink + stable_order(values)[0];
+    }
+    const double sort_us = std::chrono::duration<double, std::micro>(
+                               std::chrono::steady_clock::now() - start)
+                               .count() /
+                           iterations;
+
+    int8_t max_score = 0;
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+      sink = sink + old_argmax(values.data(), count, &max_score);
+    }
+    const double argmax_us = std::chrono::duration<double, std::micro>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             iterations;
+
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%d classes, k=%d: top_k %.3f us, ordenação %.3f us, argmax %.3f us",
+             count, kMaxTopK, top_k_us, sort_us, argmax_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_stable_sort);
+  RUN_TEST(test_ties_keep_lower_index);
+  RUN_TEST(test_k1_matches_old_argmax);
+  RUN_TEST(test_k_limits);
+  RUN_TEST(test_benchmark_against_full_sort);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
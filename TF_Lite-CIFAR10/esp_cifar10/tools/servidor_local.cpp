@@ -0,0 +1,395 @@
+// Substituto local do servidor HTTP das aplicações, para medir o ciclo de
+// conexão com o teste_carga.py sem a placa.
+//
+// Usa o mesmo HttpRequestParser, PixelArrayParser, InputQuantizer e
+// ResponseWriter de lib/classifier-server e repete o loop de src/main.cpp:
+// até kMaxConnections conexões atendidas sem bloquear, headers lidos byte a
+// byte até a linha em branco, o corpo consumido até o último byte por
+// body_remaining e a conexão mantida aberta só se o cliente pediu e o corpo
+// foi lido por inteiro. A inferência é trocada por uma espera fixa e a
+// resposta tem o formato de /predict. Com --legado o servidor faz o que as
+// aplicações faziam antes do keep-alive: "Connection: close", delay(100) e
+// fecha a conexão depois de cada requisição (rode o teste_carga.py com
+// --modes close nesse caso).
+//
+// Compilar e rodar, na pasta do projeto:
+//   g++ -std=gnu++17 -O2 -Ilib/classifier-server -o /tmp/servidor_local
+//       tools/servidor_local.cpp lib/classifier-server/{http_request_parser,
+//       pixel_array_parser,input_quantizer,response_writer}.cpp
+//   (numa linha só)
+//   /tmp/servidor_local --porta 18080 --inferencia_ms 38 &
+//   python3 src/teste_carga.py --host 127.0.0.1 --port 18080
+// O tamanho da imagem padrão é o do CIFAR-10 (3.072 bytes); use
+// --tamanho_imagem 784 no MNIST e 27648 na MobileNetV2.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "http_request_parser.h"
+#include "input_quantizer.h"
+#include "pixel_array_parser.h"
+#include "response_writer.h"
+
+namespace {
+
+const int kMaxConnections = 4;
+const int kMaxRawImages = 8;
+const unsigned long kKeepAliveTimeoutMs = 5000;
+const unsigned long kHeaderTimeoutMs = 10000;
+const unsigned long kBodyTimeoutMs = 5000;
+
+int image_size = 32 * 32 * 3;
+int inference_ms = 0;
+bool legacy = false;
+
+unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// O WiFiClient do arduino-esp32: available() e read() sobre o buffer de
+// recepção, sem bloquear.
+class Client {
+ public:
+  void attach(int fd) {
+    fd_ = fd;
+    pos_ = len_ = 0;
+    closed_ = false;
+  }
+  int available() {
+    if (pos_ == len_ && !closed_) {
+      const ssize_t n = recv(fd_, buffer_, sizeof(buffer_), MSG_DONTWAIT);
+      if (n > 0) {
+        pos_ = 0;
+        len_ = n;
+      } else if (n == 0) {
+        closed_ = true;
+      }
+    }
+    return len_ - pos_;
+  }
+  bool connected() { return available() > 0 || !closed_; }
+  int read() { return available() > 0 ? static_cast<uint8_t>(buffer_[pos_++]) : -1; }
+  int read(uint8_t* out, int size) {
+    const int n = std::min(size, available());
+    memcpy(out, buffer_ + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  void write(const char* data, size_t size) {
+    send(fd_, data, size, MSG_NOSIGNAL);
+  }
+  void stop() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+  }
+  int fd() const { return fd_; }
+
+ private:
+  int fd_ = -1;
+  char buffer_[1436];  // um segmento TCP, como o lwIP entrega
+  int pos_ = 0;
+  int len_ = 0;
+  bool closed_ = false;
+};
+
+enum ConnectionState { kReadHeaders, kReadBody, kDiscardBody };
+enum Route { kRoutePredict, kRoutePredictRaw, kRouteStatus, kRouteHelp };
+
+InputQuantizer input_quantizer;
+int8_t input[27648 * kMaxRawImages];
+char response_buffer[8192];
+ResponseWriter response_writer(response_buffer, sizeof(response_buffer));
+
+struct ClientConnection {
+  Client client;
+  bool active = false;
+  ConnectionState state = kReadHeaders;
+  Route route = kRouteHelp;
+  HttpRequestParser request;
+  PixelArrayParser pixels{input, 0, nullptr};
+  int body_remaining = 0;
+  int image_count = 0;
+  unsigned long last_activity = 0;
+  const char* error_message = "";
+};
+
+ClientConnection connections[kMaxConnections];
+
+void close_connection(ClientConnection& conn) {
+  conn.client.stop();
+  conn.active = false;
+}
+
+void send_response(ClientConnection& conn, int status, bool keep_alive) {
+  response_writer.finish(status, "application/json", keep_alive);
+  conn.client.write(response_writer.data(), response_writer.size());
+}
+
+// Responde à requisição atual, como finish_request() das aplicações.
+void finish_request(ClientConnection& conn) {
+  if (conn.route == kRoutePredict || conn.route == kRoutePredictRaw) {
+    if (conn.error_message[0] == '\0' && inference_ms > 0) {
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(inference_ms * conn.image_count));
+    }
+  }
+  response_writer.reset();
+  response_writer.begin_object();
+  response_writer.field_bool("success", conn.error_message[0] == '\0');
+  response_writer.field_int("predicted_class", 3);
+  response_writer.field_float("confidence", 0.8125f, 6);
+  response_writer.field_string("error_message", conn.error_message);
+  response_writer.end_object();
+
+  const bool keep_alive =
+      !legacy && conn.request.keep_alive() && conn.body_remaining == 0;
+  send_response(conn, 200, keep_alive);
+  if (legacy) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  if (keep_alive) {
+    conn.state = kReadHeaders;
+    conn.request.reset();
+    conn.last_activity = millis();
+  } else {
+    close_connection(conn);
+  }
+}
+
+void start_request(ClientConnection& conn) {
+  const HttpRequestParser& request = conn.request;
+  if (request.status() == HttpRequestParser::kError) {
+    response_writer.reset();
+    response_writer.begin_object();
+    response_writer.field_bool("success", false);
+    response_writer.field_string("error_message", request.error());
+    response_writer.end_object();
+    send_response(conn, request.error_status(), false);
+    close_connection(conn);
+    return;
+  }
+  if (request.expect_continue()) {
+    const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+    conn.client.write(kContinue, sizeof(kContinue) - 1);
+  }
+
+  conn.state = kDiscardBody;
+  conn.body_remaining = request.content_length();
+  conn.error_message = "";
+  conn.image_count = 1;
+  if (request.matches("POST", "/predict_raw")) {
+    conn.route = kRoutePredictRaw;
+    conn.image_count = conn.body_remaining / image_size;
+    if (conn.body_remaining <= 0 || conn.body_remaining % image_size != 0 ||
+        conn.image_count > kMaxRawImages) {
+      conn.error_message = "Corpo com tamanho inválido";
+    } else {
+      conn.state = kReadBody;
+    }
+  } else if (request.matches("POST", "/predict")) {
+    conn.route = kRoutePredict;
+    conn.pixels.reset(input, image_size, input_quantizer.table());
+    conn.state = kReadBody;
+  } else if (request.matches("GET", "/status")) {
+    conn.route = kRouteStatus;
+  } else {
+    conn.route = kRouteHelp;
+  }
+  conn.last_activity = millis();
+}
+
+bool read_headers(ClientConnection& conn) {
+  int available = conn.client.available();
+  if (available <= 0) {
+    const unsigned long idle = millis() - conn.last_activity;
+    if (idle >= (conn.request.started() ? kHeaderTimeoutMs
+                                        : kKeepAliveTimeoutMs)) {
+      close_connection(conn);
+      return true;
+    }
+    return false;
+  }
+  conn.last_activity = millis();
+  while (available-- > 0) {
+    if (conn.request.feed(static_cast<char>(conn.client.read())) !=
+        HttpRequestParser::kNeedMore) {
+      start_request(conn);
+      break;
+    }
+  }
+  return true;
+}
+
+// Bytes do corpo que já podem ser lidos; -1 se a conexão foi fechada por
+// timeout.
+int body_bytes_available(ClientConnection& conn) {
+  const int available = conn.client.available();
+  if (available > 0) {
+    conn.last_activity = millis();
+    return std::min(available, conn.body_remaining);
+  }
+  if (millis() - conn.last_activity >= kBodyTimeoutMs) {
+    conn.error_message = "Corpo incompleto";
+    finish_request(conn);
+    return -1;
+  }
+  return 0;
+}
+
+bool read_body(ClientConnection& conn) {
+  static uint8_t chunk[512];
+  if (conn.body_remaining > 0) {
+    int n = body_bytes_available(conn);
+    if (n <= 0) return n < 0;
+    n = conn.client.read(chunk, std::min(n, static_cast<int>(sizeof(chunk))));
+    const int offset = conn.route == kRoutePredictRaw
+                           ? conn.image_count * image_size - conn.body_remaining
+                           : 0;
+    conn.body_remaining -= n;
+    if (conn.route == kRoutePredict) {
+      conn.pixels.feed(reinterpret_cast<const char*>(chunk), n);
+      if (conn.body_remaining > 0 &&
+          conn.pixels.status() != PixelArrayParser::kError) {
+        return true;
+      }
+    } else {
+      input_quantizer.apply(chunk, input + offset, n);
+      if (conn.body_remaining > 0) return true;
+    }
+  }
+  if (conn.route == kRoutePredict &&
+      conn.pixels.finish() != PixelArrayParser::kDone) {
+    conn.error_message = conn.pixels.error();
+    conn.state = kDiscardBody;
+    return true;
+  }
+  finish_request(conn);
+  return true;
+}
+
+bool discard_body(ClientConnection& conn) {
+  if (conn.body_remaining > 0) {
+    uint8_t chunk[64];
+    int n = body_bytes_available(conn);
+    if (n <= 0) return n < 0;
+    n = conn.client.read(chunk, std::min(n, static_cast<int>(sizeof(chunk))));
+    conn.body_remaining -= n;
+    if (conn.body_remaining > 0) return true;
+  }
+  finish_request(conn);
+  return true;
+}
+
+bool service_connection(ClientConnection& conn) {
+  if (!conn.client.connected()) {
+    close_connection(conn);
+    return true;
+  }
+  switch (conn.state) {
+    case kReadHeaders: return read_headers(conn);
+    case kReadBody: return read_body(conn);
+    case kDiscardBody: return discard_body(conn);
+  }
+  return false;
+}
+
+void accept_clients(int server) {
+  for (;;) {
+    ClientConnection* conn = nullptr;
+    for (ClientConnection& candidate : connections) {
+      if (!candidate.active) {
+        conn = &candidate;
+        break;
+      }
+    }
+    if (conn == nullptr) {
+      for (ClientConnection& candidate : connections) {
+        if (candidate.state == kReadHeaders && !candidate.request.started()) {
+          conn = &candidate;
+          break;
+        }
+      }
+    }
+    if (conn == nullptr) return;
+    const int fd = accept4(server, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd < 0) return;
+    if (conn->active) close_connection(*conn);
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn->client.attach(fd);
+    conn->active = true;
+    conn->state = kReadHeaders;
+    conn->request.reset();
+    conn->last_activity = millis();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int port = 18080;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--legado") == 0) {
+      legacy = true;
+    } else if (strcmp(argv[i], "--porta") == 0 && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--inferencia_ms") == 0 && i + 1 < argc) {
+      inference_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--tamanho_imagem") == 0 && i + 1 < argc) {
+      image_size = std::min(atoi(argv[++i]), 27648);
+    } else {
+      fprintf(stderr,
+              "uso: %s [--porta N] [--inferencia_ms N] "
+              "[--tamanho_imagem N] [--legado]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  input_quantizer.build(InputQuantizer::kUnitRange, 1.0f / 255.0f, -128);
+
+  const int server = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  const int one = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+          0 ||
+      listen(server, 8) != 0) {
+    perror("bind");
+    return 1;
+  }
+  printf("Servidor local em 127.0.0.1:%d\n", port);
+  fflush(stdout);
+
+  for (;;) {
+    accept_clients(server);
+    bool progress = false;
+    for (ClientConnection& conn : connections) {
+      if (conn.active) progress |= service_connection(conn);
+    }
+    if (!progress) {
+      // O delay(1) do loop() das aplicações, acordando antes se chegar algo.
+      pollfd fds[kMaxConnections + 1];
+      int count = 0;
+      fds[count++] = {server, POLLIN, 0};
+      for (ClientConnection& conn : connections) {
+        if (conn.active) fds[count++] = {conn.client.fd(), POLLIN, 0};
+      }
+      poll(fds, count, 1);
+    }
+  }
+}
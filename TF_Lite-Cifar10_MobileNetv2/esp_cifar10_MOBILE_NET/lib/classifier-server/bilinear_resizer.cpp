@@ -0,0 +1,103 @@
+#include "bilinear_resizer.h"
+
+BilinearResizer::BilinearResizer()
+    : in_width_(0),
+      in_height_(0),
+      out_width_(0),
+      out_height_(0),
+      channels_(0) {
+  cached_row_[0] = -1;
+  cached_row_[1] = -1;
+}
+
+// A amostra da saída d fica em (2d + 1) * in / (2 * out) - 0.5 na origem;
+// em unidades de 1 / (2 * out) isso é (2d + 1) * in - out, então índice e
+// fração saem de uma divisão inteira, sem erro acumulado.
+void BilinearResizer::compute_taps(int in_size, int out_size, int stride,
+                                   Tap* taps) {
+  const int denominator = 2 * out_size;
+  for (int d = 0; d < out_size; ++d) {
+    const int numerator = (2 * d + 1) * in_size - out_size;
+    int first = 0;
+    int weight = 0;
+    if (numerator > 0) {
+      first = numerator / denominator;
+      weight = ((numerator % denominator) * 256 + out_size) / denominator;
+    }
+    const int second = first + 1 < in_size ? first + 1 : in_size - 1;
+    taps[d].first = static_cast<uint16_t>(first * stride);
+    taps[d].second = static_cast<uint16_t>(second * stride);
+    taps[d].weight = static_cast<uint16_t>(weight);
+  }
+}
+
+bool BilinearResizer::configure(int in_width, int in_height, int out_width,
+                                int out_height, int channels) {
+  if (in_width < 1 || in_width > kMaxDimension || in_height < 1 ||
+      in_height > kMaxDimension || out_width < 1 ||
+      out_width > kMaxDimension || out_height < 1 ||
+      out_height > kMaxDimension || channels < 1 || channels > kMaxChannels) {
+    in_width_ = in_height_ = 0;
+    return false;
+  }
+  in_width_ = in_width;
+  in_height_ = in_height;
+  out_width_ = out_width;
+  out_height_ = out_height;
+  channels_ = channels;
+  compute_taps(in_width, out_width, channels, columns_);
+  compute_taps(in_height, out_height, 1, rows_);
+  return true;
+}
+
+void BilinearResizer::interpolate_row(const uint8_t* input, int row,
+                                      uint16_t* cache) const {
+  const uint8_t* line = input + row * in_width_ * channels_;
+  for (int x = 0; x < out_width_; ++x) {
+    const Tap& tap = columns_[x];
+    const uint8_t* a = line + tap.first;
+    const uint8_t* b = line + tap.second;
+    const unsigned weight = tap.weight;
+    const unsigned keep = 256 - weight;
+    for (int c = 0; c < channels_; ++c) {
+      *cache++ = static_cast<uint16_t>(a[c] * keep + b[c] * weight);
+    }
+  }
+}
+
+void BilinearResizer::resize(const uint8_t* input, int8_t* output,
+                             const int8_t* quant_table) {
+  if (in_width_ == 0) return;
+  // As linhas de origem só avançam, então cada uma é interpolada uma vez;
+  // ao carregar uma nova, sai a mais antiga que não estiver em uso.
+  cached_row_[0] = -1;
+  cached_row_[1] = -1;
+  const int row_values = out_width_ * channels_;
+  for (int y = 0; y < out_height_; ++y) {
+    const Tap& tap = rows_[y];
+    int top = cached_row_[0] == tap.first ? 0 : (cached_row_[1] == tap.first ? 1 : -1);
+    if (top < 0) {
+      top = cached_row_[0] < cached_row_[1] ? 0 : 1;
+      interpolate_row(input, tap.first, cache_[top]);
+      cached_row_[top] = tap.first;
+    }
+    int bottom = top;
+    if (tap.second != tap.first) {
+      bottom = 1 - top;
+      if (cached_row_[bottom] != tap.second) {
+        interpolate_row(input, tap.second, cache_[bottom]);
+        cached_row_[bottom] = tap.second;
+      }
+    }
+
+    const uint16_t* a = cache_[top];
+    const uint16_t* b = cache_[bottom];
+    const uint32_t weight = tap.weight;
+    const uint32_t keep = 256 - weight;
+    for (int i = 0; i < row_values; ++i) {
+      // a e b estão em 1/256; a soma, em 1/65536, volta a 0..255 arredondada.
+      const uint32_t value = a[i] * keep + b[i] * weight;
+      *output++ = quant_table[(value + 32768) >> 16];
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef BILINEAR_RESIZER_H_
+#define BILINEAR_RESIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Redimensiona uma imagem uint8 HWC por interpolação bilinear e grava o
+// resultado já quantizado na entrada do modelo, numa passada só.
+//
+// As coordenadas seguem o tf.image.resize do treino (bilinear com
+// half_pixel_centers): o pixel de saída d amostra a origem em
+// (d + 0.5) * in / out - 0.5, limitado à borda. Índices e pesos (em 1/256)
+// de cada linha e coluna são calculados com inteiros no configure(); no
+// resize() cada linha de origem é interpolada na horizontal uma vez só e
+// guardada, e cada pixel de saída custa a mistura vertical de duas linhas,
+// o arredondamento para 0..255 e uma leitura da tabela de quantização
+// (InputQuantizer::table()), sem float.
+class BilinearResizer {
+ public:
+  static constexpr int kMaxDimension = 128;
+  static constexpr int kMaxChannels = 3;
+
+  BilinearResizer();
+
+  // Prepara a conversão de in_width x in_height para out_width x
+  // out_height, com `channels` canais. Falso se alguma dimensão estiver fora
+  // de 1..kMaxDimension (ou 1..kMaxChannels).
+  bool configure(int in_width, int in_height, int out_width, int out_height,
+                 int channels);
+  bool configured_for(int in_width, int in_height) const {
+    return in_width == in_width_ && in_height == in_height_;
+  }
+
+  // `input` tem in_width * in_height * channels bytes; `output`,
+  // out_width * out_height * channels. Não podem ser o mesmo buffer.
+  void resize(const uint8_t* input, int8_t* output,
+              const int8_t* quant_table);
+
+ private:
+  struct Tap {
+    uint16_t first;   // índice de origem (já multiplicado pelos canais nas colunas)
+    uint16_t second;  // vizinho seguinte, ou o mesmo na borda
+    uint16_t weight;  // peso do vizinho seguinte, em 1/256
+  };
+
+  static void compute_taps(int in_size, int out_size, int stride, Tap* taps);
+  // Interpola na horizontal a linha de origem `row` para `cache`, em 1/256.
+  void interpolate_row(const uint8_t* input, int row, uint16_t* cache) const;
+
+  int in_width_;
+  int in_height_;
+  int out_width_;
+  int out_height_;
+  int channels_;
+  Tap columns_[kMaxDimension];
+  Tap rows_[kMaxDimension];
+
+  // As duas linhas de origem interpoladas usadas pela linha de saída atual.
+  uint16_t cache_[2][kMaxDimension * kMaxChannels];
+  int cached_row_[2];
+};
+
+#endif  // BILINEAR_RESIZER_H_
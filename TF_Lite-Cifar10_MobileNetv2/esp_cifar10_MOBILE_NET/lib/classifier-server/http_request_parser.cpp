@@ -0,0 +1,277 @@
+#include "http_request_parser.h"
+
+#include <string.h>
+
+namespace {
+
+inline char to_lower(char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; }
+
+inline bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+// Limite dos valores de query_int(), para não estourar o long.
+const long kMaxQueryValue = 1000000;
+
+// Compara `length` caracteres de `text` com `lower`, que já está em
+// minúsculas.
+bool equals_ignore_case(const char* text, int length, const char* lower) {
+  int i = 0;
+  for (; i < length && lower[i] != '\0'; ++i) {
+    if (to_lower(text[i]) != lower[i]) return false;
+  }
+  return i == length && lower[i] == '\0';
+}
+
+// Procura o token `lower` numa lista separada por vírgulas, como em
+// "Connection: keep-alive, Upgrade".
+bool has_token(const char* value, int length, const char* lower) {
+  int start = 0;
+  while (start < length) {
+    while (start < length && (is_space(value[start]) || value[start] == ',')) ++start;
+    int end = start;
+    while (end < length && value[end] != ',') ++end;
+    int token_end = end;
+    while (token_end > start && is_space(value[token_end - 1])) --token_end;
+    if (token_end > start &&
+        equals_ignore_case(value + start, token_end - start, lower)) {
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
+}
+
+}  // namespace
+
+HttpRequestParser::HttpRequestParser() { reset(); }
+
+void HttpRequestParser::reset() {
+  status_ = kNeedMore;
+  started_ = false;
+  request_line_done_ = false;
+  line_overflow_ = false;
+  line_length_ = 0;
+  header_bytes_ = 0;
+  content_length_ = 0;
+  has_content_length_ = false;
+  keep_alive_ = true;
+  expect_continue_ = false;
+  error_status_ = 0;
+  error_ = "";
+  method_[0] = '\0';
+  path_[0] = '\0';
+  query_[0] = '\0';
+}
+
+HttpRequestParser::Status HttpRequestParser::fail(int http_status,
+                                                  const char* message) {
+  error_status_ = http_status;
+  error_ = message;
+  status_ = kError;
+  return status_;
+}
+
+HttpRequestParser::Status HttpRequestParser::feed(char c) {
+  if (status_ != kNeedMore) return status_;
+
+  if (!started_) {
+    // Linhas em branco antes da linha de requisição são ignoradas.
+    if (c == '\r' || c == '\n') return status_;
+    started_ = true;
+  }
+
+  if (++header_bytes_ > kMaxHeaderBytes) {
+    return fail(431, "Headers muito grandes");
+  }
+
+  if (c == '\n') {
+    if (line_length_ > 0 && line_[line_length_ - 1] == '\r') --line_length_;
+    Status status = process_line();
+    line_length_ = 0;
+    line_overflow_ = false;
+    return status;
+  }
+
+  if (line_length_ < kMaxLineLength) {
+    line_[line_length_++] = c;
+  } else {
+    line_overflow_ = true;
+  }
+  return status_;
+}
+
+HttpRequestParser::Status HttpRequestParser::feed(const char* data,
+                                                  size_t size,
+                                                  size_t* consumed) {
+  size_t i = 0;
+  while (i < size && status_ == kNeedMore) {
+    feed(data[i++]);
+  }
+  if (consumed != nullptr) *consumed = i;
+  return status_;
+}
+
+HttpRequestParser::Status HttpRequestParser::process_line() {
+  if (!request_line_done_) {
+    request_line_done_ = true;
+    return parse_request_line();
+  }
+  if (line_length_ == 0 && !line_overflow_) {
+    status_ = kDone;
+    return status_;
+  }
+  return parse_header_line();
+}
+
+HttpRequestParser::Status HttpRequestParser::parse_request_line() {
+  if (line_overflow_) return fail(414, "URI muito longa");
+
+  const char* line = line_;
+  const int length = line_length_;
+
+  int method_end = 0;
+  while (method_end < length && line[method_end] != ' ') ++method_end;
+  if (method_end == 0 || method_end >= kMaxMethodLength || method_end == length) {
+    return fail(400, "Linha de requisição inválida");
+  }
+  for (int i = 0; i < method_end; ++i) {
+    if (line[i] < 'A' || line[i] > 'Z') {
+      return fail(400, "Linha de requisição inválida");
+    }
+  }
+  memcpy(method_, line, method_end);
+  method_[method_end] = '\0';
+
+  const int target_start = method_end + 1;
+  int target_end = target_start;
+  while (target_end < length && line[target_end] != ' ') ++target_end;
+  if (target_end == target_start || target_end == length) {
+    return fail(400, "Linha de requisição inválida");
+  }
+  int path_end = target_start;
+  while (path_end < target_end && line[path_end] != '?') ++path_end;
+  const int path_length = path_end - target_start;
+  if (path_length >= kMaxPathLength) return fail(414, "URI muito longa");
+  memcpy(path_, line + target_start, path_length);
+  path_[path_length] = '\0';
+  const int query_start = path_end < target_end ? path_end + 1 : target_end;
+  const int query_length = target_end - query_start;
+  if (query_length >= kMaxQueryLength) return fail(414, "URI muito longa");
+  memcpy(query_, line + query_start, query_length);
+  query_[query_length] = '\0';
+
+  const char* version = line + target_end + 1;
+  const int version_length = length - target_end - 1;
+  if (version_length == 8 && memcmp(version, "HTTP/1.1", 8) == 0) {
+    keep_alive_ = true;
+  } else if (version_length == 8 && memcmp(version, "HTTP/1.0", 8) == 0) {
+    keep_alive_ = false;
+  } else {
+    return fail(505, "Versão HTTP não suportada");
+  }
+  return status_;
+}
+
+HttpRequestParser::Status HttpRequestParser::parse_header_line() {
+  const char* line = line_;
+  const int length = line_length_;
+
+  int name_end = 0;
+  while (name_end < length && line[name_end] != ':') ++name_end;
+  if (name_end == length) {
+    // Linha truncada pelo limite: o nome pode ter ficado de fora, mas só
+    // importa se for um dos headers abaixo, que são curtos.
+    if (line_overflow_) return status_;
+    return fail(400, "Header inválido");
+  }
+  if (name_end == 0 || is_space(line[name_end - 1])) {
+    return fail(400, "Header inválido");
+  }
+
+  int value_start = name_end + 1;
+  while (value_start < length && is_space(line[value_start])) ++value_start;
+  int value_end = length;
+  while (value_end > value_start && is_space(line[value_end - 1])) --value_end;
+  const char* value = line + value_start;
+  const int value_length = value_end - value_start;
+
+  if (equals_ignore_case(line, name_end, "content-length")) {
+    if (line_overflow_ || value_length == 0) {
+      return fail(400, "Content-Length inválido");
+    }
+    long content_length = 0;
+    for (int i = 0; i < value_length; ++i) {
+      if (value[i] < '0' || value[i] > '9') {
+        return fail(400, "Content-Length inválido");
+      }
+      content_length = content_length * 10 + (value[i] - '0');
+      if (content_length > kMaxContentLength) {
+        return fail(413, "Corpo muito grande");
+      }
+    }
+    if (has_content_length_ && content_length != content_length_) {
+      return fail(400, "Content-Length duplicado");
+    }
+    content_length_ = content_length;
+    has_content_length_ = true;
+  } else if (equals_ignore_case(line, name_end, "connection")) {
+    if (has_token(value, value_length, "close")) {
+      keep_alive_ = false;
+    } else if (has_token(value, value_length, "keep-alive")) {
+      keep_alive_ = true;
+    }
+  } else if (equals_ignore_case(line, name_end, "transfer-encoding")) {
+    // Sem Content-Length não dá para saber onde o corpo termina.
+    return fail(501, "Transfer-Encoding não suportado");
+  } else if (equals_ignore_case(line, name_end, "expect")) {
+    expect_continue_ = equals_ignore_case(value, value_length, "100-continue");
+  }
+  return status_;
+}
+
+bool HttpRequestParser::matches(const char* method, const char* path) const {
+  return status_ == kDone && strcmp(method_, method) == 0 &&
+         strcmp(path_, path) == 0;
+}
+
+long HttpRequestParser::query_int(const char* name, long fallback) const {
+  const size_t name_length = strlen(name);
+  const char* param = query_;
+  while (*param != '\0') {
+    const char* end = strchr(param, '&');
+    if (end == nullptr) end = param + strlen(param);
+    if (static_cast<size_t>(end - param) > name_length &&
+        memcmp(param, name, name_length) == 0 && param[name_length] == '=') {
+      const char* digits = param + name_length + 1;
+      if (digits == end) return -1;
+      long value = 0;
+      for (const char* p = digits; p < end; ++p) {
+        if (*p < '0' || *p > '9') return -1;
+        value = value * 10 + (*p - '0');
+        if (value > kMaxQueryValue) return -1;
+      }
+      return value;
+    }
+    param = *end == '&' ? end + 1 : end;
+  }
+  return fallback;
+}
+
+const char* http_status_text(int http_status) {
+  switch (http_status) {
+    case 100: return "Continue";
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    case 505: return "HTTP Version Not Supported";
+    default: return "";
+  }
+}
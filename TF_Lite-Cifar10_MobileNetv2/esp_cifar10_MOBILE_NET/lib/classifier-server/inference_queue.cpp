@@ -0,0 +1,98 @@
+#include "inference_queue.h"
+
+#include <chrono>
+
+InferenceQueue::InferenceQueue(int slots)
+    : slots_(slots < 1 ? 1 : (slots > kMaxSlots ? kMaxSlots : slots)),
+      fifo_head_(0),
+      fifo_count_(0),
+      stats_() {
+  for (int i = 0; i < kMaxSlots; ++i) {
+    state_[i] = kFree;
+    orphaned_[i] = false;
+    submit_us_[i] = 0;
+    start_us_[i] = 0;
+  }
+  stats_.slots = slots_;
+}
+
+uint32_t InferenceQueue::now_us() {
+  return static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+int InferenceQueue::acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < slots_; ++i) {
+    if (state_[i] == kFree) {
+      state_[i] = kFilling;
+      orphaned_[i] = false;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void InferenceQueue::reject() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.rejected++;
+}
+
+void InferenceQueue::submit(int slot) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state_[slot] = kQueued;
+    submit_us_[slot] = now_us();
+    fifo_[(fifo_head_ + fifo_count_) % slots_] = slot;
+    fifo_count_++;
+    stats_.submitted++;
+    stats_.depth++;
+    if (stats_.depth > stats_.max_depth) stats_.max_depth = stats_.depth;
+  }
+  queued_.notify_one();
+}
+
+bool InferenceQueue::done(int slot) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return state_[slot] == kDone;
+}
+
+void InferenceQueue::release(int slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_[slot] == kQueued || state_[slot] == kRunning) {
+    orphaned_[slot] = true;
+  } else {
+    state_[slot] = kFree;
+  }
+}
+
+int InferenceQueue::take() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  queued_.wait(lock, [this] { return fifo_count_ > 0; });
+  const int slot = fifo_[fifo_head_];
+  fifo_head_ = (fifo_head_ + 1) % slots_;
+  fifo_count_--;
+  state_[slot] = kRunning;
+  start_us_[slot] = now_us();
+  const uint32_t wait_us = start_us_[slot] - submit_us_[slot];
+  stats_.total_wait_us += wait_us;
+  if (wait_us > stats_.max_wait_us) stats_.max_wait_us = wait_us;
+  return slot;
+}
+
+void InferenceQueue::complete(int slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint32_t run_us = now_us() - start_us_[slot];
+  stats_.total_run_us += run_us;
+  if (run_us > stats_.max_run_us) stats_.max_run_us = run_us;
+  stats_.completed++;
+  stats_.depth--;
+  state_[slot] = orphaned_[slot] ? kFree : kDone;
+}
+
+InferenceQueue::Stats InferenceQueue::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
@@ -0,0 +1,88 @@
+#ifndef RESPONSE_WRITER_H_
+#define RESPONSE_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Monta uma resposta HTTP inteira (status, headers e corpo) num buffer fixo,
+// para ser enviada com um único client.write().
+//
+// O corpo é escrito a partir de kHeaderSpace bytes do início do buffer; no
+// finish() os headers, que dependem do tamanho do corpo, são formatados e
+// copiados logo antes dele, então nada é movido nem alocado. O JSON sai no
+// mesmo formato das respostas antigas: um membro por linha no nível de cima
+// e objetos "inline" ({"a": 1, "b": 2}) numa linha só, como os itens de um
+// lote.
+//
+// Se o corpo não couber, as escritas seguintes são ignoradas e o finish()
+// troca a resposta por um 500 curto.
+class ResponseWriter {
+ public:
+  static constexpr size_t kHeaderSpace = 256;
+  static constexpr int kMaxDepth = 8;
+
+  // `extra_headers` são linhas prontas ("Nome: valor\r\n...") acrescentadas
+  // a toda resposta, como os headers de CORS.
+  ResponseWriter(char* buffer, size_t capacity, const char* extra_headers = "");
+
+  // Começa uma nova resposta, descartando a anterior.
+  void reset();
+
+  // Texto cru no corpo, por exemplo HTML ou o formato do Prometheus.
+  void append(const char* text);
+  void append(const char* text, size_t length);
+  void append_uint(unsigned long value);
+
+  // JSON. `key` é nullptr para valores dentro de arrays.
+  void begin_object(const char* key = nullptr, bool inline_members = false);
+  void end_object();
+  void begin_array(const char* key, bool inline_members = false);
+  void end_array();
+  void field_string(const char* key, const char* value);
+  void field_bool(const char* key, bool value);
+  void field_int(const char* key, long value);
+  void field_uint(const char* key, unsigned long value);
+  // Número com `decimals` casas fixas, como String(value, decimals). NaN e
+  // infinito viram null.
+  void field_float(const char* key, float value, int decimals);
+
+  // Array de objetos {"<class_key>": classes[i], "score": scores[i]}, um por
+  // linha (ou todos numa linha dentro de um objeto inline), com as `count`
+  // primeiras classes.
+  void field_top_k(const char* key, const char* class_key, const int* classes,
+                   const float* scores, int count, int decimals);
+
+  bool overflow() const { return overflow_; }
+  size_t body_size() const { return body_end_ - kHeaderSpace; }
+
+  // Escreve os headers na frente do corpo. Depois disso data()/size() são a
+  // resposta completa.
+  void finish(int status, const char* content_type, bool keep_alive);
+
+  const char* data() const { return buffer_ + start_; }
+  size_t size() const { return body_end_ - start_; }
+
+ private:
+  void put(char c);
+  void put(const char* text, size_t length);
+  void put_string(const char* text);
+  void put_uint(unsigned long value);
+  void put_fixed(float value, int decimals);
+  void indent(int depth);
+  // Vírgula, quebra de linha e chave antes de um membro.
+  void member(const char* key);
+  void close(char bracket);
+
+  char* buffer_;
+  size_t capacity_;
+  const char* extra_headers_;
+  size_t start_;
+  size_t body_end_;
+  bool overflow_;
+
+  int depth_;
+  int members_[kMaxDepth];
+  bool inline_[kMaxDepth];
+};
+
+#endif  // RESPONSE_WRITER_H_
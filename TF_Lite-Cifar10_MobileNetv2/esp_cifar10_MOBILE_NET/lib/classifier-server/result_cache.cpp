@@ -0,0 +1,137 @@
+#include "result_cache.h"
+
+#include <string.h>
+
+#include <chrono>
+
+ResultCache::ResultCache(int capacity)
+    : capacity_(capacity < 0 ? 0
+                              : (capacity > kMaxEntries ? kMaxEntries : capacity)),
+      clock_(0),
+      stats_() {
+  for (int i = 0; i < kMaxEntries; ++i) entries_[i].last_used = 0;
+  stats_.capacity = capacity_;
+}
+
+uint32_t ResultCache::now_us() {
+  return static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+uint64_t ResultCache::hash(const void* data, size_t size) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t h = 0x5f3759df9e3779b9ULL ^ (size * m);
+
+  const size_t words = size / 8;
+  for (size_t i = 0; i < words; ++i) {
+    uint64_t k;
+    memcpy(&k, bytes + i * 8, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  const uint8_t* tail = bytes + words * 8;
+  const size_t rest = size & 7;
+  if (rest != 0) {
+    for (size_t i = 0; i < rest; ++i) {
+      h ^= static_cast<uint64_t>(tail[i]) << (8 * i);
+    }
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+uint64_t ResultCache::check(const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+bool ResultCache::lookup(const void* input, size_t size, Key* key,
+                         CachedPrediction* prediction) {
+  if (capacity_ == 0) return false;
+  const uint32_t start_us = now_us();
+  key->hash = hash(input, size);
+  key->check = check(input, size);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  bool hit = false;
+  bool collision = false;
+  for (int i = 0; i < capacity_; ++i) {
+    Entry& entry = entries_[i];
+    if (entry.last_used == 0 || entry.key.hash != key->hash) continue;
+    if (entry.key.check != key->check) {
+      collision = true;
+      continue;
+    }
+    entry.last_used = ++clock_;
+    *prediction = entry.prediction;
+    hit = true;
+    break;
+  }
+  if (hit) {
+    stats_.hits++;
+  } else {
+    stats_.misses++;
+    if (collision) stats_.collisions++;
+  }
+  const uint32_t lookup_us = now_us() - start_us;
+  stats_.total_lookup_us += lookup_us;
+  if (lookup_us > stats_.max_lookup_us) stats_.max_lookup_us = lookup_us;
+  return hit;
+}
+
+void ResultCache::insert(const Key& key, const CachedPrediction& prediction,
+                         uint32_t invoke_us) {
+  if (capacity_ == 0) return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.total_invoke_us += invoke_us;
+
+  // Vazia ou, sem nenhuma, a menos usada recentemente. Com o cache cheio o
+  // clock nunca chega a dar a volta na prática (2^32 acessos).
+  int victim = 0;
+  for (int i = 0; i < capacity_; ++i) {
+    if (entries_[i].last_used == 0) {
+      victim = i;
+      break;
+    }
+    if (entries_[i].last_used < entries_[victim].last_used) victim = i;
+  }
+  Entry& entry = entries_[victim];
+  if (entry.last_used != 0) {
+    stats_.evictions++;
+  } else {
+    stats_.entries++;
+  }
+  entry.key = key;
+  entry.last_used = ++clock_;
+  entry.prediction = prediction;
+}
+
+void ResultCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < kMaxEntries; ++i) entries_[i].last_used = 0;
+  clock_ = 0;
+  if (stats_.entries > 0) stats_.invalidations++;
+  stats_.entries = 0;
+}
+
+ResultCache::Stats ResultCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
@@ -0,0 +1,69 @@
+#ifndef SERVER_METRICS_H_
+#define SERVER_METRICS_H_
+
+#include <stdint.h>
+
+#include <mutex>
+
+#include "response_writer.h"
+
+// Métricas do servidor no formato de texto do Prometheus (GET /metrics):
+// um histograma de latência por etapa do pipeline e a contagem de
+// requisições por resultado.
+//
+// Os baldes são fixos (kBucketBoundsUs, de 100 µs a 5 s), então record() é
+// uma busca em kBuckets limites e três somas, sem alocação, e o texto é
+// gerado direto num ResponseWriter. record() é chamado pelas duas tarefas
+// (rede e inferência) e write() pela de rede, então tudo passa por um
+// std::mutex; write() copia os contadores e formata fora dele.
+class ServerMetrics {
+ public:
+  enum Stage {
+    kReceive,      // headers lidos -> corpo completo
+    kParse,        // decodificação do corpo (JSON ou bytes) para int8
+    kQueue,        // imagem submetida -> início da inferência
+    kPreprocess,   // slot -> tensor de entrada (cópia ou redimensionamento)
+    kInvoke,       // Invoke(), só nas falhas do cache
+    kPostprocess,  // top-k e cache
+    kSend,         // montagem e envio da resposta
+    kStageCount,
+  };
+
+  enum Outcome {
+    kOk,
+    kError,     // respondida com error_message (corpo, top_k, modelo...)
+    kRejected,  // 503, fila cheia
+    kFailed,    // alguma inferência do lote falhou
+    kOutcomeCount,
+  };
+
+  static constexpr int kBuckets = 12;
+  static const uint32_t kBucketBoundsUs[kBuckets];
+
+  ServerMetrics();
+
+  void record(Stage stage, uint32_t duration_us);
+  void count_request(Outcome outcome);
+
+  // Histogramas e contadores de requisição, com # HELP e # TYPE.
+  void write(ResponseWriter& out) const;
+
+  // Uma métrica avulsa (gauge ou counter) sem labels, para o que a
+  // aplicação lê na hora: arena, heap, fila, cache.
+  static void write_metric(ResponseWriter& out, const char* name,
+                           const char* type, const char* help,
+                           unsigned long value);
+
+ private:
+  struct Histogram {
+    uint32_t buckets[kBuckets + 1];  // não cumulativos; o último é o +Inf
+    uint32_t count;
+    uint64_t sum_us;
+  };
+
+  mutable std::mutex mutex_;
+  Histogram stages_[kStageCount];
+  uint32_t requests_[kOutcomeCount];
+};
+
+#endif  // SERVER_METRICS_H_
@@ -28,7 +28,7 @@ limitations under the License.
 
 static uint32_t Log2FractionPart(const uint32_t x, const uint32_t log2x) {
   // Part 1
-  int32_t frac = x - (1LL << log2x);
+  int32_t frac = x - (((uint32_t)1) << log2x);
   if (log2x < kLogScaleLog2) {
     frac <<= kLogScaleLog2 - log2x;
   } else {
@@ -49,35 +49,47 @@ static uint32_t Log2FractionPart(const uint32_t x, const uint32_t log2x) {
 static uint32_t Log(const uint32_t x, const uint32_t scale_shift) {
   const uint32_t integer = MostSignificantBit32(x) - 1;
   const uint32_t fraction = Log2FractionPart(x, integer);
-  const uint32_t log2 = (integer << kLogScaleLog2) + fraction;
   const uint32_t round = kLogScale / 2;
-  const uint32_t loge = (((uint64_t)kLogCoeff) * log2 + round) >> kLogScaleLog2;
+  // Same as (kLogCoeff * ((integer << kLogScaleLog2) + fraction) + round) >>
+  // kLogScaleLog2 without the 64 bit product: the integer part is a multiple
+  // of kLogScale and fraction is at most 65675, so kLogCoeff * fraction fits
+  // in 32 bits.
+  const uint32_t loge =
+      kLogCoeff * integer + ((kLogCoeff * fraction + round) >> kLogScaleLog2);
   // Finally scale to our output scale
   const uint32_t loge_scaled = ((loge << scale_shift) + round) >> kLogScaleLog2;
   return loge_scaled;
 }
 
+static uint16_t Saturate16(const uint32_t value) {
+  return (value < kuint16max) ? value : kuint16max;
+}
+
+static uint16_t LogOrZero(const uint32_t value, const uint32_t scale_shift) {
+  return (value > 1) ? Saturate16(Log(value, scale_shift)) : 0;
+}
+
 uint16_t* LogScaleApply(struct LogScaleState* state, uint32_t* signal,
                         int signal_size, int correction_bits) {
   const int scale_shift = state->scale_shift;
   uint16_t* output = (uint16_t*)signal;
   uint16_t* ret = output;
   int i;
-  for (i = 0; i < signal_size; ++i) {
-    uint32_t value = *signal++;
-    if (state->enable_log) {
-      if (correction_bits < 0) {
-        value >>= -correction_bits;
-      } else {
-        value <<= correction_bits;
-      }
-      if (value > 1) {
-        value = Log(value, scale_shift);
-      } else {
-        value = 0;
-      }
+  // Each output overwrites the low half of an input already read, so the
+  // loops run in place front to back.
+  if (!state->enable_log) {
+    for (i = 0; i < signal_size; ++i) {
+      output[i] = Saturate16(signal[i]);
+    }
+  } else if (correction_bits < 0) {
+    const int shift = -correction_bits;
+    for (i = 0; i < signal_size; ++i) {
+      output[i] = LogOrZero(signal[i] >> shift, scale_shift);
+    }
+  } else {
+    for (i = 0; i < signal_size; ++i) {
+      output[i] = LogOrZero(signal[i] << correction_bits, scale_shift);
     }
-    *output++ = (value < kuint16max) ? value : kuint16max;
   }
   return ret;
 }
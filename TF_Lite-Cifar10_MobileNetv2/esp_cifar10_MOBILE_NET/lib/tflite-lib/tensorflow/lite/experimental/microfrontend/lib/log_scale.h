@@ -29,6 +29,11 @@ struct LogScaleState {
 
 // Applies a fixed point logarithm to the signal and converts it to 16 bit. Note
 // that the signal array will be modified.
+//
+// Gives the same output as the former 64-bit version for every uint32_t
+// input, 2^31 and above included. With correction_bits > 0 the shifted value
+// still wraps modulo 2^32 before the logarithm, and results over 0xFFFF
+// saturate there, as before.
 uint16_t* LogScaleApply(struct LogScaleState* state, uint32_t* signal,
                         int signal_size, int correction_bits);
 
@@ -0,0 +1,105 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_REQUANTIZE_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_REQUANTIZE_H_
+
+#include <algorithm>
+#include <cstdint>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Kernels without a scratch buffer for their int32 accumulators collect up
+// to this many on the stack and requantize them as one row.
+constexpr int kRequantizeBlockSize = 32;
+
+// MultiplyByQuantizedMultiplier(int32_t, multiplier, shift) with the shift
+// split into left_shift = max(shift, 0) and right_shift = max(-shift, 0).
+// Unlike the out-of-line version it is inlined and branch-free, so a loop
+// over a row keeps everything in registers. Bit-exact for the non-negative
+// multipliers QuantizeMultiplier produces.
+inline int32_t MultiplyByQuantizedMultiplierSplit(int32_t x,
+                                                  int32_t quantized_multiplier,
+                                                  int left_shift,
+                                                  int right_shift) {
+  TFLITE_DCHECK_GE(quantized_multiplier, 0);
+#if TFLITE_SINGLE_ROUNDING
+  return MultiplyByQuantizedMultiplier(x, quantized_multiplier,
+                                       left_shift - right_shift);
+#else
+  // SaturatingRoundingDoublingHighMul. Its only saturating case needs a
+  // negative multiplier, and its nudged division by 2^31, truncating toward
+  // zero, is the same as adding 2^30 and shifting right.
+  const int64_t product =
+      static_cast<int64_t>(x * (1 << left_shift)) * quantized_multiplier;
+  const int32_t high =
+      static_cast<int32_t>((product + (int64_t{1} << 30)) >> 31);
+  // RoundingDivideByPOT: round to nearest, ties away from zero.
+  const int32_t mask =
+      static_cast<int32_t>((int64_t{1} << right_shift) - 1);
+  const int32_t threshold = (mask >> 1) + (high < 0 ? 1 : 0);
+  return (high >> right_shift) + ((high & mask) > threshold ? 1 : 0);
+#endif
+}
+
+// output[i] = clamp(MultiplyByQuantizedMultiplier(acc[i] + bias[i],
+// multiplier, shift) + output_offset) for i < size, with one multiplier and
+// shift for the whole row. `bias` may be null.
+template <typename T>
+inline void RequantizeRow(const int32_t* acc, const int32_t* bias,
+                          int32_t multiplier, int shift, int32_t output_offset,
+                          int32_t activation_min, int32_t activation_max,
+                          int size, T* output) {
+  const int left_shift = std::max(shift, 0);
+  const int right_shift = std::max(-shift, 0);
+  for (int i = 0; i < size; ++i) {
+    const int32_t x = bias != nullptr ? acc[i] + bias[i] : acc[i];
+    int32_t value = MultiplyByQuantizedMultiplierSplit(x, multiplier,
+                                                       left_shift, right_shift);
+    value += output_offset;
+    value = std::max(value, activation_min);
+    value = std::min(value, activation_max);
+    output[i] = static_cast<T>(value);
+  }
+}
+
+// RequantizeRow with per-channel multipliers and shifts, element i using
+// multiplier[i] and shift[i].
+template <typename T>
+inline void RequantizeRowPerChannel(const int32_t* acc, const int32_t* bias,
+                                    const int32_t* multiplier,
+                                    const int32_t* shift,
+                                    int32_t output_offset,
+                                    int32_t activation_min,
+                                    int32_t activation_max, int size,
+                                    T* output) {
+  for (int i = 0; i < size; ++i) {
+    const int32_t x = bias != nullptr ? acc[i] + bias[i] : acc[i];
+    int32_t value = MultiplyByQuantizedMultiplierSplit(
+        x, multiplier[i], std::max<int>(shift[i], 0),
+        std::max<int>(-shift[i], 0));
+    value += output_offset;
+    value = std::max(value, activation_min);
+    value = std::min(value, activation_max);
+    output[i] = static_cast<T>(value);
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_REQUANTIZE_H_
@@ -227,33 +227,45 @@ void PortableSparseMatrixBatchVectorMultiplyAccumulate1x4(
   }
 }
 
-void PortableSparseMatrixBatchVectorMultiplyAccumulate1x16(
+namespace {
+
+// Shared body of the int8 1xN sparse kernels. The sum of each row's weights is
+// multiplied by input_offset once instead of adding the offset per weight.
+template <int kBlockSize>
+void SparseMatrixBatchVectorMultiplyAccumulateInt8(
     const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
     const int32_t* __restrict__ indices, int m_rows, int m_cols,
     const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
     int n_batch, const int32_t input_offset, const int32_t output_multiplier,
-    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_shift, const int32_t* per_channel_scale,
+    const int32_t* per_channel_shift, const int32_t output_offset,
     const int32_t output_activation_min, const int32_t output_activation_max,
     int8_t* __restrict__ result) {
-  const int kBlockSize = 16;
   TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
   for (int batch = 0; batch < n_batch; ++batch) {
     const int8_t* matrix_ptr = matrix;
+    const int8_t* vector_in_batch = vector + batch * m_cols;
     for (int row = 0; row < m_rows; ++row) {
       int32_t dot_prod = 0;
-      const int8_t* vector_in_batch = vector + batch * m_cols;
+      int32_t row_sum = 0;
       for (int i = segments[row]; i < segments[row + 1]; ++i) {
-        const int block_start_index = indices[i] * kBlockSize;
         const int8_t* vector_block_in_batch_ptr =
-            vector_in_batch + block_start_index;
+            vector_in_batch + indices[i] * kBlockSize;
         for (int c = 0; c < kBlockSize; c++) {
-          dot_prod += *matrix_ptr * *vector_block_in_batch_ptr++;
-          dot_prod += *matrix_ptr++ * input_offset;
+          row_sum += *matrix_ptr;
+          dot_prod += *matrix_ptr++ * *vector_block_in_batch_ptr++;
         }
       }
+      dot_prod += row_sum * input_offset;
       const int32_t bias_value = bias_vector != nullptr ? bias_vector[row] : 0;
-      dot_prod = MultiplyByQuantizedMultiplier(dot_prod + bias_value,
-                                               output_multiplier, output_shift);
+      if (per_channel_scale != nullptr) {
+        dot_prod = MultiplyByQuantizedMultiplier(
+            dot_prod + bias_value, per_channel_scale[row],
+            per_channel_shift[row]);
+      } else {
+        dot_prod = MultiplyByQuantizedMultiplier(
+            dot_prod + bias_value, output_multiplier, output_shift);
+      }
       dot_prod += output_offset;
       result[batch * m_rows + row] =
           static_cast<int8_t>(ActivationFunctionWithMinMax(
@@ -262,6 +274,40 @@ void PortableSparseMatrixBatchVectorMultiplyAccumulate1x16(
   }
 }
 
+}  // namespace
+
+void PortableSparseMatrixBatchVectorMultiplyAccumulate1x16(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t* per_channel_scale,
+    const int32_t* per_channel_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  SparseMatrixBatchVectorMultiplyAccumulateInt8<16>(
+      matrix, segments, indices, m_rows, m_cols, vector, bias_vector, n_batch,
+      input_offset, output_multiplier, output_shift, per_channel_scale,
+      per_channel_shift, output_offset, output_activation_min,
+      output_activation_max, result);
+}
+
+void PortableSparseMatrixBatchVectorMultiplyAccumulate1x4(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t* per_channel_scale,
+    const int32_t* per_channel_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  SparseMatrixBatchVectorMultiplyAccumulateInt8<4>(
+      matrix, segments, indices, m_rows, m_cols, vector, bias_vector, n_batch,
+      input_offset, output_multiplier, output_shift, per_channel_scale,
+      per_channel_shift, output_offset, output_activation_min,
+      output_activation_max, result);
+}
+
 void PortableSparseMatrixBatchVectorMultiplyAccumulate(
     const float* __restrict__ matrix, const uint8_t* __restrict__ ledger,
     int m_rows, int m_cols, const float* __restrict__ vector, int n_batch,
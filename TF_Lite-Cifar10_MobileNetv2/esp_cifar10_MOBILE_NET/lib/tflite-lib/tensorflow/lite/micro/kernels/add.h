@@ -47,6 +47,11 @@ struct OpDataAdd {
   int32_t input2_offset;
   int32_t output_offset;
 
+  // optimized_integer_ops scaled-input tables of both inputs, filled in
+  // Prepare for large int8 tensors, or nullptr when the reference path is
+  // used.
+  const int32_t* input_tables;
+
   // Used only for float evals:
   float output_activation_min_f32;
   float output_activation_max_f32;
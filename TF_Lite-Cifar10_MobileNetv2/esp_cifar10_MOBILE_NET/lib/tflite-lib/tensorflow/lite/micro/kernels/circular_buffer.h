@@ -39,6 +39,14 @@ extern const TfLiteStatus kTfLiteAbort;
 struct OpDataCircularBuffer {
   int cycles_until_run;
   int cycles_max;
+
+  // Persistent buffer of 2 * num_slots slots, each input being written to
+  // slot ring_head and to slot ring_head + num_slots. The num_slots most
+  // recent inputs are then always contiguous, starting at the oldest one, and
+  // the output eval tensor points at them. nullptr when the allocation failed
+  // and the output is shifted in place instead.
+  int8_t* ring_buffer;
+  int ring_head;
 };
 
 TfLiteStatus CircularBufferPrepare(TfLiteContext* context, TfLiteNode* node);
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
 #include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
@@ -62,6 +63,38 @@ void EvalAdd(TfLiteContext* context, TfLiteNode* node, TfLiteAddParams* params,
   }
 }
 
+namespace {
+
+// Int8 Add through the shared binary-elementwise engine, with both inputs
+// rescaled via the lookup tables AddPrepare filled. Returns false when
+// AddPrepare did not build the tables (small tensors) or the shapes need the
+// generic broadcast, so the caller falls back to the reference kernels.
+bool EvalAddInt8Optimized(const OpDataAdd* data,
+                          const ArithmeticParams& op_params,
+                          bool need_broadcast, const TfLiteEvalTensor* input1,
+                          const TfLiteEvalTensor* input2,
+                          TfLiteEvalTensor* output) {
+  if (data->input_tables == nullptr ||
+      !optimized_integer_ops::BinaryElementwiseSupported(op_params,
+                                                         need_broadcast)) {
+    return false;
+  }
+  const int32_t* input1_table = data->input_tables;
+  const int32_t* input2_table =
+      input1_table + optimized_integer_ops::kScaledInputTableSize;
+  optimized_integer_ops::BinaryElementwise(
+      op_params, need_broadcast, tflite::micro::GetTensorShape(input1),
+      tflite::micro::GetTensorData<int8_t>(input1),
+      tflite::micro::GetTensorShape(input2),
+      tflite::micro::GetTensorData<int8_t>(input2),
+      tflite::micro::GetTensorShape(output),
+      tflite::micro::GetTensorData<int8_t>(output),
+      optimized_integer_ops::AddOp(op_params, input1_table, input2_table));
+  return true;
+}
+
+}  // namespace
+
 TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
                               TfLiteAddParams* params, const OpDataAdd* data,
                               const TfLiteEvalTensor* input1,
@@ -87,6 +120,10 @@ TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
   switch (output->type) {
     case kTfLiteInt8: {
       if (need_broadcast) {
+        if (EvalAddInt8Optimized(data, op_params, need_broadcast, input1,
+                                 input2, output)) {
+          break;
+        }
         reference_integer_ops::BroadcastAdd4DSlow(
             op_params, tflite::micro::GetTensorShape(input1),
             tflite::micro::GetTensorData<int8_t>(input1),
@@ -120,6 +157,10 @@ TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
                                                        tflite::micro::GetTensorShape(output))
                                   );
 #else
+        if (EvalAddInt8Optimized(data, op_params, need_broadcast, input1,
+                                 input2, output)) {
+          break;
+        }
         reference_integer_ops::Add(
             op_params, tflite::micro::GetTensorShape(input1),
             tflite::micro::GetTensorData<int8_t>(input1),
@@ -132,7 +173,17 @@ TfLiteStatus EvalAddQuantized(TfLiteContext* context, TfLiteNode* node,
       break;
     }
     case kTfLiteInt16: {
-      if (need_broadcast) {
+      if (optimized_integer_ops::BinaryElementwiseSupported(op_params,
+                                                            need_broadcast)) {
+        optimized_integer_ops::BinaryElementwise(
+            op_params, need_broadcast, tflite::micro::GetTensorShape(input1),
+            tflite::micro::GetTensorData<int16_t>(input1),
+            tflite::micro::GetTensorShape(input2),
+            tflite::micro::GetTensorData<int16_t>(input2),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int16_t>(output),
+            optimized_integer_ops::AddInt16Op(op_params));
+      } else if (need_broadcast) {
         reference_ops::BroadcastAdd4DSlow(
             op_params, tflite::micro::GetTensorShape(input1),
             tflite::micro::GetTensorData<int16_t>(input1),
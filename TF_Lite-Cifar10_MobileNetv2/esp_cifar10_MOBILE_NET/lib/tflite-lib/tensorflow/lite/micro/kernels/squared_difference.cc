@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/binary_function.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
+#include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
 #include "tensorflow/lite/micro/micro_context.h"
@@ -30,6 +32,8 @@ constexpr int kOutputTensor = 0;
 struct OpData {
   bool requires_broadcast;
   ArithmeticParams arithmetic_params;
+  // Int8 scaled-input tables filled in Prepare, nullptr if unused.
+  const int32_t* input_tables;
 };
 
 template <typename T>
@@ -147,6 +151,26 @@ TfLiteStatus SquaredDifferencePrepare(TfLiteContext* context,
 
   data->requires_broadcast = !HaveSameShapes(input1, input2);
 
+  data->input_tables = nullptr;
+  if (input1->type == kTfLiteInt8 &&
+      NumElements(output) >=
+          optimized_integer_ops::kScaledInputTableMinElements) {
+    const ArithmeticParams& params = data->arithmetic_params;
+    int32_t* input1_table = static_cast<int32_t*>(
+        context->AllocatePersistentBuffer(
+            context, optimized_integer_ops::kScaledInputTablesBytes));
+    TF_LITE_ENSURE(context, input1_table != nullptr);
+    int32_t* input2_table =
+        input1_table + optimized_integer_ops::kScaledInputTableSize;
+    optimized_integer_ops::PopulateScaledInputTable(
+        params.input1_offset, params.input1_multiplier, params.input1_shift,
+        params.left_shift, input1_table);
+    optimized_integer_ops::PopulateScaledInputTable(
+        params.input2_offset, params.input2_multiplier, params.input2_shift,
+        params.left_shift, input2_table);
+    data->input_tables = input1_table;
+  }
+
   micro_context->DeallocateTempTfLiteTensor(input1);
   micro_context->DeallocateTempTfLiteTensor(input2);
   micro_context->DeallocateTempTfLiteTensor(output);
@@ -179,6 +203,39 @@ T SquaredDifference(T x, T y, const ArithmeticParams& params) {
   return static_cast<T>(clamped_output);
 }
 
+// Int8 SquaredDifference through the shared binary-elementwise engine.
+// Returns false when Prepare did not build the tables or the shapes need the
+// generic broadcast.
+bool EvalSquaredDifferenceInt8Optimized(const OpData* data,
+                                        const TfLiteEvalTensor* input1,
+                                        const TfLiteEvalTensor* input2,
+                                        TfLiteEvalTensor* output) {
+  if (data->input_tables == nullptr) {
+    return false;
+  }
+  ArithmeticParams op_params = data->arithmetic_params;
+  const bool need_broadcast = reference_ops::ProcessBroadcastShapes(
+      tflite::micro::GetTensorShape(input1),
+      tflite::micro::GetTensorShape(input2), &op_params);
+  if (!optimized_integer_ops::BinaryElementwiseSupported(op_params,
+                                                         need_broadcast)) {
+    return false;
+  }
+  const int32_t* input1_table = data->input_tables;
+  const int32_t* input2_table =
+      input1_table + optimized_integer_ops::kScaledInputTableSize;
+  optimized_integer_ops::BinaryElementwise(
+      op_params, need_broadcast, tflite::micro::GetTensorShape(input1),
+      tflite::micro::GetTensorData<int8_t>(input1),
+      tflite::micro::GetTensorShape(input2),
+      tflite::micro::GetTensorData<int8_t>(input2),
+      tflite::micro::GetTensorShape(output),
+      tflite::micro::GetTensorData<int8_t>(output),
+      optimized_integer_ops::SquaredDifferenceOp(op_params, input1_table,
+                                                 input2_table));
+  return true;
+}
+
 template <typename T>
 void EvalQuantizedSquaredDifference(TfLiteContext* context, TfLiteNode* node,
                                     const OpData* data,
@@ -245,8 +302,10 @@ TfLiteStatus SquaredDifferenceEval(TfLiteContext* context, TfLiteNode* node) {
   } else if (output->type == kTfLiteInt32) {
     EvalSquaredDifference<int32_t>(context, node, data, input1, input2, output);
   } else if (output->type == kTfLiteInt8) {
-    EvalQuantizedSquaredDifference<int8_t>(context, node, data, input1, input2,
-                                           output);
+    if (!EvalSquaredDifferenceInt8Optimized(data, input1, input2, output)) {
+      EvalQuantizedSquaredDifference<int8_t>(context, node, data, input1,
+                                             input2, output);
+    }
   } else if (output->type == kTfLiteInt16) {
     EvalQuantizedSquaredDifference<int16_t>(context, node, data, input1, input2,
                                             output);
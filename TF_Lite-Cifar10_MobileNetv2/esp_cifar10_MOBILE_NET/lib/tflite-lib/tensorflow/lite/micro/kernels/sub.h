@@ -46,6 +46,11 @@ struct OpDataSub {
   int32_t input1_offset;
   int32_t input2_offset;
   int32_t output_offset;
+
+  // optimized_integer_ops scaled-input tables of both inputs, filled in
+  // Prepare for large int8 tensors, or nullptr when the reference path is
+  // used.
+  const int32_t* input_tables;
 };
 
 TfLiteStatus CalculateOpDataSub(TfLiteContext* context, TfLiteSubParams* params,
@@ -0,0 +1,145 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/micro/palettized_weights.h"
+
+#include <cstring>
+
+#include "tensorflow/lite/micro/micro_log.h"
+
+namespace tflite {
+namespace {
+
+constexpr int kHeaderWords = 2;
+constexpr int kEntryWords = 6;
+
+// Returns the data of buffer `buffer_index`, or nullptr if it has none.
+const flatbuffers::Vector<uint8_t>* GetBufferData(const Model* model,
+                                                  uint32_t buffer_index) {
+  const auto* buffers = model->buffers();
+  if (buffers == nullptr || buffer_index >= buffers->size()) {
+    return nullptr;
+  }
+  const Buffer* buffer = buffers->Get(buffer_index);
+  return buffer != nullptr ? buffer->data() : nullptr;
+}
+
+const flatbuffers::Vector<uint8_t>* FindPalettizedWeightsMetadata(
+    const Model* model) {
+  if (model->metadata() == nullptr) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < model->metadata()->size(); ++i) {
+    const Metadata* metadata = model->metadata()->Get(i);
+    if (metadata->name() != nullptr &&
+        strcmp(metadata->name()->c_str(), kPalettizedWeightsMetadata) == 0) {
+      return GetBufferData(model, metadata->buffer());
+    }
+  }
+  return nullptr;
+}
+
+// Metadata buffers are not guaranteed to be word aligned.
+uint32_t ReadWord(const flatbuffers::Vector<uint8_t>* data, size_t index) {
+  uint32_t word;
+  memcpy(&word, data->data() + index * sizeof(uint32_t), sizeof(word));
+  return word;
+}
+
+}  // namespace
+
+TfLiteStatus GetPalettizedWeightsParams(const Model* model, int subgraph_index,
+                                        int tensor_index,
+                                        PalettizedWeightsParams* params) {
+  params->palette = nullptr;
+  const flatbuffers::Vector<uint8_t>* metadata =
+      FindPalettizedWeightsMetadata(model);
+  if (metadata == nullptr) {
+    return kTfLiteOk;
+  }
+  const size_t num_words = metadata->size() / sizeof(uint32_t);
+  // The entry count is compared by division so that a huge count cannot wrap
+  // the size computation around and pass.
+  if (num_words < kHeaderWords ||
+      ReadWord(metadata, 0) != kPalettizedWeightsVersion ||
+      ReadWord(metadata, 1) > (num_words - kHeaderWords) / kEntryWords) {
+    MicroPrintf("Malformed %s metadata.", kPalettizedWeightsMetadata);
+    return kTfLiteError;
+  }
+
+  const size_t num_entries = ReadWord(metadata, 1);
+  uint32_t entry[kEntryWords];
+  size_t i = 0;
+  for (; i < num_entries; ++i) {
+    for (int j = 0; j < kEntryWords; ++j) {
+      entry[j] = ReadWord(metadata, kHeaderWords + i * kEntryWords + j);
+    }
+    if (entry[0] == static_cast<uint32_t>(subgraph_index) &&
+        entry[1] == static_cast<uint32_t>(tensor_index)) {
+      break;
+    }
+  }
+  if (i == num_entries) {
+    return kTfLiteOk;
+  }
+
+  const int index_bits = static_cast<int>(entry[2]);
+  const int palette_channels = static_cast<int>(entry[4]);
+  const Tensor* tensor =
+      model->subgraphs()->Get(subgraph_index)->tensors()->Get(tensor_index);
+  const auto* shape = tensor->shape();
+  if (tensor->type() != TensorType_INT8 || shape == nullptr ||
+      shape->size() < 2) {
+    MicroPrintf("Palettized tensor %d must be an int8 tensor of rank >= 2.",
+                tensor_index);
+    return kTfLiteError;
+  }
+  const int num_rows = shape->Get(0);
+  int row_length = 1;
+  for (size_t d = 1; d < shape->size(); ++d) {
+    row_length *= shape->Get(d);
+  }
+  if (index_bits < 1 || index_bits > 8 || entry[3] != (1u << index_bits) ||
+      (palette_channels != 1 && palette_channels != num_rows)) {
+    MicroPrintf("Unsupported palette for tensor %d: %d bits, %d entries, "
+                "%d channels.",
+                tensor_index, index_bits, static_cast<int>(entry[3]),
+                palette_channels);
+    return kTfLiteError;
+  }
+
+  const int row_bytes =
+      optimized_integer_ops::PalettizedWeightsRowBytes(row_length, index_bits);
+  const flatbuffers::Vector<uint8_t>* indices =
+      GetBufferData(model, tensor->buffer());
+  const flatbuffers::Vector<uint8_t>* palette = GetBufferData(model, entry[5]);
+  if (indices == nullptr ||
+      indices->size() != static_cast<size_t>(num_rows * row_bytes) ||
+      palette == nullptr ||
+      palette->size() != static_cast<size_t>(palette_channels << index_bits)) {
+    MicroPrintf("Palettized tensor %d does not match its buffers.",
+                tensor_index);
+    return kTfLiteError;
+  }
+
+  params->palette = reinterpret_cast<const int8_t*>(palette->data());
+  params->palette_channels = palette_channels;
+  params->index_bits = index_bits;
+  params->num_rows = num_rows;
+  params->row_length = row_length;
+  params->row_bytes = row_bytes;
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
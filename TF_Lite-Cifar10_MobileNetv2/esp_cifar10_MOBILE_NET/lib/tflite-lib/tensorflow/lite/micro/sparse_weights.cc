@@ -0,0 +1,163 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/micro/sparse_weights.h"
+
+#include "tensorflow/lite/micro/micro_context.h"
+#include "tensorflow/lite/micro/micro_log.h"
+
+namespace tflite {
+namespace {
+
+template <typename T>
+const int32_t* WidenIndexVector(MicroContext* context,
+                                const flatbuffers::Vector<T>* values,
+                                int* size) {
+  if (values == nullptr) {
+    return nullptr;
+  }
+  int32_t* widened = static_cast<int32_t*>(
+      context->AllocatePersistentBuffer(values->size() * sizeof(int32_t)));
+  if (widened == nullptr) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < values->size(); ++i) {
+    widened[i] = values->Get(i);
+  }
+  *size = values->size();
+  return widened;
+}
+
+// Returns the values of a sparse index vector as int32 and their number in
+// `size`, or nullptr if there are none.
+const int32_t* GetIndexVector(MicroContext* context, SparseIndexVector type,
+                              const void* vector, int* size) {
+  if (vector == nullptr) {
+    return nullptr;
+  }
+  switch (type) {
+    case SparseIndexVector_Int32Vector: {
+      const auto* values = static_cast<const Int32Vector*>(vector)->values();
+      if (values == nullptr) {
+        return nullptr;
+      }
+      *size = values->size();
+      return values->data();
+    }
+    case SparseIndexVector_Uint16Vector:
+      return WidenIndexVector(
+          context, static_cast<const Uint16Vector*>(vector)->values(), size);
+    case SparseIndexVector_Uint8Vector:
+      return WidenIndexVector(
+          context, static_cast<const Uint8Vector*>(vector)->values(), size);
+    default:
+      return nullptr;
+  }
+}
+
+bool IsIdentity(const flatbuffers::Vector<int32_t>* order, int size) {
+  if (order == nullptr || static_cast<int>(order->size()) != size) {
+    return false;
+  }
+  for (int i = 0; i < size; ++i) {
+    if (order->Get(i) != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+TfLiteStatus GetBlockSparseWeightsParams(MicroContext* context,
+                                         const Model* model,
+                                         int subgraph_index, int tensor_index,
+                                         BlockSparseWeightsParams* params) {
+  params->segments = nullptr;
+  const Tensor* tensor =
+      model->subgraphs()->Get(subgraph_index)->tensors()->Get(tensor_index);
+  const SparsityParameters* sparsity = tensor->sparsity();
+  if (sparsity == nullptr) {
+    return kTfLiteOk;
+  }
+
+  const auto* shape = tensor->shape();
+  const int rank = shape != nullptr ? shape->size() : 0;
+  const auto* dim_metadata = sparsity->dim_metadata();
+  const auto* block_map = sparsity->block_map();
+  bool supported = tensor->type() == TensorType_INT8 && rank >= 2 &&
+                   IsIdentity(sparsity->traversal_order(), rank + 1) &&
+                   block_map != nullptr && block_map->size() == 1 &&
+                   block_map->Get(0) == rank - 1 &&
+                   dim_metadata != nullptr &&
+                   static_cast<int>(dim_metadata->size()) == rank + 1;
+  int num_rows = 1;
+  for (int d = 0; supported && d < rank - 1; ++d) {
+    const DimensionMetadata* dim = dim_metadata->Get(d);
+    supported = dim->format() == DimensionType_DENSE &&
+                dim->dense_size() == shape->Get(d);
+    num_rows *= shape->Get(d);
+  }
+  const DimensionMetadata* sparse_dim =
+      supported ? dim_metadata->Get(rank - 1) : nullptr;
+  const DimensionMetadata* block_dim =
+      supported ? dim_metadata->Get(rank) : nullptr;
+  const int block_size = supported ? block_dim->dense_size() : 0;
+  const int row_length = rank > 0 ? shape->Get(rank - 1) : 0;
+  if (!supported || sparse_dim->format() != DimensionType_SPARSE_CSR ||
+      block_dim->format() != DimensionType_DENSE ||
+      (block_size != 4 && block_size != 16) || row_length % block_size != 0) {
+    MicroPrintf("Unsupported sparsity for tensor %d, expected int8 1x4 or "
+                "1x16 blocks along the last dimension.",
+                tensor_index);
+    return kTfLiteError;
+  }
+
+  int num_segments = 0;
+  int num_indices = 0;
+  const int32_t* segments =
+      GetIndexVector(context, sparse_dim->array_segments_type(),
+                     sparse_dim->array_segments(), &num_segments);
+  const int32_t* indices =
+      GetIndexVector(context, sparse_dim->array_indices_type(),
+                     sparse_dim->array_indices(), &num_indices);
+  const Buffer* buffer = model->buffers()->Get(tensor->buffer());
+  const int num_values =
+      buffer != nullptr && buffer->data() != nullptr ? buffer->data()->size()
+                                                     : 0;
+  bool valid = segments != nullptr && indices != nullptr &&
+               num_segments == num_rows + 1 && segments[0] == 0 &&
+               segments[num_rows] == num_indices &&
+               num_values == num_indices * block_size;
+  for (int r = 0; valid && r < num_rows; ++r) {
+    valid = segments[r] <= segments[r + 1];
+  }
+  for (int i = 0; valid && i < num_indices; ++i) {
+    valid = indices[i] >= 0 && indices[i] < row_length / block_size;
+  }
+  if (!valid) {
+    MicroPrintf("Sparse tensor %d does not match its segments and indices.",
+                tensor_index);
+    return kTfLiteError;
+  }
+
+  params->segments = segments;
+  params->indices = indices;
+  params->block_size = block_size;
+  params->num_rows = num_rows;
+  params->row_length = row_length;
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
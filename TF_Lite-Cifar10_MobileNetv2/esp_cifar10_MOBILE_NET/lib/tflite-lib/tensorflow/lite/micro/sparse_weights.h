@@ -0,0 +1,43 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_SPARSE_WEIGHTS_H_
+#define TENSORFLOW_LITE_MICRO_SPARSE_WEIGHTS_H_
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/sparse_weights.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+
+class MicroContext;
+
+// Fills `params` from the SparsityParameters of tensor `tensor_index` of
+// subgraph `subgraph_index`, as written by micro/tools/sparsify_weights.py or
+// the TFLite converter. params->segments is left null if the tensor is dense.
+//
+// Supported is the block-sparse layout of a rank-n int8 tensor with
+// traversal_order 0..n, block_map [n - 1] and dim_metadata of n + 1
+// dimensions: n - 1 dense ones matching the shape, a SPARSE_CSR one over the
+// blocks of the last dimension and a dense block of 4 or 16 values. Segments
+// and indices stored in 8 or 16 bits are widened into `context`'s persistent
+// memory. Anything else returns an error.
+TfLiteStatus GetBlockSparseWeightsParams(MicroContext* context,
+                                         const Model* model,
+                                         int subgraph_index, int tensor_index,
+                                         BlockSparseWeightsParams* params);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_SPARSE_WEIGHTS_H_
@@ -0,0 +1,135 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_MICRO_STREAMING_AUDIO_PIPELINE_H_
+#define TENSORFLOW_LITE_MICRO_STREAMING_AUDIO_PIPELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+namespace tflite {
+
+// The frontend outputs roughly 0 to 670; models trained on the microfrontend
+// features conventionally see them divided by 25.6.
+constexpr float kDefaultFrontendFeatureScale = 1.0f / 25.6f;
+
+struct StreamingAudioPipelineStats {
+  int64_t samples_processed;
+  int32_t slices_generated;
+  int32_t invocations;
+  // Time spent in the frontend (including quantizing the slices) and in
+  // copying the window plus MicroInterpreter::Invoke.
+  int64_t frontend_time_us;
+  int64_t invoke_time_us;
+  // Duration of the last ProcessSamples call that ran the model, i.e. the
+  // delay between handing over the samples completing a stride and the
+  // model outputs being ready.
+  int64_t last_latency_us;
+};
+
+// Runs a model on a sliding window of microfrontend features computed from a
+// PCM stream.
+//
+// The model input 0 is the window: num_slices * num_channels int8 or float32
+// values, oldest slice first, num_channels being the frontend filterbank
+// channel count. Each slice is computed once, when its samples arrive, and
+// stored quantized in a ring of num_slices slices. The model runs once the
+// window is first full, then every stride_slices new slices; only then is the
+// ring copied, oldest first, into the input tensor (whose contents are not
+// preserved across invocations).
+//
+// The ring is a caller-provided buffer of at least input(0)->bytes bytes, so
+// it can live in static memory next to the tensor arena. The frontend state
+// is still allocated by FrontendPopulateState, once, in Init.
+//
+// Usage:
+//   static uint8_t features[kInputBytes];
+//   StreamingAudioPipeline pipeline(&interpreter, /*stride_slices=*/2);
+//   pipeline.Init(config, 16000, features, sizeof(features));
+//   while (num_samples > 0) {
+//     size_t read;
+//     bool invoked;
+//     pipeline.ProcessSamples(samples, num_samples, &read, &invoked);
+//     if (invoked) { /* read interpreter.output(0) */ }
+//     samples += read;
+//     num_samples -= read;
+//   }
+class StreamingAudioPipeline {
+ public:
+  // `interpreter` must outlive the pipeline and have allocated its tensors.
+  StreamingAudioPipeline(MicroInterpreter* interpreter, int stride_slices);
+  ~StreamingAudioPipeline();
+
+  // Sets up the frontend and the feature ring in `feature_buffer`, which
+  // must outlive the pipeline and hold at least input(0)->bytes bytes.
+  // `feature_scale` converts the frontend output to the float feature values
+  // the model was trained on.
+  TfLiteStatus Init(const FrontendConfig& config, int sample_rate,
+                    uint8_t* feature_buffer, size_t feature_buffer_bytes,
+                    float feature_scale = kDefaultFrontendFeatureScale);
+
+  // Consumes samples until the model has run or all samples are used, like
+  // FrontendProcessSamples. When `invoked` is set, the interpreter outputs
+  // hold the result for the latest window and must be read before the next
+  // call.
+  TfLiteStatus ProcessSamples(const int16_t* samples, size_t num_samples,
+                              size_t* num_samples_read, bool* invoked);
+
+  // Drops the buffered audio and features, starts filling a new window and
+  // clears the stats.
+  void Reset();
+
+  const StreamingAudioPipelineStats& stats() const { return stats_; }
+
+  // Processing time over audio duration; below 1 keeps up with real time.
+  float RealTimeFactor() const;
+
+ private:
+  void AppendSlice(const FrontendOutput& output);
+  TfLiteStatus InvokeOnWindow();
+
+  MicroInterpreter* interpreter_;
+  const int stride_slices_;
+  int sample_rate_ = 0;
+  bool initialized_ = false;
+
+  FrontendState frontend_state_;
+
+  TfLiteType input_type_ = kTfLiteNoType;
+  int num_channels_ = 0;
+  int num_slices_ = 0;
+  int slice_bytes_ = 0;
+  // Frontend output value to input tensor value: a float multiplier, plus
+  // the zero point for int8 inputs.
+  float input_multiplier_ = 0.0f;
+  int32_t input_zero_point_ = 0;
+
+  // num_slices_ slices in the caller's feature buffer; ring_head_ is the next
+  // slice to overwrite, which is also the oldest one once the ring is full.
+  uint8_t* ring_ = nullptr;
+  int ring_head_ = 0;
+  int ring_fill_ = 0;
+  int slices_since_invoke_ = 0;
+
+  StreamingAudioPipelineStats stats_ = {};
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_STREAMING_AUDIO_PIPELINE_H_
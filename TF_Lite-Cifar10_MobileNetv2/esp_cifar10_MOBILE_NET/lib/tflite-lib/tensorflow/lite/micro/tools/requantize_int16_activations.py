@@ -0,0 +1,179 @@
+# Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Turns a full-integer int8 TFLite model into a 16x8 model: int16
+activations, int8 weights.
+
+Every activation tensor keeps the real range calibrated for int8 and is
+requantized symmetrically over int16, s16 = max|s8 * (q - z8)| / 32767 with
+zero point 0, so the step shrinks by about 256x. Conv, depthwise and
+fully-connected biases become int64 scaled by input_scale * filter_scale, and
+the softmax output takes the fixed 1 / 32768 scale of the int16 kernel. The
+weights are not touched. The model input and output become int16 as well.
+
+Only models made of operators with 16x8 kernels are accepted. A model
+converted by the TFLite converter with
+EXPERIMENTAL_TFLITE_BUILTINS_ACTIVATIONS_INT16_WEIGHTS_INT8 and a
+representative dataset is calibrated for int16 and usually a little more
+accurate; this script is for when only the int8 model is at hand.
+
+Usage:
+  python requantize_int16_activations.py --input_model=model_int8.tflite \
+      --output_model=model_16x8.tflite
+"""
+
+import argparse
+
+import numpy as np
+from tensorflow.lite.python import schema_py_generated as schema_fb
+from tensorflow.lite.tools import flatbuffer_utils
+
+INT16_MAX = 32767
+SOFTMAX_INT16_SCALE = 1.0 / 32768
+
+_OP = schema_fb.BuiltinOperator
+# Operators with int16 activation kernels, and their bias input if any.
+_SUPPORTED_OPS = {
+    _OP.CONV_2D: 2,
+    _OP.DEPTHWISE_CONV_2D: 2,
+    _OP.FULLY_CONNECTED: 2,
+    _OP.ADD: None,
+    _OP.SOFTMAX: None,
+    _OP.MEAN: None,
+    _OP.RESHAPE: None,
+    _OP.MAX_POOL_2D: None,
+    _OP.AVERAGE_POOL_2D: None,
+}
+# Inputs that are parameters rather than activations: filters, biases,
+# shapes and axes.
+_PARAMETER_INPUTS = {
+    _OP.CONV_2D: (1, 2),
+    _OP.DEPTHWISE_CONV_2D: (1, 2),
+    _OP.FULLY_CONNECTED: (1, 2),
+    _OP.MEAN: (1,),
+    _OP.RESHAPE: (1,),
+}
+
+
+def _builtin_code(operator_code):
+  return max(operator_code.builtinCode, operator_code.deprecatedBuiltinCode)
+
+
+def _tensor_name(tensor):
+  return tensor.name.decode() if isinstance(tensor.name, bytes) else tensor.name
+
+
+def int16_scale(scale, zero_point):
+  """Symmetric int16 scale covering the real range of an int8 tensor."""
+  return max(abs(scale * (-128 - zero_point)),
+             abs(scale * (127 - zero_point))) / INT16_MAX
+
+
+def requantize_model(model):
+  """Converts a schema_fb.ModelT to int16 activations in place.
+
+  Returns a list of (tensor name, int8 scale, int16 scale) for the converted
+  activations. Raises ValueError if the model has an operator or tensor this
+  conversion does not support.
+  """
+  buffer_users = {}
+  for subgraph in model.subgraphs:
+    for tensor in subgraph.tensors:
+      buffer_users[tensor.buffer] = buffer_users.get(tensor.buffer, 0) + 1
+
+  report = []
+  for subgraph in model.subgraphs:
+    tensors = subgraph.tensors
+    activations = set()
+    softmax_outputs = set()
+    biases = {}
+    for op in subgraph.operators:
+      code = _builtin_code(model.operatorCodes[op.opcodeIndex])
+      if code not in _SUPPORTED_OPS:
+        raise ValueError("operator %d has no 16x8 kernel" % code)
+      parameters = _PARAMETER_INPUTS.get(code, ())
+      for position, tensor_index in enumerate(op.inputs):
+        if tensor_index >= 0 and position not in parameters:
+          activations.add(tensor_index)
+      activations.update(op.outputs)
+      if code == _OP.SOFTMAX:
+        softmax_outputs.update(op.outputs)
+      bias_input = _SUPPORTED_OPS[code]
+      if (bias_input is not None and len(op.inputs) > bias_input and
+          op.inputs[bias_input] >= 0):
+        biases.setdefault(op.inputs[bias_input], []).append(op.inputs[0])
+
+    scales = {}
+    for t in sorted(activations):
+      tensor = tensors[t]
+      if tensor.type != schema_fb.TensorType.INT8:
+        raise ValueError("activation %s is not int8" % _tensor_name(tensor))
+      if model.buffers[tensor.buffer].data is not None:
+        raise ValueError("constant activation %s is not supported" %
+                         _tensor_name(tensor))
+      quantization = tensor.quantization
+      scale = float(quantization.scale[0])
+      zero_point = int(quantization.zeroPoint[0])
+      if t in softmax_outputs:
+        new_scale = SOFTMAX_INT16_SCALE
+      else:
+        new_scale = int16_scale(scale, zero_point)
+      scales[t] = (scale, new_scale)
+
+    for b, inputs in biases.items():
+      bias = tensors[b]
+      buffer = model.buffers[bias.buffer]
+      if (bias.type != schema_fb.TensorType.INT32 or buffer.data is None or
+          buffer_users[bias.buffer] != 1 or len(set(inputs)) != 1):
+        raise ValueError("bias %s must be a constant int32 tensor of one "
+                         "input" % _tensor_name(bias))
+      scale, new_scale = scales[inputs[0]]
+      ratio = scale / new_scale
+      values = np.frombuffer(
+          np.asarray(buffer.data, dtype=np.uint8).tobytes(), dtype="<i4")
+      rescaled = np.round(values.astype(np.float64) * ratio).astype("<i8")
+      buffer.data = np.frombuffer(rescaled.tobytes(), dtype=np.uint8)
+      bias.type = schema_fb.TensorType.INT64
+      bias.quantization.scale = [
+          float(s) / ratio for s in bias.quantization.scale]
+
+    for t, (scale, new_scale) in scales.items():
+      tensor = tensors[t]
+      tensor.type = schema_fb.TensorType.INT16
+      tensor.quantization.scale = [new_scale]
+      tensor.quantization.zeroPoint = [0]
+      report.append((_tensor_name(tensor), scale, new_scale))
+  return report
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument("--input_model", required=True)
+  parser.add_argument("--output_model", required=True)
+  args = parser.parse_args()
+
+  model = flatbuffer_utils.read_model(args.input_model)
+  try:
+    report = requantize_model(model)
+  except ValueError as error:
+    parser.error("%s: %s" % (args.input_model, error))
+  flatbuffer_utils.write_model(model, args.output_model)
+
+  for name, scale, new_scale in report:
+    print("%-60s step %.3g -> %.3g" % (name, scale, new_scale))
+  print("%d activations requantized to int16" % len(report))
+
+
+if __name__ == "__main__":
+  main()
@@ -12,9 +12,23 @@
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
+#include "bilinear_resizer.h"
+#include "http_request_parser.h"
+#include "inference_queue.h"
+#include "input_quantizer.h"
+#include "pixel_array_parser.h"
+#include "raw_image_body.h"
+#include "response_writer.h"
+#include "result_cache.h"
+#include "server_metrics.h"
+#include "top_k.h"
+
 const char *ssid = "REDE WIFI";
 const char *password = "PASSWORD";
 const int serverPort = 80;
+const unsigned long kKeepAliveTimeoutMs = 5000; // conexão ociosa entre requisições
+const unsigned long kHeaderTimeoutMs = 10000;
+const unsigned long kBodyTimeoutMs = 10000;
 
 WiFiServer server(serverPort);
 
@@ -35,26 +49,149 @@ struct CIFAR10Model
   static constexpr int kInputHeight = 96;
   static constexpr int kInputChannels = 3;
   static constexpr int kImageSize = kInputWidth * kInputHeight * kInputChannels;
-  static constexpr int kTensorArenaSize = 450 * 1024;
+  // Imagens de outro tamanho (?width=32&height=32) são redimensionadas na
+  // inferência; precisam caber no slot de kImageSize bytes.
+  static constexpr int kMaxSourceDimension = BilinearResizer::kMaxDimension;
+  // arena_used_bytes() dá 451.136 bytes no host de 64 bits (no ESP32, com
+  // ponteiros de 32 bits, é menos), ~20 KB deles nas tabelas que o Prepare
+  // dos ADD int8 guarda. 480 KB deixam ~29 KB (6%) de folga; o uso real
+  // sai no log de load_model() e em /metrics.
+  static constexpr int kTensorArenaSize = 480 * 1024;
+  static constexpr int kMaxRawImages = 4; // imagens por POST /predict_raw
 };
 
 CIFAR10Model cifar10_model = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, false};
 
+// Pixel 0..255 -> int8 da entrada do modelo, montado depois do AllocateTensors.
+InputQuantizer input_quantizer;
+// Só usado pela tarefa de inferência.
+BilinearResizer input_resizer;
+
 struct InferenceResult
 {
   int predicted_class;
   float confidence;
   bool success;
   String error_message;
+  uint32_t receive_us;   // headers lidos -> imagem completa no slot
+  uint32_t queue_us;     // submetida -> início da inferência
+  uint32_t inference_us; // Invoke e top-k
+  int top_count;         // entradas de top_k na resposta (0 sem ?top_k)
+  int top_classes[kMaxTopK];
+  float top_scores[kMaxTopK];
+  bool cached;            // respondido pelo result_cache, sem Invoke
+};
+
+// Toda resposta é montada aqui e enviada com um único write. 12 KB cabem
+// o /metrics mesmo com os contadores no limite de 32 bits.
+char response_buffer[12288];
+ResponseWriter response_writer(response_buffer, sizeof(response_buffer));
+
+const int kQueueSlots = 4;
+// Resultados guardados por hash da entrada quantizada; 0 desliga o cache.
+const int kResultCacheEntries = 32;
+const int kMaxConnections = 4;
+const uint32_t kInferenceTaskStackSize = 16 * 1024;
+
+// Um slot da fila de inferência: a imagem, preenchida pela rede, e o
+// resultado, preenchido pela tarefa de inferência. Com width x height igual
+// à entrada do modelo a imagem já chega quantizada; senão são os pixels
+// uint8 originais, redimensionados e quantizados direto no tensor.
+struct InferenceJob
+{
+  int8_t *input;
+  int width;
+  int height;
+  int top_k;
+  uint32_t receive_us;
+  uint32_t submitted_us;
+  InferenceResult result;
 };
 
+InferenceJob inference_jobs[kQueueSlots];
+InferenceQueue inference_queue(kQueueSlots);
+ResultCache result_cache(kResultCacheEntries);
+// Histogramas por etapa e contagem de requisições, expostos em GET /metrics.
+ServerMetrics server_metrics;
+
+enum ConnectionState
+{
+  kReadHeaders, // esperando a próxima requisição
+  kReadBody,    // corpo de /predict ou /predict_raw indo para os slots
+  kDiscardBody, // corpo que não será usado (erro, /status, página)
+  kWaitResults, // corpo lido, esperando as inferências
+};
+
+enum Route
+{
+  kRoutePredict,
+  kRoutePredictRaw,
+  kRouteStatus,
+  kRouteMetrics,
+  kRouteHelp
+};
+
+// Uma conexão atendida pelo loop(). Cada uma avança um pouco por volta,
+// sem bloquear, então várias podem ter imagens na fila ao mesmo tempo.
+struct ClientConnection
+{
+  WiFiClient client;
+  bool active = false;
+  ConnectionState state = kReadHeaders;
+  Route route = kRouteHelp;
+  HttpRequestParser request;
+  PixelArrayParser pixels{nullptr, CIFAR10Model::kImageSize, input_quantizer.table()};
+  int body_remaining = 0;
+  unsigned long last_activity = 0;
+  unsigned long request_start_us = 0;
+  uint32_t parse_us = 0; // decodificação do corpo, somada entre os pedaços
+  int request_count = 0;
+
+  int response_status = 200;
+  String error_message;
+  int image_count = 0;   // imagens da requisição (1 em /predict)
+  int top_k = 0;         // ?top_k=N; 0 responde só a classe prevista
+  int image_width = CIFAR10Model::kInputWidth;
+  int image_height = CIFAR10Model::kInputHeight;
+  int image_bytes = CIFAR10Model::kImageSize;
+  int images_read = 0;   // já submetidas à fila
+  int images_done = 0;   // resultados já copiados para results
+  int filling_slot = -1; // slot recebendo a imagem atual
+  RawImageBody raw_body;  // bytes de /predict_raw já lidos
+  int pending_slots[CIFAR10Model::kMaxRawImages];
+  InferenceResult results[CIFAR10Model::kMaxRawImages];
+};
+
+ClientConnection connections[kMaxConnections];
+
 void cleanup_model();
 bool connect_wifi();
-void handle_client();
-String parse_json_array(String json_data, uint8_t *image_array);
-String create_json_response(const InferenceResult &result);
+void accept_clients();
+bool service_connection(ClientConnection &conn);
+bool read_headers(ClientConnection &conn);
+void start_request(ClientConnection &conn);
+bool read_image_size(ClientConnection &conn);
+bool resizing(const ClientConnection &conn);
+bool start_image(ClientConnection &conn);
+void submit_image(ClientConnection &conn);
+int body_bytes_available(ClientConnection &conn);
+bool read_json_body(ClientConnection &conn);
+bool read_raw_body(ClientConnection &conn);
+bool discard_body(ClientConnection &conn);
+bool collect_results(ClientConnection &conn);
+bool wait_results(ClientConnection &conn);
+void release_slots(ClientConnection &conn);
+void finish_request(ClientConnection &conn);
+void close_connection(ClientConnection &conn);
+void send_response(WiFiClient &client, int status, const char *content_type, bool keep_alive);
+void write_json_response(ResponseWriter &out, const InferenceResult &result);
+void write_batch_json_response(ResponseWriter &out, const InferenceResult *results, int count);
+void write_status_response(ResponseWriter &out);
+void write_metrics(ResponseWriter &out);
+void write_help_page(ResponseWriter &out);
 bool initialize_cifar10_model();
-InferenceResult run_inference(const uint8_t *image_data);
+bool start_inference_task();
+InferenceResult run_inference_on_input(int top_k);
 
 bool connect_wifi()
 {
@@ -178,6 +315,10 @@ bool initialize_interpreter()
     return false;
   }
 
+  // Normalização para [-1, 1] como no mobilenet_v2.preprocess_input
+  input_quantizer.build(InputQuantizer::kSymmetricRange, cifar10_model.input_tensor->params.scale,
+                        cifar10_model.input_tensor->params.zero_point);
+
   Serial.printf("Arena usada: %lu/%d bytes\n",
                 cifar10_model.interpreter->arena_used_bytes(), CIFAR10Model::kTensorArenaSize);
   Serial.println("Interpretador inicializado com sucesso");
@@ -188,6 +329,9 @@ bool initialize_cifar10_model()
 {
   Serial.println("=== Inicializando Modelo CIFAR-10 ===");
 
+  // Resultados de um modelo anterior não valem para o novo.
+  result_cache.clear();
+
   static tflite::MicroErrorReporter micro_error_reporter;
   cifar10_model.error_reporter = &micro_error_reporter;
 
@@ -207,24 +351,8 @@ bool initialize_cifar10_model()
   return true;
 }
 
-void preprocess_image(const uint8_t* image_data) {
-    const float input_scale = cifar10_model.input_tensor->params.scale;
-    const int32_t input_zero_point = cifar10_model.input_tensor->params.zero_point;
-
-    for (int i = 0; i < CIFAR10Model::kImageSize; ++i) {
-        // <<< MUDANÇA: Normalização para [-1, 1] como no mobilenet_v2.preprocess_input
-        float normalized_pixel = (static_cast<float>(image_data[i]) - 127.5f) / 127.5f;
-        
-        int32_t quantized_value = static_cast<int32_t>(
-            roundf(normalized_pixel / input_scale) + input_zero_point);
-        
-        quantized_value = max(SCHAR_MIN, min(SCHAR_MAX, quantized_value));
-        
-        cifar10_model.input_tensor->data.int8[i] = static_cast<int8_t>(quantized_value);
-    }
-}
-
-InferenceResult run_inference(const uint8_t *image_data)
+// Executa o modelo sobre o que já está no tensor de entrada.
+InferenceResult run_inference_on_input(int top_k)
 {
   InferenceResult result = {-1, 0.0f, false, ""};
 
@@ -235,239 +363,758 @@ InferenceResult run_inference(const uint8_t *image_data)
     return result;
   }
 
-  preprocess_image(image_data);
+  // A mesma entrada quantizada dá sempre a mesma saída: num acerto do
+  // cache o Invoke() é pulado. O top-k guardado é sempre o completo
+  // (kMaxTopK), para servir qualquer ?top_k.
+  const TfLiteTensor *input = cifar10_model.input_tensor;
+  ResultCache::Key key = {};
+  CachedPrediction prediction;
+  result.cached = result_cache.lookup(input->data.int8, input->bytes, &key, &prediction);
+  uint32_t postprocess_start_us = micros();
+  if (!result.cached)
+  {
+    const uint32_t invoke_start_us = postprocess_start_us;
+    TfLiteStatus invoke_status = cifar10_model.interpreter->Invoke();
+    postprocess_start_us = micros();
+    server_metrics.record(ServerMetrics::kInvoke, postprocess_start_us - invoke_start_us);
+    if (invoke_status != kTfLiteOk)
+    {
+      result.error_message = "Falha na execução da inferência";
+      Serial.printf("ERRO: Invoke falhou (código: %d)\n", invoke_status);
+      return result;
+    }
+
+    const TfLiteTensor *output = cifar10_model.output_tensor;
+    prediction.count = select_top_k(output->data.int8, output->dims->data[1], kMaxTopK,
+                                    output->params.scale, output->params.zero_point,
+                                    prediction.classes, prediction.scores);
+    result_cache.insert(key, prediction, micros() - invoke_start_us);
+  }
+
+  // A classe prevista e a confiança são o primeiro lugar.
+  memcpy(result.top_classes, prediction.classes, sizeof(result.top_classes));
+  memcpy(result.top_scores, prediction.scores, sizeof(result.top_scores));
+  result.predicted_class = prediction.classes[0];
+  result.confidence = prediction.scores[0];
+  result.top_count = top_k > 0 ? min(top_k, prediction.count) : 0;
+  result.success = true;
+  server_metrics.record(ServerMetrics::kPostprocess, micros() - postprocess_start_us);
 
-  TfLiteStatus invoke_status = cifar10_model.interpreter->Invoke();
-  if (invoke_status != kTfLiteOk)
+  return result;
+}
+
+// Campos de um resultado, comuns à resposta simples e aos itens de um lote.
+void write_result_fields(ResponseWriter &out, const InferenceResult &result)
+{
+  out.field_bool("success", result.success);
+  out.field_int("predicted_class", result.predicted_class);
+  out.field_float("confidence", result.confidence, 6);
+  if (result.top_count > 0)
   {
-    result.error_message = "Falha na execução da inferência";
-    Serial.printf("ERRO: Invoke falhou (código: %d)\n", invoke_status);
-    return result;
+    out.field_top_k("top_k", "class", result.top_classes, result.top_scores,
+                    result.top_count, 6);
+  }
+  out.field_string("error_message", result.error_message.c_str());
+  if (result.success)
+  {
+    out.field_bool("cached", result.cached);
+    out.begin_object("timings_ms", true);
+    out.field_float("receive", result.receive_us / 1000.0f, 3);
+    out.field_float("queue", result.queue_us / 1000.0f, 3);
+    out.field_float("inference", result.inference_us / 1000.0f, 3);
+    out.end_object();
+  }
+}
+
+void write_system_fields(ResponseWriter &out)
+{
+  out.field_uint("heap_free", esp_get_free_heap_size());
+  out.field_bool("model_initialized", cifar10_model.initialized);
+}
+
+void write_json_response(ResponseWriter &out, const InferenceResult &result)
+{
+  out.begin_object();
+  write_result_fields(out, result);
+  write_system_fields(out);
+  out.end_object();
+}
+
+void write_batch_json_response(ResponseWriter &out, const InferenceResult *results, int count)
+{
+  bool all_success = true;
+  for (int i = 0; i < count; ++i)
+    all_success = all_success && results[i].success;
+
+  out.begin_object();
+  out.field_bool("success", all_success);
+  out.field_int("count", count);
+  out.begin_array("results");
+  for (int i = 0; i < count; ++i)
+  {
+    out.begin_object(nullptr, true);
+    write_result_fields(out, results[i]);
+    out.end_object();
   }
+  out.end_array();
+  write_system_fields(out);
+  out.end_object();
+}
+
+// GET /status: estado do modelo e métricas da fila de inferência.
+void write_status_response(ResponseWriter &out)
+{
+  const InferenceQueue::Stats queue = inference_queue.stats();
+  const uint32_t completed = queue.completed > 0 ? queue.completed : 1;
+  const ResultCache::Stats cache = result_cache.stats();
+  const uint32_t lookups = cache.hits + cache.misses;
+
+  out.begin_object();
+  out.field_bool("success", cifar10_model.initialized);
+  out.field_int("predicted_class", -1);
+  out.field_float("confidence", 0.0f, 6);
+  out.field_string("error_message", cifar10_model.initialized ? "" : "Modelo não inicializado");
+  write_system_fields(out);
+  out.begin_object("queue", true);
+  out.field_int("slots", queue.slots);
+  out.field_int("depth", queue.depth);
+  out.field_int("max_depth", queue.max_depth);
+  out.field_uint("submitted", queue.submitted);
+  out.field_uint("completed", queue.completed);
+  out.field_uint("rejected", queue.rejected);
+  out.field_float("avg_wait_ms", queue.total_wait_us / completed / 1000.0f, 3);
+  out.field_float("max_wait_ms", queue.max_wait_us / 1000.0f, 3);
+  out.field_float("avg_inference_ms", queue.total_run_us / completed / 1000.0f, 3);
+  out.field_float("max_inference_ms", queue.max_run_us / 1000.0f, 3);
+  out.end_object();
+  out.begin_object("cache", true);
+  out.field_int("capacity", cache.capacity);
+  out.field_int("entries", cache.entries);
+  out.field_uint("hits", cache.hits);
+  out.field_uint("misses", cache.misses);
+  out.field_uint("evictions", cache.evictions);
+  out.field_uint("collisions", cache.collisions);
+  out.field_uint("invalidations", cache.invalidations);
+  out.field_float("hit_rate", lookups > 0 ? static_cast<float>(cache.hits) / lookups : 0.0f, 3);
+  out.field_float("avg_lookup_ms", cache.total_lookup_us / (lookups > 0 ? lookups : 1) / 1000.0f, 3);
+  out.field_float("max_lookup_ms", cache.max_lookup_us / 1000.0f, 3);
+  out.field_float("avg_invoke_ms", cache.total_invoke_us / (cache.misses > 0 ? cache.misses : 1) / 1000.0f, 3);
+  out.end_object();
+  out.end_object();
+}
 
-  int best_index = 0;
-  int8_t max_score = SCHAR_MIN;
-  const int output_size = cifar10_model.output_tensor->dims->data[1];
+// GET /metrics: latências por etapa, requisições por resultado, memória,
+// fila e cache no formato de texto do Prometheus.
+void write_metrics(ResponseWriter &out)
+{
+  const InferenceQueue::Stats queue = inference_queue.stats();
+  const ResultCache::Stats cache = result_cache.stats();
+  const unsigned long arena_used = cifar10_model.initialized ? cifar10_model.interpreter->arena_used_bytes() : 0;
+
+  server_metrics.write(out);
+  ServerMetrics::write_metric(out, "classifier_model_initialized", "gauge",
+                              "1 com o modelo carregado.", cifar10_model.initialized ? 1 : 0);
+  ServerMetrics::write_metric(out, "classifier_arena_used_bytes", "gauge",
+                              "Bytes da tensor arena em uso.", arena_used);
+  ServerMetrics::write_metric(out, "classifier_arena_size_bytes", "gauge",
+                              "Tamanho da tensor arena.", CIFAR10Model::kTensorArenaSize);
+  ServerMetrics::write_metric(out, "classifier_heap_free_bytes", "gauge",
+                              "Heap livre.", esp_get_free_heap_size());
+  ServerMetrics::write_metric(out, "classifier_heap_min_free_bytes", "gauge",
+                              "Menor heap livre desde o boot.", esp_get_minimum_free_heap_size());
+  ServerMetrics::write_metric(out, "classifier_psram_free_bytes", "gauge",
+                              "PSRAM livre.", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  ServerMetrics::write_metric(out, "classifier_psram_min_free_bytes", "gauge",
+                              "Menor PSRAM livre desde o boot.",
+                              heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+  ServerMetrics::write_metric(out, "classifier_queue_depth", "gauge",
+                              "Slots na fila ou em execução.", queue.depth);
+  ServerMetrics::write_metric(out, "classifier_queue_max_depth", "gauge",
+                              "Maior profundidade da fila.", queue.max_depth);
+  ServerMetrics::write_metric(out, "classifier_inferences_total", "counter",
+                              "Imagens processadas pela tarefa de inferência.", queue.completed);
+  ServerMetrics::write_metric(out, "classifier_queue_rejected_total", "counter",
+                              "Requisições recusadas com a fila cheia.", queue.rejected);
+  ServerMetrics::write_metric(out, "classifier_cache_entries", "gauge",
+                              "Resultados guardados no cache.", cache.entries);
+  ServerMetrics::write_metric(out, "classifier_cache_hits_total", "counter",
+                              "Acertos do cache de resultados.", cache.hits);
+  ServerMetrics::write_metric(out, "classifier_cache_misses_total", "counter",
+                              "Falhas do cache de resultados.", cache.misses);
+  ServerMetrics::write_metric(out, "classifier_cache_evictions_total", "counter",
+                              "Resultados descartados com o cache cheio.", cache.evictions);
+  ServerMetrics::write_metric(out, "classifier_cache_collisions_total", "counter",
+                              "Entradas com o mesmo hash e outra imagem.", cache.collisions);
+}
 
-  for (int i = 0; i < output_size; ++i)
+void write_help_page(ResponseWriter &out)
+{
+  char max_images[12];
+  snprintf(max_images, sizeof(max_images), "%d", CIFAR10Model::kMaxRawImages);
+  out.append("<!DOCTYPE html><html><body><h1>CIFAR-10 API</h1><h2>Endpoints:</h2><p><b>POST /predict</b> - Body: {\"pixels\": [array de 27648 valores (96x96x3) 0-255]}</p><p><b>POST /predict_raw</b> - Body application/octet-stream: 27648 bytes (96x96x3, HWC) por imagem, até ");
+  out.append(max_images);
+  out.append(" imagens</p><p>Com <b>?width=32&amp;height=32</b> as duas rotas aceitam a imagem no tamanho original (32x32x3 valores), redimensionada no ESP32 por interpolação bilinear</p><p>Com <b>?top_k=N</b> (até 10) devolvem também as N classes mais prováveis</p><p><b>GET /status</b> - Status do sistema e da fila de inferência</p><p><b>GET /metrics</b> - Latências por etapa, memória, fila e cache no formato do Prometheus</p><p>IP: ");
+  out.append(WiFi.localIP().toString().c_str());
+  out.append("</p></body></html>");
+}
+
+// Consome a fila no core 0 enquanto o loop(), no core 1, continua aceitando
+// conexões e lendo os corpos das próximas requisições.
+void inference_task(void *parameter)
+{
+  for (;;)
   {
-    if (cifar10_model.output_tensor->data.int8[i] > max_score)
+    const int slot = inference_queue.take();
+    InferenceJob &job = inference_jobs[slot];
+    const uint32_t start_us = micros();
+    if (job.width == CIFAR10Model::kInputWidth && job.height == CIFAR10Model::kInputHeight)
     {
-      max_score = cifar10_model.output_tensor->data.int8[i];
-      best_index = i;
+      memcpy(cifar10_model.input_tensor->data.int8, job.input, CIFAR10Model::kImageSize);
     }
+    else
+    {
+      if (!input_resizer.configured_for(job.width, job.height))
+      {
+        input_resizer.configure(job.width, job.height, CIFAR10Model::kInputWidth,
+                                CIFAR10Model::kInputHeight, CIFAR10Model::kInputChannels);
+      }
+      input_resizer.resize(reinterpret_cast<const uint8_t *>(job.input),
+                           cifar10_model.input_tensor->data.int8, input_quantizer.table());
+    }
+    server_metrics.record(ServerMetrics::kQueue, start_us - job.submitted_us);
+    server_metrics.record(ServerMetrics::kPreprocess, micros() - start_us);
+    job.result = run_inference_on_input(job.top_k);
+    job.result.receive_us = job.receive_us;
+    job.result.queue_us = start_us - job.submitted_us;
+    job.result.inference_us = micros() - start_us;
+    inference_queue.complete(slot);
   }
+}
 
-  const float output_scale = cifar10_model.output_tensor->params.scale;
-  const int32_t output_zero_point = cifar10_model.output_tensor->params.zero_point;
-  float confidence = (static_cast<float>(max_score) - output_zero_point) * output_scale;
+bool start_inference_task()
+{
+  for (int i = 0; i < kQueueSlots; ++i)
+  {
+    inference_jobs[i].input = static_cast<int8_t*>(allocate_memory(CIFAR10Model::kImageSize));
+    if (inference_jobs[i].input == nullptr)
+    {
+      Serial.println("ERRO: Falha na alocação dos slots da fila");
+      return false;
+    }
+  }
 
-  result.predicted_class = best_index;
-  result.confidence = confidence;
-  result.success = true;
+  BaseType_t created = xTaskCreatePinnedToCore(
+      inference_task, "inference", kInferenceTaskStackSize, nullptr, 1, nullptr, 0);
+  if (created != pdPASS)
+  {
+    Serial.println("ERRO: Falha ao criar a tarefa de inferência");
+    return false;
+  }
 
-  return result;
+  Serial.printf("Tarefa de inferência no core 0, fila com %d slots\n", kQueueSlots);
+  return true;
 }
 
-String create_json_response(const InferenceResult &result)
+// Aceita clientes novos enquanto houver entrada livre em connections. Com
+// todas ocupadas, uma conexão ociosa entre requisições keep-alive dá lugar
+// ao cliente que está esperando; se nenhuma estiver ociosa, ele fica no
+// backlog do socket até alguma fechar.
+void accept_clients()
 {
-  String response = "{\n";
-  response += "  \"success\": " + String(result.success ? "true" : "false") + ",\n";
-  response += "  \"predicted_class\": " + String(result.predicted_class) + ",\n";
-  response += "  \"confidence\": " + String(result.confidence, 6) + ",\n";
-  response += "  \"error_message\": \"" + result.error_message + "\",\n";
-  response += "  \"heap_free\": " + String(esp_get_free_heap_size()) + ",\n";
-  response += "  \"model_initialized\": " + String(cifar10_model.initialized ? "true" : "false") + "\n";
-  response += "}";
-  return response;
+  while (server.hasClient())
+  {
+    ClientConnection *conn = nullptr;
+    for (ClientConnection &candidate : connections)
+    {
+      if (!candidate.active)
+      {
+        conn = &candidate;
+        break;
+      }
+    }
+    if (conn == nullptr)
+    {
+      for (ClientConnection &candidate : connections)
+      {
+        if (candidate.state == kReadHeaders && !candidate.request.started())
+        {
+          close_connection(candidate);
+          conn = &candidate;
+          break;
+        }
+      }
+    }
+    if (conn == nullptr)
+      return;
+
+    conn->client = server.available();
+    conn->client.setNoDelay(true);
+    conn->active = true;
+    conn->state = kReadHeaders;
+    conn->request.reset();
+    conn->filling_slot = -1;
+    conn->images_read = 0;
+    conn->images_done = 0;
+    conn->request_count = 0;
+    conn->last_activity = millis();
+    Serial.println("=== Cliente conectado ===");
+  }
 }
 
-void handle_client()
+// Avança uma conexão sem bloquear. Retorna se algo foi feito, para o loop()
+// saber se pode dormir.
+bool service_connection(ClientConnection &conn)
 {
-  WiFiClient client = server.available();
-  if (!client)
-    return;
-
-  Serial.println("=== Cliente conectado ===");
-  client.setTimeout(5000);
+  if (!conn.client.connected() && conn.client.available() <= 0)
+  {
+    close_connection(conn);
+    return true;
+  }
+  switch (conn.state)
+  {
+    case kReadHeaders: return read_headers(conn);
+    case kReadBody: return conn.route == kRoutePredict ? read_json_body(conn) : read_raw_body(conn);
+    case kDiscardBody: return discard_body(conn);
+    case kWaitResults: return wait_results(conn);
+  }
+  return false;
+}
 
-  String request = "";
-  String headers = "";
-  String body = "";
-  bool reading_body = false;
-  int content_length = 0;
-  unsigned long start_time = millis();
+// Lê os headers byte a byte, parando na linha em branco para que o corpo e
+// as requisições pipelined seguintes fiquem no socket.
+bool read_headers(ClientConnection &conn)
+{
+  int available = conn.client.available();
+  if (available <= 0)
+  {
+    unsigned long idle = millis() - conn.last_activity;
+    if (idle >= (conn.request.started() ? kHeaderTimeoutMs : kKeepAliveTimeoutMs))
+    {
+      close_connection(conn);
+      return true;
+    }
+    return false;
+  }
 
-  while (client.connected() && (millis() - start_time < 10000))
+  conn.last_activity = millis();
+  while (available-- > 0)
   {
-    if (!client.available())
+    if (conn.request.feed(static_cast<char>(conn.client.read())) != HttpRequestParser::kNeedMore)
     {
-      delay(1);
-      continue;
+      start_request(conn);
+      break;
     }
-    String line = client.readStringUntil('\n');
-    line.trim();
+  }
+  return true;
+}
+
+// Headers completos: escolhe a rota e, para /predict e /predict_raw, reserva
+// o slot da primeira imagem. Sem slot livre a requisição é recusada com 503
+// depois de descartar o corpo.
+void start_request(ClientConnection &conn)
+{
+  const HttpRequestParser &request = conn.request;
+  if (request.status() == HttpRequestParser::kError)
+  {
+    Serial.printf("ERRO na requisição: %d %s\n", request.error_status(), request.error());
+    InferenceResult error = {-1, 0.0f, false, request.error()};
+    response_writer.reset();
+    write_json_response(response_writer, error);
+    send_response(conn.client, request.error_status(), "application/json", false);
+    server_metrics.count_request(ServerMetrics::kError);
+    close_connection(conn);
+    return;
+  }
+
+  Serial.printf("Requisição: %s %s\n", request.method(), request.path());
+  Serial.printf("Body length: %ld\n", request.content_length());
 
-    if (!reading_body)
+  if (request.expect_continue())
+    conn.client.print("HTTP/1.1 100 Continue\r\n\r\n");
+
+  conn.state = kDiscardBody;
+  conn.request_start_us = micros();
+  conn.parse_us = 0;
+  conn.body_remaining = request.content_length();
+  conn.response_status = 200;
+  conn.error_message = "";
+  conn.image_count = 1;
+  conn.images_read = 0;
+  conn.images_done = 0;
+  conn.top_k = request.query_int("top_k", 0);
+
+  if (request.matches("POST", "/predict_raw"))
+  {
+    conn.route = kRoutePredictRaw;
+    if (read_image_size(conn))
     {
-      if (line.length() == 0)
+      if (conn.raw_body.begin(conn.body_remaining, conn.image_bytes,
+                              CIFAR10Model::kMaxRawImages) == RawImageBody::kError)
       {
-        reading_body = true;
-        break;
+        conn.error_message = conn.raw_body.error();
       }
-      if (request.length() == 0)
-        request = line;
-      if (line.startsWith("Content-Length:"))
-        content_length = line.substring(15).toInt();
+      conn.image_count = conn.raw_body.image_count();
     }
   }
+  else if (request.matches("POST", "/predict"))
+  {
+    conn.route = kRoutePredict;
+    read_image_size(conn);
+  }
+  else if (request.matches("GET", "/status"))
+  {
+    conn.route = kRouteStatus;
+  }
+  else if (request.matches("GET", "/metrics"))
+  {
+    conn.route = kRouteMetrics;
+  }
+  else
+  {
+    conn.route = kRouteHelp;
+  }
 
-  if (content_length > 0 && content_length < 150000) { // <<< MUDANÇA: Aumentar limite
-        body.reserve(content_length + 1);
-        unsigned long body_start = millis();
-        // <<< MUDANÇA: Aumentar timeout de leitura do body
-        while (body.length() < content_length && client.connected() && (millis() - body_start < 10000)) { 
-            if (client.available()) body += (char)client.read();
-            else delay(1);
-        }
+  if ((conn.route == kRoutePredict || conn.route == kRoutePredictRaw) && conn.error_message.length() == 0)
+  {
+    if (conn.top_k < 0 || conn.top_k > kMaxTopK)
+    {
+      conn.error_message = "top_k deve estar entre 0 e " + String(kMaxTopK);
+    }
+    else if (!cifar10_model.initialized)
+    {
+      conn.error_message = "Modelo não inicializado";
     }
+    else if (!start_image(conn))
+    {
+      conn.response_status = 503;
+      conn.error_message = "Fila de inferência cheia, tente novamente";
+      inference_queue.reject();
+    }
+    else
+    {
+      conn.state = kReadBody;
+    }
+  }
+  if (conn.error_message.length() > 0)
+    Serial.println("ERRO: " + conn.error_message);
+  conn.last_activity = millis();
+}
 
-  Serial.println("Requisição: " + request);
-  Serial.println("Body length: " + String(body.length()));
+// Tamanho das imagens da requisição, de ?width=W&height=H; sem eles, o da
+// entrada do modelo. Falso (com a mensagem de erro) se não couber no slot.
+bool read_image_size(ClientConnection &conn)
+{
+  conn.image_width = conn.request.query_int("width", CIFAR10Model::kInputWidth);
+  conn.image_height = conn.request.query_int("height", CIFAR10Model::kInputHeight);
+  conn.image_bytes = CIFAR10Model::kImageSize;
+  if (conn.image_width < 1 || conn.image_width > CIFAR10Model::kMaxSourceDimension ||
+      conn.image_height < 1 || conn.image_height > CIFAR10Model::kMaxSourceDimension ||
+      conn.image_width * conn.image_height * CIFAR10Model::kInputChannels > CIFAR10Model::kImageSize)
+  {
+    conn.error_message = "width e height devem estar entre 1 e " +
+                         String(CIFAR10Model::kMaxSourceDimension) + ", com no máximo " +
+                         String(CIFAR10Model::kInputWidth * CIFAR10Model::kInputHeight) + " pixels";
+    return false;
+  }
+  conn.image_bytes = conn.image_width * conn.image_height * CIFAR10Model::kInputChannels;
+  return true;
+}
 
-  String response_body = "";
-  String content_type = "text/html";
+bool resizing(const ClientConnection &conn)
+{
+  return conn.image_width != CIFAR10Model::kInputWidth ||
+         conn.image_height != CIFAR10Model::kInputHeight;
+}
 
-    if (request.startsWith("POST /predict"))
+// Reserva o slot que vai receber a próxima imagem da requisição.
+bool start_image(ClientConnection &conn)
+{
+  conn.filling_slot = inference_queue.acquire();
+  if (conn.filling_slot < 0)
+    return false;
+  InferenceJob &job = inference_jobs[conn.filling_slot];
+  job.width = conn.image_width;
+  job.height = conn.image_height;
+  job.top_k = conn.top_k;
+  if (conn.route == kRoutePredict)
   {
-    content_type = "application/json";
-    InferenceResult result;
-    
-    // Aloca na heap ao invés da stack
-    uint8_t* image_data = new (std::nothrow) uint8_t[CIFAR10Model::kImageSize];
+    // Imagem a redimensionar fica em uint8; a quantização vem depois.
+    conn.pixels.reset(job.input, conn.image_bytes,
+                      resizing(conn) ? nullptr : input_quantizer.table());
+  }
+  return true;
+}
+
+void submit_image(ClientConnection &conn)
+{
+  InferenceJob &job = inference_jobs[conn.filling_slot];
+  job.submitted_us = micros();
+  job.receive_us = job.submitted_us - conn.request_start_us;
+  conn.pending_slots[conn.images_read++] = conn.filling_slot;
+  inference_queue.submit(conn.filling_slot);
+  conn.filling_slot = -1;
+}
 
-    if (image_data == nullptr) {
-        result.success = false;
-        result.error_message = "Falha na alocacao de memoria para a imagem.";
-        Serial.println("ERRO: " + result.error_message);
-    } else {
-        String parse_error = parse_json_array(body, image_data);
+// Corpo inteiro lido: tempo de recepção e de decodificação da requisição.
+void record_body_metrics(ClientConnection &conn)
+{
+  server_metrics.record(ServerMetrics::kReceive, micros() - conn.request_start_us);
+  server_metrics.record(ServerMetrics::kParse, conn.parse_us);
+}
 
-        if (parse_error.length() > 0)
-        {
-          result.success = false;
-          result.error_message = parse_error;
-          result.predicted_class = -1;
-          result.confidence = 0.0f;
-          Serial.println("ERRO no parsing: " + parse_error);
-        }
-        else
-        {
-          Serial.println("=== EXECUTANDO INFERÊNCIA ===");
-          result = run_inference(image_data);
-          if (result.success)
-          {
-            Serial.println("=== RESULTADO ===");
-            Serial.printf("Predição: %d\n", result.predicted_class);
-            Serial.printf("Confiança: %.6f\n", result.confidence);
-            Serial.println("==================");
-          }
-          else
-          {
-            Serial.println("Falha na inferência: " + result.error_message);
-          }
-        }
-        // Libera a memória alocada na heap
-        delete[] image_data;
+// Bytes do corpo que já podem ser lidos. Se nada chega há kBodyTimeoutMs,
+// responde com erro, fecha a conexão e retorna -1.
+int body_bytes_available(ClientConnection &conn)
+{
+  int available = conn.client.available();
+  if (available > 0)
+  {
+    conn.last_activity = millis();
+    return min(available, conn.body_remaining);
+  }
+  if (millis() - conn.last_activity >= kBodyTimeoutMs)
+  {
+    if (conn.error_message.length() == 0)
+    {
+      conn.error_message = "Corpo incompleto: faltaram " + String(conn.body_remaining) + " bytes";
     }
-    
-    response_body = create_json_response(result);
+    Serial.println("ERRO: " + conn.error_message);
+    finish_request(conn);
+    return -1;
+  }
+  return 0;
+}
+
+// POST /predict: o PixelArrayParser grava os pixels já quantizados direto
+// na entrada do slot, à medida que o corpo chega.
+bool read_json_body(ClientConnection &conn)
+{
+  static char chunk[512];
+  if (conn.body_remaining > 0)
+  {
+    int n = body_bytes_available(conn);
+    if (n <= 0)
+      return n < 0;
+    n = conn.client.read(reinterpret_cast<uint8_t*>(chunk), min(n, (int)sizeof(chunk)));
+    if (n <= 0)
+      return false;
+    conn.body_remaining -= n;
+    const uint32_t parse_start_us = micros();
+    conn.pixels.feed(chunk, n);
+    conn.parse_us += micros() - parse_start_us;
+    if (conn.body_remaining > 0 && conn.pixels.status() != PixelArrayParser::kError)
+      return true;
   }
-  else if (request.startsWith("GET /status"))
+
+  if (conn.pixels.finish() == PixelArrayParser::kDone)
   {
-    content_type = "application/json";
-    InferenceResult status_result;
-    status_result.success = cifar10_model.initialized;
-    status_result.predicted_class = -1;
-    status_result.confidence = 0.0f;
-    status_result.error_message = cifar10_model.initialized ? "" : "Modelo não inicializado";
-    response_body = create_json_response(status_result);
+    record_body_metrics(conn);
+    submit_image(conn);
+    conn.state = kWaitResults;
   }
   else
   {
-    response_body = "<!DOCTYPE html><html><body><h1>CIFAR-10 API</h1><h2>Endpoints:</h2><p><b>POST /predict</b> - Body: {\"pixels\": [array de 3072 valores (32x32x3) 0-255]}</p><p><b>GET /status</b> - Status do sistema</p><p>IP: " + WiFi.localIP().toString() + "</p></body></html>";
+    conn.error_message = conn.pixels.error();
+    Serial.println("ERRO no parsing: " + conn.error_message);
+    release_slots(conn);
+    conn.state = kDiscardBody;
   }
+  return true;
+}
 
-  client.println("HTTP/1.1 200 OK");
-  client.println("Content-Type: " + content_type);
-  client.println("Access-Control-Allow-Origin: *");
-  client.println("Connection: close");
-  client.println("Content-Length: " + String(response_body.length()));
-  client.println();
-  client.print(response_body);
-  client.flush();
-  delay(100);
-  client.stop();
-  Serial.println("Cliente desconectado\n");
+// POST /predict_raw: o corpo são image_bytes por imagem (pixels 0..255 em
+// HWC, como no array de /predict), de 1 a kMaxRawImages imagens. Cada
+// imagem é lida direto no seu slot e submetida assim que completa, então as
+// primeiras já estão sendo inferidas enquanto as seguintes chegam. Se os
+// slots acabarem no meio do lote, a leitura espera um deles voltar.
+bool read_raw_body(ClientConnection &conn)
+{
+  bool progress = collect_results(conn);
+  if (conn.filling_slot < 0 && !start_image(conn))
+    return progress;
+
+  int n = body_bytes_available(conn);
+  if (n <= 0)
+    return progress || n < 0;
+  int8_t *input = inference_jobs[conn.filling_slot].input + conn.raw_body.filled();
+  n = conn.client.read(reinterpret_cast<uint8_t*>(input), conn.raw_body.want(n));
+  if (n <= 0)
+    return progress;
+  if (!resizing(conn))
+  {
+    const uint32_t parse_start_us = micros();
+    input_quantizer.apply(input, n);
+    conn.parse_us += micros() - parse_start_us;
+  }
+  conn.body_remaining -= n;
+
+  const RawImageBody::Status status = conn.raw_body.consume(n);
+  if (status == RawImageBody::kImageDone || status == RawImageBody::kDone)
+  {
+    const bool last_image = status == RawImageBody::kDone;
+    if (last_image)
+      record_body_metrics(conn);
+    submit_image(conn);
+    if (last_image)
+      conn.state = kWaitResults;
+  }
+  return true;
 }
 
-String parse_json_array(String json_data, uint8_t *image_array)
+// Descarta o corpo que não será usado e responde.
+bool discard_body(ClientConnection &conn)
 {
-  int start_index = json_data.indexOf("\"pixels\":");
-  if (start_index == -1)
-    return "Campo 'pixels' não encontrado";
+  if (conn.body_remaining > 0)
+  {
+    uint8_t chunk[64];
+    int n = body_bytes_available(conn);
+    if (n <= 0)
+      return n < 0;
+    n = conn.client.read(chunk, min(n, (int)sizeof(chunk)));
+    if (n > 0)
+      conn.body_remaining -= n;
+    if (conn.body_remaining > 0)
+      return true;
+  }
+  finish_request(conn);
+  return true;
+}
 
-  start_index = json_data.indexOf('[', start_index);
-  if (start_index == -1)
-    return "Array de pixels não encontrado";
+// Copia os resultados já prontos, na ordem das imagens, e devolve os slots.
+bool collect_results(ClientConnection &conn)
+{
+  bool progress = false;
+  while (conn.images_done < conn.images_read &&
+         inference_queue.done(conn.pending_slots[conn.images_done]))
+  {
+    const int slot = conn.pending_slots[conn.images_done];
+    conn.results[conn.images_done++] = inference_jobs[slot].result;
+    inference_queue.release(slot);
+    progress = true;
+  }
+  return progress;
+}
 
-  int end_index = json_data.indexOf(']', start_index);
-  if (end_index == -1)
-    return "Fim do array não encontrado";
+bool wait_results(ClientConnection &conn)
+{
+  bool progress = collect_results(conn);
+  if (conn.images_done < conn.image_count)
+    return progress;
+  finish_request(conn);
+  return true;
+}
 
-  String array_content = json_data.substring(start_index + 1, end_index);
-  int pixel_count = 0;
-  int current_pos = 0;
+// Devolve os slots que a requisição ainda segura. Os que estão na fila ou
+// em execução voltam a ficar livres quando a inferência terminar.
+void release_slots(ClientConnection &conn)
+{
+  if (conn.filling_slot >= 0)
+  {
+    inference_queue.release(conn.filling_slot);
+    conn.filling_slot = -1;
+  }
+  while (conn.images_done < conn.images_read)
+  {
+    inference_queue.release(conn.pending_slots[conn.images_done++]);
+  }
+}
 
-  while (current_pos < array_content.length() && pixel_count < CIFAR10Model::kImageSize)
+// Resultado da requisição para classifier_requests_total.
+ServerMetrics::Outcome request_outcome(const ClientConnection &conn)
+{
+  if (conn.response_status == 503)
+    return ServerMetrics::kRejected;
+  if (conn.error_message.length() > 0)
+    return ServerMetrics::kError;
+  if (conn.route == kRoutePredict || conn.route == kRoutePredictRaw)
   {
-    while (current_pos < array_content.length() && isspace(array_content.charAt(current_pos)))
+    for (int i = 0; i < conn.image_count; ++i)
     {
-      current_pos++;
+      if (!conn.results[i].success)
+        return ServerMetrics::kFailed;
     }
-    if (current_pos >= array_content.length())
-      break;
+  }
+  return ServerMetrics::kOk;
+}
 
-    int comma_pos = array_content.indexOf(',', current_pos);
-    String value_str = (comma_pos == -1) ? array_content.substring(current_pos) : array_content.substring(current_pos, comma_pos);
-    value_str.trim();
+// Responde à requisição atual. A conexão só continua aberta se o cliente
+// pediu e o corpo foi consumido por inteiro; senão a próxima requisição
+// começaria no meio dele.
+void finish_request(ClientConnection &conn)
+{
+  release_slots(conn);
 
-    bool is_valid_number = (value_str.length() > 0);
-    for (int i = 0; i < value_str.length() && is_valid_number; i++)
+  const uint32_t send_start_us = micros();
+  const char *content_type = "application/json";
+  response_writer.reset();
+  if (conn.route == kRouteStatus)
+  {
+    write_status_response(response_writer);
+  }
+  else if (conn.route == kRouteMetrics)
+  {
+    content_type = "text/plain; version=0.0.4; charset=utf-8";
+    write_metrics(response_writer);
+  }
+  else if (conn.route == kRouteHelp)
+  {
+    content_type = "text/html";
+    write_help_page(response_writer);
+  }
+  else if (conn.error_message.length() > 0)
+  {
+    InferenceResult error = {-1, 0.0f, false, conn.error_message};
+    write_json_response(response_writer, error);
+  }
+  else
+  {
+    for (int i = 0; i < conn.image_count; ++i)
     {
-      if (!isdigit(value_str.charAt(i)))
-        is_valid_number = false;
+      Serial.printf("Imagem %d: predição %d, confiança %.6f\n",
+                    i, conn.results[i].predicted_class, conn.results[i].confidence);
     }
-
-    if (!is_valid_number)
+    if (conn.image_count == 1)
     {
-      return "Valor inválido no índice " + String(pixel_count) + ": '" + value_str + "'";
+      write_json_response(response_writer, conn.results[0]);
     }
+    else
+    {
+      write_batch_json_response(response_writer, conn.results, conn.image_count);
+    }
+  }
 
-    int pixel_value = value_str.toInt();
-    image_array[pixel_count] = (uint8_t)constrain(pixel_value, 0, 255);
-    pixel_count++;
+  bool keep_alive = conn.request.keep_alive() && conn.body_remaining == 0;
+  send_response(conn.client, conn.response_status, content_type, keep_alive);
+  server_metrics.record(ServerMetrics::kSend, micros() - send_start_us);
+  server_metrics.count_request(request_outcome(conn));
+  conn.request_count++;
 
-    if (comma_pos == -1)
-      break;
-    current_pos = comma_pos + 1;
+  if (keep_alive)
+  {
+    conn.state = kReadHeaders;
+    conn.request.reset();
+    conn.last_activity = millis();
   }
-
-  if (pixel_count != CIFAR10Model::kImageSize)
+  else
   {
-    return "Array deve ter " + String(CIFAR10Model::kImageSize) + " valores, recebido: " + String(pixel_count);
+    close_connection(conn);
   }
-  return "";
+}
+
+void close_connection(ClientConnection &conn)
+{
+  release_slots(conn);
+  conn.client.stop();
+  conn.active = false;
+  Serial.printf("Cliente desconectado (%d requisições)\n\n", conn.request_count);
+}
+
+// Fecha a resposta montada em response_writer e a envia num único write,
+// em vez de uma escrita por header.
+void send_response(WiFiClient &client, int status, const char *content_type, bool keep_alive)
+{
+  response_writer.finish(status, content_type, keep_alive);
+  client.write(reinterpret_cast<const uint8_t*>(response_writer.data()), response_writer.size());
 }
 
 void setup()
@@ -485,7 +1132,7 @@ void setup()
     ESP.restart();
   }
 
-  if (!initialize_cifar10_model())
+  if (!initialize_cifar10_model() || !start_inference_task())
   {
     Serial.println("Falha na inicialização do modelo! Parando.");
     while (true)
@@ -505,6 +1152,14 @@ void loop()
     Serial.println("WiFi desconectado - tentando reconectar...");
     connect_wifi();
   }
-  handle_client();
-  delay(10);
-}
\ No newline at end of file
+
+  accept_clients();
+  bool progress = false;
+  for (ClientConnection &conn : connections)
+  {
+    if (conn.active)
+      progress |= service_connection(conn);
+  }
+  if (!progress)
+    delay(1);
+}
@@ -0,0 +1,187 @@
+import argparse
+import socket
+import threading
+import time
+import numpy as np
+
+ESP32_IP = "192.168.0.111"
+ESP32_PORT = 80
+RAW_IMAGE_SIZE = 96 * 96 * 3
+REQUEST_TIMEOUT = 10
+
+
+def build_request(path, body, keep_alive):
+    method = "POST" if body else "GET"
+    lines = [
+        f"{method} {path} HTTP/1.1",
+        f"Host: {ESP32_IP}",
+        f"Connection: {'keep-alive' if keep_alive else 'close'}",
+    ]
+    if body:
+        lines.append("Content-Type: application/octet-stream")
+        lines.append(f"Content-Length: {len(body)}")
+    return ("\r\n".join(lines) + "\r\n\r\n").encode() + body
+
+
+class ResponseReader:
+    """Reads Content-Length framed HTTP responses from a socket."""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.buffer = b""
+
+    def _fill(self):
+        data = self.sock.recv(65536)
+        if not data:
+            raise ConnectionError("connection closed by server")
+        self.buffer += data
+
+    def read_response(self):
+        while b"\r\n\r\n" not in self.buffer:
+            self._fill()
+        head, self.buffer = self.buffer.split(b"\r\n\r\n", 1)
+        lines = head.decode("latin-1").split("\r\n")
+        status = int(lines[0].split()[1])
+        headers = {}
+        for line in lines[1:]:
+            name, _, value = line.partition(":")
+            headers[name.strip().lower()] = value.strip()
+        if status == 100:
+            return self.read_response()
+        length = int(headers.get("content-length", 0))
+        while len(self.buffer) < length:
+            self._fill()
+        body, self.buffer = self.buffer[:length], self.buffer[length:]
+        return status, headers, body
+
+
+def connect(host, port):
+    sock = socket.create_connection((host, port), timeout=REQUEST_TIMEOUT)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    return sock
+
+
+def run_close(host, port, request, count):
+    """One TCP connection per request, as before keep-alive."""
+    latencies = []
+    for _ in range(count):
+        start = time.perf_counter()
+        with connect(host, port) as sock:
+            sock.sendall(request)
+            status, _, _ = ResponseReader(sock).read_response()
+        latencies.append(time.perf_counter() - start)
+        if status != 200:
+            raise RuntimeError(f"HTTP {status}")
+    return latencies
+
+
+def run_keep_alive(host, port, request, count):
+    """Sequential requests on a single persistent connection."""
+    latencies = []
+    with connect(host, port) as sock:
+        reader = ResponseReader(sock)
+        for _ in range(count):
+            start = time.perf_counter()
+            sock.sendall(request)
+            status, headers, _ = reader.read_response()
+            latencies.append(time.perf_counter() - start)
+            if status != 200:
+                raise RuntimeError(f"HTTP {status}")
+            if headers.get("connection", "").lower() == "close":
+                raise RuntimeError("server closed the keep-alive connection")
+    return latencies
+
+
+def run_pipelined(host, port, request, count, depth):
+    """Keeps up to `depth` requests in flight on a single connection."""
+    latencies = []
+    sent_at = []
+    with connect(host, port) as sock:
+        reader = ResponseReader(sock)
+        sent = 0
+        while len(latencies) < count:
+            while sent < count and sent - len(latencies) < depth:
+                sock.sendall(request)
+                sent_at.append(time.perf_counter())
+                sent += 1
+            status, _, _ = reader.read_response()
+            latencies.append(time.perf_counter() - sent_at[len(latencies)])
+            if status != 200:
+                raise RuntimeError(f"HTTP {status}")
+    return latencies
+
+
+def run_concurrent(host, port, request, count, connections):
+    """Several keep-alive connections at once, so requests overlap in the
+    server's inference queue. 503 (queue full) is counted, not fatal."""
+    latencies = []
+    rejected = [0]
+    lock = threading.Lock()
+
+    def worker(requests):
+        with connect(host, port) as sock:
+            reader = ResponseReader(sock)
+            for _ in range(requests):
+                start = time.perf_counter()
+                sock.sendall(request)
+                status, _, _ = reader.read_response()
+                elapsed = time.perf_counter() - start
+                with lock:
+                    if status == 503:
+                        rejected[0] += 1
+                    elif status != 200:
+                        raise RuntimeError(f"HTTP {status}")
+                    else:
+                        latencies.append(elapsed)
+
+    threads = [threading.Thread(target=worker, args=(count // connections,)) for _ in range(connections)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    if rejected[0]:
+        print(f"{rejected[0]} requests rejected with 503 (inference queue full)")
+    return latencies
+
+
+def report(name, latencies, elapsed):
+    ms = np.array(latencies) * 1000
+    print(f"{name:12s} {len(ms):5d} req | {len(ms) / elapsed:8.1f} req/s | "
+          f"p50 {np.percentile(ms, 50):7.2f} ms | p95 {np.percentile(ms, 95):7.2f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load generator for the classifier HTTP server")
+    parser.add_argument("--host", default=ESP32_IP)
+    parser.add_argument("--port", type=int, default=ESP32_PORT)
+    parser.add_argument("--path", default="/status", help="GET path, or POST path when --raw-size > 0")
+    parser.add_argument("--raw-size", type=int, default=0,
+                        help=f"POST this many random bytes (e.g. {RAW_IMAGE_SIZE} for /predict_raw)")
+    parser.add_argument("--count", type=int, default=100)
+    parser.add_argument("--depth", type=int, default=4, help="requests in flight when pipelining")
+    parser.add_argument("--connections", type=int, default=4, help="parallel connections in concurrent mode")
+    parser.add_argument("--modes", default="close,keepalive,pipeline,concurrent")
+    args = parser.parse_args()
+
+    body = np.random.randint(0, 256, args.raw_size, dtype=np.uint8).tobytes() if args.raw_size else b""
+    print(f"{args.count} requests to {args.host}:{args.port}{args.path} (body {len(body)} bytes)")
+
+    for mode in args.modes.split(","):
+        start = time.perf_counter()
+        if mode == "close":
+            latencies = run_close(args.host, args.port, build_request(args.path, body, False), args.count)
+        elif mode == "keepalive":
+            latencies = run_keep_alive(args.host, args.port, build_request(args.path, body, True), args.count)
+        elif mode == "pipeline":
+            latencies = run_pipelined(args.host, args.port, build_request(args.path, body, True),
+                                      args.count, args.depth)
+        elif mode == "concurrent":
+            latencies = run_concurrent(args.host, args.port, build_request(args.path, body, True),
+                                       args.count, args.connections)
+        else:
+            raise SystemExit(f"unknown mode: {mode}")
+        report(mode, latencies, time.perf_counter() - start)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,7 @@
+import argparse
 import requests
 import json
+import time
 import numpy as np
 import matplotlib.pyplot as plt
 import tensorflow as tf
@@ -13,7 +15,10 @@ logging.getLogger('tensorflow').setLevel(logging.ERROR)
 
 ESP32_IP = "192.168.0.111"
 PREDICT_URL = f"http://{ESP32_IP}/predict"
+PREDICT_RAW_URL = f"http://{ESP32_IP}/predict_raw"
 REQUEST_TIMEOUT = 10
+# Sent with the original 32x32 image so the ESP32 resizes it to 96x96.
+NATIVE_SIZE_QUERY = "?width=32&height=32"
 
 CLASS_NAMES = [
     "airplane", "automobile", "bird", "cat", "deer",
@@ -50,6 +55,67 @@ def send_image_for_inference(url, image_data):
         print(f"An unexpected error occurred: {e}")
         return None
 
+def send_image_raw(url, image_data):
+    """Sends one uint8 HWC image, or a batch of them stacked on axis 0, as
+    raw bytes to /predict_raw."""
+    try:
+        payload = np.ascontiguousarray(image_data, dtype=np.uint8).tobytes()
+        headers = {"Content-Type": "application/octet-stream"}
+
+        response = requests.post(
+            url,
+            data=payload,
+            headers=headers,
+            timeout=REQUEST_TIMEOUT
+        )
+
+        response.raise_for_status()
+        return response.json()
+
+    except requests.exceptions.RequestException as e:
+        print(f"Error connecting to ESP32: {e}")
+        return None
+    except Exception as e:
+        print(f"An unexpected error occurred: {e}")
+        return None
+
+def resize_on_client(image):
+    resized_image_tensor = tf.image.resize(image, [96, 96], method=tf.image.ResizeMethod.NEAREST_NEIGHBOR)
+    return tf.cast(resized_image_tensor, tf.uint8).numpy()
+
+def compare_latency(original_image, runs):
+    """Times /predict (JSON) and /predict_raw with the image resized to 96x96
+    on the client and with the original 32x32 image resized on the ESP32."""
+    resized_image = resize_on_client(original_image)
+    endpoints = [
+        ("JSON, 96x96", PREDICT_URL, send_image_for_inference, resized_image),
+        ("JSON, 32x32", PREDICT_URL + NATIVE_SIZE_QUERY, send_image_for_inference, original_image),
+        ("raw, 96x96", PREDICT_RAW_URL, send_image_raw, resized_image),
+        ("raw, 32x32", PREDICT_RAW_URL + NATIVE_SIZE_QUERY, send_image_raw, original_image),
+    ]
+
+    print(f"Comparing request latency over {runs} runs per endpoint...")
+    for name, url, send, image in endpoints:
+        if send is send_image_raw:
+            payload_size = image.size
+        else:
+            payload_size = len(json.dumps({"pixels": image.flatten().tolist()}))
+        latencies = []
+        for _ in range(runs):
+            start = time.perf_counter()
+            result = send(url, image)
+            elapsed_ms = (time.perf_counter() - start) * 1000
+            if result and result.get("success"):
+                latencies.append(elapsed_ms)
+        if not latencies:
+            print(f"{name:18s} all requests failed")
+            continue
+        print(f"{name:18s} payload {payload_size:6d} bytes | "
+              f"mean {np.mean(latencies):7.1f} ms | "
+              f"median {np.median(latencies):7.1f} ms | "
+              f"min {np.min(latencies):7.1f} ms | "
+              f"ok {len(latencies)}/{runs}")
+
 def plot_prediction(image, true_name, predicted_name, confidence):
     plt.figure(figsize=(4, 4))
     plt.imshow(image)
@@ -58,17 +124,36 @@ def plot_prediction(image, true_name, predicted_name, confidence):
     plt.show()
 
 def main():
-    image_index = 22
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--index", type=int, default=22, help="CIFAR-10 test image index")
+    parser.add_argument("--json", action="store_true", help="use /predict (JSON) instead of /predict_raw")
+    parser.add_argument("--compare", type=int, metavar="RUNS",
+                        help="compare /predict and /predict_raw latency, resized on the client and on the ESP32")
+    parser.add_argument("--client-resize", action="store_true",
+                        help="resize to 96x96 before sending instead of letting the ESP32 do it")
+    args = parser.parse_args()
+
+    image_index = args.index
     
     original_image, true_label_index, true_label_name = get_cifar10_sample(image_index)
 
-    print("Resizing image from 32x32 to 96x96 for the model...")
-    resized_image_tensor = tf.image.resize(original_image, [96, 96], method=tf.image.ResizeMethod.NEAREST_NEIGHBOR)
-    resized_image_uint8 = tf.cast(resized_image_tensor, tf.uint8).numpy()
-    
-    print(f"Sending resized image {image_index} ({true_label_name}) to {PREDICT_URL}...")
+    if args.compare:
+        compare_latency(original_image, args.compare)
+        return
+
+    url = PREDICT_URL if args.json else PREDICT_RAW_URL
+    if args.client_resize:
+        print("Resizing image from 32x32 to 96x96 for the model...")
+        image = resize_on_client(original_image)
+    else:
+        url += NATIVE_SIZE_QUERY
+        image = original_image
+    print(f"Sending image {image_index} ({true_label_name}) to {url}...")
     
-    result = send_image_for_inference(PREDICT_URL, resized_image_uint8)
+    if args.json:
+        result = send_image_for_inference(url, image)
+    else:
+        result = send_image_raw(url, image)
 
     if not result:
         print("Inference failed.")
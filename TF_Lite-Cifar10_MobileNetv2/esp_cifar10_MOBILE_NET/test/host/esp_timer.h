@@ -0,0 +1,16 @@
+// Substituto do esp_timer.h do ESP-IDF para o env native (pio test -e
+// native). Os kernels em esp_nn/ medem o próprio tempo com
+// esp_timer_get_time(); no host o relógio monotônico faz o mesmo papel.
+#ifndef TEST_HOST_ESP_TIMER_H_
+#define TEST_HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+#endif  // TEST_HOST_ESP_TIMER_H_
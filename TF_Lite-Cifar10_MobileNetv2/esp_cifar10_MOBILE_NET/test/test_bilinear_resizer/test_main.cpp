@@ -0,0 +1,296 @@
+// BilinearResizer contra o tf.image.resize do treino (bilinear com
+// half_pixel_centers e sem antialias), reescrito em float como no
+// resize_bilinear do TensorFlow: cada pixel redimensionado e arredondado
+// para 0..255 fica a no máximo 1 LSB da referência, e o tamanho de
+// entrada igual ao de saída é uma cópia exata. Mede também o upload
+// pequeno com o redimensionamento no servidor contra o upload já
+// redimensionado (96x96x3) que só passa pela tabela de quantização.
+#include <unity.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "bilinear_resizer.h"
+#include "input_quantizer.h"
+
+namespace {
+
+std::mt19937 rng(47);
+
+const int kOutputSize = 96;
+const int kChannels = 3;
+
+// Tabela identidade deslocada: o int8 de saída é o valor 0..255 - 128,
+// para comparar o valor interpolado antes da quantização.
+struct IdentityTable {
+  int8_t values[256];
+  IdentityTable() {
+    for (int i = 0; i < 256; ++i) values[i] = static_cast<int8_t>(i - 128);
+  }
+};
+
+// tf.image.resize(method="bilinear") em float, como o resize_bilinear do
+// TensorFlow com half_pixel_centers: a origem de d é (d + 0.5) * in / out -
+// 0.5, o vizinho de baixo é floor() limitado a 0 e o de cima ceil()
+// limitado à borda.
+void reference_resize(const uint8_t* input, int in_width, int in_height,
+                      int out_width, int out_height, int channels,
+                      float* output) {
+  const float height_scale = static_cast<float>(in_height) / out_height;
+  const float width_scale = static_cast<float>(in_width) / out_width;
+  for (int y = 0; y < out_height; ++y) {
+    const float in_y = (y + 0.5f) * height_scale - 0.5f;
+    const float y_floor = floorf(in_y);
+    const int top = std::max(static_cast<int>(y_floor), 0);
+    const int bottom = std::min(static_cast<int>(ceilf(in_y)), in_height - 1);
+    const float y_lerp = in_y - y_floor;
+    for (int x = 0; x < out_width; ++x) {
+      const float in_x = (x + 0.5f) * width_scale - 0.5f;
+      const float x_floor = floorf(in_x);
+      const int left = std::max(static_cast<int>(x_floor), 0);
+      const int right = std::min(static_cast<int>(ceilf(in_x)), in_width - 1);
+      const float x_lerp = in_x - x_floor;
+      for (int c = 0; c < channels; ++c) {
+        auto at = [&](int row, int column) {
+          return static_cast<float>(
+              input[(row * in_width + column) * channels + c]);
+        };
+        const float top_value =
+            at(top, left) + (at(top, right) - at(top, left)) * x_lerp;
+        const float bottom_value =
+            at(bottom, left) + (at(bottom, right) - at(bottom, left)) * x_lerp;
+        *output++ = top_value + (bottom_value - top_value) * y_lerp;
+      }
+    }
+  }
+}
+
+std::vector<uint8_t> random_image(int width, int height, int channels,
+                                  bool smooth) {
+  std::vector<uint8_t> image(width * height * channels);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      for (int c = 0; c < channels; ++c) {
+        // Ruído puro e um gradiente com ruído, mais parecido com foto.
+        const int noise = static_cast<int>(rng() % 256);
+        const int value =
+            smooth ? (x * 255 / width + y * 128 / height + noise / 8) % 256
+                   : noise;
+        image[(y * width + x) * channels + c] = static_cast<uint8_t>(value);
+      }
+    }
+  }
+  return image;
+}
+
+struct ResizeStats {
+  int max_error;
+  long exact;
+  long total;
+};
+
+// Redimensiona `image` e compara cada valor com a referência arredondada.
+ResizeStats compare_with_reference(BilinearResizer& resizer,
+                                   const std::vector<uint8_t>& image,
+                                   int in_width, int in_height, int out_width,
+                                   int out_height, int channels) {
+  static const IdentityTable identity;
+  const int size = out_width * out_height * channels;
+  std::vector<int8_t> output(size);
+  std::vector<float> expected(size);
+  TEST_ASSERT_TRUE(
+      resizer.configure(in_width, in_height, out_width, out_height, channels));
+  TEST_ASSERT_TRUE(resizer.configured_for(in_width, in_height));
+  resizer.resize(image.data(), output.data(), identity.values);
+  reference_resize(image.data(), in_width, in_height, out_width, out_height,
+                   channels, expected.data());
+
+  ResizeStats stats = {0, 0, size};
+  for (int i = 0; i < size; ++i) {
+    const int actual = output[i] + 128;
+    const int rounded = static_cast<int>(lroundf(expected[i]));
+    const int error = abs(actual - rounded);
+    if (error > 1) {
+      char message[128];
+      snprintf(message, sizeof(message),
+               "%dx%d -> %dx%d, %d canais, índice %d: %d, referência %.3f",
+               in_width, in_height, out_width, out_height, channels, i,
+               actual, expected[i]);
+      TEST_FAIL_MESSAGE(message);
+    }
+    stats.max_error = std::max(stats.max_error, error);
+    if (error == 0) ++stats.exact;
+  }
+  return stats;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Os tamanhos que os clientes mandam para a MobileNetV2 (CIFAR-10 32x32,
+// MNIST 28x28, 64x64, o próprio 96x96 e 128x128 reduzido), mais
+// combinações aleatórias de largura, altura e canais nos dois sentidos.
+void test_within_one_lsb_of_tf_resize() {
+  BilinearResizer resizer;
+  const int kSources[] = {32, 28, 64, 96, 128, 1, 2, 95, 97};
+  ResizeStats total = {0, 0, 0};
+  for (int source : kSources) {
+    for (bool smooth : {false, true}) {
+      const std::vector<uint8_t> image =
+          random_image(source, source, kChannels, smooth);
+      const ResizeStats stats =
+          compare_with_reference(resizer, image, source, source, kOutputSize,
+                                 kOutputSize, kChannels);
+      total.max_error = std::max(total.max_error, stats.max_error);
+      total.exact += stats.exact;
+      total.total += stats.total;
+    }
+  }
+  std::uniform_int_distribution<int> dimension(1, BilinearResizer::kMaxDimension);
+  for (int trial = 0; trial < 100; ++trial) {
+    const int in_width = dimension(rng);
+    const int in_height = dimension(rng);
+    const int out_width = dimension(rng);
+    const int out_height = dimension(rng);
+    const int channels = 1 + trial % BilinearResizer::kMaxChannels;
+    const std::vector<uint8_t> image =
+        random_image(in_width, in_height, channels, trial % 2 == 0);
+    const ResizeStats stats = compare_with_reference(
+        resizer, image, in_width, in_height, out_width, out_height, channels);
+    total.max_error = std::max(total.max_error, stats.max_error);
+    total.exact += stats.exact;
+    total.total += stats.total;
+  }
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%ld valores: erro máximo %d LSB, %.2f%% iguais à referência",
+           total.total, total.max_error, 100.0 * total.exact / total.total);
+  TEST_MESSAGE(line);
+}
+
+// Mesmo tamanho na entrada e na saída: cópia exata pela tabela.
+void test_same_size_is_exact_copy() {
+  BilinearResizer resizer;
+  InputQuantizer quantizer;
+  quantizer.build(InputQuantizer::kSymmetricRange, 0.00784313772f, -1);
+  const std::vector<uint8_t> image =
+      random_image(kOutputSize, kOutputSize, kChannels, false);
+  std::vector<int8_t> resized(image.size());
+  std::vector<int8_t> quantized(image.size());
+  TEST_ASSERT_TRUE(resizer.configure(kOutputSize, kOutputSize, kOutputSize,
+                                     kOutputSize, kChannels));
+  resizer.resize(image.data(), resized.data(), quantizer.table());
+  quantizer.apply(image.data(), quantized.data(), image.size());
+  TEST_ASSERT_EQUAL_INT8_ARRAY(quantized.data(), resized.data(), image.size());
+}
+
+void test_rejects_invalid_dimensions() {
+  BilinearResizer resizer;
+  const int max = BilinearResizer::kMaxDimension;
+  TEST_ASSERT_FALSE(resizer.configure(0, 32, 96, 96, 3));
+  TEST_ASSERT_FALSE(resizer.configure(32, max + 1, 96, 96, 3));
+  TEST_ASSERT_FALSE(resizer.configure(32, 32, max + 1, 96, 3));
+  TEST_ASSERT_FALSE(resizer.configure(32, 32, 96, 0, 3));
+  TEST_ASSERT_FALSE(resizer.configure(32, 32, 96, 96, 0));
+  TEST_ASSERT_FALSE(resizer.configure(32, 32, 96, 96, BilinearResizer::kMaxChannels + 1));
+  TEST_ASSERT_FALSE(resizer.configured_for(32, 32));
+  // Sem configuração válida, resize() não escreve nada.
+  int8_t output[4] = {1, 2, 3, 4};
+  const uint8_t input[4] = {0};
+  const IdentityTable identity;
+  resizer.resize(input, output, identity.values);
+  TEST_ASSERT_EQUAL_INT8(1, output[0]);
+  TEST_ASSERT_TRUE(resizer.configure(max, max, 1, 1, 1));
+}
+
+// Upload de 32x32x3 redimensionado no servidor contra o upload de 96x96x3
+// já redimensionado pelo cliente, que só passa pelo InputQuantizer::apply.
+// O primeiro manda 9x menos bytes pela rede; o custo no servidor é o
+// resize() no lugar do apply().
+void test_benchmark_against_pre_resized_upload() {
+  BilinearResizer resizer;
+  InputQuantizer quantizer;
+  quantizer.build(InputQuantizer::kSymmetricRange, 0.00784313772f, -1);
+  const int kIterations = 2000;
+  const int output_size = kOutputSize * kOutputSize * kChannels;
+  std::vector<int8_t> output(output_size);
+  volatile int8_t sink = 0;
+
+  for (int source : {32, 64}) {
+    const std::vector<uint8_t> small = random_image(source, source, kChannels, true);
+    TEST_ASSERT_TRUE(resizer.configure(source, source, kOutputSize, kOutputSize,
+                                       kChannels));
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < kIterations; ++n) {
+      resizer.resize(small.data(), output.data(), quantizer.table());
+      sink = output[n % output_size];
+    }
+    const double resize_us = std::chrono::duration<double, std::micro>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             kIterations;
+
+    std::vector<float> reference(output_size);
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < kIterations / 10; ++n) {
+      reference_resize(small.data(), source, source, kOutputSize, kOutputSize,
+                       kChannels, reference.data());
+      sink = static_cast<int8_t>(reference[n % output_size]);
+    }
+    const double float_us = std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - start)
+                                .count() /
+                            (kIterations / 10);
+
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%dx%d (%d bytes) -> 96x96: resize %.1f us (float %.1f us)",
+             source, source, static_cast<int>(small.size()), resize_us, float_us);
+    TEST_MESSAGE(line);
+  }
+
+  const std::vector<uint8_t> large =
+      random_image(kOutputSize, kOutputSize, kChannels, true);
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < kIterations; ++n) {
+    quantizer.apply(large.data(), output.data(), output_size);
+    sink = output[n % output_size];
+  }
+  const double apply_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          kIterations;
+  (void)sink;
+  char line[128];
+  snprintf(line, sizeof(line), "96x96 já redimensionado (%d bytes): apply %.1f us",
+           output_size, apply_us);
+  TEST_MESSAGE(line);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_within_one_lsb_of_tf_resize);
+  RUN_TEST(test_same_size_is_exact_copy);
+  RUN_TEST(test_rejects_invalid_dimensions);
+  RUN_TEST(test_benchmark_against_pre_resized_upload);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
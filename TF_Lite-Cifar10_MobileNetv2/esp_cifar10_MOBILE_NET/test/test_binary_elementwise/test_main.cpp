@@ -0,0 +1,598 @@
+// int8 ADD, SUB, MUL and SQUARED_DIFFERENCE kernels, which go through
+// optimized_integer_ops::BinaryElementwise (binary_elementwise.h) with the
+// scaled-input tables their Prepare fills, against the reference functions
+// they called before, with ArithmeticParams computed the way each Prepare
+// does. Covers every broadcast category ProcessBroadcastShapes produces
+// (either input broadcast, per-channel and per-pixel runs, scalars, and the
+// generic case that falls back to the reference), outputs below
+// kScaledInputTableMinElements, and a timing comparison on MobileNetV2-style
+// residual and per-channel shapes.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/binary_function.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/mul.h"
+#include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
+#include "tensorflow/lite/kernels/internal/reference/sub.h"
+#include "tensorflow/lite/micro/arena_allocator/single_arena_buffer_allocator.h"
+#include "tensorflow/lite/micro/fake_micro_context.h"
+#include "tensorflow/lite/micro/kernels/micro_ops.h"
+#include "tensorflow/lite/micro/micro_context.h"
+#include "tensorflow/lite/micro/mock_micro_graph.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+
+namespace {
+
+std::mt19937 rng(28);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+enum class Op { kAdd, kSub, kMul, kSquaredDifference };
+
+const char* OpName(Op op) {
+  switch (op) {
+    case Op::kAdd:
+      return "ADD";
+    case Op::kSub:
+      return "SUB";
+    case Op::kMul:
+      return "MUL";
+    case Op::kSquaredDifference:
+      return "SQUARED_DIFFERENCE";
+  }
+  return "";
+}
+
+// The int8 function squared_difference.cc hands to the reference broadcast
+// loop (it lives in that file's anonymous namespace).
+int8_t SquaredDifference(int8_t x, int8_t y,
+                         const tflite::ArithmeticParams& params) {
+  const int32_t shifted_input1_val =
+      (params.input1_offset + x) * (1 << params.left_shift);
+  const int32_t shifted_input2_val =
+      (params.input2_offset + y) * (1 << params.left_shift);
+  const int32_t scaled_input1_val =
+      tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(
+          shifted_input1_val, params.input1_multiplier, params.input1_shift);
+  const int32_t scaled_input2_val =
+      tflite::MultiplyByQuantizedMultiplierSmallerThanOneExp(
+          shifted_input2_val, params.input2_multiplier, params.input2_shift);
+  const int32_t raw_diff = scaled_input1_val - scaled_input2_val;
+  const int32_t raw_output =
+      tflite::MultiplyByQuantizedMultiplier(raw_diff * raw_diff,
+                                            params.output_multiplier,
+                                            params.output_shift) +
+      params.output_offset;
+  return static_cast<int8_t>(
+      std::min(params.quantized_activation_max,
+               std::max(params.quantized_activation_min, raw_output)));
+}
+
+struct BinaryCase {
+  Op op;
+  std::vector<int32_t> input1_dims, input2_dims, output_dims;
+  float input1_scale, input2_scale, output_scale;
+  int32_t input1_zero_point, input2_zero_point, output_zero_point;
+  TfLiteFusedActivation activation;
+  std::vector<int8_t> input1;
+  std::vector<int8_t> input2;
+
+  BinaryCase(Op op, const std::vector<int32_t>& input1_dims,
+             const std::vector<int32_t>& input2_dims)
+      : op(op),
+        input1_dims(input1_dims),
+        input2_dims(input2_dims),
+        output_dims(input1_dims.size()),
+        input1(FlatSize(input1_dims)),
+        input2(FlatSize(input2_dims)) {
+    for (size_t i = 0; i < output_dims.size(); ++i) {
+      output_dims[i] = std::max(input1_dims[i], input2_dims[i]);
+    }
+    const float scales[] = {0.004f, 0.02f, 0.05f, 0.11f};
+    input1_scale = scales[RandomInt(0, 3)];
+    input2_scale = scales[RandomInt(0, 3)];
+    output_scale = scales[RandomInt(0, 3)] * (op == Op::kMul ? 4 : 2);
+    input1_zero_point = RandomInt(-128, 127);
+    input2_zero_point = RandomInt(-128, 127);
+    output_zero_point = RandomInt(-128, 127);
+    activation = op != Op::kSquaredDifference && RandomInt(0, 3) == 0
+                     ? kTfLiteActRelu
+                     : kTfLiteActNone;
+    for (int8_t& value : input1) value = static_cast<int8_t>(rng());
+    for (int8_t& value : input2) value = static_cast<int8_t>(rng());
+  }
+
+  static int FlatSize(const std::vector<int32_t>& dims) {
+    int size = 1;
+    for (int32_t dim : dims) size *= dim;
+    return size;
+  }
+
+  tflite::RuntimeShape Input1Shape() const {
+    return tflite::RuntimeShape(input1_dims.size(), input1_dims.data());
+  }
+  tflite::RuntimeShape Input2Shape() const {
+    return tflite::RuntimeShape(input2_dims.size(), input2_dims.data());
+  }
+  tflite::RuntimeShape OutputShape() const {
+    return tflite::RuntimeShape(output_dims.size(), output_dims.data());
+  }
+  int OutputSize() const { return FlatSize(output_dims); }
+
+  // As AddPrepare, SubPrepare, MulPrepare and SquaredDifferencePrepare
+  // compute them, with the broadcast fields from ProcessBroadcastShapes.
+  tflite::ArithmeticParams Params(bool* need_broadcast) const {
+    tflite::ArithmeticParams params = {};
+    params.input1_offset = -input1_zero_point;
+    params.input2_offset = -input2_zero_point;
+    params.output_offset = output_zero_point;
+    if (op == Op::kMul) {
+      tflite::QuantizeMultiplier(static_cast<double>(input1_scale) *
+                                     static_cast<double>(input2_scale) /
+                                     static_cast<double>(output_scale),
+                                 &params.output_multiplier,
+                                 &params.output_shift);
+    } else if (op == Op::kSquaredDifference) {
+      params.left_shift = 7;
+      const double twice_max_input_scale =
+          2.0 * static_cast<double>(std::max(input1_scale, input2_scale));
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(input1_scale) / twice_max_input_scale,
+          &params.input1_multiplier, &params.input1_shift);
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(input2_scale) / twice_max_input_scale,
+          &params.input2_multiplier, &params.input2_shift);
+      tflite::QuantizeMultiplier(
+          twice_max_input_scale * twice_max_input_scale /
+              static_cast<double>((1 << params.left_shift * 2) * output_scale),
+          &params.output_multiplier, &params.output_shift);
+    } else if (op == Op::kAdd) {
+      params.left_shift = 20;
+      const double twice_max_input_scale =
+          2 * static_cast<double>(std::max(input1_scale, input2_scale));
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(input1_scale) / twice_max_input_scale,
+          &params.input1_multiplier, &params.input1_shift);
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(input2_scale) / twice_max_input_scale,
+          &params.input2_multiplier, &params.input2_shift);
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          twice_max_input_scale /
+              ((1 << params.left_shift) * static_cast<double>(output_scale)),
+          &params.output_multiplier, &params.output_shift);
+    } else {
+      // SubPrepare does the scale arithmetic in float.
+      params.left_shift = 20;
+      const float twice_max_input_scale =
+          2 * std::max(input1_scale, input2_scale);
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(input1_scale / twice_max_input_scale),
+          &params.input1_multiplier, &params.input1_shift);
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(input2_scale / twice_max_input_scale),
+          &params.input2_multiplier, &params.input2_shift);
+      tflite::QuantizeMultiplierSmallerThanOneExp(
+          static_cast<double>(twice_max_input_scale /
+                              ((1 << params.left_shift) * output_scale)),
+          &params.output_multiplier, &params.output_shift);
+    }
+    params.quantized_activation_min =
+        activation == kTfLiteActRelu ? std::max(-128, output_zero_point) : -128;
+    params.quantized_activation_max = 127;
+    *need_broadcast = tflite::reference_ops::ProcessBroadcastShapes(
+        Input1Shape(), Input2Shape(), &params);
+    return params;
+  }
+
+  void RunReference(const tflite::ArithmeticParams& params,
+                    bool need_broadcast, int8_t* output) const {
+    switch (op) {
+      case Op::kAdd:
+        if (need_broadcast) {
+          tflite::reference_integer_ops::BroadcastAdd4DSlow(
+              params, Input1Shape(), input1.data(), Input2Shape(),
+              input2.data(), OutputShape(), output);
+        } else {
+          tflite::reference_integer_ops::Add(params, Input1Shape(),
+                                             input1.data(), Input2Shape(),
+                                             input2.data(), OutputShape(),
+                                             output);
+        }
+        break;
+      case Op::kSub:
+        if (need_broadcast) {
+          tflite::reference_ops::BroadcastQuantSubSlow(
+              params, Input1Shape(), input1.data(), Input2Shape(),
+              input2.data(), OutputShape(), output);
+        } else {
+          tflite::reference_ops::Sub(params, Input1Shape(), input1.data(),
+                                     Input2Shape(), input2.data(),
+                                     OutputShape(), output);
+        }
+        break;
+      case Op::kMul:
+        if (need_broadcast) {
+          tflite::reference_integer_ops::BroadcastMul4DSlow(
+              params, Input1Shape(), input1.data(), Input2Shape(),
+              input2.data(), OutputShape(), output);
+        } else {
+          tflite::reference_integer_ops::Mul(params, Input1Shape(),
+                                             input1.data(), Input2Shape(),
+                                             input2.data(), OutputShape(),
+                                             output);
+        }
+        break;
+      case Op::kSquaredDifference:
+        if (input1_dims != input2_dims) {
+          tflite::reference_integer_ops::BroadcastBinaryFunction4DSlow(
+              params, Input1Shape(), input1.data(), Input2Shape(),
+              input2.data(), OutputShape(), output,
+              tflite::reference_integer_ops::CheckArithmeticParams,
+              SquaredDifference);
+        } else {
+          tflite::reference_integer_ops::ElementWise(
+              OutputSize(), params, input1.data(), input2.data(), output,
+              tflite::reference_integer_ops::CheckArithmeticParams,
+              SquaredDifference);
+        }
+        break;
+    }
+  }
+
+  void RunReference(int8_t* output) const {
+    bool need_broadcast;
+    const tflite::ArithmeticParams params = Params(&need_broadcast);
+    RunReference(params, need_broadcast, output);
+  }
+};
+
+// FakeMicroContext (and so KernelRunner) allocates a new temp eval tensor on
+// every GetEvalTensor call, which runs out of arena over the benchmark's
+// invocations. The interpreter's eval tensors persist, so these do too.
+class EvalTensorContext : public tflite::FakeMicroContext {
+ public:
+  EvalTensorContext(TfLiteTensor* tensors,
+                    tflite::SingleArenaBufferAllocator* allocator,
+                    tflite::MicroGraph* graph)
+      : FakeMicroContext(tensors, allocator, graph) {
+    for (int i = 0; i < 3; ++i) {
+      eval_tensors_[i].data = tensors[i].data;
+      eval_tensors_[i].dims = tensors[i].dims;
+      eval_tensors_[i].type = tensors[i].type;
+    }
+  }
+
+  TfLiteEvalTensor* GetEvalTensor(int tensor_index) override {
+    return &eval_tensors_[tensor_index];
+  }
+
+ private:
+  TfLiteEvalTensor eval_tensors_[3];
+};
+
+// The registered kernel on one case, with the TfLiteContext wired the way
+// KernelRunner does it: Init and Prepare once, then Invoke on demand.
+class KernelCase {
+ public:
+  KernelCase(const BinaryCase& binary, int8_t* output)
+      : registration_(Registration(binary.op)),
+        input1_dims_(Dims(binary.input1_dims)),
+        input2_dims_(Dims(binary.input2_dims)),
+        output_dims_(Dims(binary.output_dims)),
+        arena_(8192),
+        allocator_(tflite::SingleArenaBufferAllocator::Create(arena_.data(),
+                                                              arena_.size())),
+        graph_(allocator_) {
+    tensors_[0] = tflite::testing::CreateQuantizedTensor(
+        binary.input1.data(),
+        tflite::testing::IntArrayFromInts(input1_dims_.data()),
+        binary.input1_scale, binary.input1_zero_point);
+    tensors_[1] = tflite::testing::CreateQuantizedTensor(
+        binary.input2.data(),
+        tflite::testing::IntArrayFromInts(input2_dims_.data()),
+        binary.input2_scale, binary.input2_zero_point);
+    tensors_[2] = tflite::testing::CreateQuantizedTensor(
+        output, tflite::testing::IntArrayFromInts(output_dims_.data()),
+        binary.output_scale, binary.output_zero_point);
+    micro_context_ = new (micro_context_storage_)
+        EvalTensorContext(tensors_, allocator_, &graph_);
+    context_.impl_ = static_cast<void*>(micro_context_);
+    context_.ReportError = tflite::MicroContextReportOpError;
+    context_.GetTensor = tflite::MicroContextGetTensor;
+    context_.GetEvalTensor = tflite::MicroContextGetEvalTensor;
+    context_.AllocatePersistentBuffer =
+        tflite::MicroContextAllocatePersistentBuffer;
+    context_.RequestScratchBufferInArena =
+        tflite::MicroContextRequestScratchBufferInArena;
+    context_.GetScratchBuffer = tflite::MicroContextGetScratchBuffer;
+    node_.inputs = tflite::testing::IntArrayFromInts(inputs_array_);
+    node_.outputs = tflite::testing::IntArrayFromInts(outputs_array_);
+
+    add_params_.activation = binary.activation;
+    sub_params_.activation = binary.activation;
+    mul_params_.activation = binary.activation;
+    switch (binary.op) {
+      case Op::kAdd:
+        node_.builtin_data = &add_params_;
+        break;
+      case Op::kSub:
+        node_.builtin_data = &sub_params_;
+        break;
+      case Op::kMul:
+        node_.builtin_data = &mul_params_;
+        break;
+      case Op::kSquaredDifference:
+        break;
+    }
+    node_.user_data = registration_.init(&context_, nullptr, 0);
+    TEST_ASSERT_EQUAL(kTfLiteOk, registration_.prepare(&context_, &node_));
+  }
+
+  KernelCase(const KernelCase&) = delete;
+  KernelCase& operator=(const KernelCase&) = delete;
+
+  void Invoke() {
+    TEST_ASSERT_EQUAL(kTfLiteOk, registration_.invoke(&context_, &node_));
+  }
+
+ private:
+  static TfLiteRegistration_V1 Registration(Op op) {
+    switch (op) {
+      case Op::kAdd:
+        return tflite::Register_ADD();
+      case Op::kSub:
+        return tflite::Register_SUB();
+      case Op::kMul:
+        return tflite::Register_MUL();
+      case Op::kSquaredDifference:
+        return tflite::Register_SQUARED_DIFFERENCE();
+    }
+    return {};
+  }
+
+  // IntArrayFromInts layout: the rank, then the dimensions.
+  static std::vector<int> Dims(const std::vector<int32_t>& dims) {
+    std::vector<int> array(1, static_cast<int>(dims.size()));
+    array.insert(array.end(), dims.begin(), dims.end());
+    return array;
+  }
+
+  TfLiteRegistration_V1 registration_;
+  std::vector<int> input1_dims_;
+  std::vector<int> input2_dims_;
+  std::vector<int> output_dims_;
+  std::vector<uint8_t> arena_;
+  tflite::SingleArenaBufferAllocator* allocator_;
+  tflite::MockMicroGraph graph_;
+  int inputs_array_[3] = {2, 0, 1};
+  int outputs_array_[2] = {1, 2};
+  TfLiteTensor tensors_[3];
+  alignas(EvalTensorContext) uint8_t
+      micro_context_storage_[sizeof(EvalTensorContext)];
+  EvalTensorContext* micro_context_;
+  TfLiteContext context_ = {};
+  TfLiteNode node_ = {};
+  TfLiteAddParams add_params_ = {};
+  TfLiteSubParams sub_params_ = {};
+  TfLiteMulParams mul_params_ = {};
+};
+
+void CheckCase(const BinaryCase& binary) {
+  const int size = binary.OutputSize();
+  std::vector<int8_t> expected(size);
+  std::vector<int8_t> actual(size, 0x5a);
+  binary.RunReference(expected.data());
+  KernelCase kernel(binary, actual.data());
+  kernel.Invoke();
+  for (int i = 0; i < size; ++i) {
+    if (expected[i] != actual[i]) {
+      char message[160];
+      snprintf(message, sizeof(message),
+               "%s [%d,%d,%d,%d] x [%d,%d,%d,%d], element %d: expected %d, "
+               "got %d",
+               OpName(binary.op), binary.input1_dims[0],
+               binary.input1_dims[1], binary.input1_dims[2],
+               binary.input1_dims[3], binary.input2_dims[0],
+               binary.input2_dims[1], binary.input2_dims[2],
+               binary.input2_dims[3], i, expected[i], actual[i]);
+      TEST_FAIL_MESSAGE(message);
+    }
+  }
+}
+
+// Random 4D output shape; each dimension of each input is either the
+// output's or 1, so any broadcast ProcessBroadcastShapes can meet shows up.
+void RandomShapes(std::vector<int32_t>* input1_dims,
+                  std::vector<int32_t>* input2_dims) {
+  const int max_dims[] = {2, 12, 12, 40};
+  input1_dims->assign(4, 1);
+  input2_dims->assign(4, 1);
+  for (int i = 0; i < 4; ++i) {
+    const int dim = RandomInt(1, max_dims[i]);
+    switch (RandomInt(0, 3)) {
+      case 0:
+        (*input1_dims)[i] = dim;
+        break;
+      case 1:
+        (*input2_dims)[i] = dim;
+        break;
+      default:
+        (*input1_dims)[i] = dim;
+        (*input2_dims)[i] = dim;
+        break;
+    }
+  }
+}
+
+const Op kOps[] = {Op::kAdd, Op::kSub, Op::kMul, Op::kSquaredDifference};
+
+double MicrosPerCall(const BinaryCase& binary, bool kernel) {
+  std::vector<int8_t> output(binary.OutputSize());
+  bool need_broadcast;
+  const tflite::ArithmeticParams params = binary.Params(&need_broadcast);
+  KernelCase kernel_case(binary, output.data());
+  const int iterations = 4000000 / binary.OutputSize() + 10;
+  volatile int8_t sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; ++n) {
+    if (kernel) {
+      kernel_case.Invoke();
+    } else {
+      binary.RunReference(params, need_broadcast, output.data());
+    }
+    sink = output[n % output.size()];
+  }
+  (void)sink;
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// 300 random shapes per op; the fast categories must come up often enough
+// to matter, in both directions and with both run kinds.
+void test_random_broadcasts_match_reference() {
+  int counts[5] = {};
+  for (Op op : kOps) {
+    for (int trial = 0; trial < 300; ++trial) {
+      std::vector<int32_t> input1_dims;
+      std::vector<int32_t> input2_dims;
+      RandomShapes(&input1_dims, &input2_dims);
+      const BinaryCase binary(op, input1_dims, input2_dims);
+      bool need_broadcast;
+      const tflite::ArithmeticParams params = binary.Params(&need_broadcast);
+      if (!need_broadcast) {
+        ++counts[0];
+      } else if (params.broadcast_category ==
+                 tflite::BroadcastableOpCategory::kGenericBroadcast) {
+        ++counts[1];
+      } else {
+        ++counts[params.broadcast_category ==
+                         tflite::BroadcastableOpCategory::
+                             kFirstInputBroadcastsFast
+                     ? 2
+                     : 3];
+        if (params.broadcast_shape[4] == 1) ++counts[4];
+      }
+      CheckCase(binary);
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(100, counts[2]);
+  TEST_ASSERT_GREATER_THAN(100, counts[3]);
+  TEST_ASSERT_GREATER_THAN(50, counts[4]);
+  TEST_ASSERT_GREATER_THAN(20, counts[1]);
+  char line[128];
+  snprintf(line, sizeof(line),
+           "same shape %d, generic %d, input1 fast %d, input2 fast %d "
+           "(scalar runs %d)",
+           counts[0], counts[1], counts[2], counts[3], counts[4]);
+  TEST_MESSAGE(line);
+}
+
+// The shapes the MobileNetV2 and CIFAR graphs use and their mirror images:
+// a per-channel vector, a per-pixel value, a scalar, each on either side,
+// plus the same-shape residual and a small output that stays on the
+// reference path.
+void test_model_shapes_match_reference() {
+  const std::vector<int32_t> feature_map = {1, 12, 12, 96};
+  const std::vector<std::vector<int32_t>> others = {
+      {1, 12, 12, 96}, {1, 1, 1, 96}, {1, 12, 12, 1},
+      {1, 1, 1, 1},    {1, 12, 1, 96}, {1, 1, 12, 96}};
+  for (Op op : kOps) {
+    for (const std::vector<int32_t>& other : others) {
+      CheckCase(BinaryCase(op, feature_map, other));
+      CheckCase(BinaryCase(op, other, feature_map));
+    }
+    CheckCase(BinaryCase(op, {1, 4, 4, 8}, {1, 1, 1, 8}));
+    CheckCase(BinaryCase(op, {1, 1, 1, 8}, {1, 4, 4, 1}));
+  }
+  // The per-pixel value is the y4 == 1 run, broadcast over the channels.
+  bool need_broadcast;
+  const tflite::ArithmeticParams params =
+      BinaryCase(Op::kAdd, feature_map, {1, 12, 12, 1}).Params(&need_broadcast);
+  TEST_ASSERT_TRUE(need_broadcast);
+  TEST_ASSERT_EQUAL(1, params.broadcast_shape[4]);
+}
+
+// Every int8 value on both sides, with the extreme zero points and scales,
+// for the table lookups and the output clamp.
+void test_extreme_params_match_reference() {
+  for (Op op : kOps) {
+    for (int trial = 0; trial < 20; ++trial) {
+      BinaryCase binary(op, {1, 16, 16, 8}, {1, 1, 1, 8});
+      for (size_t i = 0; i < binary.input1.size(); ++i) {
+        binary.input1[i] = static_cast<int8_t>(i);
+      }
+      binary.input1_zero_point = trial % 2 == 0 ? -128 : 127;
+      binary.input2_zero_point = trial % 4 < 2 ? 127 : -128;
+      binary.input1_scale = trial % 3 == 0 ? 1e-4f : 0.5f;
+      binary.output_scale = trial % 5 == 0 ? 1e-3f : binary.output_scale;
+      CheckCase(binary);
+      std::swap(binary.input1_dims, binary.input2_dims);
+      std::swap(binary.input1, binary.input2);
+      CheckCase(binary);
+    }
+  }
+}
+
+void test_benchmark_against_reference() {
+  const struct {
+    std::vector<int32_t> input1_dims;
+    std::vector<int32_t> input2_dims;
+    const char* name;
+  } shapes[] = {
+      {{1, 12, 12, 96}, {1, 12, 12, 96}, "12x12x96 + 12x12x96"},
+      {{1, 12, 12, 96}, {1, 1, 1, 96}, "12x12x96 + 1x1x96"},
+      {{1, 1, 1, 96}, {1, 12, 12, 96}, "1x1x96 + 12x12x96"},
+      {{1, 12, 12, 96}, {1, 12, 12, 1}, "12x12x96 + 12x12x1"},
+      {{1, 12, 12, 96}, {1, 1, 1, 1}, "12x12x96 + scalar"},
+  };
+  for (Op op : {Op::kAdd, Op::kMul}) {
+    for (const auto& shape : shapes) {
+      const BinaryCase binary(op, shape.input1_dims, shape.input2_dims);
+      const double reference_us = MicrosPerCall(binary, false);
+      const double kernel_us = MicrosPerCall(binary, true);
+      char line[128];
+      snprintf(line, sizeof(line),
+               "%s %s: reference %.1f us, kernel %.1f us (%.2fx)", OpName(op),
+               shape.name, reference_us, kernel_us, reference_us / kernel_us);
+      TEST_MESSAGE(line);
+    }
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_random_broadcasts_match_reference);
+  RUN_TEST(test_model_shapes_match_reference);
+  RUN_TEST(test_extreme_params_match_reference);
+  RUN_TEST(test_benchmark_against_reference);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
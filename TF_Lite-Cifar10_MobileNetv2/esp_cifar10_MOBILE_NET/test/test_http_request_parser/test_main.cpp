@@ -0,0 +1,293 @@
+// HttpRequestParser nos casos de borda que o loop das aplicações depende:
+// requisições pipelined no mesmo buffer, a requisição dividida em qualquer
+// posição (inclusive entre o CR e o LF), Content-Length duplicado ou
+// inválido, Transfer-Encoding, e linha de requisição e headers longos
+// demais. O parser para exatamente na linha em branco, então os testes
+// conferem também quantos bytes cada requisição consumiu.
+#include <unity.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "http_request_parser.h"
+
+namespace {
+
+std::mt19937 rng(43);
+
+// Alimenta o parser com a requisição inteira de uma vez e devolve o
+// status; `consumed` recebe os bytes usados.
+HttpRequestParser::Status parse(HttpRequestParser& parser,
+                                const std::string& request,
+                                size_t* consumed = nullptr) {
+  parser.reset();
+  size_t used = 0;
+  const HttpRequestParser::Status status =
+      parser.feed(request.data(), request.size(), &used);
+  if (consumed != nullptr) *consumed = used;
+  return status;
+}
+
+// Status HTTP do erro de `request`, ou 0 se os headers foram aceitos.
+int error_status(const std::string& request) {
+  HttpRequestParser parser;
+  if (parse(parser, request) != HttpRequestParser::kError) return 0;
+  return parser.error_status();
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Três requisições num buffer só, como o teste_carga.py --modes pipeline
+// manda: cada feed() para na linha em branco, o corpo fica para quem lê
+// Content-Length bytes e o resto é a próxima requisição.
+void test_pipelined_requests() {
+  const std::string first =
+      "POST /predict_raw HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n\r\n";
+  const std::string second = "GET /status HTTP/1.1\r\n\r\n";
+  const std::string third =
+      "POST /predict HTTP/1.1\r\nContent-Length: 3\r\nConnection: close\r\n\r\n";
+  const std::string buffer = first + "ABCDE" + second + third + "xyz";
+
+  HttpRequestParser parser;
+  size_t offset = 0;
+  size_t consumed = 0;
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parser.feed(buffer.data(), buffer.size(), &consumed));
+  TEST_ASSERT_EQUAL(first.size(), consumed);
+  TEST_ASSERT_TRUE(parser.matches("POST", "/predict_raw"));
+  TEST_ASSERT_EQUAL(5, parser.content_length());
+  TEST_ASSERT_TRUE(parser.keep_alive());
+  offset += consumed;
+  TEST_ASSERT_EQUAL_STRING("ABCDE", buffer.substr(offset, 5).c_str());
+  offset += parser.content_length();
+
+  parser.reset();
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parser.feed(buffer.data() + offset, buffer.size() - offset,
+                                &consumed));
+  TEST_ASSERT_EQUAL(second.size(), consumed);
+  TEST_ASSERT_TRUE(parser.matches("GET", "/status"));
+  TEST_ASSERT_EQUAL(0, parser.content_length());
+  offset += consumed;
+
+  parser.reset();
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parser.feed(buffer.data() + offset, buffer.size() - offset,
+                                &consumed));
+  TEST_ASSERT_EQUAL(third.size(), consumed);
+  TEST_ASSERT_TRUE(parser.matches("POST", "/predict"));
+  TEST_ASSERT_FALSE(parser.keep_alive());
+  offset += consumed;
+  TEST_ASSERT_EQUAL_STRING("xyz", buffer.substr(offset).c_str());
+
+  // Byte a byte, como read_headers(): feed(char) devolve kDone no LF da
+  // linha em branco e não consome mais nada depois.
+  parser.reset();
+  size_t position = 0;
+  while (parser.feed(buffer[position]) == HttpRequestParser::kNeedMore) {
+    ++position;
+  }
+  TEST_ASSERT_EQUAL(first.size() - 1, position);
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone, parser.feed('A'));
+  TEST_ASSERT_EQUAL(5, parser.content_length());
+}
+
+// A mesma requisição dividida em dois pedaços em cada posição possível, e
+// em pedaços aleatórios, dá o mesmo resultado; inclui CR num pedaço e LF
+// no próximo. Linhas terminadas só com LF e linhas em branco antes da
+// linha de requisição (sobras de um cliente anterior) também são aceitas.
+void test_split_at_every_position() {
+  const std::string requests[] = {
+      "POST /predict_raw?count=2 HTTP/1.1\r\nHost: 10.0.0.2\r\n"
+      "Content-Length: 6144\r\nConnection: keep-alive\r\n\r\n",
+      "POST /predict_raw?count=2 HTTP/1.1\nHost: 10.0.0.2\n"
+      "Content-Length: 6144\nConnection: keep-alive\n\n",
+      "\r\n\r\nPOST /predict_raw?count=2 HTTP/1.1\r\nHost: 10.0.0.2\r\n"
+      "Content-Length: 6144\r\nConnection: keep-alive\r\n\r\n",
+  };
+  for (const std::string& request : requests) {
+    for (size_t split = 0; split <= request.size(); ++split) {
+      HttpRequestParser parser;
+      size_t first = 0;
+      size_t second = 0;
+      const HttpRequestParser::Status expected =
+          split < request.size() ? HttpRequestParser::kNeedMore
+                                 : HttpRequestParser::kDone;
+      TEST_ASSERT_EQUAL(expected, parser.feed(request.data(), split, &first));
+      TEST_ASSERT_EQUAL(split, first);
+      TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                        parser.feed(request.data() + split,
+                                    request.size() - split, &second));
+      TEST_ASSERT_EQUAL(request.size(), first + second);
+      TEST_ASSERT_TRUE(parser.matches("POST", "/predict_raw"));
+      TEST_ASSERT_EQUAL_STRING("count=2", parser.query());
+      TEST_ASSERT_EQUAL(2, parser.query_int("count", 1));
+      TEST_ASSERT_EQUAL(6144, parser.content_length());
+      TEST_ASSERT_TRUE(parser.keep_alive());
+    }
+    for (int trial = 0; trial < 100; ++trial) {
+      HttpRequestParser parser;
+      size_t offset = 0;
+      HttpRequestParser::Status status = HttpRequestParser::kNeedMore;
+      while (status == HttpRequestParser::kNeedMore) {
+        const size_t n = std::min<size_t>(request.size() - offset, 1 + rng() % 7);
+        size_t consumed = 0;
+        status = parser.feed(request.data() + offset, n, &consumed);
+        TEST_ASSERT_EQUAL(n, consumed);
+        offset += consumed;
+      }
+      TEST_ASSERT_EQUAL(HttpRequestParser::kDone, status);
+      TEST_ASSERT_EQUAL(request.size(), offset);
+      TEST_ASSERT_EQUAL(6144, parser.content_length());
+    }
+  }
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::kNeedMore, parser.feed("\r\n\r\n", 4, nullptr));
+  TEST_ASSERT_FALSE(parser.started());
+}
+
+// Content-Length repetido com o mesmo valor é aceito; com valores
+// diferentes o servidor não sabe onde o corpo termina e recusa.
+void test_duplicate_content_length() {
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser,
+                          "POST /predict HTTP/1.1\r\nContent-Length: 12\r\n"
+                          "content-length:12\r\n\r\n"));
+  TEST_ASSERT_EQUAL(12, parser.content_length());
+  TEST_ASSERT_EQUAL(400, error_status("POST /predict HTTP/1.1\r\nContent-Length: 12\r\n"
+                                      "Content-Length: 13\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, error_status("POST /predict HTTP/1.1\r\nContent-Length: 0\r\n"
+                                      "Content-Length: 5\r\n\r\n"));
+}
+
+void test_invalid_content_length() {
+  const char* const kValues[] = {"", " ", "1x", "-1", "+5", "5 5", "0x10", "1.0", "5,5"};
+  for (const char* value : kValues) {
+    const std::string request = std::string("POST /predict HTTP/1.1\r\nContent-Length: ") +
+                                value + "\r\n\r\n";
+    TEST_ASSERT_EQUAL_MESSAGE(400, error_status(request), value);
+  }
+  // Acima de kMaxContentLength, inclusive números que estourariam o long.
+  TEST_ASSERT_EQUAL(413, error_status("POST /predict HTTP/1.1\r\nContent-Length: 1048577\r\n\r\n"));
+  TEST_ASSERT_EQUAL(413, error_status("POST /predict HTTP/1.1\r\n"
+                                      "Content-Length: 99999999999999999999999\r\n\r\n"));
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser, "POST /predict HTTP/1.1\r\nContent-Length: 1048576 \r\n\r\n"));
+  TEST_ASSERT_EQUAL(HttpRequestParser::kMaxContentLength, parser.content_length());
+}
+
+// Transfer-Encoding, com ou sem Content-Length, em qualquer ordem: o corpo
+// não tem tamanho conhecido, então 501 e a conexão é fechada.
+void test_transfer_encoding_rejected() {
+  const char* const kRequests[] = {
+      "POST /predict HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n",
+      "POST /predict HTTP/1.1\r\ntransfer-encoding: identity\r\n\r\n",
+      "POST /predict HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n",
+      "POST /predict HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n",
+  };
+  for (const char* request : kRequests) {
+    HttpRequestParser parser;
+    size_t consumed = 0;
+    TEST_ASSERT_EQUAL(HttpRequestParser::kError, parse(parser, request, &consumed));
+    TEST_ASSERT_EQUAL(501, parser.error_status());
+    TEST_ASSERT_EQUAL_STRING("Not Implemented", http_status_text(parser.error_status()));
+    // Para no LF do header, sem consumir o resto.
+    TEST_ASSERT_TRUE(consumed < strlen(request));
+  }
+}
+
+// Linha de requisição acima de kMaxLineLength, caminho ou query acima dos
+// buffers: 414. Um header longo que o servidor não usa é ignorado; um
+// Content-Length truncado não pode ser ignorado; e o total dos headers é
+// limitado por kMaxHeaderBytes.
+void test_overlong_lines() {
+  const std::string long_path(HttpRequestParser::kMaxLineLength, 'a');
+  TEST_ASSERT_EQUAL(414, error_status("GET /" + long_path + " HTTP/1.1\r\n\r\n"));
+  const std::string path(HttpRequestParser::kMaxPathLength, 'p');
+  TEST_ASSERT_EQUAL(414, error_status("GET /" + path + " HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_EQUAL(0, error_status("GET /" + path.substr(2) + " HTTP/1.1\r\n\r\n"));
+  const std::string query(HttpRequestParser::kMaxQueryLength, 'q');
+  TEST_ASSERT_EQUAL(414, error_status("GET /status?" + query + " HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_EQUAL(0, error_status("GET /status?" + query.substr(1) + " HTTP/1.1\r\n\r\n"));
+
+  const std::string long_value(HttpRequestParser::kMaxLineLength * 2, 'v');
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser, "POST /predict HTTP/1.1\r\nUser-Agent: " + long_value +
+                                      "\r\nContent-Length: 7\r\n\r\n"));
+  TEST_ASSERT_EQUAL(7, parser.content_length());
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser, "POST /predict HTTP/1.1\r\n" + long_value +
+                                      "\r\nContent-Length: 7\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400,
+                    error_status("POST /predict HTTP/1.1\r\nContent-Length: 7" +
+                                 std::string(HttpRequestParser::kMaxLineLength, ' ') +
+                                 "\r\n\r\n"));
+
+  std::string many_headers = "GET /status HTTP/1.1\r\n";
+  while (many_headers.size() <= static_cast<size_t>(HttpRequestParser::kMaxHeaderBytes)) {
+    many_headers += "X-Filler: " + std::string(100, 'f') + "\r\n";
+  }
+  TEST_ASSERT_EQUAL(431, error_status(many_headers + "\r\n"));
+  TEST_ASSERT_EQUAL(431, error_status(std::string(HttpRequestParser::kMaxHeaderBytes + 1, 'G')));
+}
+
+void test_request_line_and_connection() {
+  TEST_ASSERT_EQUAL(505, error_status("GET /status HTTP/2.0\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, error_status("GET /status\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, error_status("get /status HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, error_status("GET  HTTP/1.1\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, error_status("GET /status HTTP/1.1\r\nsem dois pontos\r\n\r\n"));
+  TEST_ASSERT_EQUAL(400, error_status("GET /status HTTP/1.1\r\nHost : x\r\n\r\n"));
+
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone, parse(parser, "GET /status HTTP/1.0\r\n\r\n"));
+  TEST_ASSERT_FALSE(parser.keep_alive());
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser, "GET /status HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"));
+  TEST_ASSERT_TRUE(parser.keep_alive());
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser, "GET /status HTTP/1.1\r\nConnection: Upgrade, close\r\n\r\n"));
+  TEST_ASSERT_FALSE(parser.keep_alive());
+  TEST_ASSERT_FALSE(parser.expect_continue());
+  TEST_ASSERT_EQUAL(HttpRequestParser::kDone,
+                    parse(parser, "POST /predict_raw?width=96&height=x HTTP/1.1\r\n"
+                                  "Expect: 100-continue\r\nContent-Length: 3\r\n\r\n"));
+  TEST_ASSERT_TRUE(parser.expect_continue());
+  TEST_ASSERT_EQUAL(96, parser.query_int("width", 32));
+  TEST_ASSERT_EQUAL(-1, parser.query_int("height", 32));
+  TEST_ASSERT_EQUAL(32, parser.query_int("depth", 32));
+  TEST_ASSERT_FALSE(parser.matches("POST", "/predict"));
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pipelined_requests);
+  RUN_TEST(test_split_at_every_position);
+  RUN_TEST(test_duplicate_content_length);
+  RUN_TEST(test_invalid_content_length);
+  RUN_TEST(test_transfer_encoding_rejected);
+  RUN_TEST(test_overlong_lines);
+  RUN_TEST(test_request_line_and_connection);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
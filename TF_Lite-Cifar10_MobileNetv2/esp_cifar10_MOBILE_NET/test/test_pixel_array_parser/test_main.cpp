@@ -0,0 +1,269 @@
+// PixelArrayParser contra o caminho antigo de POST /predict (corpo inteiro
+// num String, um byte por vez, depois parse_json_array e a quantização em
+// float por pixel), com os tamanhos das aplicações: 3.072 valores (32x32x3,
+// CIFAR-10) e 27.648 (96x96x3, MobileNetV2 antes do redimensionamento).
+// Confere que 200 divisões aleatórias do corpo em pedaços dão a mesma saída
+// e mede o tempo por corpo dos dois caminhos.
+#include <unity.h>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "input_quantizer.h"
+#include "pixel_array_parser.h"
+
+namespace {
+
+std::mt19937 rng(41);
+
+const int kPayloadSizes[] = {32 * 32 * 3, 96 * 96 * 3};
+const float kScale = 1.0f / 255.0f;
+const int32_t kZeroPoint = -128;
+
+// parse_json_array das aplicações antes do PixelArrayParser, com
+// std::string no lugar do String do Arduino. Retorna "" ou a mensagem de
+// erro.
+std::string old_parse_json_array(const std::string& json_data,
+                                 uint8_t* image_array, int image_size) {
+  size_t start_index = json_data.find("\"pixels\":");
+  if (start_index == std::string::npos) return "Campo 'pixels' não encontrado";
+
+  start_index = json_data.find('[', start_index);
+  if (start_index == std::string::npos) return "Array de pixels não encontrado";
+
+  const size_t end_index = json_data.find(']', start_index);
+  if (end_index == std::string::npos) return "Fim do array não encontrado";
+
+  const std::string array_content =
+      json_data.substr(start_index + 1, end_index - start_index - 1);
+  int pixel_count = 0;
+  size_t current_pos = 0;
+
+  while (current_pos < array_content.size() && pixel_count < image_size) {
+    while (current_pos < array_content.size() &&
+           isspace(static_cast<unsigned char>(array_content[current_pos]))) {
+      current_pos++;
+    }
+    if (current_pos >= array_content.size()) break;
+
+    const size_t comma_pos = array_content.find(',', current_pos);
+    std::string value_str =
+        comma_pos == std::string::npos
+            ? array_content.substr(current_pos)
+            : array_content.substr(current_pos, comma_pos - current_pos);
+    while (!value_str.empty() &&
+           isspace(static_cast<unsigned char>(value_str.back()))) {
+      value_str.pop_back();
+    }
+
+    bool is_valid_number = !value_str.empty();
+    for (char c : value_str) {
+      if (!isdigit(static_cast<unsigned char>(c))) is_valid_number = false;
+    }
+    if (!is_valid_number) {
+      return "Valor inválido no índice " + std::to_string(pixel_count);
+    }
+
+    const int pixel_value = atoi(value_str.c_str());
+    image_array[pixel_count] =
+        static_cast<uint8_t>(std::min(255, std::max(0, pixel_value)));
+    pixel_count++;
+
+    if (comma_pos == std::string::npos) break;
+    current_pos = comma_pos + 1;
+  }
+
+  if (pixel_count != image_size) return "Array com tamanho errado";
+  return "";
+}
+
+// O caminho antigo inteiro: o corpo lido byte a byte num String, o parse e
+// o preprocess_image com a conta em float por pixel.
+bool old_predict_body(const std::string& body, uint8_t* image_data,
+                      int8_t* input, int image_size) {
+  std::string received;
+  received.reserve(body.size() + 1);
+  for (char c : body) received += c;
+  if (!old_parse_json_array(received, image_data, image_size).empty()) {
+    return false;
+  }
+  for (int i = 0; i < image_size; i++) {
+    const float normalized_pixel = image_data[i] / 255.0f;
+    int32_t quantized_value = static_cast<int32_t>(
+        roundf(normalized_pixel / kScale) + kZeroPoint);
+    quantized_value = std::max(-128, std::min(127, quantized_value));
+    input[i] = static_cast<int8_t>(quantized_value);
+  }
+  return true;
+}
+
+// Um corpo {"pixels": [...]} com `pixels`; com `loose` os separadores levam
+// espaços, tabs e quebras de linha aleatórios, e há outro campo antes.
+std::string make_body(const std::vector<uint8_t>& pixels, bool loose) {
+  static const char* const kSpaces[] = {"", " ", "  ", "\n", "\r\n ", "\t"};
+  std::string body = loose ? "{\"id\": 7,\n \"pixels\": [" : "{\"pixels\": [";
+  for (size_t i = 0; i < pixels.size(); i++) {
+    if (loose) body += kSpaces[rng() % 6];
+    body += std::to_string(pixels[i]);
+    if (loose) body += kSpaces[rng() % 6];
+    if (i + 1 < pixels.size()) body += loose ? "," : ", ";
+  }
+  body += loose ? "\n]\n}" : "]}";
+  return body;
+}
+
+std::vector<uint8_t> random_pixels(int size) {
+  std::vector<uint8_t> pixels(size);
+  for (uint8_t& pixel : pixels) pixel = static_cast<uint8_t>(rng() & 0xff);
+  return pixels;
+}
+
+// Alimenta o parser com `body` em pedaços de 1 a `max_chunk` bytes.
+PixelArrayParser::Status feed_in_chunks(PixelArrayParser& parser,
+                                        const std::string& body,
+                                        size_t max_chunk) {
+  PixelArrayParser::Status status = PixelArrayParser::kNeedMore;
+  size_t offset = 0;
+  while (offset < body.size() && status == PixelArrayParser::kNeedMore) {
+    const size_t n = std::min(body.size() - offset, 1 + rng() % max_chunk);
+    status = parser.feed(body.data() + offset, n);
+    offset += n;
+  }
+  return parser.finish();
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// 200 divisões aleatórias do corpo (de 1 byte a pedaços maiores que o
+// buffer de 512 bytes das aplicações) dão a mesma saída que o caminho
+// antigo, com e sem tabela de quantização.
+void test_random_chunkings_match_old_parser() {
+  InputQuantizer quantizer;
+  quantizer.build(InputQuantizer::kUnitRange, kScale, kZeroPoint);
+  for (int size : kPayloadSizes) {
+    const std::vector<uint8_t> pixels = random_pixels(size);
+    std::vector<uint8_t> old_pixels(size);
+    std::vector<int8_t> expected(size);
+    std::vector<int8_t> actual(size);
+    for (bool loose : {false, true}) {
+      const std::string body = make_body(pixels, loose);
+      TEST_ASSERT_TRUE(
+          old_predict_body(body, old_pixels.data(), expected.data(), size));
+      for (int trial = 0; trial < 200; trial++) {
+        const size_t max_chunk = trial % 4 == 0 ? 8 : 1400;
+        std::fill(actual.begin(), actual.end(), 0);
+        PixelArrayParser parser(actual.data(), size, quantizer.table());
+        TEST_ASSERT_EQUAL(PixelArrayParser::kDone,
+                          feed_in_chunks(parser, body, max_chunk));
+        TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), size);
+
+        // Sem tabela, os bytes do pixel como estão (MobileNetV2).
+        parser.reset(actual.data(), size, nullptr);
+        TEST_ASSERT_EQUAL(PixelArrayParser::kDone,
+                          feed_in_chunks(parser, body, max_chunk));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(
+            pixels.data(), reinterpret_cast<uint8_t*>(actual.data()), size);
+      }
+    }
+  }
+}
+
+// Corpos que o caminho antigo recusava também são recusados, em qualquer
+// divisão.
+void test_rejects_what_old_parser_rejects() {
+  const char* const kBodies[] = {
+      "{}",
+      "{\"pixels\": 5}",
+      "{\"pixels\": [1, 2",
+      "{\"pixels\": [1, 2]}",
+      "{\"pixels\": [1.5, 2, 3]}",
+      "{\"pixels\": [1, , 3]}",
+      "{\"pixels\": [1 2 3]}",
+      "{\"pixels\": [1, 2, x]}",
+  };
+  int8_t output[3];
+  uint8_t old_pixels[3];
+  for (const char* body : kBodies) {
+    TEST_ASSERT_FALSE(old_parse_json_array(body, old_pixels, 3).empty());
+    for (int trial = 0; trial < 20; trial++) {
+      PixelArrayParser parser(output, 3, nullptr);
+      TEST_ASSERT_EQUAL_MESSAGE(PixelArrayParser::kError,
+                                feed_in_chunks(parser, body, 4), body);
+      TEST_ASSERT_NOT_EQUAL(0, strlen(parser.error()));
+    }
+  }
+}
+
+void test_benchmark_against_old_parser() {
+  InputQuantizer quantizer;
+  quantizer.build(InputQuantizer::kUnitRange, kScale, kZeroPoint);
+  for (int size : kPayloadSizes) {
+    const std::string body = make_body(random_pixels(size), false);
+    std::vector<uint8_t> old_pixels(size);
+    std::vector<int8_t> output(size);
+    const int iterations = 2000 * 3072 / size;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      old_predict_body(body, old_pixels.data(), output.data(), size);
+    }
+    const double old_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          iterations;
+
+    PixelArrayParser parser(output.data(), size, quantizer.table());
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      parser.reset();
+      for (size_t offset = 0; offset < body.size(); offset += 512) {
+        parser.feed(body.data() + offset,
+                    std::min<size_t>(512, body.size() - offset));
+      }
+      parser.finish();
+    }
+    const double new_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          iterations;
+    TEST_ASSERT_EQUAL(PixelArrayParser::kDone, parser.status());
+
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%d valores (%u bytes): antigo %.1f us, parser %.1f us "
+             "(%.1fx, %.1f MB/s)",
+             size, static_cast<unsigned>(body.size()), old_us, new_us,
+             old_us / new_us, body.size() / new_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_random_chunkings_match_old_parser);
+  RUN_TEST(test_rejects_what_old_parser_rejects);
+  RUN_TEST(test_benchmark_against_old_parser);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,288 @@
+// optimized_integer_ops MaxPool and AveragePool, used by esp_nn/pooling.cc
+// for int8, against reference_integer_ops MaxPool and AveragePool: random
+// shapes with SAME, VALID and explicit padding, strides above and below the
+// filter size (the direct and two-pass paths), average ties rounded away from
+// zero, and windows left empty by padding. Plus a timing comparison on the
+// shapes the CIFAR-10 models use.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/pooling.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/pooling.h"
+
+namespace {
+
+std::mt19937 rng(29);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+enum class Padding { kValid, kSame, kExplicit };
+
+struct PoolCase {
+  int batches;
+  int height;
+  int width;
+  int depth;
+  int output_height;
+  int output_width;
+  tflite::PoolParams params;
+  std::vector<int8_t> input;
+
+  // `filter` and `stride` are {height, width}. Explicit padding must stay
+  // below the filter size unless the test wants empty windows.
+  PoolCase(int batches, int height, int width, int depth, const int filter[2],
+           const int stride[2], Padding padding, const int explicit_pad[2])
+      : batches(batches),
+        height(height),
+        width(width),
+        depth(depth),
+        params(),
+        input(batches * height * width * depth) {
+    params.filter_height = filter[0];
+    params.filter_width = filter[1];
+    params.stride_height = stride[0];
+    params.stride_width = stride[1];
+    params.quantized_activation_min = -128;
+    params.quantized_activation_max = 127;
+    output_height = OutputSize(height, filter[0], stride[0], padding,
+                               explicit_pad ? explicit_pad[0] : 0,
+                               &params.padding_values.height);
+    output_width = OutputSize(width, filter[1], stride[1], padding,
+                              explicit_pad ? explicit_pad[1] : 0,
+                              &params.padding_values.width);
+    for (int8_t& value : input) {
+      value = static_cast<int8_t>(RandomInt(-128, 127));
+    }
+  }
+
+  // The TFLite formulas: VALID keeps windows inside the input, SAME gives
+  // ceil(size / stride) outputs with the extra padding at the end.
+  static int OutputSize(int size, int filter, int stride, Padding padding,
+                        int explicit_pad, int16_t* pad) {
+    switch (padding) {
+      case Padding::kValid:
+        *pad = 0;
+        return (size - filter) / stride + 1;
+      case Padding::kSame: {
+        const int output = (size + stride - 1) / stride;
+        *pad = std::max(0, (output - 1) * stride + filter - size) / 2;
+        return output;
+      }
+      case Padding::kExplicit:
+        break;
+    }
+    *pad = explicit_pad;
+    return (size + 2 * explicit_pad - filter) / stride + 1;
+  }
+
+  int OutputSize() const {
+    return batches * output_height * output_width * depth;
+  }
+
+  tflite::RuntimeShape InputShape() const {
+    const int dims[] = {batches, height, width, depth};
+    return tflite::RuntimeShape(4, dims);
+  }
+
+  tflite::RuntimeShape OutputShape() const {
+    const int dims[] = {batches, output_height, output_width, depth};
+    return tflite::RuntimeShape(4, dims);
+  }
+
+  void RunReferenceMax(int8_t* output) const {
+    tflite::reference_integer_ops::MaxPool(params, InputShape(), input.data(),
+                                           OutputShape(), output);
+  }
+
+  void RunOptimizedMax(int8_t* output) const {
+    std::vector<int8_t> scratch(std::max(
+        1, tflite::optimized_integer_ops::MaxPoolScratchBytes(params, width,
+                                                              depth)));
+    tflite::optimized_integer_ops::MaxPool(params, InputShape(), input.data(),
+                                           OutputShape(), output,
+                                           scratch.data());
+  }
+
+  bool RunReferenceAverage(int8_t* output) const {
+    return tflite::reference_integer_ops::AveragePool(
+        params, InputShape(), input.data(), OutputShape(), output);
+  }
+
+  bool RunOptimizedAverage(int8_t* output) const {
+    const int bytes = tflite::optimized_integer_ops::AveragePoolScratchBytes(
+        params, width, depth);
+    std::vector<int32_t> scratch(bytes / sizeof(int32_t));
+    return tflite::optimized_integer_ops::AveragePool(
+        params, InputShape(), input.data(), OutputShape(), output,
+        scratch.data());
+  }
+};
+
+void CheckCase(const PoolCase& pool) {
+  const int size = pool.OutputSize();
+  std::vector<int8_t> expected(size);
+  std::vector<int8_t> actual(size);
+  pool.RunReferenceMax(expected.data());
+  pool.RunOptimizedMax(actual.data());
+  TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), size);
+  TEST_ASSERT_TRUE(pool.RunReferenceAverage(expected.data()));
+  TEST_ASSERT_TRUE(pool.RunOptimizedAverage(actual.data()));
+  TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), size);
+}
+
+PoolCase RandomCase(Padding padding) {
+  const int filter[] = {RandomInt(1, 5), RandomInt(1, 5)};
+  const int stride[] = {RandomInt(1, 4), RandomInt(1, 4)};
+  const int explicit_pad[] = {RandomInt(0, filter[0] - 1),
+                              RandomInt(0, filter[1] - 1)};
+  // VALID needs the input to hold at least one window.
+  PoolCase pool(RandomInt(1, 2), RandomInt(filter[0], 13),
+                RandomInt(filter[1], 13), RandomInt(1, 20), filter, stride,
+                padding, explicit_pad);
+  pool.params.quantized_activation_min = RandomInt(-128, 0);
+  pool.params.quantized_activation_max = RandomInt(0, 127);
+  return pool;
+}
+
+template <typename Body>
+double MicrosPerCall(int iterations, Body body) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) body();
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_matches_reference_on_random_shapes() {
+  for (Padding padding : {Padding::kValid, Padding::kSame, Padding::kExplicit}) {
+    for (int trial = 0; trial < 300; ++trial) {
+      CheckCase(RandomCase(padding));
+    }
+  }
+}
+
+// stride < filter takes the two-pass path, stride >= filter the direct one;
+// SAME padding puts partial windows on the bottom and right edges.
+void test_matches_reference_on_model_shapes() {
+  const int shapes[][6] = {
+      // height, width, depth, filter, stride, SAME
+      {32, 32, 32, 2, 2, 0}, {16, 16, 64, 2, 2, 0}, {32, 32, 16, 3, 1, 1},
+      {15, 15, 24, 3, 2, 1}, {7, 7, 40, 3, 1, 0},   {9, 9, 8, 4, 3, 1},
+      {4, 4, 1280, 4, 4, 0}, {5, 5, 3, 5, 1, 1},
+  };
+  for (const auto& shape : shapes) {
+    const int filter[] = {shape[3], shape[3]};
+    const int stride[] = {shape[4], shape[4]};
+    CheckCase(PoolCase(1, shape[0], shape[1], shape[2], filter, stride,
+                       shape[5] ? Padding::kSame : Padding::kValid, nullptr));
+  }
+}
+
+// Windows of two summing to odd values, then padded edges where windows
+// hold one, two or four values, so averages land exactly on .5 for both
+// signs.
+void test_average_rounds_ties_away_from_zero() {
+  const int filter[] = {1, 2};
+  const int stride[] = {1, 2};
+  PoolCase pairs(1, 1, 8, 1, filter, stride, Padding::kValid, nullptr);
+  const int8_t values[] = {1, 2, -1, -2, 127, -128, -127, 126};
+  pairs.input.assign(values, values + 8);
+  std::vector<int8_t> expected(pairs.OutputSize());
+  std::vector<int8_t> actual(expected.size());
+  TEST_ASSERT_TRUE(pairs.RunReferenceAverage(expected.data()));
+  TEST_ASSERT_TRUE(pairs.RunOptimizedAverage(actual.data()));
+  const int8_t rounded[] = {2, -2, -1, -1};  // 1.5, -1.5, -0.5, -0.5
+  TEST_ASSERT_EQUAL_INT8_ARRAY(rounded, expected.data(), 4);
+  TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), 4);
+
+  const int square[] = {2, 2};
+  const int square_stride[] = {2, 2};
+  const int pad[] = {1, 1};
+  for (int trial = 0; trial < 200; ++trial) {
+    PoolCase padded(1, RandomInt(1, 6), RandomInt(1, 6), RandomInt(1, 4),
+                    square, square_stride, Padding::kExplicit, pad);
+    // Small values make ties frequent.
+    for (int8_t& value : padded.input) {
+      value = static_cast<int8_t>(RandomInt(-3, 3));
+    }
+    CheckCase(padded);
+  }
+}
+
+// Padding of at least the filter size leaves the first window empty; both
+// kernels must refuse instead of dividing by zero.
+void test_average_rejects_empty_windows() {
+  const int filter[] = {2, 2};
+  const int stride[] = {1, 1};
+  const int pad[] = {2, 0};
+  PoolCase pool(1, 4, 4, 3, filter, stride, Padding::kExplicit, pad);
+  std::vector<int8_t> output(pool.OutputSize());
+  TEST_ASSERT_FALSE(pool.RunReferenceAverage(output.data()));
+  TEST_ASSERT_FALSE(pool.RunOptimizedAverage(output.data()));
+}
+
+void test_benchmark_against_reference() {
+  const int shapes[][5] = {
+      // height, width, depth, filter, stride
+      {32, 32, 32, 2, 2},
+      {32, 32, 32, 3, 1},
+      {16, 16, 64, 3, 2},
+  };
+  for (const auto& shape : shapes) {
+    const int filter[] = {shape[3], shape[3]};
+    const int stride[] = {shape[4], shape[4]};
+    const PoolCase pool(1, shape[0], shape[1], shape[2], filter, stride,
+                        Padding::kSame, nullptr);
+    std::vector<int8_t> output(pool.OutputSize());
+    const int iterations = 200;
+    const double max_reference_us = MicrosPerCall(
+        iterations, [&] { pool.RunReferenceMax(output.data()); });
+    const double max_optimized_us = MicrosPerCall(
+        iterations, [&] { pool.RunOptimizedMax(output.data()); });
+    const double average_reference_us = MicrosPerCall(
+        iterations, [&] { pool.RunReferenceAverage(output.data()); });
+    const double average_optimized_us = MicrosPerCall(
+        iterations, [&] { pool.RunOptimizedAverage(output.data()); });
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%dx%dx%d %dx%d/s%d: max %.1f -> %.1f us, average %.1f -> %.1f "
+             "us",
+             shape[0], shape[1], shape[2], shape[3], shape[3], shape[4],
+             max_reference_us, max_optimized_us, average_reference_us,
+             average_optimized_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_reference_on_random_shapes);
+  RUN_TEST(test_matches_reference_on_model_shapes);
+  RUN_TEST(test_average_rounds_ties_away_from_zero);
+  RUN_TEST(test_average_rejects_empty_windows);
+  RUN_TEST(test_benchmark_against_reference);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
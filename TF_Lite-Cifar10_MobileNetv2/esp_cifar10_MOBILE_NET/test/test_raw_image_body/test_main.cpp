@@ -0,0 +1,295 @@
+// RawImageBody, a contabilidade de POST /predict_raw: Content-Length
+// errado (zero, negativo, fora do múltiplo, acima de max_images imagens)
+// recusado antes de qualquer leitura; leituras em pedaços aleatórios nunca
+// passam do fim de uma imagem e cada imagem chega inteira ao seu slot;
+// corpo curto nunca dá kDone. Mede também, por imagem, o PixelArrayParser
+// no corpo JSON de /predict contra RawImageBody + InputQuantizer::apply no
+// corpo binário, com os bytes de cada um, nos tamanhos das três aplicações.
+#include <unity.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "input_quantizer.h"
+#include "pixel_array_parser.h"
+#include "raw_image_body.h"
+
+namespace {
+
+std::mt19937 rng(42);
+
+// Um segmento TCP na rede local; o socket entrega o corpo nesses pedaços.
+const int kSegmentSize = 1460;
+
+// Lê `body` (no máximo `available` por vez, como o socket) para os slots,
+// e devolve os status de consume() na ordem.
+std::vector<RawImageBody::Status> read_body(RawImageBody& raw,
+                                            const std::vector<uint8_t>& body,
+                                            std::vector<std::vector<uint8_t>>& slots,
+                                            int image_size) {
+  std::vector<RawImageBody::Status> statuses;
+  size_t offset = 0;
+  while (offset < body.size()) {
+    const long available = 1 + rng() % 2000;
+    const int n = std::min<long>(raw.want(available), body.size() - offset);
+    if (n == 0) break;
+    TEST_ASSERT_TRUE(n <= available);
+    TEST_ASSERT_TRUE(raw.filled() + n <= image_size);
+    memcpy(slots[raw.images_done()].data() + raw.filled(), &body[offset], n);
+    offset += n;
+    statuses.push_back(raw.consume(n));
+    TEST_ASSERT_EQUAL(static_cast<long>(raw.image_count()) * image_size -
+                          static_cast<long>(offset),
+                      raw.remaining());
+  }
+  return statuses;
+}
+
+std::string json_body(const std::vector<uint8_t>& pixels) {
+  // O json.dumps do teste_inferencia.py: separadores ", ".
+  std::string body = "{\"pixels\": [";
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    if (i > 0) body += ", ";
+    body += std::to_string(pixels[i]);
+  }
+  return body + "]}";
+}
+
+template <typename Function>
+double micros_per_body(int iterations, Function function) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; ++n) function();
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Só múltiplos positivos de image_size com até max_images imagens; a
+// mensagem traz o tamanho esperado e o recebido.
+void test_content_length_validation() {
+  const int kImageSize = 3072;
+  const int kMaxImages = 8;
+  RawImageBody raw;
+  for (int images = 1; images <= kMaxImages; ++images) {
+    TEST_ASSERT_EQUAL(RawImageBody::kNeedMore,
+                      raw.begin(images * kImageSize, kImageSize, kMaxImages));
+    TEST_ASSERT_EQUAL(images, raw.image_count());
+    TEST_ASSERT_EQUAL(images * kImageSize, raw.remaining());
+    TEST_ASSERT_EQUAL_STRING("", raw.error());
+  }
+  const long kWrong[] = {0,
+                         -1,
+                         -kImageSize,
+                         1,
+                         kImageSize - 1,
+                         kImageSize + 1,
+                         2 * kImageSize - 1,
+                         (kMaxImages + 1) * kImageSize,
+                         (kMaxImages + 1) * kImageSize - 1,
+                         100L * kImageSize,
+                         LONG_MAX,
+                         LONG_MIN};
+  for (long content_length : kWrong) {
+    TEST_ASSERT_EQUAL(RawImageBody::kError,
+                      raw.begin(content_length, kImageSize, kMaxImages));
+    TEST_ASSERT_EQUAL(0, raw.image_count());
+    TEST_ASSERT_EQUAL(0, raw.want(kImageSize));
+    TEST_ASSERT_EQUAL(RawImageBody::kError, raw.consume(10));
+    char expected[96];
+    snprintf(expected, sizeof(expected),
+             "Corpo deve ter 3072 bytes por imagem (até 8 imagens), "
+             "recebido: %ld",
+             content_length);
+    TEST_ASSERT_EQUAL_STRING(expected, raw.error());
+  }
+  // Um corpo válido depois de um recusado começa do zero.
+  TEST_ASSERT_EQUAL(RawImageBody::kNeedMore,
+                    raw.begin(kImageSize, kImageSize, kMaxImages));
+  TEST_ASSERT_EQUAL_STRING("", raw.error());
+  TEST_ASSERT_EQUAL(kImageSize, raw.want(LONG_MAX));
+}
+
+// Pedaços de 1 a 2.000 bytes: cada imagem chega inteira e na ordem ao seu
+// slot, kImageDone uma vez por imagem e kDone na última.
+void test_split_reads_fill_each_image() {
+  for (int image_size : {28 * 28, 32 * 32 * 3, 96 * 96 * 3, 1, 7}) {
+    for (int images = 1; images <= 8; ++images) {
+      std::vector<uint8_t> body(image_size * images);
+      for (uint8_t& value : body) value = static_cast<uint8_t>(rng());
+      std::vector<std::vector<uint8_t>> slots(
+          images, std::vector<uint8_t>(image_size));
+      RawImageBody raw;
+      TEST_ASSERT_EQUAL(RawImageBody::kNeedMore,
+                        raw.begin(body.size(), image_size, 8));
+      const std::vector<RawImageBody::Status> statuses =
+          read_body(raw, body, slots, image_size);
+
+      TEST_ASSERT_EQUAL(RawImageBody::kDone, statuses.back());
+      TEST_ASSERT_EQUAL(images - 1,
+                        std::count(statuses.begin(), statuses.end(),
+                                   RawImageBody::kImageDone));
+      TEST_ASSERT_EQUAL(1, std::count(statuses.begin(), statuses.end(),
+                                      RawImageBody::kDone));
+      TEST_ASSERT_EQUAL(0, std::count(statuses.begin(), statuses.end(),
+                                      RawImageBody::kError));
+      for (int i = 0; i < images; ++i) {
+        TEST_ASSERT_EQUAL_MEMORY(&body[i * image_size], slots[i].data(),
+                                 image_size);
+      }
+      TEST_ASSERT_EQUAL(images, raw.images_done());
+      TEST_ASSERT_EQUAL(0, raw.remaining());
+      // O que vier depois do corpo não é pedido nem contado.
+      TEST_ASSERT_EQUAL(0, raw.want(100));
+      TEST_ASSERT_EQUAL(RawImageBody::kDone, raw.consume(5));
+      TEST_ASSERT_EQUAL(0, raw.remaining());
+    }
+  }
+}
+
+// Corpo mais curto que o Content-Length (a conexão cai ou o cliente mente):
+// a imagem incompleta nunca é dada como pronta e remaining() diz quanto
+// faltou, para a mensagem de "Corpo incompleto".
+void test_short_body_never_completes() {
+  const int kImageSize = 32 * 32 * 3;
+  for (int trial = 0; trial < 200; ++trial) {
+    const int images = 1 + rng() % 8;
+    const long content_length = static_cast<long>(images) * kImageSize;
+    const long sent = rng() % content_length;
+    std::vector<uint8_t> body(sent);
+    std::vector<std::vector<uint8_t>> slots(
+        images, std::vector<uint8_t>(kImageSize));
+    RawImageBody raw;
+    raw.begin(content_length, kImageSize, 8);
+    const std::vector<RawImageBody::Status> statuses =
+        read_body(raw, body, slots, kImageSize);
+    TEST_ASSERT_EQUAL(0, std::count(statuses.begin(), statuses.end(),
+                                    RawImageBody::kDone));
+    TEST_ASSERT_EQUAL(sent / kImageSize, raw.images_done());
+    TEST_ASSERT_EQUAL(sent % kImageSize, raw.filled());
+    TEST_ASSERT_EQUAL(content_length - sent, raw.remaining());
+    TEST_ASSERT_TRUE(raw.want(LONG_MAX) > 0);
+  }
+}
+
+// Ler mais do que want() deixou é erro, não escrita além do slot.
+void test_read_past_image_is_an_error() {
+  RawImageBody raw;
+  raw.begin(2 * 784, 784, 8);
+  TEST_ASSERT_EQUAL(RawImageBody::kNeedMore, raw.consume(700));
+  TEST_ASSERT_EQUAL(84, raw.want(1000));
+  TEST_ASSERT_EQUAL(RawImageBody::kError, raw.consume(85));
+  TEST_ASSERT_EQUAL_STRING("85 bytes lidos com 84 faltando na imagem 0",
+                           raw.error());
+  TEST_ASSERT_EQUAL(0, raw.want(1000));
+  TEST_ASSERT_EQUAL(RawImageBody::kError, raw.consume(1));
+}
+
+// Por imagem, do corpo no socket à entrada int8 no slot: /predict decodifica
+// o JSON com o PixelArrayParser (que já quantiza pela tabela) e
+// /predict_raw só conta os bytes e quantiza pela mesma tabela. Os dois
+// chegam à mesma entrada.
+void test_benchmark_against_json() {
+  struct Case {
+    const char* name;
+    int image_size;
+    InputQuantizer::Normalization normalization;
+    float scale;
+    int32_t zero_point;
+  };
+  const Case cases[] = {
+      {"MNIST", 28 * 28, InputQuantizer::kUnitRange, 1.0f / 255.0f, -128},
+      {"CIFAR-10", 32 * 32 * 3, InputQuantizer::kUnitRange, 1.0f / 255.0f,
+       -128},
+      {"MobileNetV2", 96 * 96 * 3, InputQuantizer::kSymmetricRange,
+       1.0f / 128.0f, 0},
+  };
+  for (const Case& c : cases) {
+    InputQuantizer quantizer;
+    quantizer.build(c.normalization, c.scale, c.zero_point);
+    std::vector<uint8_t> pixels(c.image_size);
+    for (uint8_t& value : pixels) value = static_cast<uint8_t>(rng());
+    const std::string json = json_body(pixels);
+
+    std::vector<int8_t> json_input(c.image_size);
+    PixelArrayParser parser(json_input.data(), c.image_size, quantizer.table());
+    auto parse_json = [&] {
+      parser.reset();
+      for (size_t offset = 0; offset < json.size(); offset += kSegmentSize) {
+        parser.feed(json.data() + offset,
+                    std::min<size_t>(kSegmentSize, json.size() - offset));
+      }
+      parser.finish();
+    };
+
+    std::vector<int8_t> raw_input(c.image_size);
+    RawImageBody raw;
+    auto read_raw = [&] {
+      raw.begin(c.image_size, c.image_size, 1);
+      size_t offset = 0;
+      while (raw.status() != RawImageBody::kDone) {
+        const int n = raw.want(kSegmentSize);
+        // O client.read() do socket, aqui uma cópia do segmento.
+        memcpy(raw_input.data() + raw.filled(), &pixels[offset], n);
+        quantizer.apply(raw_input.data() + raw.filled(), n);
+        offset += n;
+        raw.consume(n);
+      }
+    };
+
+    parse_json();
+    read_raw();
+    TEST_ASSERT_EQUAL(PixelArrayParser::kDone, parser.status());
+    TEST_ASSERT_EQUAL_INT8_ARRAY(json_input.data(), raw_input.data(),
+                                 c.image_size);
+
+    const int iterations = 20000000 / static_cast<int>(json.size());
+    double json_us = 1e9;
+    double raw_us = 1e9;
+    for (int round = 0; round < 3; ++round) {
+      json_us = std::min(json_us, micros_per_body(iterations, parse_json));
+      raw_us = std::min(raw_us, micros_per_body(iterations, read_raw));
+    }
+    char line[128];
+    snprintf(line, sizeof(line),
+             "%s: JSON %u B %.2f us, raw %d B %.2f us (%.1fx menos bytes, "
+             "%.0fx menos tempo)",
+             c.name, static_cast<unsigned>(json.size()), json_us, c.image_size,
+             raw_us, static_cast<double>(json.size()) / c.image_size,
+             json_us / raw_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_content_length_validation);
+  RUN_TEST(test_split_reads_fill_each_image);
+  RUN_TEST(test_short_body_never_completes);
+  RUN_TEST(test_read_past_image_is_an_error);
+  RUN_TEST(test_benchmark_against_json);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,97 @@
+#ifndef HTTP_REQUEST_PARSER_H_
+#define HTTP_REQUEST_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parser incremental da linha de requisição e dos headers HTTP/1.x.
+//
+// Consome exatamente até a linha em branco que fecha os headers e para ali,
+// então o corpo (Content-Length bytes) e as próximas requisições de uma
+// conexão keep-alive ou pipelined continuam no socket para quem for lê-los.
+// Só guarda o que os servidores usam: método, caminho, query string,
+// Content-Length e se a conexão deve continuar aberta. Não aloca memória.
+class HttpRequestParser {
+ public:
+  enum Status { kNeedMore, kDone, kError };
+
+  static constexpr int kMaxMethodLength = 8;
+  static constexpr int kMaxPathLength = 64;
+  static constexpr int kMaxQueryLength = 64;
+  static constexpr int kMaxLineLength = 256;
+  static constexpr int kMaxHeaderBytes = 4096;
+  static constexpr long kMaxContentLength = 1024 * 1024;
+
+  HttpRequestParser();
+
+  // Volta ao início para a próxima requisição da conexão.
+  void reset();
+
+  // Consome um byte. Retorna kDone no fim dos headers, kError no primeiro
+  // erro e kNeedMore enquanto os headers não terminaram. Depois de kDone ou
+  // kError os bytes seguintes não são consumidos.
+  Status feed(char c);
+
+  // Consome bytes de `data` até o fim dos headers ou até um erro e devolve
+  // em `consumed` quantos foram usados; o resto pertence ao corpo ou à
+  // próxima requisição.
+  Status feed(const char* data, size_t size, size_t* consumed);
+
+  Status status() const { return status_; }
+  // Verdadeiro depois do primeiro byte da requisição (linhas em branco antes
+  // da linha de requisição não contam).
+  bool started() const { return started_; }
+
+  const char* method() const { return method_; }
+  const char* path() const { return path_; }
+  // O que vem depois do '?', sem decodificar; vazia se não houver.
+  const char* query() const { return query_; }
+  // Compara método e caminho exatos, por exemplo matches("POST", "/predict").
+  bool matches(const char* method, const char* path) const;
+  // Valor inteiro do parâmetro `name` da query ("?width=32&height=32").
+  // Devolve `fallback` se o parâmetro não existir e -1 se o valor não for
+  // um inteiro não negativo.
+  long query_int(const char* name, long fallback) const;
+
+  long content_length() const { return content_length_; }
+  // HTTP/1.1 mantém a conexão salvo "Connection: close"; HTTP/1.0 só com
+  // "Connection: keep-alive".
+  bool keep_alive() const { return keep_alive_; }
+  // O cliente mandou "Expect: 100-continue" e espera o 100 antes do corpo.
+  bool expect_continue() const { return expect_continue_; }
+
+  // Status HTTP a responder quando status() == kError (400, 413, 414, 431,
+  // 501 ou 505) e a mensagem correspondente.
+  int error_status() const { return error_status_; }
+  const char* error() const { return error_; }
+
+ private:
+  Status process_line();
+  Status parse_request_line();
+  Status parse_header_line();
+  Status fail(int http_status, const char* message);
+
+  Status status_;
+  bool started_;
+  bool request_line_done_;
+  bool line_overflow_;
+  int line_length_;
+  int header_bytes_;
+
+  long content_length_;
+  bool has_content_length_;
+  bool keep_alive_;
+  bool expect_continue_;
+  int error_status_;
+  const char* error_;
+
+  char method_[kMaxMethodLength];
+  char path_[kMaxPathLength];
+  char query_[kMaxQueryLength];
+  char line_[kMaxLineLength];
+};
+
+// Frase padrão de um status HTTP ("OK", "Bad Request", ...).
+const char* http_status_text(int http_status);
+
+#endif  // HTTP_REQUEST_PARSER_H_
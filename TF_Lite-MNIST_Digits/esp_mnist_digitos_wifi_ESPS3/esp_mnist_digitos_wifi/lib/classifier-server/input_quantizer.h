@@ -0,0 +1,46 @@
+#ifndef INPUT_QUANTIZER_H_
+#define INPUT_QUANTIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Leva pixels 0..255 ao int8 da entrada do modelo por uma tabela de 256
+// entradas, montada uma vez a partir de input_tensor->params depois do
+// AllocateTensors.
+//
+// Cada entrada é calculada com a mesma conta em float que as aplicações
+// faziam por pixel (normaliza, divide pela escala, roundf, soma o zero point
+// e satura), então o resultado é idêntico bit a bit; por pixel só sobra a
+// leitura da tabela.
+class InputQuantizer {
+ public:
+  // Normalização aplicada ao pixel antes de quantizar.
+  enum Normalization {
+    kUnitRange,       // pixel / 255, em [0, 1]
+    kSymmetricRange,  // (pixel - 127.5) / 127.5, em [-1, 1] (MobileNetV2)
+  };
+
+  InputQuantizer();
+
+  // Monta a tabela para a escala e o zero point do tensor de entrada.
+  void build(Normalization normalization, float scale, int32_t zero_point);
+
+  // Um pixel, pela conta em float (usada para montar e conferir a tabela).
+  static int8_t quantize(uint8_t pixel, Normalization normalization,
+                         float scale, int32_t zero_point);
+
+  int8_t operator[](uint8_t pixel) const { return table_[pixel]; }
+  // A tabela, para quem quantiza um valor por vez (PixelArrayParser).
+  const int8_t* table() const { return table_; }
+
+  // Quantiza `count` bytes. `data` chega com os pixels 0..255 lidos do
+  // socket e sai com os int8 do modelo, no mesmo buffer.
+  void apply(int8_t* data, size_t count) const;
+  // Idem, de `input` para `output` (que podem ser o mesmo buffer).
+  void apply(const uint8_t* input, int8_t* output, size_t count) const;
+
+ private:
+  int8_t table_[256];
+};
+
+#endif  // INPUT_QUANTIZER_H_
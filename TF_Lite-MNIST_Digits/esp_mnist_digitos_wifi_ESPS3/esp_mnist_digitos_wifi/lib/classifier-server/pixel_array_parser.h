@@ -0,0 +1,77 @@
+#ifndef PIXEL_ARRAY_PARSER_H_
+#define PIXEL_ARRAY_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Parser incremental do corpo {"pixels": [v0, v1, ...]} de POST /predict.
+//
+// O corpo chega em pedaços de qualquer tamanho, na ordem em que são lidos do
+// socket, e cada valor é gravado já quantizado em `output` (normalmente
+// input_tensor->data.int8) por meio de `quant_table`, que leva o pixel 0..255
+// ao int8 do modelo. Com `quant_table` nullptr o pixel é gravado como está
+// (os bits do uint8), para quem ainda vai redimensionar a imagem. Nada é
+// alocado e o corpo não é guardado: entre um pedaço e outro só ficam o
+// estado, o número em andamento e a posição no texto.
+//
+// Os valores são inteiros, com sinal opcional, limitados a 0..255 como nos
+// parsers antigos.
+// Campos antes de "pixels" e o que vier depois do ']' são ignorados.
+class PixelArrayParser {
+ public:
+  enum Status { kNeedMore, kDone, kError };
+
+  PixelArrayParser(int8_t* output, int expected_values,
+                   const int8_t* quant_table);
+
+  // Volta ao início para um novo corpo.
+  void reset();
+  // Idem, gravando o próximo corpo em `output` (um slot de entrada diferente).
+  void reset(int8_t* output);
+  // Idem, trocando também o número de valores esperados e a tabela.
+  void reset(int8_t* output, int expected_values, const int8_t* quant_table);
+
+  // Consome `size` bytes do corpo. Retorna kDone quando o ']' que fecha o
+  // array foi lido com exatamente `expected_values` valores, kError no
+  // primeiro erro e kNeedMore enquanto o array não terminou. Depois de kDone
+  // ou kError os bytes seguintes são ignorados.
+  Status feed(const char* data, size_t size);
+
+  // Marca o fim do corpo; se o array não foi fechado, vira erro.
+  Status finish();
+
+  Status status() const { return status_; }
+  int values_parsed() const { return count_; }
+  // Mensagem do erro, com o índice do valor e a posição em bytes no corpo.
+  // Vazia se não houve erro.
+  const char* error() const { return error_; }
+
+ private:
+  enum State : uint8_t {
+    kSeekKey,      // procurando "pixels"
+    kSeekColon,    // depois de "pixels", esperando ':'
+    kSeekBracket,  // depois do ':', esperando '['
+    kSeekValue,    // esperando um valor (ou ']' se o array estiver vazio)
+    kSign,         // depois de '-' ou '+', esperando um dígito
+    kNumber,       // dentro de um número
+    kAfterValue,   // esperando ',' ou ']'
+  };
+
+  void store_value();
+  Status fail(const char* format, ...);
+
+  int8_t* output_;
+  const int8_t* quant_table_;
+  int expected_;
+
+  State state_;
+  Status status_;
+  int count_;
+  uint8_t key_matched_;  // caracteres de "pixels" (com as aspas) já casados
+  bool negative_;
+  int value_;
+  size_t offset_;  // bytes consumidos até o início do pedaço atual
+  char error_[128];
+};
+
+#endif  // PIXEL_ARRAY_PARSER_H_
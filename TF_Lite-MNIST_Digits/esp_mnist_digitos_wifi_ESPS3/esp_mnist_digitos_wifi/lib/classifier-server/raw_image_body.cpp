@@ -0,0 +1,63 @@
+#include "raw_image_body.h"
+
+#include <stdio.h>
+
+RawImageBody::RawImageBody()
+    : status_(kError),
+      image_size_(1),
+      image_count_(0),
+      images_done_(0),
+      filled_(0),
+      remaining_(0) {
+  error_[0] = '\0';
+}
+
+RawImageBody::Status RawImageBody::begin(long content_length, int image_size,
+                                         int max_images) {
+  image_size_ = image_size > 0 ? image_size : 1;
+  images_done_ = 0;
+  filled_ = 0;
+  remaining_ = 0;
+  image_count_ = 0;
+  error_[0] = '\0';
+  if (content_length <= 0 || content_length % image_size_ != 0 ||
+      content_length / image_size_ > max_images) {
+    snprintf(error_, sizeof(error_),
+             "Corpo deve ter %d bytes por imagem (até %d imagens), "
+             "recebido: %ld",
+             image_size_, max_images, content_length);
+    status_ = kError;
+    return status_;
+  }
+  image_count_ = static_cast<int>(content_length / image_size_);
+  remaining_ = content_length;
+  status_ = kNeedMore;
+  return status_;
+}
+
+int RawImageBody::want(long available) const {
+  if (status_ == kDone || status_ == kError || available <= 0) return 0;
+  const int rest = image_size_ - filled_;
+  return available < rest ? static_cast<int>(available) : rest;
+}
+
+RawImageBody::Status RawImageBody::consume(int size) {
+  if (status_ == kDone || status_ == kError || size <= 0) return status_;
+  if (size > image_size_ - filled_) {
+    snprintf(error_, sizeof(error_),
+             "%d bytes lidos com %d faltando na imagem %d", size,
+             image_size_ - filled_, images_done_);
+    status_ = kError;
+    return status_;
+  }
+  filled_ += size;
+  remaining_ -= size;
+  if (filled_ < image_size_) {
+    status_ = kNeedMore;
+  } else {
+    filled_ = 0;
+    images_done_++;
+    status_ = images_done_ == image_count_ ? kDone : kImageDone;
+  }
+  return status_;
+}
@@ -0,0 +1,49 @@
+#ifndef RAW_IMAGE_BODY_H_
+#define RAW_IMAGE_BODY_H_
+
+#include <stdint.h>
+
+// Contabilidade do corpo de POST /predict_raw: `image_size` bytes por
+// imagem (pixels 0..255 em HWC, como no array de /predict), de 1 a
+// `max_images` imagens, lidos do socket direto nos slots de entrada.
+//
+// begin() valida o Content-Length antes de qualquer leitura. Depois, cada
+// leitura pede no máximo want() bytes, para não passar do fim da imagem
+// atual, grava a partir de filled() no slot e informa o que chegou em
+// consume(). Nada do corpo passa por aqui: só os contadores.
+class RawImageBody {
+ public:
+  enum Status { kNeedMore, kImageDone, kDone, kError };
+
+  RawImageBody();
+
+  // Começa um corpo de `content_length` bytes. kError (com error()) se não
+  // for um múltiplo positivo de `image_size` com até `max_images` imagens.
+  Status begin(long content_length, int image_size, int max_images);
+
+  // Quantos dos `available` bytes no socket a próxima leitura pode pedir.
+  int want(long available) const;
+  // Conta `size` bytes gravados a partir de filled(). kImageDone quando uma
+  // imagem completa, kDone quando completa a última, kNeedMore antes disso.
+  Status consume(int size);
+
+  Status status() const { return status_; }
+  int image_count() const { return image_count_; }
+  int images_done() const { return images_done_; }
+  // Bytes já gravados na imagem atual.
+  int filled() const { return filled_; }
+  // Bytes do corpo que ainda faltam.
+  long remaining() const { return remaining_; }
+  const char* error() const { return error_; }
+
+ private:
+  Status status_;
+  int image_size_;
+  int image_count_;
+  int images_done_;
+  int filled_;
+  long remaining_;
+  char error_[96];
+};
+
+#endif  // RAW_IMAGE_BODY_H_
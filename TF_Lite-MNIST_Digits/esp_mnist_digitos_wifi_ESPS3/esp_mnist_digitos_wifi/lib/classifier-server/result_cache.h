@@ -0,0 +1,95 @@
+#ifndef RESULT_CACHE_H_
+#define RESULT_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+
+#include "top_k.h"
+
+// Saída do modelo já pós-processada: as kMaxTopK primeiras classes, o
+// suficiente para responder qualquer ?top_k.
+struct CachedPrediction {
+  int count;
+  int classes[kMaxTopK];
+  float scores[kMaxTopK];
+};
+
+// Cache LRU de tamanho fixo dos resultados da inferência, indexado por um
+// hash de 64 bits da entrada já quantizada (o tensor de entrada pronto para
+// o Invoke()).
+//
+// A mesma entrada produz sempre a mesma saída, então um acerto dispensa o
+// Invoke(). A entrada em si não é guardada (seriam 27 KB por entrada na
+// MobileNetV2); cada entrada guarda também um segundo hash, FNV-1a, de
+// outra família, e só há acerto se os dois baterem. Duas imagens com o
+// mesmo MurmurHash e FNV-1a diferente contam como falha (e em
+// Stats::collisions). Com poucas dezenas de entradas a busca é uma
+// varredura linear, como os slots da InferenceQueue. clear() descarta tudo e deve ser chamado sempre
+// que o modelo for (re)carregado.
+//
+// lookup() e insert() são chamados pela tarefa de inferência e stats() pela
+// de rede, então tudo passa por um std::mutex.
+class ResultCache {
+ public:
+  static constexpr int kMaxEntries = 64;
+
+  struct Stats {
+    int capacity;
+    int entries;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t collisions;       // falhas com o mesmo hash e outro check
+    uint32_t invalidations;    // clear() com o cache não vazio
+    uint64_t total_lookup_us;  // hash + busca, em todo lookup()
+    uint32_t max_lookup_us;
+    uint64_t total_invoke_us;  // informado no insert(): o custo de uma falha
+  };
+
+  // Os dois hashes de uma entrada, calculados no lookup() e repassados ao
+  // insert() numa falha.
+  struct Key {
+    uint64_t hash;
+    uint64_t check;
+  };
+
+  // `capacity` 0 desliga o cache: lookup() sempre falha sem calcular o hash.
+  explicit ResultCache(int capacity);
+
+  // MurmurHash64A: palavras de 8 bytes, bom espalhamento e sem tabela.
+  static uint64_t hash(const void* data, size_t size);
+  // FNV-1a de 64 bits, a confirmação de um acerto.
+  static uint64_t check(const void* data, size_t size);
+
+  // Calcula os hashes de `input` em `key` e procura o resultado. Verdadeiro
+  // (com `prediction` preenchido) num acerto.
+  bool lookup(const void* input, size_t size, Key* key,
+              CachedPrediction* prediction);
+  // Guarda o resultado de uma falha, no lugar da entrada usada há mais
+  // tempo se o cache estiver cheio. `invoke_us` é quanto a inferência
+  // custou, para comparar com o custo de um acerto.
+  void insert(const Key& key, const CachedPrediction& prediction,
+              uint32_t invoke_us);
+  void clear();
+
+  Stats stats() const;
+
+ private:
+  struct Entry {
+    Key key;
+    uint32_t last_used;  // valor de clock_ no último acesso; 0 = vazia
+    CachedPrediction prediction;
+  };
+
+  static uint32_t now_us();
+
+  const int capacity_;
+  mutable std::mutex mutex_;
+  Entry entries_[kMaxEntries];
+  uint32_t clock_;
+  Stats stats_;
+};
+
+#endif  // RESULT_CACHE_H_
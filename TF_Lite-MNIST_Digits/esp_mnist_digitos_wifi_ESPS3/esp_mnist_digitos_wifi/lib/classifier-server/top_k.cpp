@@ -0,0 +1,31 @@
+#include "top_k.h"
+
+int select_top_k(const int8_t* values, int count, int k, float scale,
+                 int32_t zero_point, int* classes, float* scores) {
+  if (k < 1) k = 1;
+  if (k > kMaxTopK) k = kMaxTopK;
+  if (k > count) k = count;
+  if (k <= 0) return 0;
+
+  int8_t best[kMaxTopK];
+  int filled = 0;
+  for (int i = 0; i < count; ++i) {
+    const int8_t value = values[i];
+    // Com o ranking cheio, só entra quem supera o último; igual não entra,
+    // para o índice menor ficar na frente.
+    if (filled == k && value <= best[k - 1]) continue;
+    int position = filled < k ? filled++ : k - 1;
+    while (position > 0 && best[position - 1] < value) {
+      best[position] = best[position - 1];
+      classes[position] = classes[position - 1];
+      --position;
+    }
+    best[position] = value;
+    classes[position] = i;
+  }
+
+  for (int i = 0; i < k; ++i) {
+    scores[i] = (static_cast<float>(best[i]) - zero_point) * scale;
+  }
+  return k;
+}
@@ -0,0 +1,51 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_FFT_RADIX4_H_
+#define TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_FFT_RADIX4_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tensorflow/lite/experimental/microfrontend/lib/fft.h"
+
+// Real-input, power-of-two, 16-bit fixed-point FFT used by FftCompute.
+//
+// The input is treated as fft_size / 2 complex values, transformed with
+// iterative radix-4 stages (plus one radix-2 stage when log2(fft_size / 2) is
+// odd) and split into the fft_size / 2 + 1 bins of the real transform. The
+// rounding and 1/N scaling of every butterfly follow kiss_fftr with
+// FIXED_POINT=16, so the output is bit-exact with the kissfft version it
+// replaces.
+//
+// Compared to kissfft the stages run without recursion, each stage reads its
+// twiddles contiguously, the first stage is fused with the digit-reversal
+// load and needs no multiplies, the k = 0 butterflies of later stages skip
+// their multiplies (exact, since the twiddle there rounds to identity), and
+// the real split runs in place in the output.
+
+// Bytes of scratch needed for the given fft_size; 0 if fft_size is not a
+// power of two of at least 4.
+size_t FftRadix4ScratchSize(size_t fft_size);
+
+// Precomputes twiddles and the load order into `scratch`. Returns 1 on
+// success and 0 if scratch_size is too small.
+int FftRadix4Init(size_t fft_size, void* scratch, size_t scratch_size);
+
+// Transforms fft_size real values. `output` must hold fft_size / 2 + 1
+// values and must not overlap `input`.
+void FftRadix4Real(const void* scratch, const int16_t* input,
+                   struct complex_int16_t* output);
+
+#endif  // TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_FFT_RADIX4_H_
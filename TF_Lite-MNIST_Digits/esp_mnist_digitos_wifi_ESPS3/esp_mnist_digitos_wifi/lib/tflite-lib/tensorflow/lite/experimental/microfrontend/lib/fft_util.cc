@@ -16,7 +16,7 @@ limitations under the License.
 
 #include <stdio.h>
 
-#include "tensorflow/lite/experimental/microfrontend/lib/kiss_fft_int16.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_radix4.h"
 
 int FftPopulateState(struct FftState* state, size_t input_size) {
   state->input_size = input_size;
@@ -39,12 +39,9 @@ int FftPopulateState(struct FftState* state, size_t input_size) {
     return 0;
   }
 
-  // Ask kissfft how much memory it wants.
-  size_t scratch_size = 0;
-  kissfft_fixed16::kiss_fftr_cfg kfft_cfg = kissfft_fixed16::kiss_fftr_alloc(
-      state->fft_size, 0, nullptr, &scratch_size);
-  if (kfft_cfg != nullptr) {
-    fprintf(stderr, "Kiss memory sizing failed.\n");
+  const size_t scratch_size = FftRadix4ScratchSize(state->fft_size);
+  if (scratch_size == 0) {
+    fprintf(stderr, "Unsupported fft size %zu\n", state->fft_size);
     return 0;
   }
   state->scratch = malloc(scratch_size);
@@ -53,11 +50,8 @@ int FftPopulateState(struct FftState* state, size_t input_size) {
     return 0;
   }
   state->scratch_size = scratch_size;
-  // Let kissfft configure the scratch space we just allocated
-  kfft_cfg = kissfft_fixed16::kiss_fftr_alloc(state->fft_size, 0,
-                                              state->scratch, &scratch_size);
-  if (kfft_cfg != state->scratch) {
-    fprintf(stderr, "Kiss memory preallocation strategy failed.\n");
+  if (!FftRadix4Init(state->fft_size, state->scratch, scratch_size)) {
+    fprintf(stderr, "Failed to init fft scratch buffer\n");
     return 0;
   }
   return 1;
@@ -0,0 +1,121 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_FULLY_CONNECTED_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_FULLY_CONNECTED_H_
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_ops {
+
+// Same blocking as optimized_integer_ops::FullyConnected: 4 output channels
+// per pass over the input, 2 batch rows sharing each weight load.
+constexpr int kFloatFullyConnectedRowBlock = 4;
+constexpr int kFloatFullyConnectedBatchBlock = 2;
+
+// Each accumulator sums over d in the same order as
+// reference_ops::FullyConnected, which gives the same floats only without
+// fast math. tflite-lib is built with -Ofast, so the compiler may reassociate
+// or contract to FMA differently in the two kernels; there they agree to
+// within rounding, not bit for bit.
+template <int kRows, int kBatches>
+inline void FloatFullyConnectedBlock(const float* input_data,
+                                     const float* weights_data,
+                                     const float* bias_data, int accum_depth,
+                                     int output_depth, float activation_min,
+                                     float activation_max,
+                                     float* output_data) {
+  float acc[kBatches][kRows] = {};
+  for (int d = 0; d < accum_depth; ++d) {
+    float input_val[kBatches];
+    for (int b = 0; b < kBatches; ++b) {
+      input_val[b] = input_data[b * accum_depth + d];
+    }
+    for (int r = 0; r < kRows; ++r) {
+      const float weight_val = weights_data[r * accum_depth + d];
+      for (int b = 0; b < kBatches; ++b) {
+        acc[b][r] += input_val[b] * weight_val;
+      }
+    }
+  }
+  // Bias and the fused activation (ReLU, ReLU6, ...) are applied while the
+  // accumulators are still in registers.
+  for (int b = 0; b < kBatches; ++b) {
+    for (int r = 0; r < kRows; ++r) {
+      const float bias_value = bias_data ? bias_data[r] : 0.0f;
+      output_data[b * output_depth + r] = ActivationFunctionWithMinMax(
+          acc[b][r] + bias_value, activation_min, activation_max);
+    }
+  }
+}
+
+template <int kBatches>
+inline void FloatFullyConnectedBatchRows(const float* input_data,
+                                         const float* weights_data,
+                                         const float* bias_data,
+                                         int accum_depth, int output_depth,
+                                         float activation_min,
+                                         float activation_max,
+                                         float* output_data) {
+  int out_c = 0;
+  for (; out_c + kFloatFullyConnectedRowBlock <= output_depth;
+       out_c += kFloatFullyConnectedRowBlock) {
+    FloatFullyConnectedBlock<kFloatFullyConnectedRowBlock, kBatches>(
+        input_data, weights_data + out_c * accum_depth,
+        bias_data ? bias_data + out_c : nullptr, accum_depth, output_depth,
+        activation_min, activation_max, output_data + out_c);
+  }
+  for (; out_c < output_depth; ++out_c) {
+    FloatFullyConnectedBlock<1, kBatches>(
+        input_data, weights_data + out_c * accum_depth,
+        bias_data ? bias_data + out_c : nullptr, accum_depth, output_depth,
+        activation_min, activation_max, output_data + out_c);
+  }
+}
+
+inline void FullyConnected(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const float* input_data, const RuntimeShape& weights_shape,
+    const float* weights_data, const RuntimeShape& bias_shape,
+    const float* bias_data, const RuntimeShape& output_shape,
+    float* output_data) {
+  const int output_dims_count = output_shape.DimensionsCount();
+  const int weights_dims_count = weights_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dims_count - 1);
+  const int output_depth = MatchingDim(weights_shape, weights_dims_count - 2,
+                                       output_shape, output_dims_count - 1);
+  const int accum_depth = weights_shape.Dims(weights_dims_count - 1);
+
+  int b = 0;
+  for (; b + kFloatFullyConnectedBatchBlock <= batches;
+       b += kFloatFullyConnectedBatchBlock) {
+    FloatFullyConnectedBatchRows<kFloatFullyConnectedBatchBlock>(
+        input_data + b * accum_depth, weights_data, bias_data, accum_depth,
+        output_depth, params.float_activation_min,
+        params.float_activation_max, output_data + b * output_depth);
+  }
+  for (; b < batches; ++b) {
+    FloatFullyConnectedBatchRows<1>(
+        input_data + b * accum_depth, weights_data, bias_data, accum_depth,
+        output_depth, params.float_activation_min,
+        params.float_activation_max, output_data + b * output_depth);
+  }
+}
+
+}  // namespace optimized_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_FULLY_CONNECTED_H_
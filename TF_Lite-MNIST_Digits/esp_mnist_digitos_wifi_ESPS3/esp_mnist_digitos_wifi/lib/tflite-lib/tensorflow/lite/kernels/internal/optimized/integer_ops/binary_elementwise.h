@@ -0,0 +1,343 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_BINARY_ELEMENTWISE_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_BINARY_ELEMENTWISE_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/requantize.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// One table entry per int8 value, indexed by value + 128.
+constexpr int kScaledInputTableSize = 256;
+
+// Add, Sub and SquaredDifference only use the per-input tables when the
+// output has at least this many elements. The tables depend only on the
+// quantization params, so they are filled once in Prepare and kept in
+// persistent memory; below this size the 2 KB per op is not worth the two
+// multiplies per element it saves.
+constexpr int kScaledInputTableMinElements = 512;
+
+// Persistent bytes needed for the tables of both inputs, input1's first.
+constexpr int kScaledInputTablesBytes =
+    2 * kScaledInputTableSize * sizeof(int32_t);
+
+// Add, Sub and SquaredDifference bring both inputs to a common fixed-point
+// scale before combining them. That rescaling depends only on the int8 value
+// and the per-tensor params, so it is done once per possible value here
+// instead of once per element.
+inline void PopulateScaledInputTable(int32_t input_offset,
+                                     int32_t input_multiplier, int input_shift,
+                                     int left_shift, int32_t* table) {
+  for (int i = 0; i < kScaledInputTableSize; ++i) {
+    const int32_t input_val = input_offset + (i - 128);
+    table[i] = MultiplyByQuantizedMultiplierSmallerThanOneExp(
+        input_val * (1 << left_shift), input_multiplier, input_shift);
+  }
+}
+
+inline int32_t ScaledInput(const int32_t* table, int8_t value) {
+  return table[value + 128];
+}
+
+// Computes raw(i) for i < size into blocks of int32 values, each requantized
+// with the per-tensor output params as one row. All the ops below feed their
+// output stage through this.
+template <typename T, typename RawFn>
+inline void RequantizeOutput(const ArithmeticParams& params, int size,
+                             const RawFn& raw, T* output_data) {
+  int32_t block[kRequantizeBlockSize];
+  for (int start = 0; start < size; start += kRequantizeBlockSize) {
+    const int block_size = std::min(kRequantizeBlockSize, size - start);
+    for (int i = 0; i < block_size; ++i) {
+      block[i] = raw(start + i);
+    }
+    RequantizeRow(block, nullptr, params.output_multiplier,
+                  params.output_shift, params.output_offset,
+                  params.quantized_activation_min,
+                  params.quantized_activation_max, block_size,
+                  output_data + start);
+  }
+}
+
+// Combining steps ahead of the output rescale; with it they are bit-exact
+// with AddFunc, SubElementwise and the SquaredDifference kernel
+// respectively.
+struct AddOutput {
+  static int32_t Raw(int32_t scaled1, int32_t scaled2) {
+    return scaled1 + scaled2;
+  }
+};
+
+struct SubOutput {
+  static int32_t Raw(int32_t scaled1, int32_t scaled2) {
+    return scaled1 - scaled2;
+  }
+};
+
+struct SquaredDifferenceOutput {
+  static int32_t Raw(int32_t scaled1, int32_t scaled2) {
+    const int32_t raw_diff = scaled1 - scaled2;
+    return raw_diff * raw_diff;
+  }
+};
+
+// Binary op over inputs rescaled through PopulateScaledInputTable tables.
+// When one side is broadcast its scaled value is looked up once per run.
+template <typename Output>
+class ScaledInputsOp {
+ public:
+  ScaledInputsOp(const ArithmeticParams& params, const int32_t* input1_table,
+                 const int32_t* input2_table)
+      : params_(params),
+        input1_table_(input1_table),
+        input2_table_(input2_table) {}
+
+  void Elementwise(int size, const int8_t* input1_data,
+                   const int8_t* input2_data, int8_t* output_data) const {
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return Output::Raw(ScaledInput(input1_table_, input1_data[i]),
+                             ScaledInput(input2_table_, input2_data[i]));
+        },
+        output_data);
+  }
+
+  void Input1Scalar(int size, int8_t input1, const int8_t* input2_data,
+                    int8_t* output_data) const {
+    const int32_t scaled1 = ScaledInput(input1_table_, input1);
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return Output::Raw(scaled1,
+                             ScaledInput(input2_table_, input2_data[i]));
+        },
+        output_data);
+  }
+
+  void Input2Scalar(int size, const int8_t* input1_data, int8_t input2,
+                    int8_t* output_data) const {
+    const int32_t scaled2 = ScaledInput(input2_table_, input2);
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return Output::Raw(ScaledInput(input1_table_, input1_data[i]),
+                             scaled2);
+        },
+        output_data);
+  }
+
+ private:
+  const ArithmeticParams& params_;
+  const int32_t* input1_table_;
+  const int32_t* input2_table_;
+};
+
+using AddOp = ScaledInputsOp<AddOutput>;
+using SubOp = ScaledInputsOp<SubOutput>;
+using SquaredDifferenceOp = ScaledInputsOp<SquaredDifferenceOutput>;
+
+// Mul has no per-input rescaling to hoist, only the zero points; bit-exact
+// with reference_integer_ops::MulElementwise.
+class MulOp {
+ public:
+  explicit MulOp(const ArithmeticParams& params) : params_(params) {}
+
+  void Elementwise(int size, const int8_t* input1_data,
+                   const int8_t* input2_data, int8_t* output_data) const {
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return (params_.input1_offset + input1_data[i]) *
+                 (params_.input2_offset + input2_data[i]);
+        },
+        output_data);
+  }
+
+  void Input1Scalar(int size, int8_t input1, const int8_t* input2_data,
+                    int8_t* output_data) const {
+    const int32_t input1_val = params_.input1_offset + input1;
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return input1_val * (params_.input2_offset + input2_data[i]);
+        },
+        output_data);
+  }
+
+  void Input2Scalar(int size, const int8_t* input1_data, int8_t input2,
+                    int8_t* output_data) const {
+    const int32_t input2_val = params_.input2_offset + input2;
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return (params_.input1_offset + input1_data[i]) * input2_val;
+        },
+        output_data);
+  }
+
+ private:
+  const ArithmeticParams& params_;
+};
+
+// Int16 Add. 65536-entry tables would not pay off, so both inputs are
+// rescaled per element as in reference_ops::AddElementwise, except that a
+// broadcast input is rescaled once per run.
+class AddInt16Op {
+ public:
+  explicit AddInt16Op(const ArithmeticParams& params) : params_(params) {}
+
+  void Elementwise(int size, const int16_t* input1_data,
+                   const int16_t* input2_data, int16_t* output_data) const {
+    RequantizeOutput(
+        params_, size,
+        [&](int i) {
+          return Scale1(input1_data[i]) + Scale2(input2_data[i]);
+        },
+        output_data);
+  }
+
+  void Input1Scalar(int size, int16_t input1, const int16_t* input2_data,
+                    int16_t* output_data) const {
+    const int32_t scaled1 = Scale1(input1);
+    RequantizeOutput(
+        params_, size, [&](int i) { return scaled1 + Scale2(input2_data[i]); },
+        output_data);
+  }
+
+  void Input2Scalar(int size, const int16_t* input1_data, int16_t input2,
+                    int16_t* output_data) const {
+    const int32_t scaled2 = Scale2(input2);
+    RequantizeOutput(
+        params_, size, [&](int i) { return Scale1(input1_data[i]) + scaled2; },
+        output_data);
+  }
+
+ private:
+  // MultiplyByQuantizedMultiplierSmallerThanOneExp of the shifted input.
+  int32_t Scale1(int16_t value) const {
+    return MultiplyByQuantizedMultiplierSplit(
+        (params_.input1_offset + value) * (1 << params_.left_shift),
+        params_.input1_multiplier, 0, -params_.input1_shift);
+  }
+
+  int32_t Scale2(int16_t value) const {
+    return MultiplyByQuantizedMultiplierSplit(
+        (params_.input2_offset + value) * (1 << params_.left_shift),
+        params_.input2_multiplier, 0, -params_.input2_shift);
+  }
+
+  const ArithmeticParams& params_;
+};
+
+// Fivefold broadcast loop over params.broadcast_shape as filled in by
+// reference_ops::ProcessBroadcastShapes. Input "a" is the one broadcast
+// along y3 and input "b" the one broadcast along y1:
+//   a.FlatSize() == y0 * y1 * y2 * y4, b.FlatSize() == y0 * y2 * y3 * y4.
+// Runs of y4 contiguous elements go to op.Elementwise; when y4 == 1 a single
+// element of a is broadcast over y3 contiguous elements of b instead. The op
+// always sees the inputs in their original order, so Sub stays correct when
+// the second input is the one broadcast.
+template <typename T, typename Op>
+inline void BroadcastBinaryFiveFold(const ArithmeticParams& params,
+                                    const T* input1_data, const T* input2_data,
+                                    T* output_data, const Op& op) {
+  const bool input1_is_a = params.broadcast_category ==
+                           BroadcastableOpCategory::kFirstInputBroadcastsFast;
+  const T* a_data = input1_is_a ? input1_data : input2_data;
+  const T* b_data_reset = input1_is_a ? input2_data : input1_data;
+
+  const int y0 = params.broadcast_shape[0];
+  const int y1 = params.broadcast_shape[1];
+  const int y2 = params.broadcast_shape[2];
+  const int y3 = params.broadcast_shape[3];
+  const int y4 = params.broadcast_shape[4];
+
+  for (int i0 = 0; i0 < y0; ++i0) {
+    const T* b_data = b_data_reset;
+    for (int i1 = 0; i1 < y1; ++i1) {
+      b_data = b_data_reset;
+      for (int i2 = 0; i2 < y2; ++i2) {
+        if (y4 > 1) {
+          for (int i3 = 0; i3 < y3; ++i3) {
+            if (input1_is_a) {
+              op.Elementwise(y4, a_data, b_data, output_data);
+            } else {
+              op.Elementwise(y4, b_data, a_data, output_data);
+            }
+            b_data += y4;
+            output_data += y4;
+          }
+          a_data += y4;
+        } else {
+          if (input1_is_a) {
+            op.Input1Scalar(y3, *a_data, b_data, output_data);
+          } else {
+            op.Input2Scalar(y3, b_data, *a_data, output_data);
+          }
+          b_data += y3;
+          output_data += y3;
+          a_data += 1;
+        }
+      }
+    }
+    b_data_reset = b_data;
+  }
+}
+
+// True when BinaryElementwise can handle the shapes described by params,
+// i.e. after ProcessBroadcastShapes did not fall back to kGenericBroadcast.
+inline bool BinaryElementwiseSupported(const ArithmeticParams& params,
+                                       bool need_broadcast) {
+  return !need_broadcast ||
+         params.broadcast_category ==
+             BroadcastableOpCategory::kFirstInputBroadcastsFast ||
+         params.broadcast_category ==
+             BroadcastableOpCategory::kSecondInputBroadcastsFast;
+}
+
+// `need_broadcast` is the result of ProcessBroadcastShapes on the two input
+// shapes; params must satisfy BinaryElementwiseSupported. T is int8_t, or
+// int16_t for AddInt16Op.
+template <typename T, typename Op>
+inline void BinaryElementwise(const ArithmeticParams& params,
+                              bool need_broadcast,
+                              const RuntimeShape& input1_shape,
+                              const T* input1_data,
+                              const RuntimeShape& input2_shape,
+                              const T* input2_data,
+                              const RuntimeShape& output_shape, T* output_data,
+                              const Op& op) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  TFLITE_DCHECK(BinaryElementwiseSupported(params, need_broadcast));
+  if (need_broadcast) {
+    BroadcastBinaryFiveFold(params, input1_data, input2_data, output_data, op);
+  } else {
+    const int flat_size =
+        MatchingElementsSize(input1_shape, input2_shape, output_shape);
+    op.Elementwise(flat_size, input1_data, input2_data, output_data);
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_BINARY_ELEMENTWISE_H_
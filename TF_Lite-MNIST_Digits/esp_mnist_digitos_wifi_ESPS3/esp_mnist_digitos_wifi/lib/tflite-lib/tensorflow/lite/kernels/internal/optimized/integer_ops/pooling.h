@@ -0,0 +1,254 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_POOLING_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_POOLING_H_
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// All kernels below are NHWC and keep channels as the innermost loop, so
+// every inner loop runs over `depth` contiguous values.
+//
+// When horizontally adjacent windows overlap (stride_width < filter_width),
+// each output row is computed in two passes. A vertical pass reduces the
+// window rows into one value per input column, so each input element is read
+// once per output row instead of once per window containing it. A horizontal
+// pass then reduces the columns of each window. AveragePool keeps that as a
+// running sum, subtracting the columns that leave the window and adding the
+// ones that enter; a max cannot drop a column, so MaxPool takes the max of
+// the window's column maxima afresh for every output. Otherwise windows are
+// reduced directly.
+
+inline bool PoolWindowsOverlap(const PoolParams& params) {
+  return params.stride_width < params.filter_width;
+}
+
+// Scratch bytes needed by MaxPool: one int8 row of column maxima when
+// windows overlap, nothing otherwise.
+inline int MaxPoolScratchBytes(const PoolParams& params, int input_width,
+                               int depth) {
+  return PoolWindowsOverlap(params) ? input_width * depth : 0;
+}
+
+// Scratch bytes needed by AveragePool: `depth` int32 accumulators, plus one
+// int32 row of column sums when windows overlap.
+inline int AveragePoolScratchBytes(const PoolParams& params, int input_width,
+                                   int depth) {
+  const int columns = PoolWindowsOverlap(params) ? input_width : 0;
+  return (columns + 1) * depth * static_cast<int>(sizeof(int32_t));
+}
+
+// Clamped window bounds along one axis, as in the reference kernels.
+inline void PoolWindowBounds(int out_index, int stride, int padding,
+                             int filter_size, int input_size, int* start,
+                             int* end) {
+  const int origin = out_index * stride - padding;
+  *start = std::max(0, origin);
+  *end = std::min(origin + filter_size, input_size);
+}
+
+inline void MaxPoolClampRow(const PoolParams& params, int size,
+                            int8_t* output_data) {
+  const int8_t act_min = static_cast<int8_t>(params.quantized_activation_min);
+  const int8_t act_max = static_cast<int8_t>(params.quantized_activation_max);
+  for (int i = 0; i < size; ++i) {
+    output_data[i] = std::min(act_max, std::max(act_min, output_data[i]));
+  }
+}
+
+// Bit-exact with reference_integer_ops::MaxPool. `scratch` must hold
+// MaxPoolScratchBytes bytes.
+inline void MaxPool(const PoolParams& params, const RuntimeShape& input_shape,
+                    const int8_t* input_data, const RuntimeShape& output_shape,
+                    int8_t* output_data, int8_t* scratch) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const bool separable = PoolWindowsOverlap(params);
+  constexpr int8_t kLowest = std::numeric_limits<int8_t>::lowest();
+
+  for (int batch = 0; batch < batches; ++batch) {
+    const int8_t* input_batch =
+        input_data + batch * input_height * input_width * depth;
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      int y_start, y_end;
+      PoolWindowBounds(out_y, params.stride_height,
+                       params.padding_values.height, params.filter_height,
+                       input_height, &y_start, &y_end);
+      int8_t* output_row = output_data;
+      if (separable) {
+        // Vertical pass: column maxima over the window rows.
+        std::fill(scratch, scratch + input_width * depth, kLowest);
+        for (int in_y = y_start; in_y < y_end; ++in_y) {
+          const int8_t* input_row = input_batch + in_y * input_width * depth;
+          for (int i = 0; i < input_width * depth; ++i) {
+            scratch[i] = std::max(scratch[i], input_row[i]);
+          }
+        }
+      }
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        int x_start, x_end;
+        PoolWindowBounds(out_x, params.stride_width,
+                         params.padding_values.width, params.filter_width,
+                         input_width, &x_start, &x_end);
+        std::fill(output_data, output_data + depth, kLowest);
+        if (separable) {
+          // Horizontal pass: max of this window's column maxima.
+          for (int in_x = x_start; in_x < x_end; ++in_x) {
+            const int8_t* column = scratch + in_x * depth;
+            for (int c = 0; c < depth; ++c) {
+              output_data[c] = std::max(output_data[c], column[c]);
+            }
+          }
+        } else {
+          for (int in_y = y_start; in_y < y_end; ++in_y) {
+            for (int in_x = x_start; in_x < x_end; ++in_x) {
+              const int8_t* input_pixel =
+                  input_batch + (in_y * input_width + in_x) * depth;
+              for (int c = 0; c < depth; ++c) {
+                output_data[c] = std::max(output_data[c], input_pixel[c]);
+              }
+            }
+          }
+        }
+        output_data += depth;
+      }
+      MaxPoolClampRow(params, output_width * depth, output_row);
+    }
+  }
+}
+
+// Rounds to nearest with ties away from zero, then clamps; matches the
+// reference average pooling.
+inline void AveragePoolStore(const PoolParams& params, const int32_t* acc,
+                             int filter_count, int depth,
+                             int8_t* output_data) {
+  for (int c = 0; c < depth; ++c) {
+    int32_t average = acc[c] > 0 ? (acc[c] + filter_count / 2) / filter_count
+                                 : (acc[c] - filter_count / 2) / filter_count;
+    average = std::max(average, params.quantized_activation_min);
+    average = std::min(average, params.quantized_activation_max);
+    output_data[c] = static_cast<int8_t>(average);
+  }
+}
+
+// Bit-exact with reference_integer_ops::AveragePool, including returning
+// false for an empty window. `scratch` must hold AveragePoolScratchBytes
+// bytes.
+inline bool AveragePool(const PoolParams& params,
+                        const RuntimeShape& input_shape,
+                        const int8_t* input_data,
+                        const RuntimeShape& output_shape, int8_t* output_data,
+                        int32_t* scratch) {
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int depth = MatchingDim(input_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const bool separable = PoolWindowsOverlap(params);
+  int32_t* acc = scratch;
+  int32_t* column_sums = scratch + depth;
+
+  for (int batch = 0; batch < batches; ++batch) {
+    const int8_t* input_batch =
+        input_data + batch * input_height * input_width * depth;
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      int y_start, y_end;
+      PoolWindowBounds(out_y, params.stride_height,
+                       params.padding_values.height, params.filter_height,
+                       input_height, &y_start, &y_end);
+      if (separable) {
+        // Vertical pass: column sums over the window rows.
+        std::fill(column_sums, column_sums + input_width * depth, 0);
+        for (int in_y = y_start; in_y < y_end; ++in_y) {
+          const int8_t* input_row = input_batch + in_y * input_width * depth;
+          for (int i = 0; i < input_width * depth; ++i) {
+            column_sums[i] += input_row[i];
+          }
+        }
+      }
+      // [acc_start, acc_end) is the column range currently summed in acc.
+      // Window bounds only move right, so the horizontal pass keeps a
+      // running sum, dropping columns on the left and adding on the right.
+      int acc_start = 0;
+      int acc_end = 0;
+      std::fill(acc, acc + depth, 0);
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        int x_start, x_end;
+        PoolWindowBounds(out_x, params.stride_width,
+                         params.padding_values.width, params.filter_width,
+                         input_width, &x_start, &x_end);
+        const int filter_count =
+            std::max(0, y_end - y_start) * std::max(0, x_end - x_start);
+        if (filter_count == 0) return false;
+        if (separable) {
+          if (x_start >= acc_end) {
+            std::fill(acc, acc + depth, 0);
+            acc_start = acc_end = x_start;
+          }
+          for (; acc_start < x_start; ++acc_start) {
+            const int32_t* column = column_sums + acc_start * depth;
+            for (int c = 0; c < depth; ++c) {
+              acc[c] -= column[c];
+            }
+          }
+          for (; acc_end < x_end; ++acc_end) {
+            const int32_t* column = column_sums + acc_end * depth;
+            for (int c = 0; c < depth; ++c) {
+              acc[c] += column[c];
+            }
+          }
+        } else {
+          std::fill(acc, acc + depth, 0);
+          for (int in_y = y_start; in_y < y_end; ++in_y) {
+            for (int in_x = x_start; in_x < x_end; ++in_x) {
+              const int8_t* input_pixel =
+                  input_batch + (in_y * input_width + in_x) * depth;
+              for (int c = 0; c < depth; ++c) {
+                acc[c] += input_pixel[c];
+              }
+            }
+          }
+        }
+        AveragePoolStore(params, acc, filter_count, depth, output_data);
+        output_data += depth;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_POOLING_H_
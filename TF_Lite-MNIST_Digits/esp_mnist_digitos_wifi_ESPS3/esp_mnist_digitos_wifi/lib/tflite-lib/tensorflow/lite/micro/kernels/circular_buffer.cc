@@ -41,6 +41,15 @@ limitations under the License.
  * After shifting:
  * Output: [<input 2>, <input 3>, <input ...>, <input N+1>]
  *
+ * The shift is not done by moving data: inputs go to a ring of 2 * N slots,
+ * written twice, N slots apart, so the N most recent inputs are always
+ * contiguous in it, and the output eval tensor is pointed at that window.
+ * Consumers read the ring at that offset through their eval tensor, as
+ * kernels do, so each invocation writes one input twice whatever N and
+ * cycles_max are. The planned output buffer is only written by the in-place
+ * shift kept for when the ring cannot be allocated; a TfLiteTensor view of
+ * the output (e.g. MicroInterpreter::output()) does not follow the ring.
+ *
  * We make some assumptions in this custom operator:
  * - Input shape must be [1, 1, 1, depth]
  * - Output shape must be [1, num_slots, 1, depth]
@@ -74,6 +83,19 @@ void EvalInt8(const int8_t* input, int num_slots, int depth, int8_t* output) {
   memcpy(&output[(num_slots - 1) * depth], input, depth);
 }
 
+// Writes the new input to both copies of the ring head, advances the head and
+// returns the num_slots most recent inputs, oldest first.
+int8_t* EvalInt8Ring(const int8_t* input, int num_slots, int depth,
+                     OpDataCircularBuffer* data) {
+  int8_t* slot = data->ring_buffer + data->ring_head * depth;
+  memcpy(slot, input, depth);
+  memcpy(slot + num_slots * depth, input, depth);
+  if (++data->ring_head == num_slots) {
+    data->ring_head = 0;
+  }
+  return data->ring_buffer + data->ring_head * depth;
+}
+
 TfLiteStatus CircularBufferEval(TfLiteContext* context, TfLiteNode* node) {
   const TfLiteEvalTensor* input =
       tflite::micro::GetEvalInput(context, node, kCircularBufferInputTensor);
@@ -88,8 +110,13 @@ TfLiteStatus CircularBufferEval(TfLiteContext* context, TfLiteNode* node) {
   int depth = output->dims->data[2] * output->dims->data[3];
 
   if (input->type == kTfLiteInt8) {
-    EvalInt8(tflite::micro::GetTensorData<int8_t>(input), num_slots, depth,
-             tflite::micro::GetTensorData<int8_t>(output));
+    if (data->ring_buffer != nullptr) {
+      output->data.int8 = EvalInt8Ring(
+          tflite::micro::GetTensorData<int8_t>(input), num_slots, depth, data);
+    } else {
+      EvalInt8(tflite::micro::GetTensorData<int8_t>(input), num_slots, depth,
+               tflite::micro::GetTensorData<int8_t>(output));
+    }
   } else {
     MicroPrintf("Type %s (%d) not supported.",
                        TfLiteTypeGetName(input->type), input->type);
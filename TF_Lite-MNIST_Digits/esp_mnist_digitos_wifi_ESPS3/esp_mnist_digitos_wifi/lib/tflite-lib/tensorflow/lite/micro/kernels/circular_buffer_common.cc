@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cstring>
+
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
@@ -86,6 +88,17 @@ TfLiteStatus CircularBufferPrepare(TfLiteContext* context, TfLiteNode* node) {
     }
   }
   op_data->cycles_until_run = op_data->cycles_max;
+
+  const int num_slots = output->dims->data[1];
+  const int depth = output->dims->data[2] * output->dims->data[3];
+  op_data->ring_head = 0;
+  op_data->ring_buffer =
+      static_cast<int8_t*>(context->AllocatePersistentBuffer(
+          context, 2 * num_slots * depth * sizeof(int8_t)));
+  if (op_data->ring_buffer != nullptr) {
+    memset(op_data->ring_buffer, output->params.zero_point,
+           2 * num_slots * depth);
+  }
   node->user_data = op_data;
 
   micro_context->DeallocateTempTfLiteTensor(input);
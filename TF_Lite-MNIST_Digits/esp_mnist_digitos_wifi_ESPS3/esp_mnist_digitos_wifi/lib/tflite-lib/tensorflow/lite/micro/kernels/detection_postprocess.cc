@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <numeric>
 #include <tuple>
 
@@ -26,6 +28,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/kernels/op_macros.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
+#include "tensorflow/lite/micro/micro_log.h"
 #include "tensorflow/lite/micro/micro_utils.h"
 
 namespace tflite {
@@ -38,6 +41,14 @@ namespace {
  * 1.) Temporaries (temporary tensors) - Micro use instead scratch buffer API.
  * 2.) Output dimensions - the TFLite version does not support undefined out
  * dimensions. So model must have static out dimensions.
+ * 3.) Candidate pre-filtering - anchors whose class scores are all below
+ * nms_score_threshold can never be selected, so they are dropped up front by
+ * comparing the raw (float or quantized) scores against the threshold. Only
+ * the remaining candidates are dequantized and decoded, in float32.
+ * 4.) NMS sweep - candidates are popped from a max-heap in score order and
+ * compared only against the boxes already selected, stopping as soon as
+ * enough detections are found, instead of fully sorting them and marking
+ * every lower-scoring overlap.
  */
 
 // Input tensors
@@ -98,8 +109,12 @@ struct OpData {
   bool use_regular_non_max_suppression;
   CenterSizeEncoding scale_values;
 
+  // Smallest raw class prediction passing nms_score_threshold, for quantized
+  // class predictions.
+  int32_t quantized_score_threshold;
+
   // Scratch buffers indexes
-  int active_candidate_idx;
+  int candidate_indices_idx;
   int decoded_boxes_idx;
   int scores_idx;
   int score_buffer_idx;
@@ -149,6 +164,37 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
   return op_data;
 }
 
+class Dequantizer {
+ public:
+  Dequantizer(int zero_point, float scale)
+      : zero_point_(zero_point), scale_(scale) {}
+  float operator()(int32_t x) const {
+    return (static_cast<float>(x) - zero_point_) * scale_;
+  }
+
+ private:
+  int zero_point_;
+  float scale_;
+};
+
+// Returns the smallest value in [T's lowest, T's max + 1] whose dequantized
+// score is >= threshold, so that comparing raw values against it selects
+// exactly the same scores as comparing the dequantized ones.
+template <typename T>
+int32_t QuantizeScoreThreshold(float threshold, const Dequantizer& dequantize,
+                               float scale, int zero_point) {
+  constexpr int32_t kMin = std::numeric_limits<T>::lowest();
+  constexpr int32_t kMax = std::numeric_limits<T>::max();
+  const float estimate = std::ceil(zero_point + threshold / scale);
+  int32_t raw = static_cast<int32_t>(
+      std::min<float>(std::max<float>(estimate, kMin), kMax + 1));
+  // The estimate can be off by one ulp either way; settle it against the
+  // dequantizer itself.
+  while (raw > kMin && dequantize(raw - 1) >= threshold) --raw;
+  while (raw <= kMax && dequantize(raw) < threshold) ++raw;
+  return raw;
+}
+
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   auto* op_data = static_cast<OpData*>(node->user_data);
 
@@ -181,17 +227,46 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   op_data->input_anchors.scale = input_anchors->params.scale;
   op_data->input_anchors.zero_point = input_anchors->params.zero_point;
 
+  const Dequantizer score_dequantizer(
+      op_data->input_class_predictions.zero_point,
+      op_data->input_class_predictions.scale);
+  switch (input_class_predictions->type) {
+    case kTfLiteFloat32:
+      break;
+    case kTfLiteUInt8:
+      op_data->quantized_score_threshold = QuantizeScoreThreshold<uint8_t>(
+          op_data->non_max_suppression_score_threshold, score_dequantizer,
+          op_data->input_class_predictions.scale,
+          op_data->input_class_predictions.zero_point);
+      break;
+    case kTfLiteInt8:
+      op_data->quantized_score_threshold = QuantizeScoreThreshold<int8_t>(
+          op_data->non_max_suppression_score_threshold, score_dequantizer,
+          op_data->input_class_predictions.scale,
+          op_data->input_class_predictions.zero_point);
+      break;
+    default:
+      MicroPrintf("Type %s (%d) not supported for class predictions.",
+                  TfLiteTypeGetName(input_class_predictions->type),
+                  input_class_predictions->type);
+      return kTfLiteError;
+  }
+
   // Scratch tensors
-  context->RequestScratchBufferInArena(context, num_boxes,
-                                       &op_data->active_candidate_idx);
+  context->RequestScratchBufferInArena(context, num_boxes * sizeof(int),
+                                       &op_data->candidate_indices_idx);
   context->RequestScratchBufferInArena(context,
                                        num_boxes * kNumCoordBox * sizeof(float),
                                        &op_data->decoded_boxes_idx);
-  context->RequestScratchBufferInArena(
-      context,
-      input_class_predictions->dims->data[1] *
-          input_class_predictions->dims->data[2] * sizeof(float),
-      &op_data->scores_idx);
+  // Dequantized class predictions; float predictions are read in place.
+  op_data->scores_idx = -1;
+  if (input_class_predictions->type != kTfLiteFloat32) {
+    context->RequestScratchBufferInArena(
+        context,
+        input_class_predictions->dims->data[1] *
+            input_class_predictions->dims->data[2] * sizeof(float),
+        &op_data->scores_idx);
+  }
 
   // Additional buffers
   context->RequestScratchBufferInArena(context, num_boxes * sizeof(float),
@@ -227,19 +302,6 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   return kTfLiteOk;
 }
 
-class Dequantizer {
- public:
-  Dequantizer(int zero_point, float scale)
-      : zero_point_(zero_point), scale_(scale) {}
-  float operator()(uint8_t x) {
-    return (static_cast<float>(x) - zero_point_) * scale_;
-  }
-
- private:
-  int zero_point_;
-  float scale_;
-};
-
 template <class T>
 T ReInterpretTensor(const TfLiteEvalTensor* tensor) {
   const float* tensor_base = tflite::micro::GetTensorData<float>(tensor);
@@ -252,67 +314,162 @@ T ReInterpretTensor(TfLiteEvalTensor* tensor) {
   return reinterpret_cast<T>(tensor_base);
 }
 
+// Lists, in increasing order, the anchors with at least one class score
+// (background excluded) at or above the threshold and returns how many there
+// are. T is the raw class prediction type and `threshold` is in the same
+// domain.
+template <typename T, typename Threshold>
+int SelectCandidateBoxes(const T* raw_scores, int num_boxes,
+                         int num_classes_with_background, int num_classes,
+                         Threshold threshold, int* candidates) {
+  const int label_offset = num_classes_with_background - num_classes;
+  int num_candidates = 0;
+  for (int row = 0; row < num_boxes; ++row) {
+    const T* box_scores =
+        raw_scores + row * num_classes_with_background + label_offset;
+    T max_score = box_scores[0];
+    for (int col = 1; col < num_classes; ++col) {
+      max_score = std::max(max_score, box_scores[col]);
+    }
+    if (max_score >= threshold) {
+      candidates[num_candidates++] = row;
+    }
+  }
+  return num_candidates;
+}
+
+// Quantized variant: selects on the raw values, then dequantizes the class
+// predictions of the candidate anchors only.
+template <typename T>
+int SelectQuantizedCandidateBoxes(const T* raw_scores, int num_boxes,
+                                  int num_classes_with_background,
+                                  int num_classes, const OpData* op_data,
+                                  int* candidates, float* scores) {
+  const int num_candidates = SelectCandidateBoxes(
+      raw_scores, num_boxes, num_classes_with_background, num_classes,
+      op_data->quantized_score_threshold, candidates);
+  const Dequantizer dequantize(op_data->input_class_predictions.zero_point,
+                               op_data->input_class_predictions.scale);
+  for (int i = 0; i < num_candidates; ++i) {
+    const int offset = candidates[i] * num_classes_with_background;
+    for (int col = 0; col < num_classes_with_background; ++col) {
+      scores[offset + col] = dequantize(raw_scores[offset + col]);
+    }
+  }
+  return num_candidates;
+}
+
+// Thresholds the class predictions on their raw values, fills `candidates`
+// and points `scores` at float predictions for (at least) the candidate
+// anchors.
+TfLiteStatus SelectCandidates(TfLiteContext* context, TfLiteNode* node,
+                              OpData* op_data, int* candidates,
+                              int* num_candidates, const float** scores) {
+  const TfLiteEvalTensor* input_box_encodings =
+      tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
+  const TfLiteEvalTensor* input_class_predictions =
+      tflite::micro::GetEvalInput(context, node, kInputTensorClassPredictions);
+  const int num_boxes = input_box_encodings->dims->data[1];
+  const int num_classes = op_data->num_classes;
+
+  TF_LITE_ENSURE_EQ(context, input_class_predictions->dims->data[0],
+                    kBatchSize);
+  TF_LITE_ENSURE_EQ(context, input_class_predictions->dims->data[1], num_boxes);
+  const int num_classes_with_background =
+      input_class_predictions->dims->data[2];
+
+  TF_LITE_ENSURE(context, (num_classes_with_background - num_classes <= 1));
+  TF_LITE_ENSURE(context, (num_classes_with_background >= num_classes));
+  TF_LITE_ENSURE(context, (num_classes > 0));
+
+  switch (input_class_predictions->type) {
+    case kTfLiteFloat32:
+      *scores = tflite::micro::GetTensorData<float>(input_class_predictions);
+      *num_candidates = SelectCandidateBoxes(
+          *scores, num_boxes, num_classes_with_background, num_classes,
+          op_data->non_max_suppression_score_threshold, candidates);
+      break;
+    case kTfLiteUInt8: {
+      float* dequantized_scores = reinterpret_cast<float*>(
+          context->GetScratchBuffer(context, op_data->scores_idx));
+      *num_candidates = SelectQuantizedCandidateBoxes(
+          tflite::micro::GetTensorData<uint8_t>(input_class_predictions),
+          num_boxes, num_classes_with_background, num_classes, op_data,
+          candidates, dequantized_scores);
+      *scores = dequantized_scores;
+      break;
+    }
+    case kTfLiteInt8: {
+      float* dequantized_scores = reinterpret_cast<float*>(
+          context->GetScratchBuffer(context, op_data->scores_idx));
+      *num_candidates = SelectQuantizedCandidateBoxes(
+          tflite::micro::GetTensorData<int8_t>(input_class_predictions),
+          num_boxes, num_classes_with_background, num_classes, op_data,
+          candidates, dequantized_scores);
+      *scores = dequantized_scores;
+      break;
+    }
+    default:
+      // Unsupported type.
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+// Decodes the candidate anchors only, in single precision, and checks that
+// the resulting boxes are well formed.
 TfLiteStatus DecodeCenterSizeBoxes(TfLiteContext* context, TfLiteNode* node,
-                                   OpData* op_data) {
+                                   OpData* op_data, const int* candidates,
+                                   int num_candidates) {
   // Parse input tensor boxencodings
   const TfLiteEvalTensor* input_box_encodings =
       tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
   TF_LITE_ENSURE_EQ(context, input_box_encodings->dims->data[0], kBatchSize);
-  const int num_boxes = input_box_encodings->dims->data[1];
   TF_LITE_ENSURE(context, input_box_encodings->dims->data[2] >= kNumCoordBox);
   const TfLiteEvalTensor* input_anchors =
       tflite::micro::GetEvalInput(context, node, kInputTensorAnchors);
+  // Please see DequantizeBoxEncodings function for the support detail.
+  if (input_box_encodings->type != kTfLiteFloat32 ||
+      input_anchors->type != kTfLiteFloat32) {
+    // Unsupported type.
+    return kTfLiteError;
+  }
+  const float* box_encodings =
+      tflite::micro::GetTensorData<float>(input_box_encodings);
+  const int box_encoding_stride = input_box_encodings->dims->data[2];
+  const CenterSizeEncoding* anchors =
+      ReInterpretTensor<const CenterSizeEncoding*>(input_anchors);
+  BoxCornerEncoding* decoded_boxes = reinterpret_cast<BoxCornerEncoding*>(
+      context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
 
-  // Decode the boxes to get (ymin, xmin, ymax, xmax) based on the anchors
-  CenterSizeEncoding box_centersize;
-  CenterSizeEncoding scale_values = op_data->scale_values;
-  CenterSizeEncoding anchor;
-  for (int idx = 0; idx < num_boxes; ++idx) {
-    switch (input_box_encodings->type) {
-        // Float
-      case kTfLiteFloat32: {
-        // Please see DequantizeBoxEncodings function for the support detail.
-        const int box_encoding_idx = idx * input_box_encodings->dims->data[2];
-        const float* boxes = &(tflite::micro::GetTensorData<float>(
-            input_box_encodings)[box_encoding_idx]);
-        box_centersize = *reinterpret_cast<const CenterSizeEncoding*>(boxes);
-        anchor =
-            ReInterpretTensor<const CenterSizeEncoding*>(input_anchors)[idx];
-        break;
-      }
-      default:
-        // Unsupported type.
-        return kTfLiteError;
-    }
-
-    float ycenter = static_cast<float>(static_cast<double>(box_centersize.y) /
-                                           static_cast<double>(scale_values.y) *
-                                           static_cast<double>(anchor.h) +
-                                       static_cast<double>(anchor.y));
-
-    float xcenter = static_cast<float>(static_cast<double>(box_centersize.x) /
-                                           static_cast<double>(scale_values.x) *
-                                           static_cast<double>(anchor.w) +
-                                       static_cast<double>(anchor.x));
-
-    float half_h =
-        static_cast<float>(0.5 *
-                           (std::exp(static_cast<double>(box_centersize.h) /
-                                     static_cast<double>(scale_values.h))) *
-                           static_cast<double>(anchor.h));
-    float half_w =
-        static_cast<float>(0.5 *
-                           (std::exp(static_cast<double>(box_centersize.w) /
-                                     static_cast<double>(scale_values.w))) *
-                           static_cast<double>(anchor.w));
-
-    float* decoded_boxes = reinterpret_cast<float*>(
-        context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
-    auto& box = reinterpret_cast<BoxCornerEncoding*>(decoded_boxes)[idx];
+  // Decode the boxes to get (ymin, xmin, ymax, xmax) based on the anchors.
+  // The divisions by the scale values are hoisted out as reciprocals.
+  const CenterSizeEncoding& scale_values = op_data->scale_values;
+  const float inv_y_scale = 1.0f / scale_values.y;
+  const float inv_x_scale = 1.0f / scale_values.x;
+  const float inv_h_scale = 1.0f / scale_values.h;
+  const float inv_w_scale = 1.0f / scale_values.w;
+  for (int i = 0; i < num_candidates; ++i) {
+    const int idx = candidates[i];
+    const CenterSizeEncoding& box_centersize =
+        *reinterpret_cast<const CenterSizeEncoding*>(
+            box_encodings + idx * box_encoding_stride);
+    const CenterSizeEncoding& anchor = anchors[idx];
+
+    const float ycenter = box_centersize.y * inv_y_scale * anchor.h + anchor.y;
+    const float xcenter = box_centersize.x * inv_x_scale * anchor.w + anchor.x;
+    const float half_h =
+        0.5f * std::exp(box_centersize.h * inv_h_scale) * anchor.h;
+    const float half_w =
+        0.5f * std::exp(box_centersize.w * inv_w_scale) * anchor.w;
+
+    BoxCornerEncoding& box = decoded_boxes[idx];
     box.ymin = ycenter - half_h;
     box.xmin = xcenter - half_w;
     box.ymax = ycenter + half_h;
     box.xmax = xcenter + half_w;
+    // ymax>=ymin, xmax>=xmin
+    TF_LITE_ENSURE(context, box.ymin < box.ymax && box.xmin < box.xmax);
   }
   return kTfLiteOk;
 }
@@ -326,82 +483,25 @@ void DecreasingPartialArgSort(const float* values, int num_values,
                     });
 }
 
-template <typename Compare>
-void InsertionSort(int* start, int* end, Compare compare) {
-  for (int* i = start; i != end; ++i) {
-    std::rotate(std::upper_bound(start, i, *i, compare), i, i + 1);
-  }
-}
-
-template <typename Compare>
-void TopDownMerge(int* values, int* scratch, const int half_num_values,
-                  int num_values, Compare compare) {
-  int left = 0;
-  int right = half_num_values;
-
-  for (int i = 0; i < num_values; i++) {
-    if (left >= half_num_values ||
-        (right < num_values && compare(values[right], values[left]))) {
-      scratch[i] = values[right++];
-    } else {
-      scratch[i] = values[left++];
-    }
-  }
-  memcpy(values, scratch, num_values * sizeof(int));
-}
-
-template <typename Compare>
-void MergeSort(int* values, int* scratch, const int num_values,
-               Compare compare) {
-  constexpr int threshold = 20;
-
-  if (num_values < threshold) {
-    InsertionSort(values, values + num_values, compare);
-    return;
-  }
-
-  const int half_num_values = num_values / 2;
-
-  MergeSort(values, scratch, half_num_values, compare);
-  MergeSort(values + half_num_values, scratch, num_values - half_num_values,
-            compare);
-  TopDownMerge(values, scratch, half_num_values, num_values, compare);
-}
-
-void DecreasingArgSort(const float* values, int num_values, int* indices,
-                       int* scratch) {
-  std::iota(indices, indices + num_values, 0);
-
-  MergeSort(indices, scratch, num_values, [&values](const int i, const int j) {
-    return values[i] > values[j];
-  });
-}
-
-int SelectDetectionsAboveScoreThreshold(const float* values, int size,
+// Like SelectDetectionsAboveScoreThreshold in the TFLite version, but only
+// visits the candidate anchors.
+int SelectDetectionsAboveScoreThreshold(const float* values,
+                                        const int* candidates,
+                                        int num_candidates,
                                         const float threshold,
                                         float* keep_values, int* keep_indices) {
   int counter = 0;
-  for (int i = 0; i < size; i++) {
-    if (values[i] >= threshold) {
-      keep_values[counter] = values[i];
-      keep_indices[counter] = i;
+  for (int i = 0; i < num_candidates; i++) {
+    const int index = candidates[i];
+    if (values[index] >= threshold) {
+      keep_values[counter] = values[index];
+      keep_indices[counter] = index;
       counter++;
     }
   }
   return counter;
 }
 
-bool ValidateBoxes(const float* decoded_boxes, const int num_boxes) {
-  for (int i = 0; i < num_boxes; ++i) {
-    // ymax>=ymin, xmax>=xmin
-    auto& box = reinterpret_cast<const BoxCornerEncoding*>(decoded_boxes)[i];
-    if (box.ymin >= box.ymax || box.xmin >= box.xmax) {
-      return false;
-    }
-  }
-  return true;
-}
-
 float ComputeIntersectionOverUnion(const float* decoded_boxes, const int i,
                                    const int j) {
   auto& box_i = reinterpret_cast<const BoxCornerEncoding*>(decoded_boxes)[i];
@@ -421,17 +521,18 @@ float ComputeIntersectionOverUnion(const float* decoded_boxes, const int i,
 
 // NonMaxSuppressionSingleClass() prunes out the box locations with high overlap
 // before selecting the highest scoring boxes (max_detections in number)
-// It assumes all boxes are good in beginning and sorts based on the scores.
-// If lower-scoring box has too much overlap with a higher-scoring box,
-// we get rid of the lower-scoring box.
-// Complexity is O(N^2) pairwise comparison between boxes
+// It assumes all boxes are good in beginning and visits them in decreasing
+// score order. If lower-scoring box has too much overlap with a higher-scoring
+// box that was already selected, we get rid of the lower-scoring box.
+// The order comes from a max-heap over the boxes above the threshold, so only
+// the boxes actually visited before max_detections are selected pay for the
+// sorting, and each visited box is compared against at most max_detections
+// selected boxes. Ties keep the lower anchor index first, which gives the same
+// selection as a stable sort.
 TfLiteStatus NonMaxSuppressionSingleClassHelper(
     TfLiteContext* context, TfLiteNode* node, OpData* op_data,
-    const float* scores, int* selected, int* selected_size,
-    int max_detections) {
-  const TfLiteEvalTensor* input_box_encodings =
-      tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
-  const int num_boxes = input_box_encodings->dims->data[1];
+    const float* scores, const int* candidates, int num_candidates,
+    int* selected, int* selected_size, int max_detections) {
   const float non_max_suppression_score_threshold =
       op_data->non_max_suppression_score_threshold;
   const float intersection_over_union_threshold =
@@ -442,66 +543,49 @@ TfLiteStatus NonMaxSuppressionSingleClassHelper(
   // and should be less than 1.
   TF_LITE_ENSURE(context, (intersection_over_union_threshold > 0.0f) &&
                               (intersection_over_union_threshold <= 1.0f));
-  // Validate boxes
-  float* decoded_boxes = reinterpret_cast<float*>(
+  // Boxes were validated when they were decoded.
+  const float* decoded_boxes = reinterpret_cast<const float*>(
       context->GetScratchBuffer(context, op_data->decoded_boxes_idx));
 
-  TF_LITE_ENSURE(context, ValidateBoxes(decoded_boxes, num_boxes));
-
   // threshold scores
   int* keep_indices = reinterpret_cast<int*>(
       context->GetScratchBuffer(context, op_data->keep_indices_idx));
   float* keep_scores = reinterpret_cast<float*>(
       context->GetScratchBuffer(context, op_data->keep_scores_idx));
-  int num_scores_kept = SelectDetectionsAboveScoreThreshold(
-      scores, num_boxes, non_max_suppression_score_threshold, keep_scores,
-      keep_indices);
-  int* sorted_indices = reinterpret_cast<int*>(
-      context->GetScratchBuffer(context, op_data->sorted_indices_idx));
-
-  // Reusing keep_indices for scratch buffer and write back its values
-  // after the sorting is done.
-  DecreasingArgSort(keep_scores, num_scores_kept, sorted_indices, keep_indices);
-  int counter = 0;
-  for (int i = 0; i < num_boxes; i++) {
-    if (scores[i] >= non_max_suppression_score_threshold) {
-      keep_indices[counter] = i;
-      counter++;
-    }
-  }
-
-  const int num_boxes_kept = num_scores_kept;
+  const int num_boxes_kept = SelectDetectionsAboveScoreThreshold(
+      scores, candidates, num_candidates, non_max_suppression_score_threshold,
+      keep_scores, keep_indices);
   const int output_size = std::min(num_boxes_kept, max_detections);
   *selected_size = 0;
-
-  int num_active_candidate = num_boxes_kept;
-  uint8_t* active_box_candidate = reinterpret_cast<uint8_t*>(
-      context->GetScratchBuffer(context, op_data->active_candidate_idx));
-
-  for (int row = 0; row < num_boxes_kept; row++) {
-    active_box_candidate[row] = 1;
+  if (output_size == 0) {
+    return kTfLiteOk;
   }
-  for (int i = 0; i < num_boxes_kept; ++i) {
-    if (num_active_candidate == 0 || *selected_size >= output_size) break;
-    if (active_box_candidate[i] == 1) {
-      selected[(*selected_size)++] = keep_indices[sorted_indices[i]];
-      active_box_candidate[i] = 0;
-      num_active_candidate--;
-    } else {
-      continue;
-    }
-    for (int j = i + 1; j < num_boxes_kept; ++j) {
-      if (active_box_candidate[j] == 1) {
-        float intersection_over_union = ComputeIntersectionOverUnion(
-            decoded_boxes, keep_indices[sorted_indices[i]],
-            keep_indices[sorted_indices[j]]);
-
-        if (intersection_over_union > intersection_over_union_threshold) {
-          active_box_candidate[j] = 0;
-          num_active_candidate--;
-        }
+
+  // Heap of positions in keep_scores/keep_indices.
+  int* heap = reinterpret_cast<int*>(
+      context->GetScratchBuffer(context, op_data->sorted_indices_idx));
+  std::iota(heap, heap + num_boxes_kept, 0);
+  auto ranks_lower = [keep_scores](const int i, const int j) {
+    return keep_scores[i] < keep_scores[j] ||
+           (keep_scores[i] == keep_scores[j] && i > j);
+  };
+  std::make_heap(heap, heap + num_boxes_kept, ranks_lower);
+
+  for (int heap_size = num_boxes_kept;
+       heap_size > 0 && *selected_size < output_size; --heap_size) {
+    std::pop_heap(heap, heap + heap_size, ranks_lower);
+    const int box_index = keep_indices[heap[heap_size - 1]];
+    bool suppressed = false;
+    for (int i = 0; i < *selected_size; ++i) {
+      if (ComputeIntersectionOverUnion(decoded_boxes, selected[i], box_index) >
+          intersection_over_union_threshold) {
+        suppressed = true;
+        break;
       }
     }
+    if (!suppressed) {
+      selected[(*selected_size)++] = box_index;
+    }
   }
 
   return kTfLiteOk;
@@ -514,12 +598,9 @@ TfLiteStatus NonMaxSuppressionSingleClassHelper(
 // 3) The worst runtime of the regular NMS is O(K*N^2)
 // where N is the number of anchors and K the number of
 // classes.
-TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
-                                                      TfLiteNode* node,
-                                                      OpData* op_data,
-                                                      const float* scores) {
-  const TfLiteEvalTensor* input_box_encodings =
-      tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
+TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(
+    TfLiteContext* context, TfLiteNode* node, OpData* op_data,
+    const float* scores, const int* candidates, int num_candidates) {
   const TfLiteEvalTensor* input_class_predictions =
       tflite::micro::GetEvalInput(context, node, kInputTensorClassPredictions);
   TfLiteEvalTensor* detection_boxes =
@@ -531,7 +612,6 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
   TfLiteEvalTensor* num_detections =
       tflite::micro::GetEvalOutput(context, node, kOutputTensorNumDetections);
 
-  const int num_boxes = input_box_encodings->dims->data[1];
   const int num_classes = op_data->num_classes;
   const int num_detections_per_class = op_data->detections_per_class;
   const int max_detections = op_data->max_detections;
@@ -557,8 +637,10 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
       context->GetScratchBuffer(context, op_data->sorted_values_idx));
 
   for (int col = 0; col < num_classes; col++) {
-    for (int row = 0; row < num_boxes; row++) {
-      // Get scores of boxes corresponding to all anchors for single class
+    for (int i = 0; i < num_candidates; i++) {
+      // Get scores of boxes corresponding to all candidate anchors for single
+      // class
+      const int row = candidates[i];
       class_scores[row] =
           *(scores + row * num_classes_with_background + col + label_offset);
     }
@@ -567,8 +649,8 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
     int* selected = reinterpret_cast<int*>(
         context->GetScratchBuffer(context, op_data->selected_idx));
     TF_LITE_ENSURE_STATUS(NonMaxSuppressionSingleClassHelper(
-        context, node, op_data, class_scores, selected, &selected_size,
-        num_detections_per_class));
+        context, node, op_data, class_scores, candidates, num_candidates,
+        selected, &selected_size, num_detections_per_class));
     // Add selected indices from non-max suppression of boxes in this class
     int output_index = size_of_sorted_indices;
     for (int i = 0; i < selected_size; i++) {
@@ -647,12 +729,9 @@ TfLiteStatus NonMaxSuppressionMultiClassRegularHelper(TfLiteContext* context,
 // 3) Compared to standard NMS, the worst runtime of this version is O(N^2)
 // instead of O(KN^2) where N is the number of anchors and K the number of
 // classes.
-TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
-                                                   TfLiteNode* node,
-                                                   OpData* op_data,
-                                                   const float* scores) {
-  const TfLiteEvalTensor* input_box_encodings =
-      tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
+TfLiteStatus NonMaxSuppressionMultiClassFastHelper(
+    TfLiteContext* context, TfLiteNode* node, OpData* op_data,
+    const float* scores, const int* candidates, int num_candidates) {
   const TfLiteEvalTensor* input_class_predictions =
       tflite::micro::GetEvalInput(context, node, kInputTensorClassPredictions);
   TfLiteEvalTensor* detection_boxes =
@@ -665,7 +744,6 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
   TfLiteEvalTensor* num_detections =
       tflite::micro::GetEvalOutput(context, node, kOutputTensorNumDetections);
 
-  const int num_boxes = input_box_encodings->dims->data[1];
   const int num_classes = op_data->num_classes;
   const int max_categories_per_anchor = op_data->max_classes_per_detection;
   const int num_classes_with_background =
@@ -681,13 +759,13 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
   int* sorted_class_indices = reinterpret_cast<int*>(
       context->GetScratchBuffer(context, op_data->buffer_idx));
 
-  for (int row = 0; row < num_boxes; row++) {
+  // Only the maximum is needed to run NMS; the classes are ranked for the
+  // selected anchors only, below.
+  for (int i = 0; i < num_candidates; i++) {
+    const int row = candidates[i];
     const float* box_scores =
         scores + row * num_classes_with_background + label_offset;
-    int* class_indices = sorted_class_indices + row * num_classes;
-    DecreasingPartialArgSort(box_scores, num_classes, num_categories_per_anchor,
-                             class_indices);
-    max_scores[row] = box_scores[class_indices[0]];
+    max_scores[row] = *std::max_element(box_scores, box_scores + num_classes);
   }
 
   // Perform non-maximal suppression on max scores
@@ -695,8 +773,8 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
   int* selected = reinterpret_cast<int*>(
       context->GetScratchBuffer(context, op_data->selected_idx));
   TF_LITE_ENSURE_STATUS(NonMaxSuppressionSingleClassHelper(
-      context, node, op_data, max_scores, selected, &selected_size,
-      op_data->max_detections));
+      context, node, op_data, max_scores, candidates, num_candidates, selected,
+      &selected_size, op_data->max_detections));
 
   // Allocate output tensors
   int output_box_index = 0;
@@ -706,8 +784,9 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
 
     const float* box_scores =
         scores + selected_index * num_classes_with_background + label_offset;
-    const int* class_indices =
-        sorted_class_indices + selected_index * num_classes;
+    int* class_indices = sorted_class_indices + selected_index * num_classes;
+    DecreasingPartialArgSort(box_scores, num_classes, num_categories_per_anchor,
+                             class_indices);
 
     for (int col = 0; col < num_categories_per_anchor; ++col) {
       int box_offset = num_categories_per_anchor * output_box_index + col;
@@ -735,40 +814,16 @@ TfLiteStatus NonMaxSuppressionMultiClassFastHelper(TfLiteContext* context,
 }
 
 TfLiteStatus NonMaxSuppressionMultiClass(TfLiteContext* context,
-                                         TfLiteNode* node, OpData* op_data) {
-  // Get the input tensors
-  const TfLiteEvalTensor* input_box_encodings =
-      tflite::micro::GetEvalInput(context, node, kInputTensorBoxEncodings);
-  const TfLiteEvalTensor* input_class_predictions =
-      tflite::micro::GetEvalInput(context, node, kInputTensorClassPredictions);
-  const int num_boxes = input_box_encodings->dims->data[1];
-  const int num_classes = op_data->num_classes;
-
-  TF_LITE_ENSURE_EQ(context, input_class_predictions->dims->data[0],
-                    kBatchSize);
-  TF_LITE_ENSURE_EQ(context, input_class_predictions->dims->data[1], num_boxes);
-  const int num_classes_with_background =
-      input_class_predictions->dims->data[2];
-
-  TF_LITE_ENSURE(context, (num_classes_with_background - num_classes <= 1));
-  TF_LITE_ENSURE(context, (num_classes_with_background >= num_classes));
-
-  const float* scores;
-  switch (input_class_predictions->type) {
-    case kTfLiteFloat32:
-      scores = tflite::micro::GetTensorData<float>(input_class_predictions);
-      break;
-    default:
-      // Unsupported type.
-      return kTfLiteError;
-  }
-
+                                         TfLiteNode* node, OpData* op_data,
+                                         const float* scores,
+                                         const int* candidates,
+                                         int num_candidates) {
   if (op_data->use_regular_non_max_suppression) {
     TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClassRegularHelper(
-        context, node, op_data, scores));
+        context, node, op_data, scores, candidates, num_candidates));
   } else {
-    TF_LITE_ENSURE_STATUS(
-        NonMaxSuppressionMultiClassFastHelper(context, node, op_data, scores));
+    TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClassFastHelper(
+        context, node, op_data, scores, candidates, num_candidates));
   }
 
   return kTfLiteOk;
@@ -784,16 +839,27 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   // and do all calculations in float. Mixed quantized/float calculations are
   // currently not supported in TFLite.
 
+  // This lists the anchors with some class score above the threshold, on the
+  // raw class predictions, and dequantizes the scores of those anchors.
+  int* candidates = reinterpret_cast<int*>(
+      context->GetScratchBuffer(context, op_data->candidate_indices_idx));
+  int num_candidates = 0;
+  const float* scores = nullptr;
+  TF_LITE_ENSURE_STATUS(SelectCandidates(context, node, op_data, candidates,
+                                         &num_candidates, &scores));
+
   // This fills in temporary decoded_boxes
   // by transforming input_box_encodings and input_anchors from
-  // CenterSizeEncodings to BoxCornerEncoding
-  TF_LITE_ENSURE_STATUS(DecodeCenterSizeBoxes(context, node, op_data));
+  // CenterSizeEncodings to BoxCornerEncoding, for the candidates only.
+  TF_LITE_ENSURE_STATUS(DecodeCenterSizeBoxes(context, node, op_data,
+                                              candidates, num_candidates));
 
   // This fills in the output tensors
   // by choosing effective set of decoded boxes
   // based on Non Maximal Suppression, i.e. selecting
   // highest scoring non-overlapping boxes.
-  TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClass(context, node, op_data));
+  TF_LITE_ENSURE_STATUS(NonMaxSuppressionMultiClass(
+      context, node, op_data, scores, candidates, num_candidates));
 
   return kTfLiteOk;
 }
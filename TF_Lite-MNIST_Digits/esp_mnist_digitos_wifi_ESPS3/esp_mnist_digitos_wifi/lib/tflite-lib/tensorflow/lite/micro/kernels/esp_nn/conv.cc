@@ -18,6 +18,10 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int16_activations.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int4_weights.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/palettized_weights.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/sparse_weights.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/conv.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
@@ -41,6 +45,14 @@ namespace {
 
 struct NodeData {
   OpDataConv op_data;
+  // Set when the filter is palettized. Output channels are decoded tile_rows
+  // at a time into the tile_buffer_idx scratch buffer.
+  PalettizedWeightsParams palettized_filter;
+  int tile_rows;
+  int tile_buffer_idx;
+  // Set when the filter is block sparse, with one row per output channel and
+  // filter tap.
+  BlockSparseWeightsParams sparse_filter;
 #if ESP_NN
   int buffer_idx;
 #endif
@@ -88,7 +100,7 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
           context, num_channels * sizeof(int32_t)));
 
   // All per-channel quantized tensors need valid zero point and scale arrays.
-  if (input->type == kTfLiteInt8) {
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteInt16) {
     TF_LITE_ENSURE_EQ(context, filter->quantization.type,
                       kTfLiteAffineQuantization);
 
@@ -110,6 +122,24 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
       context, node, params, input_width, input_height, filter_width,
       filter_height, output_width, output_height, input->type, &data->op_data));
 
+  TF_LITE_ENSURE_STATUS(micro_context->GetInputPalettizedWeights(
+      node, kConvWeightsTensor, &data->palettized_filter));
+  if (data->palettized_filter.palette != nullptr) {
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+    data->tile_rows = optimized_integer_ops::PalettizedWeightsTileRows(
+        data->palettized_filter);
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, data->tile_rows * data->palettized_filter.row_length,
+        &data->tile_buffer_idx));
+  }
+
+  TF_LITE_ENSURE_STATUS(micro_context->GetInputBlockSparseWeights(
+      node, kConvWeightsTensor, &data->sparse_filter));
+  if (data->sparse_filter.segments != nullptr) {
+    TF_LITE_ENSURE_TYPES_EQ(context, input->type, kTfLiteInt8);
+    TF_LITE_ENSURE(context, data->palettized_filter.palette == nullptr);
+  }
+
 #if ESP_NN
   if (input->type == kTfLiteInt8) {
     data_dims_t input_dims =  {
@@ -270,8 +300,12 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   const auto& data = *(static_cast<const NodeData*>(node->user_data));
 
   TF_LITE_ENSURE_EQ(context, input->type, output->type);
-  TF_LITE_ENSURE_MSG(context, input->type == filter->type,
-                     "Hybrid models are not supported on TFLite Micro.");
+  TF_LITE_ENSURE_MSG(
+      context,
+      input->type == filter->type ||
+          (input->type == kTfLiteInt8 && filter->type == kTfLiteInt4) ||
+          (input->type == kTfLiteInt16 && filter->type == kTfLiteInt8),
+      "Hybrid models are not supported on TFLite Micro.");
 
   long long start_time = esp_timer_get_time();
   switch (input->type) {  // Already know in/out types are same.
@@ -290,6 +324,54 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       break;
     }
     case kTfLiteInt8: {
+      if (data.palettized_filter.palette != nullptr) {
+        optimized_integer_ops::ConvPerChannelPalettized(
+            ConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter), data.palettized_filter,
+            tflite::micro::GetTensorData<uint8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetTensorData<int32_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output),
+            static_cast<int8_t*>(
+                context->GetScratchBuffer(context, data.tile_buffer_idx)),
+            data.tile_rows);
+        break;
+      }
+      if (data.sparse_filter.segments != nullptr) {
+        optimized_integer_ops::ConvPerChannelBlockSparse(
+            ConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter), data.sparse_filter,
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetTensorData<int32_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output));
+        break;
+      }
+      if (filter->type == kTfLiteInt4) {
+        optimized_integer_ops::ConvPerChannelInt4(
+            ConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetTensorData<int32_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output));
+        break;
+      }
 #if ESP_NN
       EvalQuantizedPerChannel(context, node, params, data, input, filter,
                               bias, output);
@@ -309,6 +391,40 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 #endif
       break;
     }
+    case kTfLiteInt16: {
+      if (bias == nullptr || bias->type == kTfLiteInt64) {
+        optimized_integer_ops::ConvPerChannel16x8(
+            ConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int16_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetOptionalTensorData<int64_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int16_t>(output));
+      } else if (bias->type == kTfLiteInt32) {
+        optimized_integer_ops::ConvPerChannel16x8(
+            ConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int16_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetTensorData<int32_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int16_t>(output));
+      } else {
+        MicroPrintf("Bias type %s (%d) not supported.",
+                    TfLiteTypeGetName(bias->type), bias->type);
+        return kTfLiteError;
+      }
+      break;
+    }
     case kTfLiteUInt8: {
       //EvalQuantized
       reference_ops::Conv(ConvParamsQuantized(params, data.op_data),
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/lite/kernels/internal/reference/pooling.h"
 
 #include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/pooling.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/micro/kernels/kernel_util.h"
 #include "tensorflow/lite/micro/kernels/pooling.h"
@@ -31,11 +32,104 @@ long long pooling_total_time = 0;
 namespace tflite {
 
 namespace {
+
+PoolParams Int8PoolParams(const TfLitePoolParams* params,
+                          const OpDataPooling* data) {
+  PoolParams op_params;
+  op_params.stride_height = params->stride_height;
+  op_params.stride_width = params->stride_width;
+  op_params.filter_height = params->filter_height;
+  op_params.filter_width = params->filter_width;
+  op_params.padding_values.height = data->padding.height;
+  op_params.padding_values.width = data->padding.width;
+  op_params.quantized_activation_min = data->activation_min;
+  op_params.quantized_activation_max = data->activation_max;
+  return op_params;
+}
+
+// Runs PoolingPrepare, then reserves the scratch row the int8
+// optimized_integer_ops kernel needs, sized by `scratch_bytes`.
+TfLiteStatus PrepareInt8Scratch(TfLiteContext* context, TfLiteNode* node,
+                                int (*scratch_bytes)(const PoolParams&, int,
+                                                     int)) {
+  TF_LITE_ENSURE_STATUS(PoolingPrepare(context, node));
+
+  auto* params = reinterpret_cast<TfLitePoolParams*>(node->builtin_data);
+  OpDataPooling* data = static_cast<OpDataPooling*>(node->user_data);
+  data->buffer_idx = -1;
+
+  MicroContext* micro_context = GetMicroContext(context);
+  TfLiteTensor* input =
+      micro_context->AllocateTempInputTensor(node, kPoolingInputTensor);
+  TF_LITE_ENSURE(context, input != nullptr);
+  bool use_optimized = input->type == kTfLiteInt8;
 #if ESP_NN
-void AverageEvalQuantized(TfLiteContext* context, const TfLiteNode* node,
-                          const TfLitePoolParams* params, const OpDataPooling* data,
+  // esp-nn handles channel counts that are a multiple of 4 on its own.
+  use_optimized = use_optimized && SizeOfDimension(input, 3) % 4 != 0;
+#endif
+  if (use_optimized) {
+    PoolParams op_params = Int8PoolParams(params, data);
+    const int bytes = scratch_bytes(op_params, SizeOfDimension(input, 2),
+                                    SizeOfDimension(input, 3));
+    if (bytes > 0) {
+      TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+          context, bytes, &data->buffer_idx));
+    }
+  }
+  micro_context->DeallocateTempTfLiteTensor(input);
+  return kTfLiteOk;
+}
+
+TfLiteStatus AveragePrepare(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareInt8Scratch(context, node,
+                            optimized_integer_ops::AveragePoolScratchBytes);
+}
+
+TfLiteStatus MaxPrepare(TfLiteContext* context, TfLiteNode* node) {
+  return PrepareInt8Scratch(context, node,
+                            optimized_integer_ops::MaxPoolScratchBytes);
+}
+
+TfLiteStatus AverageEvalInt8Optimized(TfLiteContext* context,
+                                      const TfLitePoolParams* params,
+                                      const OpDataPooling* data,
+                                      const TfLiteEvalTensor* input,
+                                      TfLiteEvalTensor* output) {
+  int32_t* scratch = static_cast<int32_t*>(
+      context->GetScratchBuffer(context, data->buffer_idx));
+  TF_LITE_ENSURE(context, optimized_integer_ops::AveragePool(
+                              Int8PoolParams(params, data),
+                              tflite::micro::GetTensorShape(input),
+                              tflite::micro::GetTensorData<int8_t>(input),
+                              tflite::micro::GetTensorShape(output),
+                              tflite::micro::GetTensorData<int8_t>(output),
+                              scratch));
+  return kTfLiteOk;
+}
+
+void MaxEvalInt8Optimized(TfLiteContext* context,
+                          const TfLitePoolParams* params,
+                          const OpDataPooling* data,
                           const TfLiteEvalTensor* input,
                           TfLiteEvalTensor* output) {
+  int8_t* scratch = nullptr;
+  if (data->buffer_idx != -1) {
+    scratch = static_cast<int8_t*>(
+        context->GetScratchBuffer(context, data->buffer_idx));
+  }
+  optimized_integer_ops::MaxPool(Int8PoolParams(params, data),
+                                 tflite::micro::GetTensorShape(input),
+                                 tflite::micro::GetTensorData<int8_t>(input),
+                                 tflite::micro::GetTensorShape(output),
+                                 tflite::micro::GetTensorData<int8_t>(output),
+                                 scratch);
+}
+
+#if ESP_NN
+TfLiteStatus AverageEvalQuantized(TfLiteContext* context, const TfLiteNode* node,
+                                  const TfLitePoolParams* params, const OpDataPooling* data,
+                                  const TfLiteEvalTensor* input,
+                                  TfLiteEvalTensor* output) {
 
   const int stride_height = params->stride_height;
   const int stride_width = params->stride_width;
@@ -76,17 +170,9 @@ void AverageEvalQuantized(TfLiteContext* context, const TfLiteNode* node,
       output_data += output_size;
     }
   } else {
-    for (int batch = 0; batch < batches; ++batch) {
-      esp_nn_avg_pool_s8_ansi(input_data, input_width, input_height,
-                              output_data, output_width, output_height,
-                              stride_width, stride_height,
-                              filter_width, filter_height,
-                              pad_width, pad_height,
-                              activation_min, activation_max, depth);
-      input_data += input_size;
-      output_data += output_size;
-    }
+    return AverageEvalInt8Optimized(context, params, data, input, output);
   }
+  return kTfLiteOk;
 }
 
 void MaxEvalQuantized(TfLiteContext* context, TfLiteNode* node,
@@ -131,16 +217,7 @@ void MaxEvalQuantized(TfLiteContext* context, TfLiteNode* node,
       output_data += output_size;
     }
   } else {
-    for (int batch = 0; batch < batches; ++batch) {
-      esp_nn_max_pool_s8_ansi(input_data, input_width, input_height,
-                              output_data, output_width, output_height,
-                              stride_width, stride_height,
-                              filter_width, filter_height,
-                              pad_width, pad_height,
-                              activation_min, activation_max, depth);
-      input_data += input_size;
-      output_data += output_size;
-    }
+    MaxEvalInt8Optimized(context, params, data, input, output);
   }
 }
 #endif
@@ -166,10 +243,11 @@ TfLiteStatus AverageEval(TfLiteContext* context, TfLiteNode* node) {
       break;
     case kTfLiteInt8:
 #if ESP_NN
-      AverageEvalQuantized(context, node, params, data, input, output);
+      TF_LITE_ENSURE_OK(context, AverageEvalQuantized(context, node, params,
+                                                      data, input, output));
 #else
-      AveragePoolingEvalQuantized<int8_t>(context, node, params, data, input,
-                                          output);
+      TF_LITE_ENSURE_OK(context, AverageEvalInt8Optimized(context, params,
+                                                          data, input, output));
 #endif
       break;
     case kTfLiteInt16:
@@ -207,8 +285,7 @@ TfLiteStatus MaxEval(TfLiteContext* context, TfLiteNode* node) {
 #if ESP_NN
       MaxEvalQuantized(context, node, params, data, input, output);
 #else
-      MaxPoolingEvalQuantized<int8_t>(context, node, params, data, input,
-                                      output);
+      MaxEvalInt8Optimized(context, params, data, input, output);
 #endif
       break;
     case kTfLiteInt16:
@@ -232,11 +309,11 @@ void* Init(TfLiteContext* context, const char* buffer, size_t length) {
 }  // namespace
 
 TfLiteRegistration_V1 Register_AVERAGE_POOL_2D() {
-  return tflite::micro::RegisterOp(Init, PoolingPrepare, AverageEval);
+  return tflite::micro::RegisterOp(Init, AveragePrepare, AverageEval);
 }
 
 TfLiteRegistration_V1 Register_MAX_POOL_2D() {
-  return tflite::micro::RegisterOp(Init, PoolingPrepare, MaxEval);
+  return tflite::micro::RegisterOp(Init, MaxPrepare, MaxEval);
 }
 
 }  // namespace tflite
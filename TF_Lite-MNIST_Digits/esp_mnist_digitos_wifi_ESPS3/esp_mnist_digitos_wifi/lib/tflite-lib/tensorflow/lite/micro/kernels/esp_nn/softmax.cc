@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int16_activations.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/softmax.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
@@ -41,6 +42,9 @@ const int kInt16LUTArraySize = 513;
 
 struct NodeData {
   SoftmaxParams op_data;
+  // Differences to the row maximum up to this one have a saturated exp().
+  // Only set for int16 input.
+  int32_t saturated_diff;
 #if ESP_NN
   int buffer_idx;
 #endif
@@ -90,8 +94,9 @@ void SoftmaxQuantized(TfLiteContext* context, const TfLiteEvalTensor* input,
 #endif
     }
   } else {
-    tflite::reference_ops::SoftmaxInt16(
-        data->op_data, tflite::micro::GetTensorShape(input),
+    optimized_integer_ops::SoftmaxInt16(
+        data->op_data, data->saturated_diff,
+        tflite::micro::GetTensorShape(input),
         tflite::micro::GetTensorData<int16_t>(input),
         tflite::micro::GetTensorShape(output),
         tflite::micro::GetTensorData<int16_t>(output));
@@ -147,6 +152,10 @@ static TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   auto* params = static_cast<TfLiteSoftmaxParams*>(node->builtin_data);
   auto ret_val =
       CalculateSoftmaxParams(context, input, output, params, op_data);
+  if (ret_val == kTfLiteOk && input->type == kTfLiteInt16) {
+    data->saturated_diff =
+        optimized_integer_ops::SoftmaxInt16SaturatedDiff(*op_data);
+  }
 
 #if ESP_NN
   if (output->type == kTfLiteInt8 && input->type == kTfLiteInt8) {
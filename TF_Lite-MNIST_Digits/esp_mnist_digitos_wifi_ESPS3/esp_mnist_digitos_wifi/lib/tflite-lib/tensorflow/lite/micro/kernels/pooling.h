@@ -40,6 +40,9 @@ struct OpDataPooling {
   int32_t activation_max;
   float activation_min_f32;
   float activation_max_f32;
+  // Scratch buffer for the int8 optimized_integer_ops pooling kernels, -1 if
+  // none was requested.
+  int buffer_idx;
 };
 
 TfLiteStatus CalculateOpDataPooling(const TfLiteContext* context,
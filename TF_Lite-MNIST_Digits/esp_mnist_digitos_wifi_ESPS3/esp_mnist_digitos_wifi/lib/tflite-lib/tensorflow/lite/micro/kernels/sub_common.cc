@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/add.h"
 #include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
@@ -98,6 +99,25 @@ TfLiteStatus SubPrepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_STATUS(
       CalculateOpDataSub(context, params, input1, input2, output, data));
 
+  data->input_tables = nullptr;
+  if (output->type == kTfLiteInt8 &&
+      NumElements(output) >=
+          optimized_integer_ops::kScaledInputTableMinElements) {
+    int32_t* input1_table = static_cast<int32_t*>(
+        context->AllocatePersistentBuffer(
+            context, optimized_integer_ops::kScaledInputTablesBytes));
+    TF_LITE_ENSURE(context, input1_table != nullptr);
+    int32_t* input2_table =
+        input1_table + optimized_integer_ops::kScaledInputTableSize;
+    optimized_integer_ops::PopulateScaledInputTable(
+        data->input1_offset, data->input1_multiplier, data->input1_shift,
+        data->left_shift, input1_table);
+    optimized_integer_ops::PopulateScaledInputTable(
+        data->input2_offset, data->input2_multiplier, data->input2_shift,
+        data->left_shift, input2_table);
+    data->input_tables = input1_table;
+  }
+
   micro_context->DeallocateTempTfLiteTensor(input1);
   micro_context->DeallocateTempTfLiteTensor(input2);
   micro_context->DeallocateTempTfLiteTensor(output);
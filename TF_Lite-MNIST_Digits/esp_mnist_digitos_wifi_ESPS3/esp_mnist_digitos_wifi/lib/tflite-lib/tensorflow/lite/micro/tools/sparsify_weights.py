@@ -0,0 +1,223 @@
+# Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Prunes the int8 conv and fully-connected weights of a TFLite model into
+1x4 or 1x16 blocks and stores them block sparse.
+
+Blocks run along the last filter dimension (input channels). In each selected
+tensor the blocks with the smallest sum of absolute values are zeroed until
+the requested fraction is reached, and only the remaining blocks are stored,
+described by the tensor's SparsityParameters in the standard TFLite layout:
+the leading dimensions dense, the last one SPARSE_CSR over blocks, plus a
+dense block dimension. The CONV_2D and FULLY_CONNECTED kernels pick this up in
+Prepare and skip the pruned blocks.
+
+Pruning without retraining costs accuracy; prune a fine-tuned model with
+block-aware pruning for production, then run this script with --sparsity=0
+to only convert blocks that are already zero.
+
+Usage:
+  python sparsify_weights.py --input_model=model_int8.tflite \
+      --output_model=model_sparse.tflite --block_size=4 --sparsity=0.5
+"""
+
+import argparse
+
+import numpy as np
+from tensorflow.lite.python import schema_py_generated as schema_fb
+from tensorflow.lite.tools import flatbuffer_utils
+
+_FILTER_OPS = (schema_fb.BuiltinOperator.CONV_2D,
+               schema_fb.BuiltinOperator.FULLY_CONNECTED)
+
+
+def prune_blocks(weights, block_size, sparsity):
+  """Zeroes the fraction `sparsity` of 1 x block_size blocks of `weights`
+  with the smallest L1 norm. Returns the pruned copy."""
+  blocks = weights.reshape(-1, block_size).astype(np.int32)
+  norms = np.abs(blocks).sum(axis=1)
+  num_pruned = int(round(sparsity * len(blocks)))
+  pruned = blocks.copy()
+  if num_pruned > 0:
+    pruned[np.argsort(norms, kind="stable")[:num_pruned]] = 0
+  return pruned.astype(np.int8).reshape(weights.shape)
+
+
+def encode_block_sparse(weights, block_size):
+  """Returns (values, segments, indices) of the nonzero blocks of `weights`,
+  rows being all dimensions but the last."""
+  rows = weights.reshape(-1, weights.shape[-1] // block_size, block_size)
+  nonzero = np.any(rows != 0, axis=2)
+  segments = np.concatenate([[0], np.cumsum(nonzero.sum(axis=1))])
+  indices = np.nonzero(nonzero)[1]
+  values = rows[nonzero].reshape(-1)
+  return values, segments.astype(np.int32), indices.astype(np.int32)
+
+
+def index_vector(values):
+  """Returns (SparseIndexVector type, vector, bytes) of `values` in the
+  narrowest unsigned type that holds them; the runtime widens Uint8Vector and
+  Uint16Vector to int32 once in Prepare."""
+  largest = int(values.max()) if values.size else 0
+  if largest <= 0xff:
+    vector_type = schema_fb.SparseIndexVector.Uint8Vector
+    vector, width = schema_fb.Uint8VectorT(), 1
+  elif largest <= 0xffff:
+    vector_type = schema_fb.SparseIndexVector.Uint16Vector
+    vector, width = schema_fb.Uint16VectorT(), 2
+  else:
+    vector_type = schema_fb.SparseIndexVector.Int32Vector
+    vector, width = schema_fb.Int32VectorT(), 4
+  vector.values = [int(v) for v in values]
+  return vector_type, vector, width * values.size
+
+
+def sparsity_parameters(shape, block_size, segments, indices):
+  """SparsityParametersT of a block-sparse tensor of the given shape."""
+  rank = len(shape)
+  dims = []
+  for d in range(rank - 1):
+    dim = schema_fb.DimensionMetadataT()
+    dim.format = schema_fb.DimensionType.DENSE
+    dim.denseSize = int(shape[d])
+    dims.append(dim)
+  dim = schema_fb.DimensionMetadataT()
+  dim.format = schema_fb.DimensionType.SPARSE_CSR
+  dim.arraySegmentsType, dim.arraySegments, _ = index_vector(segments)
+  dim.arrayIndicesType, dim.arrayIndices, _ = index_vector(indices)
+  dims.append(dim)
+  dim = schema_fb.DimensionMetadataT()
+  dim.format = schema_fb.DimensionType.DENSE
+  dim.denseSize = block_size
+  dims.append(dim)
+
+  sparsity = schema_fb.SparsityParametersT()
+  sparsity.traversalOrder = list(range(rank + 1))
+  sparsity.blockMap = [rank - 1]
+  sparsity.dimMetadata = dims
+  return sparsity
+
+
+def _builtin_code(operator_code):
+  return max(operator_code.builtinCode, operator_code.deprecatedBuiltinCode)
+
+
+def _filter_uses(model):
+  """Maps (subgraph, tensor) to the output tensors of the ops using it as a
+  filter, or None if it has any other use."""
+  uses = {}
+  for s, subgraph in enumerate(model.subgraphs):
+    for op in subgraph.operators:
+      code = _builtin_code(model.operatorCodes[op.opcodeIndex])
+      for position, tensor_index in enumerate(op.inputs):
+        if tensor_index < 0:
+          continue
+        key = (s, tensor_index)
+        if code not in _FILTER_OPS or position != 1 or (key in uses and
+                                                        uses[key] is None):
+          uses[key] = None
+          continue
+        uses.setdefault(key, []).append(op.outputs[0])
+  return uses
+
+
+def sparsify_model(model, block_size, sparsity, min_elements=1024):
+  """Prunes and converts eligible filters of a schema_fb.ModelT in place.
+
+  Returns a list of (tensor name, weights, kept weights, dense bytes, sparse
+  bytes, dense MACs, sparse MACs) for the converted tensors, with MACs per
+  inference of the ops using them, padding ignored.
+  """
+  buffer_users = {}
+  for subgraph in model.subgraphs:
+    for tensor in subgraph.tensors:
+      buffer_users[tensor.buffer] = buffer_users.get(tensor.buffer, 0) + 1
+
+  uses = _filter_uses(model)
+  report = []
+  for s, subgraph in enumerate(model.subgraphs):
+    for t, tensor in enumerate(subgraph.tensors):
+      outputs = uses.get((s, t))
+      buffer = model.buffers[tensor.buffer]
+      if (not outputs or tensor.type != schema_fb.TensorType.INT8 or
+          buffer.data is None or buffer_users[tensor.buffer] != 1 or
+          tensor.sparsity is not None or len(tensor.shape) < 2 or
+          tensor.shape[-1] % block_size != 0 or
+          np.prod(tensor.shape) < min_elements):
+        continue
+      quantization = tensor.quantization
+      if (quantization is not None and quantization.zeroPoint is not None and
+          any(quantization.zeroPoint)):
+        continue
+
+      weights = np.frombuffer(
+          np.asarray(buffer.data, dtype=np.uint8).tobytes(),
+          dtype=np.int8).reshape(tensor.shape)
+      pruned = prune_blocks(weights, block_size, sparsity)
+      values, segments, indices = encode_block_sparse(pruned, block_size)
+      sparse_bytes = (values.size + index_vector(segments)[2] +
+                      index_vector(indices)[2])
+      if sparse_bytes >= weights.size:
+        continue
+
+      buffer.data = values.view(np.uint8)
+      tensor.sparsity = sparsity_parameters(tensor.shape, block_size,
+                                            segments, indices)
+      macs_per_weight = sum(
+          np.prod(subgraph.tensors[o].shape) // tensor.shape[0]
+          for o in outputs)
+      name = tensor.name.decode() if isinstance(tensor.name,
+                                                bytes) else tensor.name
+      report.append((name, weights.size, values.size, weights.size,
+                     sparse_bytes, weights.size * macs_per_weight,
+                     values.size * macs_per_weight))
+  return report
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument("--input_model", required=True)
+  parser.add_argument("--output_model", required=True)
+  parser.add_argument("--block_size", type=int, choices=(4, 16), default=4)
+  parser.add_argument("--sparsity", type=float, default=0.5,
+                      help="Fraction of blocks to prune in each tensor; 0 "
+                      "only converts blocks that are already zero.")
+  parser.add_argument("--min_elements", type=int, default=1024,
+                      help="Leave smaller weight tensors dense.")
+  args = parser.parse_args()
+  if not 0 <= args.sparsity < 1:
+    parser.error("--sparsity must be in [0, 1)")
+
+  model = flatbuffer_utils.read_model(args.input_model)
+  if model.metadata is not None and any(
+      m.name in ("PalettizedWeights", b"PalettizedWeights")
+      for m in model.metadata):
+    parser.error("%s has palettized weights" % args.input_model)
+  report = sparsify_model(model, args.block_size, args.sparsity,
+                          args.min_elements)
+  flatbuffer_utils.write_model(model, args.output_model)
+
+  for name, size, kept, before, after, _, _ in report:
+    print("%-60s %3.0f%% kept  %8d -> %7d bytes" %
+          (name, 100.0 * kept / size, before, after))
+  dense_macs = sum(r[5] for r in report)
+  sparse_macs = sum(r[6] for r in report)
+  print("%d tensors, weights %d -> %d bytes, MACs %d -> %d (%.0f%% skipped)" %
+        (len(report), sum(r[3] for r in report), sum(r[4] for r in report),
+         dense_macs, sparse_macs,
+         100.0 * (dense_macs - sparse_macs) / max(dense_macs, 1)))
+
+
+if __name__ == "__main__":
+  main()
@@ -22,10 +22,23 @@
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
+#include "http_request_parser.h"
+#include "inference_queue.h"
+#include "input_quantizer.h"
+#include "pixel_array_parser.h"
+#include "raw_image_body.h"
+#include "response_writer.h"
+#include "result_cache.h"
+#include "server_metrics.h"
+#include "top_k.h"
+
 // Configurações WiFi - ALTERE AQUI
 const char* ssid = "REDE WIFI";
 const char* password = "PASSWORD";
 const int serverPort = 80;
+const unsigned long kKeepAliveTimeoutMs = 5000; // conexão ociosa entre requisições
+const unsigned long kHeaderTimeoutMs = 10000;
+const unsigned long kBodyTimeoutMs = 5000;
 
 // Servidor WiFi
 WiFiServer server(serverPort);
@@ -54,25 +67,126 @@ struct MNISTModel {
     
     static constexpr int kTensorArenaSize = 80 * 1024;
     static constexpr int kImageSize = 28 * 28;
+    static constexpr int kMaxRawImages = 8; // imagens por POST /predict_raw
 };
 
 // Instância global do modelo
 MNISTModel mnist_model = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, false};
 
+// Pixel 0..255 -> int8 da entrada do modelo, montado depois do AllocateTensors
+InputQuantizer input_quantizer;
+
 // Estrutura para resultado da inferência
 struct InferenceResult {
     int predicted_digit;
     float confidence;
     bool success;
     String error_message;
+    uint32_t receive_us;    // headers lidos -> imagem completa no slot
+    uint32_t queue_us;      // submetida -> início da inferência
+    uint32_t inference_us;  // Invoke e top-k
+    int top_count;          // entradas de top_k na resposta (0 sem ?top_k)
+    int top_classes[kMaxTopK];
+    float top_scores[kMaxTopK];
+    bool cached;            // respondido pelo result_cache, sem Invoke
+};
+
+// Buffer da resposta: headers e body são montados aqui e enviados com um
+// único write. Os headers de CORS vão em toda resposta. 12 KB cabem o
+// /metrics mesmo com os contadores no limite de 32 bits
+char response_buffer[12288];
+ResponseWriter response_writer(response_buffer, sizeof(response_buffer),
+                               "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                               "Access-Control-Allow-Headers: Content-Type\r\n");
+
+// Fila de inferência e conexões atendidas ao mesmo tempo
+const int kQueueSlots = 4;
+// Resultados guardados por hash da entrada quantizada; 0 desliga o cache.
+const int kResultCacheEntries = 32;
+const int kMaxConnections = 4;
+const uint32_t kInferenceTaskStackSize = 16 * 1024;
+
+// Estrutura para um slot da fila: a imagem já quantizada, preenchida pela
+// rede, e o resultado, preenchido pela tarefa de inferência
+struct InferenceJob {
+    int8_t* input;
+    int top_k;
+    uint32_t receive_us;
+    uint32_t submitted_us;
+    InferenceResult result;
+};
+
+InferenceJob inference_jobs[kQueueSlots];
+InferenceQueue inference_queue(kQueueSlots);
+ResultCache result_cache(kResultCacheEntries);
+// Histogramas por etapa e contagem de requisições, expostos em GET /metrics
+ServerMetrics server_metrics;
+
+// Estado de uma conexão entre uma volta do loop() e a próxima
+enum ConnectionState {
+    kReadHeaders,   // esperando a próxima requisição
+    kReadBody,      // body de /predict ou /predict_raw indo para os slots
+    kDiscardBody,   // body que não será usado (erro, /status, página)
+    kWaitResults,   // body lido, esperando as inferências
+};
+
+enum Route { kRoutePredict, kRoutePredictRaw, kRouteStatus, kRouteMetrics, kRouteHelp };
+
+// Estrutura para uma conexão atendida pelo loop(). Cada uma avança um pouco
+// por volta, sem bloquear, então várias podem ter imagens na fila ao mesmo
+// tempo
+struct ClientConnection {
+    WiFiClient client;
+    bool active = false;
+    ConnectionState state = kReadHeaders;
+    Route route = kRouteHelp;
+    HttpRequestParser request;
+    PixelArrayParser pixels{nullptr, MNISTModel::kImageSize, input_quantizer.table()};
+    int body_remaining = 0;
+    unsigned long last_activity = 0;
+    unsigned long request_start_us = 0;
+    uint32_t parse_us = 0;  // decodificação do body, somada entre os pedaços
+    int request_count = 0;
+    
+    int response_status = 200;
+    String error_message;
+    int image_count = 0;   // imagens da requisição (1 em /predict)
+    int top_k = 0;         // ?top_k=N; 0 responde só a classe prevista
+    int images_read = 0;   // já submetidas à fila
+    int images_done = 0;   // resultados já copiados para results
+    int filling_slot = -1; // slot recebendo a imagem atual
+    RawImageBody raw_body;  // bytes de /predict_raw já lidos
+    int pending_slots[MNISTModel::kMaxRawImages];
+    InferenceResult results[MNISTModel::kMaxRawImages];
 };
 
+ClientConnection connections[kMaxConnections];
+
 // Declarações das funções
 void cleanup_model();
 bool connect_wifi();
-void handle_client();
-String parse_json_array(String json_data, uint8_t* image_array);
-String create_json_response(const InferenceResult& result);
+void accept_clients();
+bool service_connection(ClientConnection& conn);
+bool read_headers(ClientConnection& conn);
+void start_request(ClientConnection& conn);
+bool start_image(ClientConnection& conn);
+void submit_image(ClientConnection& conn);
+int body_bytes_available(ClientConnection& conn);
+bool read_json_body(ClientConnection& conn);
+bool read_raw_body(ClientConnection& conn);
+bool discard_body(ClientConnection& conn);
+bool collect_results(ClientConnection& conn);
+bool wait_results(ClientConnection& conn);
+void release_slots(ClientConnection& conn);
+void finish_request(ClientConnection& conn);
+void close_connection(ClientConnection& conn);
+void send_response(WiFiClient& client, int status, const char* content_type, bool keep_alive);
+void write_json_response(ResponseWriter& out, const InferenceResult& result);
+void write_batch_json_response(ResponseWriter& out, const InferenceResult* results, int count);
+void write_status_response(ResponseWriter& out);
+void write_metrics(ResponseWriter& out);
+void write_help_page(ResponseWriter& out);
+bool start_inference_task();
 
 // Função para conectar ao WiFi
 bool connect_wifi() {
@@ -205,6 +319,10 @@ bool initialize_interpreter() {
         return false;
     }
     
+    // Tabela de quantização da entrada, usada pelo parser e pelo /predict_raw
+    input_quantizer.build(InputQuantizer::kUnitRange, mnist_model.input_tensor->params.scale,
+                          mnist_model.input_tensor->params.zero_point);
+    
     Serial.printf("Arena usada: %d/%d bytes\n", 
                   mnist_model.interpreter->arena_used_bytes(), MNISTModel::kTensorArenaSize);
     Serial.println("Interpretador inicializado com sucesso");
@@ -214,6 +332,9 @@ bool initialize_interpreter() {
 // Função para inicializar o modelo completo
 bool initialize_mnist_model() {
     Serial.println("=== Inicializando Modelo MNIST ===");
+
+    // Resultados de um modelo anterior não valem para o novo
+    result_cache.clear();
     
     // Inicializar error reporter
     static tflite::MicroErrorReporter micro_error_reporter;
@@ -233,23 +354,8 @@ bool initialize_mnist_model() {
     return true;
 }
 
-// Função para preprocessar a imagem
-void preprocess_image(const uint8_t* image_data) {
-    const float input_scale = mnist_model.input_tensor->params.scale;
-    const int32_t input_zero_point = mnist_model.input_tensor->params.zero_point;
-    
-    for (int i = 0; i < MNISTModel::kImageSize; ++i) {
-        uint8_t pixel = image_data[i];
-        float normalized_pixel = pixel / 255.0f;
-        int32_t quantized_value = static_cast<int32_t>(
-            roundf(normalized_pixel / input_scale) + input_zero_point);
-        quantized_value = max(-128, min(127, quantized_value));
-        mnist_model.input_tensor->data.int8[i] = static_cast<int8_t>(quantized_value);
-    }
-}
-
-// Função para fazer inferência
-InferenceResult run_inference(const uint8_t* image_data) {
+// Função para fazer inferência sobre o que já está no tensor de entrada
+InferenceResult run_inference_on_input(int top_k) {
     InferenceResult result = {-1, 0.0f, false, ""};
     
     if (!mnist_model.initialized) {
@@ -258,280 +364,614 @@ InferenceResult run_inference(const uint8_t* image_data) {
         return result;
     }
     
-    // Preprocessar imagem
-    preprocess_image(image_data);
-    
-    // Executar inferência
-    TfLiteStatus invoke_status = mnist_model.interpreter->Invoke();
-    if (invoke_status != kTfLiteOk) {
-        result.error_message = "Falha na execução da inferência";
-        Serial.printf("ERRO: Invoke falhou (código: %d)\n", invoke_status);
-        return result;
-    }
-    
-    // Analisar resultado
-    int best_index = 0;
-    int8_t max_score = SCHAR_MIN;
-    const int output_size = mnist_model.output_tensor->dims->data[1];
-    
-    for (int i = 0; i < output_size; ++i) {
-        if (mnist_model.output_tensor->data.int8[i] > max_score) {
-            max_score = mnist_model.output_tensor->data.int8[i];
-            best_index = i;
+    // A mesma entrada quantizada dá sempre a mesma saída: num acerto do
+    // cache o Invoke() é pulado. O top-k guardado é sempre o completo
+    // (kMaxTopK), para servir qualquer ?top_k.
+    const TfLiteTensor* input = mnist_model.input_tensor;
+    ResultCache::Key key = {};
+    CachedPrediction prediction;
+    result.cached = result_cache.lookup(input->data.int8, input->bytes, &key, &prediction);
+    uint32_t postprocess_start_us = micros();
+    if (!result.cached) {
+        const uint32_t invoke_start_us = postprocess_start_us;
+        TfLiteStatus invoke_status = mnist_model.interpreter->Invoke();
+        postprocess_start_us = micros();
+        server_metrics.record(ServerMetrics::kInvoke, postprocess_start_us - invoke_start_us);
+        if (invoke_status != kTfLiteOk) {
+            result.error_message = "Falha na execução da inferência";
+            Serial.printf("ERRO: Invoke falhou (código: %d)\n", invoke_status);
+            return result;
         }
+
+        const TfLiteTensor* output = mnist_model.output_tensor;
+        prediction.count = select_top_k(output->data.int8, output->dims->data[1], kMaxTopK,
+                                        output->params.scale, output->params.zero_point,
+                                        prediction.classes, prediction.scores);
+        result_cache.insert(key, prediction, micros() - invoke_start_us);
     }
-    
-    // Converter score para float
-    const float output_scale = mnist_model.output_tensor->params.scale;
-    const int32_t output_zero_point = mnist_model.output_tensor->params.zero_point;
-    float confidence = (static_cast<float>(max_score) - output_zero_point) * output_scale;
-    
-    result.predicted_digit = best_index;
-    result.confidence = confidence;
+
+    // O dígito previsto e a confiança são o primeiro lugar
+    memcpy(result.top_classes, prediction.classes, sizeof(result.top_classes));
+    memcpy(result.top_scores, prediction.scores, sizeof(result.top_scores));
+    result.predicted_digit = prediction.classes[0];
+    result.confidence = prediction.scores[0];
+    result.top_count = top_k > 0 ? min(top_k, prediction.count) : 0;
     result.success = true;
+    server_metrics.record(ServerMetrics::kPostprocess, micros() - postprocess_start_us);
     
     return result;
 }
 
+// Função para escrever os campos de um resultado, comuns à resposta simples
+// e aos itens de um lote
+void write_result_fields(ResponseWriter& out, const InferenceResult& result) {
+    out.field_bool("success", result.success);
+    out.field_int("predicted_digit", result.predicted_digit);
+    out.field_float("confidence", result.confidence, 6);
+    if (result.top_count > 0) {
+        out.field_top_k("top_k", "digit", result.top_classes, result.top_scores,
+                        result.top_count, 6);
+    }
+    out.field_string("error_message", result.error_message.c_str());
+    if (result.success) {
+        out.field_bool("cached", result.cached);
+        out.begin_object("timings_ms", true);
+        out.field_float("receive", result.receive_us / 1000.0f, 3);
+        out.field_float("queue", result.queue_us / 1000.0f, 3);
+        out.field_float("inference", result.inference_us / 1000.0f, 3);
+        out.end_object();
+    }
+}
+
+// Função para escrever o estado do sistema no fim de toda resposta JSON
+void write_system_fields(ResponseWriter& out) {
+    out.field_uint("heap_free", esp_get_free_heap_size());
+    out.field_bool("model_initialized", mnist_model.initialized);
+}
 
 // Função para criar resposta JSON
-String create_json_response(const InferenceResult& result) {
-    String response = "{\n";
-    response += "  \"success\": " + String(result.success ? "true" : "false") + ",\n";
-    response += "  \"predicted_digit\": " + String(result.predicted_digit) + ",\n";
-    response += "  \"confidence\": " + String(result.confidence, 6) + ",\n";
-    response += "  \"error_message\": \"" + result.error_message + "\",\n";
-    response += "  \"heap_free\": " + String(esp_get_free_heap_size()) + ",\n";
-    response += "  \"model_initialized\": " + String(mnist_model.initialized ? "true" : "false") + "\n";
-    response += "}";
-    return response;
-}
-
-// Função para lidar com clientes HTTP
-// Função para lidar com clientes HTTP - VERSÃO CORRIGIDA
-void handle_client() {
-    WiFiClient client = server.available();
-    if (!client) return;
-    
-    Serial.println("=== Cliente conectado ===");
-    
-    // Configurar timeout do cliente
-    client.setTimeout(5000);
-    
-    String request = "";
-    String headers = "";
-    String body = "";
-    bool reading_body = false;
-    int content_length = 0;
-    
-    // Ler requisição HTTP com timeout
-    unsigned long start_time = millis();
-    const unsigned long timeout_ms = 10000; // 10 segundos
-    
-    while (client.connected() && (millis() - start_time < timeout_ms)) {
-        if (!client.available()) {
-            delay(1);
-            continue;
+void write_json_response(ResponseWriter& out, const InferenceResult& result) {
+    out.begin_object();
+    write_result_fields(out, result);
+    write_system_fields(out);
+    out.end_object();
+}
+
+// Função para criar resposta JSON de um lote de /predict_raw
+void write_batch_json_response(ResponseWriter& out, const InferenceResult* results, int count) {
+    bool all_success = true;
+    for (int i = 0; i < count; ++i) {
+        all_success = all_success && results[i].success;
+    }
+    
+    out.begin_object();
+    out.field_bool("success", all_success);
+    out.field_int("count", count);
+    out.begin_array("results");
+    for (int i = 0; i < count; ++i) {
+        out.begin_object(nullptr, true);
+        write_result_fields(out, results[i]);
+        out.end_object();
+    }
+    out.end_array();
+    write_system_fields(out);
+    out.end_object();
+}
+
+// Função para criar a resposta de GET /status, com o estado do modelo e as
+// métricas da fila de inferência
+void write_status_response(ResponseWriter& out) {
+    const InferenceQueue::Stats queue = inference_queue.stats();
+    const uint32_t completed = queue.completed > 0 ? queue.completed : 1;
+    const ResultCache::Stats cache = result_cache.stats();
+    const uint32_t lookups = cache.hits + cache.misses;
+
+    out.begin_object();
+    out.field_bool("success", mnist_model.initialized);
+    out.field_int("predicted_digit", -1);
+    out.field_float("confidence", 0.0f, 6);
+    out.field_string("error_message", mnist_model.initialized ? "" : "Modelo não inicializado");
+    write_system_fields(out);
+    out.begin_object("queue", true);
+    out.field_int("slots", queue.slots);
+    out.field_int("depth", queue.depth);
+    out.field_int("max_depth", queue.max_depth);
+    out.field_uint("submitted", queue.submitted);
+    out.field_uint("completed", queue.completed);
+    out.field_uint("rejected", queue.rejected);
+    out.field_float("avg_wait_ms", queue.total_wait_us / completed / 1000.0f, 3);
+    out.field_float("max_wait_ms", queue.max_wait_us / 1000.0f, 3);
+    out.field_float("avg_inference_ms", queue.total_run_us / completed / 1000.0f, 3);
+    out.field_float("max_inference_ms", queue.max_run_us / 1000.0f, 3);
+    out.end_object();
+    out.begin_object("cache", true);
+    out.field_int("capacity", cache.capacity);
+    out.field_int("entries", cache.entries);
+    out.field_uint("hits", cache.hits);
+    out.field_uint("misses", cache.misses);
+    out.field_uint("evictions", cache.evictions);
+    out.field_uint("collisions", cache.collisions);
+    out.field_uint("invalidations", cache.invalidations);
+    out.field_float("hit_rate", lookups > 0 ? static_cast<float>(cache.hits) / lookups : 0.0f, 3);
+    out.field_float("avg_lookup_ms", cache.total_lookup_us / (lookups > 0 ? lookups : 1) / 1000.0f, 3);
+    out.field_float("max_lookup_ms", cache.max_lookup_us / 1000.0f, 3);
+    out.field_float("avg_invoke_ms", cache.total_invoke_us / (cache.misses > 0 ? cache.misses : 1) / 1000.0f, 3);
+    out.end_object();
+    out.end_object();
+}
+
+// Função para criar a resposta de GET /metrics: latências por etapa,
+// requisições por resultado, memória, fila e cache no formato de texto do
+// Prometheus
+void write_metrics(ResponseWriter& out) {
+    const InferenceQueue::Stats queue = inference_queue.stats();
+    const ResultCache::Stats cache = result_cache.stats();
+    const unsigned long arena_used = mnist_model.initialized ? mnist_model.interpreter->arena_used_bytes() : 0;
+
+    server_metrics.write(out);
+    ServerMetrics::write_metric(out, "classifier_model_initialized", "gauge",
+                                "1 com o modelo carregado.", mnist_model.initialized ? 1 : 0);
+    ServerMetrics::write_metric(out, "classifier_arena_used_bytes", "gauge",
+                                "Bytes da tensor arena em uso.", arena_used);
+    ServerMetrics::write_metric(out, "classifier_arena_size_bytes", "gauge",
+                                "Tamanho da tensor arena.", MNISTModel::kTensorArenaSize);
+    ServerMetrics::write_metric(out, "classifier_heap_free_bytes", "gauge",
+                                "Heap livre.", esp_get_free_heap_size());
+    ServerMetrics::write_metric(out, "classifier_heap_min_free_bytes", "gauge",
+                                "Menor heap livre desde o boot.", esp_get_minimum_free_heap_size());
+    ServerMetrics::write_metric(out, "classifier_psram_free_bytes", "gauge",
+                                "PSRAM livre.", heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    ServerMetrics::write_metric(out, "classifier_psram_min_free_bytes", "gauge",
+                                "Menor PSRAM livre desde o boot.",
+                                heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+    ServerMetrics::write_metric(out, "classifier_queue_depth", "gauge",
+                                "Slots na fila ou em execução.", queue.depth);
+    ServerMetrics::write_metric(out, "classifier_queue_max_depth", "gauge",
+                                "Maior profundidade da fila.", queue.max_depth);
+    ServerMetrics::write_metric(out, "classifier_inferences_total", "counter",
+                                "Imagens processadas pela tarefa de inferência.", queue.completed);
+    ServerMetrics::write_metric(out, "classifier_queue_rejected_total", "counter",
+                                "Requisições recusadas com a fila cheia.", queue.rejected);
+    ServerMetrics::write_metric(out, "classifier_cache_entries", "gauge",
+                                "Resultados guardados no cache.", cache.entries);
+    ServerMetrics::write_metric(out, "classifier_cache_hits_total", "counter",
+                                "Acertos do cache de resultados.", cache.hits);
+    ServerMetrics::write_metric(out, "classifier_cache_misses_total", "counter",
+                                "Falhas do cache de resultados.", cache.misses);
+    ServerMetrics::write_metric(out, "classifier_cache_evictions_total", "counter",
+                                "Resultados descartados com o cache cheio.", cache.evictions);
+    ServerMetrics::write_metric(out, "classifier_cache_collisions_total", "counter",
+                                "Entradas com o mesmo hash e outra imagem.", cache.collisions);
+}
+
+// Função para escrever a página de ajuda
+void write_help_page(ResponseWriter& out) {
+    char max_images[12];
+    snprintf(max_images, sizeof(max_images), "%d", MNISTModel::kMaxRawImages);
+    out.append("<!DOCTYPE html><html><body>");
+    out.append("<h1>MNIST API</h1>");
+    out.append("<h2>Endpoints:</h2>");
+    out.append("<p><b>POST /predict</b> - Fazer inferência</p>");
+    out.append("<p>Body JSON: {\"pixels\": [array de 784 valores 0-255]}</p>");
+    out.append("<p><b>POST /predict_raw</b> - Inferência com imagens binárias</p>");
+    out.append("<p>Body application/octet-stream: 784 bytes (28x28) por imagem, até ");
+    out.append(max_images);
+    out.append(" imagens</p>");
+    out.append("<p>Com <b>?top_k=N</b> (até 10) as duas rotas devolvem também os N dígitos mais prováveis</p>");
+    out.append("<p><b>GET /status</b> - Status do sistema e da fila de inferência</p>");
+    out.append("<p><b>GET /metrics</b> - Latências por etapa, memória, fila e cache no formato do Prometheus</p>");
+    out.append("<p>IP: ");
+    out.append(WiFi.localIP().toString().c_str());
+    out.append("</p>");
+    out.append("</body></html>");
+}
+
+// Função da tarefa de inferência: consome a fila no core 0 enquanto o
+// loop(), no core 1, continua aceitando conexões e lendo os bodies
+void inference_task(void* parameter) {
+    for (;;) {
+        const int slot = inference_queue.take();
+        InferenceJob& job = inference_jobs[slot];
+        const uint32_t start_us = micros();
+        memcpy(mnist_model.input_tensor->data.int8, job.input, MNISTModel::kImageSize);
+        server_metrics.record(ServerMetrics::kQueue, start_us - job.submitted_us);
+        server_metrics.record(ServerMetrics::kPreprocess, micros() - start_us);
+        job.result = run_inference_on_input(job.top_k);
+        job.result.receive_us = job.receive_us;
+        job.result.queue_us = start_us - job.submitted_us;
+        job.result.inference_us = micros() - start_us;
+        inference_queue.complete(slot);
+    }
+}
+
+// Função para alocar os slots da fila e criar a tarefa de inferência
+bool start_inference_task() {
+    for (int i = 0; i < kQueueSlots; ++i) {
+        inference_jobs[i].input = static_cast<int8_t*>(allocate_memory(MNISTModel::kImageSize));
+        if (inference_jobs[i].input == nullptr) {
+            Serial.println("ERRO: Falha na alocação dos slots da fila");
+            return false;
         }
-        
-        String line = client.readStringUntil('\n');
-        line.trim();
-        
-        if (!reading_body) {
-            if (line.length() == 0) {
-                reading_body = true;
-                break; // Parar de ler headers
-            }
-            
-            if (request.length() == 0) {
-                request = line;
+    }
+    
+    BaseType_t created = xTaskCreatePinnedToCore(
+        inference_task, "inference", kInferenceTaskStackSize, nullptr, 1, nullptr, 0);
+    if (created != pdPASS) {
+        Serial.println("ERRO: Falha ao criar a tarefa de inferência");
+        return false;
+    }
+    
+    Serial.printf("Tarefa de inferência no core 0, fila com %d slots\n", kQueueSlots);
+    return true;
+}
+
+// Função para aceitar clientes novos enquanto houver entrada livre em
+// connections. Com todas ocupadas, uma conexão ociosa entre requisições
+// keep-alive dá lugar ao cliente que está esperando; se nenhuma estiver
+// ociosa, ele fica no backlog do socket até alguma fechar
+void accept_clients() {
+    while (server.hasClient()) {
+        ClientConnection* conn = nullptr;
+        for (ClientConnection& candidate : connections) {
+            if (!candidate.active) {
+                conn = &candidate;
+                break;
             }
-            
-            headers += line + "\n";
-            
-            if (line.startsWith("Content-Length:")) {
-                content_length = line.substring(15).toInt();
+        }
+        if (conn == nullptr) {
+            for (ClientConnection& candidate : connections) {
+                if (candidate.state == kReadHeaders && !candidate.request.started()) {
+                    close_connection(candidate);
+                    conn = &candidate;
+                    break;
+                }
             }
         }
-    }
+        if (conn == nullptr) return;
     
-    // Ler body se POST e tiver Content-Length
-    if (content_length > 0 && content_length < 50000) { // Limite de segurança
-        body.reserve(content_length + 100);
-        
-        unsigned long body_start = millis();
-        while (body.length() < content_length && client.connected() && 
-               (millis() - body_start < 5000)) {
-            if (client.available()) {
-                char c = client.read();
-                body += c;
-            } else {
-                delay(1);
-            }
+        conn->client = server.available();
+        conn->client.setNoDelay(true);
+        conn->active = true;
+        conn->state = kReadHeaders;
+        conn->request.reset();
+        conn->filling_slot = -1;
+        conn->images_read = 0;
+        conn->images_done = 0;
+        conn->request_count = 0;
+        conn->last_activity = millis();
+        Serial.println("=== Cliente conectado ===");
+    }
+}
+
+// Função para avançar uma conexão sem bloquear. Retorna se algo foi feito,
+// para o loop() saber se pode dormir
+bool service_connection(ClientConnection& conn) {
+    if (!conn.client.connected() && conn.client.available() <= 0) {
+        close_connection(conn);
+        return true;
+    }
+    switch (conn.state) {
+        case kReadHeaders: return read_headers(conn);
+        case kReadBody: return conn.route == kRoutePredict ? read_json_body(conn) : read_raw_body(conn);
+        case kDiscardBody: return discard_body(conn);
+        case kWaitResults: return wait_results(conn);
+    }
+    return false;
+}
+
+// Função para ler os headers byte a byte, parando na linha em branco para
+// que o body e as requisições pipelined seguintes fiquem no socket
+bool read_headers(ClientConnection& conn) {
+    int available = conn.client.available();
+    if (available <= 0) {
+        unsigned long idle = millis() - conn.last_activity;
+        if (idle >= (conn.request.started() ? kHeaderTimeoutMs : kKeepAliveTimeoutMs)) {
+            close_connection(conn);
+            return true;
         }
+        return false;
     }
     
-    Serial.println("Requisição: " + request);
-    Serial.println("Body length: " + String(body.length()));
-    
-    String response_body = "";
-    String content_type = "text/html";
-    
-    // Processar requisição
-    if (request.startsWith("POST /predict")) {
-        content_type = "application/json";
-        
-        // Processar inferência
-        uint8_t image_data[784];
-        String parse_error = parse_json_array(body, image_data);
-        
-        InferenceResult result;
-        if (parse_error.length() > 0) {
-            result.success = false;
-            result.error_message = parse_error;
-            result.predicted_digit = -1;
-            result.confidence = 0.0f;
-            Serial.println("ERRO no parsing: " + parse_error);
+    conn.last_activity = millis();
+    while (available-- > 0) {
+        if (conn.request.feed(static_cast<char>(conn.client.read())) != HttpRequestParser::kNeedMore) {
+            start_request(conn);
+            break;
+        }
+    }
+    return true;
+}
+
+// Função para tratar os headers completos: escolhe a rota e, para /predict
+// e /predict_raw, reserva o slot da primeira imagem. Sem slot livre a
+// requisição é recusada com 503 depois de descartar o body
+void start_request(ClientConnection& conn) {
+    const HttpRequestParser& request = conn.request;
+    if (request.status() == HttpRequestParser::kError) {
+        Serial.printf("ERRO na requisição: %d %s\n", request.error_status(), request.error());
+        InferenceResult error = {-1, 0.0f, false, request.error()};
+        response_writer.reset();
+        write_json_response(response_writer, error);
+        send_response(conn.client, request.error_status(), "application/json", false);
+        server_metrics.count_request(ServerMetrics::kError);
+        close_connection(conn);
+        return;
+    }
+
+    Serial.printf("Requisição: %s %s\n", request.method(), request.path());
+    Serial.printf("Body length: %ld\n", request.content_length());
+
+    if (request.expect_continue()) conn.client.print("HTTP/1.1 100 Continue\r\n\r\n");
+
+    conn.state = kDiscardBody;
+    conn.request_start_us = micros();
+    conn.parse_us = 0;
+    conn.body_remaining = request.content_length();
+    conn.response_status = 200;
+    conn.error_message = "";
+    conn.image_count = 1;
+    conn.images_read = 0;
+    conn.images_done = 0;
+    conn.top_k = request.query_int("top_k", 0);
+
+    if (request.matches("POST", "/predict_raw")) {
+        conn.route = kRoutePredictRaw;
+        if (conn.raw_body.begin(conn.body_remaining, MNISTModel::kImageSize,
+                                MNISTModel::kMaxRawImages) == RawImageBody::kError) {
+            conn.error_message = conn.raw_body.error();
+        }
+        conn.image_count = conn.raw_body.image_count();
+    } else if (request.matches("POST", "/predict")) {
+        conn.route = kRoutePredict;
+    } else if (request.matches("GET", "/status")) {
+        conn.route = kRouteStatus;
+    } else if (request.matches("GET", "/metrics")) {
+        conn.route = kRouteMetrics;
+    } else {
+        conn.route = kRouteHelp;
+    }
+
+    if ((conn.route == kRoutePredict || conn.route == kRoutePredictRaw) && conn.error_message.length() == 0) {
+        if (conn.top_k < 0 || conn.top_k > kMaxTopK) {
+            conn.error_message = "top_k deve estar entre 0 e " + String(kMaxTopK);
+        } else if (!mnist_model.initialized) {
+            conn.error_message = "Modelo não inicializado";
+        } else if (!start_image(conn)) {
+            conn.response_status = 503;
+            conn.error_message = "Fila de inferência cheia, tente novamente";
+            inference_queue.reject();
         } else {
-            Serial.println("=== EXECUTANDO INFERÊNCIA ===");
-            result = run_inference(image_data);
-            
-            if (result.success) {
-                Serial.println("=== RESULTADO ===");
-                Serial.printf("Predição: %d\n", result.predicted_digit);
-                Serial.printf("Confiança: %.6f\n", result.confidence);
-                Serial.println("==================");
-            } else {
-                Serial.println("Falha na inferência: " + result.error_message);
-            }
+            conn.state = kReadBody;
+        }
+    }
+    if (conn.error_message.length() > 0) Serial.println("ERRO: " + conn.error_message);
+    conn.last_activity = millis();
+}
+
+// Função para reservar o slot que vai receber a próxima imagem
+bool start_image(ClientConnection& conn) {
+    conn.filling_slot = inference_queue.acquire();
+    if (conn.filling_slot < 0) return false;
+    inference_jobs[conn.filling_slot].top_k = conn.top_k;
+    if (conn.route == kRoutePredict) conn.pixels.reset(inference_jobs[conn.filling_slot].input);
+    return true;
+}
+
+// Função para submeter a imagem do slot atual à fila
+void submit_image(ClientConnection& conn) {
+    InferenceJob& job = inference_jobs[conn.filling_slot];
+    job.submitted_us = micros();
+    job.receive_us = job.submitted_us - conn.request_start_us;
+    conn.pending_slots[conn.images_read++] = conn.filling_slot;
+    inference_queue.submit(conn.filling_slot);
+    conn.filling_slot = -1;
+}
+
+// Função para registrar o tempo de recepção e de decodificação da
+// requisição, com o body inteiro lido
+void record_body_metrics(ClientConnection& conn) {
+    server_metrics.record(ServerMetrics::kReceive, micros() - conn.request_start_us);
+    server_metrics.record(ServerMetrics::kParse, conn.parse_us);
+}
+
+// Função para saber quantos bytes do body já podem ser lidos. Se nada chega
+// há kBodyTimeoutMs, responde com erro, fecha a conexão e retorna -1
+int body_bytes_available(ClientConnection& conn) {
+    int available = conn.client.available();
+    if (available > 0) {
+        conn.last_activity = millis();
+        return min(available, conn.body_remaining);
+    }
+    if (millis() - conn.last_activity >= kBodyTimeoutMs) {
+        if (conn.error_message.length() == 0) {
+            conn.error_message = "Corpo incompleto: faltaram " + String(conn.body_remaining) + " bytes";
         }
-        
-        response_body = create_json_response(result);
-        
-    } else if (request.startsWith("GET /status")) {
-        content_type = "application/json";
-        
-        // Status do sistema
-        InferenceResult status_result;
-        status_result.success = mnist_model.initialized;
-        status_result.predicted_digit = -1;
-        status_result.confidence = 0.0f;
-        status_result.error_message = mnist_model.initialized ? "" : "Modelo não inicializado";
-        
-        response_body = create_json_response(status_result);
-        
+        Serial.println("ERRO: " + conn.error_message);
+        finish_request(conn);
+        return -1;
+    }
+    return 0;
+}
+
+// Função para ler o body de POST /predict: o PixelArrayParser grava os
+// pixels já quantizados direto na entrada do slot, à medida que o body chega
+bool read_json_body(ClientConnection& conn) {
+    static char chunk[512];
+    if (conn.body_remaining > 0) {
+        int n = body_bytes_available(conn);
+        if (n <= 0) return n < 0;
+        n = conn.client.read(reinterpret_cast<uint8_t*>(chunk), min(n, (int)sizeof(chunk)));
+        if (n <= 0) return false;
+        conn.body_remaining -= n;
+        const uint32_t parse_start_us = micros();
+        conn.pixels.feed(chunk, n);
+        conn.parse_us += micros() - parse_start_us;
+        if (conn.body_remaining > 0 && conn.pixels.status() != PixelArrayParser::kError) return true;
+    }
+
+    if (conn.pixels.finish() == PixelArrayParser::kDone) {
+        record_body_metrics(conn);
+        submit_image(conn);
+        conn.state = kWaitResults;
     } else {
+        conn.error_message = conn.pixels.error();
+        Serial.println("ERRO no parsing: " + conn.error_message);
+        release_slots(conn);
+        conn.state = kDiscardBody;
+    }
+    return true;
+}
+
+// Função para ler o body de POST /predict_raw: kImageSize bytes por imagem
+// (pixels 0..255, linha por linha), de 1 a kMaxRawImages imagens. Cada
+// imagem é lida direto no seu slot e submetida assim que completa, então as
+// primeiras já estão sendo inferidas enquanto as seguintes chegam. Se os
+// slots acabarem no meio do lote, a leitura espera um deles voltar
+bool read_raw_body(ClientConnection& conn) {
+    bool progress = collect_results(conn);
+    if (conn.filling_slot < 0 && !start_image(conn)) return progress;
+
+    int n = body_bytes_available(conn);
+    if (n <= 0) return progress || n < 0;
+    int8_t* input = inference_jobs[conn.filling_slot].input + conn.raw_body.filled();
+    n = conn.client.read(reinterpret_cast<uint8_t*>(input), conn.raw_body.want(n));
+    if (n <= 0) return progress;
+    const uint32_t parse_start_us = micros();
+    input_quantizer.apply(input, n);
+    conn.parse_us += micros() - parse_start_us;
+    conn.body_remaining -= n;
+
+    const RawImageBody::Status status = conn.raw_body.consume(n);
+    if (status == RawImageBody::kImageDone || status == RawImageBody::kDone) {
+        const bool last_image = status == RawImageBody::kDone;
+        if (last_image) record_body_metrics(conn);
+        submit_image(conn);
+        if (last_image) conn.state = kWaitResults;
+    }
+    return true;
+}
+
+// Função para descartar o body que não será usado e responder
+bool discard_body(ClientConnection& conn) {
+    if (conn.body_remaining > 0) {
+        uint8_t chunk[64];
+        int n = body_bytes_available(conn);
+        if (n <= 0) return n < 0;
+        n = conn.client.read(chunk, min(n, (int)sizeof(chunk)));
+        if (n > 0) conn.body_remaining -= n;
+        if (conn.body_remaining > 0) return true;
+    }
+    finish_request(conn);
+    return true;
+}
+
+// Função para copiar os resultados já prontos, na ordem das imagens, e
+// devolver os slots
+bool collect_results(ClientConnection& conn) {
+    bool progress = false;
+    while (conn.images_done < conn.images_read &&
+           inference_queue.done(conn.pending_slots[conn.images_done])) {
+        const int slot = conn.pending_slots[conn.images_done];
+        conn.results[conn.images_done++] = inference_jobs[slot].result;
+        inference_queue.release(slot);
+        progress = true;
+    }
+    return progress;
+}
+
+// Função para responder quando todas as imagens da requisição forem inferidas
+bool wait_results(ClientConnection& conn) {
+    bool progress = collect_results(conn);
+    if (conn.images_done < conn.image_count) return progress;
+    finish_request(conn);
+    return true;
+}
+
+// Função para devolver os slots que a requisição ainda segura. Os que estão
+// na fila ou em execução voltam a ficar livres quando a inferência terminar
+void release_slots(ClientConnection& conn) {
+    if (conn.filling_slot >= 0) {
+        inference_queue.release(conn.filling_slot);
+        conn.filling_slot = -1;
+    }
+    while (conn.images_done < conn.images_read) {
+        inference_queue.release(conn.pending_slots[conn.images_done++]);
+    }
+}
+
+// Função para classificar a requisição em classifier_requests_total
+ServerMetrics::Outcome request_outcome(const ClientConnection& conn) {
+    if (conn.response_status == 503) return ServerMetrics::kRejected;
+    if (conn.error_message.length() > 0) return ServerMetrics::kError;
+    if (conn.route == kRoutePredict || conn.route == kRoutePredictRaw) {
+        for (int i = 0; i < conn.image_count; ++i) {
+            if (!conn.results[i].success) return ServerMetrics::kFailed;
+        }
+    }
+    return ServerMetrics::kOk;
+}
+
+// Função para responder à requisição atual. A conexão só continua aberta se
+// o cliente pediu e o body foi consumido por inteiro; senão a próxima
+// requisição começaria no meio dele
+void finish_request(ClientConnection& conn) {
+    release_slots(conn);
+
+    const uint32_t send_start_us = micros();
+    const char* content_type = "application/json";
+    response_writer.reset();
+    if (conn.route == kRouteStatus) {
+        write_status_response(response_writer);
+    } else if (conn.route == kRouteMetrics) {
+        content_type = "text/plain; version=0.0.4; charset=utf-8";
+        write_metrics(response_writer);
+    } else if (conn.route == kRouteHelp) {
         // Página de ajuda
-        response_body = "<!DOCTYPE html><html><body>";
-        response_body += "<h1>MNIST API</h1>";
-        response_body += "<h2>Endpoints:</h2>";
-        response_body += "<p><b>POST /predict</b> - Fazer inferência</p>";
-        response_body += "<p>Body JSON: {\"pixels\": [array de 784 valores 0-255]}</p>";
-        response_body += "<p><b>GET /status</b> - Status do sistema</p>";
-        response_body += "<p>IP: " + WiFi.localIP().toString() + "</p>";
-        response_body += "</body></html>";
-    }
-    
-    // Enviar resposta HTTP com headers apropriados
-    client.println("HTTP/1.1 200 OK");
-    client.println("Content-Type: " + content_type);
-    client.println("Access-Control-Allow-Origin: *");
-    client.println("Access-Control-Allow-Methods: GET, POST, OPTIONS");
-    client.println("Access-Control-Allow-Headers: Content-Type");
-    client.println("Connection: close");
-    client.println("Content-Length: " + String(response_body.length()));
-    client.println(); // Linha vazia importante
-    client.print(response_body);
-    client.flush(); // Garantir que todos os dados foram enviados
-    
-    // Pequena pausa antes de fechar
-    delay(100);
-    
-    client.stop();
-    Serial.println("Cliente desconectado\n");
-}
-
-// Função para parsear array JSON - VERSÃO MAIS ROBUSTA
-String parse_json_array(String json_data, uint8_t* image_array) {
-    // Procurar pelo array "pixels"
-    int start_index = json_data.indexOf("\"pixels\":");
-    if (start_index == -1) {
-        return "Campo 'pixels' não encontrado";
-    }
-    
-    start_index = json_data.indexOf('[', start_index);
-    if (start_index == -1) {
-        return "Array de pixels não encontrado";
-    }
-    
-    int end_index = json_data.indexOf(']', start_index);
-    if (end_index == -1) {
-        return "Fim do array não encontrado";
-    }
-    
-    String array_content = json_data.substring(start_index + 1, end_index);
-    array_content.trim();
-    
-    // Parsear valores com melhor tratamento de erros
-    int pixel_count = 0;
-    int current_pos = 0;
-    
-    while (current_pos < array_content.length() && pixel_count < 784) {
-        // Pular espaços em branco
-        while (current_pos < array_content.length() && 
-               (array_content.charAt(current_pos) == ' ' || 
-                array_content.charAt(current_pos) == '\t' ||
-                array_content.charAt(current_pos) == '\n' ||
-                array_content.charAt(current_pos) == '\r')) {
-            current_pos++;
+        content_type = "text/html";
+        write_help_page(response_writer);
+    } else if (conn.error_message.length() > 0) {
+        InferenceResult error = {-1, 0.0f, false, conn.error_message};
+        write_json_response(response_writer, error);
+    } else {
+        for (int i = 0; i < conn.image_count; ++i) {
+            Serial.printf("Imagem %d: predição %d, confiança %.6f\n",
+                          i, conn.results[i].predicted_digit, conn.results[i].confidence);
         }
-        
-        if (current_pos >= array_content.length()) break;
-        
-        // Encontrar próxima vírgula ou fim
-        int comma_pos = array_content.indexOf(',', current_pos);
-        String value_str;
-        
-        if (comma_pos == -1) {
-            value_str = array_content.substring(current_pos);
+        if (conn.image_count == 1) {
+            write_json_response(response_writer, conn.results[0]);
         } else {
-            value_str = array_content.substring(current_pos, comma_pos);
+            write_batch_json_response(response_writer, conn.results, conn.image_count);
         }
-        
-        value_str.trim();
-        
-        // Verificar se é número válido
-        bool is_valid_number = true;
-        for (int i = 0; i < value_str.length(); i++) {
-            char c = value_str.charAt(i);
-            if (!isdigit(c) && c != '-' && c != '+') {
-                is_valid_number = false;
-                break;
-            }
-        }
-        
-        if (!is_valid_number || value_str.length() == 0) {
-            return "Valor inválido no índice " + String(pixel_count) + ": '" + value_str + "'";
-        }
-        
-        int pixel_value = value_str.toInt();
-        
-        // Validar range do pixel (0-255)
-        if (pixel_value < 0) pixel_value = 0;
-        if (pixel_value > 255) pixel_value = 255;
-        
-        image_array[pixel_count] = (uint8_t)pixel_value;
-        pixel_count++;
-        
-        if (comma_pos == -1) break;
-        current_pos = comma_pos + 1;
     }
-    
-    if (pixel_count != 784) {
-        return "Array deve ter exatamente 784 pixels (28x28), recebido: " + String(pixel_count);
+
+    bool keep_alive = conn.request.keep_alive() && conn.body_remaining == 0;
+    send_response(conn.client, conn.response_status, content_type, keep_alive);
+    server_metrics.record(ServerMetrics::kSend, micros() - send_start_us);
+    server_metrics.count_request(request_outcome(conn));
+    conn.request_count++;
+
+    if (keep_alive) {
+        conn.state = kReadHeaders;
+        conn.request.reset();
+        conn.last_activity = millis();
+    } else {
+        close_connection(conn);
     }
-    
-    return ""; // Sucesso
+}
+
+// Função para fechar a conexão e devolver seus slots
+void close_connection(ClientConnection& conn) {
+    release_slots(conn);
+    conn.client.stop();
+    conn.active = false;
+    Serial.printf("Cliente desconectado (%d requisições)\n\n", conn.request_count);
+}
+
+// Função para enviar a resposta montada em response_writer num único write,
+// em vez de uma escrita por header
+void send_response(WiFiClient& client, int status, const char* content_type, bool keep_alive) {
+    response_writer.finish(status, content_type, keep_alive);
+    client.write(reinterpret_cast<const uint8_t*>(response_writer.data()), response_writer.size());
 }
 
 
@@ -549,8 +989,8 @@ void setup() {
         ESP.restart();
     }
     
-    // Inicializar modelo
-    if (!initialize_mnist_model()) {
+    // Inicializar modelo e a tarefa de inferência no core 0
+    if (!initialize_mnist_model() || !start_inference_task()) {
         Serial.println("Falha na inicialização do modelo!");
         return;
     }
@@ -560,7 +1000,9 @@ void setup() {
     Serial.println("\n=== Servidor HTTP iniciado ===");
     Serial.println("Endpoints disponíveis:");
     Serial.println("POST /predict - Fazer inferência");
+    Serial.println("POST /predict_raw - Inferência com imagens binárias");
     Serial.println("GET /status - Status do sistema");
+    Serial.println("GET /metrics - Métricas no formato do Prometheus");
     Serial.println("GET / - Página de ajuda");
     Serial.println("============================\n");
 }
@@ -576,7 +1018,11 @@ void loop() {
     }
     
     // Lidar com clientes
-    handle_client();
+    accept_clients();
+    bool progress = false;
+    for (ClientConnection& conn : connections) {
+        if (conn.active) progress |= service_connection(conn);
+    }
     
-    delay(10); // Pequeno delay para não sobrecarregar
+    if (!progress) delay(1); // Nada para fazer nesta volta
 }
\ No newline at end of file
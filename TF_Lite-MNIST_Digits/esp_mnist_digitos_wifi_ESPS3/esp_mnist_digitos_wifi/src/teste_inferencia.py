@@ -1,11 +1,14 @@
+import argparse
 import requests
 import json
+import time
 import numpy as np
 import tensorflow as tf
 import matplotlib.pyplot as plt
 
 ESP32_IP = "192.168.0.111"
 API_URL = f"http://{ESP32_IP}/predict"
+API_RAW_URL = f"http://{ESP32_IP}/predict_raw"
 IMAGE_INDEX = 5
 
 def get_mnist_image(index: int):
@@ -41,6 +44,53 @@ def send_image_for_inference(url: str, image_data: np.ndarray):
         print(f"Erro na comunicação com o ESP32: {e}")
         return None
 
+def send_image_raw(url: str, image_data: np.ndarray):
+    """Envia uma imagem uint8 28x28 (ou um lote empilhado no eixo 0) como
+    bytes crus para /predict_raw."""
+    if image_data is None:
+        return None
+
+    payload = np.ascontiguousarray(image_data, dtype=np.uint8).tobytes()
+
+    headers = {
+        'Content-Type': 'application/octet-stream'
+    }
+
+    try:
+        print(f"Enviando requisição para {url}...")
+        response = requests.post(url, data=payload, headers=headers, timeout=15)
+        response.raise_for_status()
+        return response.json()
+    except requests.exceptions.RequestException as e:
+        print(f"Erro na comunicação com o ESP32: {e}")
+        return None
+
+def compare_latency(image: np.ndarray, runs: int):
+    """Mede a latência da mesma imagem em /predict (JSON) e /predict_raw."""
+    json_size = len(json.dumps({"pixels": image.flatten().tolist()}))
+    endpoints = [
+        ("/predict (JSON)", API_URL, send_image_for_inference, json_size),
+        ("/predict_raw", API_RAW_URL, send_image_raw, image.size),
+    ]
+
+    print(f"Comparando latência com {runs} requisições por endpoint...")
+    for name, url, send, payload_size in endpoints:
+        latencies = []
+        for _ in range(runs):
+            start = time.perf_counter()
+            result = send(url, image)
+            elapsed_ms = (time.perf_counter() - start) * 1000
+            if result and result.get('success'):
+                latencies.append(elapsed_ms)
+        if not latencies:
+            print(f"{name:18s} todas as requisições falharam")
+            continue
+        print(f"{name:18s} payload {payload_size:6d} bytes | "
+              f"média {np.mean(latencies):7.1f} ms | "
+              f"mediana {np.median(latencies):7.1f} ms | "
+              f"mín {np.min(latencies):7.1f} ms | "
+              f"ok {len(latencies)}/{runs}")
+
 def display_results(image: np.ndarray, true_label: int, prediction_data: dict):
     if image is None or prediction_data is None:
         print("Não foi possível processar os resultados.")
@@ -70,8 +120,21 @@ def display_results(image: np.ndarray, true_label: int, prediction_data: dict):
 
 
 if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--index", type=int, default=IMAGE_INDEX, help="índice da imagem de teste do MNIST")
+    parser.add_argument("--json", action="store_true", help="usar /predict (JSON) em vez de /predict_raw")
+    parser.add_argument("--compare", type=int, metavar="N", help="comparar a latência de /predict e /predict_raw")
+    args = parser.parse_args()
+    IMAGE_INDEX = args.index
+
     sample_image, true_label = get_mnist_image(IMAGE_INDEX)
     
     if sample_image is not None:
-        prediction_result = send_image_for_inference(API_URL, sample_image)
-        display_results(sample_image, true_label, prediction_result)
\ No newline at end of file
+        if args.compare:
+            compare_latency(sample_image, args.compare)
+        elif args.json:
+            prediction_result = send_image_for_inference(API_URL, sample_image)
+            display_results(sample_image, true_label, prediction_result)
+        else:
+            prediction_result = send_image_raw(API_RAW_URL, sample_image)
+            display_results(sample_image, true_label, prediction_result)
\ No newline at end of file
@@ -0,0 +1,296 @@
+// micro DetectionPostprocess against the kernel it replaced, kept in
+// baseline_detection_postprocess.cpp, on synthetic SSD outputs (90 classes
+// plus background, max_detections 10), plus a timing comparison over anchor
+// counts. Both kernels run through a FakeMicroContext with an arena sized for
+// the case, as KernelRunner's fixed 10 KB arena is too small here.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "flatbuffers/flexbuffers.h"
+#include "tensorflow/lite/micro/arena_allocator/single_arena_buffer_allocator.h"
+#include "tensorflow/lite/micro/fake_micro_context.h"
+#include "tensorflow/lite/micro/micro_context.h"
+#include "tensorflow/lite/micro/mock_micro_graph.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+
+namespace tflite {
+TfLiteRegistration_V1* Register_DETECTION_POSTPROCESS();
+TfLiteRegistration_V1* Register_DETECTION_POSTPROCESS_BASELINE();
+}  // namespace tflite
+
+namespace {
+
+constexpr int kNumClasses = 90;
+constexpr int kNumClassesWithBackground = kNumClasses + 1;
+constexpr int kMaxDetections = 10;
+constexpr float kScoreScale = 1.0f / 255;
+
+// Init, Prepare and Invoke of one kernel, with the TfLiteContext wired the
+// way KernelRunner does it.
+class OpRunner {
+ public:
+  OpRunner(const TfLiteRegistration_V1& registration, TfLiteTensor* tensors,
+           TfLiteIntArray* inputs, TfLiteIntArray* outputs, size_t arena_bytes)
+      : registration_(registration),
+        arena_(arena_bytes),
+        allocator_(tflite::SingleArenaBufferAllocator::Create(arena_.data(),
+                                                              arena_.size())),
+        graph_(allocator_),
+        micro_context_(tensors, allocator_, &graph_) {
+    context_.impl_ = static_cast<void*>(&micro_context_);
+    context_.ReportError = tflite::MicroContextReportOpError;
+    context_.GetTensor = tflite::MicroContextGetTensor;
+    context_.GetEvalTensor = tflite::MicroContextGetEvalTensor;
+    context_.AllocatePersistentBuffer =
+        tflite::MicroContextAllocatePersistentBuffer;
+    context_.RequestScratchBufferInArena =
+        tflite::MicroContextRequestScratchBufferInArena;
+    context_.GetScratchBuffer = tflite::MicroContextGetScratchBuffer;
+    context_.GetExternalContext = tflite::MicroContextGetExternalContext;
+    node_.inputs = inputs;
+    node_.outputs = outputs;
+  }
+
+  bool InitAndPrepare(const std::vector<uint8_t>& options) {
+    node_.user_data = registration_.init(
+        &context_, reinterpret_cast<const char*>(options.data()),
+        options.size());
+    return registration_.prepare(&context_, &node_) == kTfLiteOk;
+  }
+
+  bool Invoke() { return registration_.invoke(&context_, &node_) == kTfLiteOk; }
+
+ private:
+  const TfLiteRegistration_V1& registration_;
+  std::vector<uint8_t> arena_;
+  tflite::SingleArenaBufferAllocator* allocator_;
+  tflite::MockMicroGraph graph_;
+  tflite::FakeMicroContext micro_context_;
+  TfLiteContext context_ = {};
+  TfLiteNode node_ = {};
+};
+
+// Random box encodings over a grid of anchors. `confident_permille` of the
+// anchors get one class well above the 0.5 score threshold; the other scores
+// are sigmoids of values around -6. The uint8 scores use scale 1/255 and
+// zero point 0, and the float scores can be their dequantized values so both
+// kernels see the same numbers.
+struct SsdCase {
+  int num_anchors;
+  bool regular_nms;
+  std::vector<float> boxes;
+  std::vector<float> anchors;
+  std::vector<float> scores;
+  std::vector<uint8_t> quantized_scores;
+  std::vector<uint8_t> options;
+
+  SsdCase(int num_anchors, int confident_permille, bool regular_nms,
+          bool dequantized_scores)
+      : num_anchors(num_anchors),
+        regular_nms(regular_nms),
+        boxes(num_anchors * 4),
+        anchors(num_anchors * 4),
+        scores(num_anchors * kNumClassesWithBackground),
+        quantized_scores(scores.size()) {
+    std::mt19937 rng(num_anchors + confident_permille);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    const int side = static_cast<int>(std::ceil(std::sqrt(num_anchors)));
+    for (int i = 0; i < num_anchors; ++i) {
+      anchors[i * 4 + 0] = ((i / side) + 0.5f) / side;
+      anchors[i * 4 + 1] = ((i % side) + 0.5f) / side;
+      anchors[i * 4 + 2] = 0.1f + 0.2f * (i % 3);
+      anchors[i * 4 + 3] = 0.1f + 0.1f * (i % 5);
+      for (int k = 0; k < 4; ++k) boxes[i * 4 + k] = normal(rng);
+      const int hot = static_cast<int>(rng() % 1000) < confident_permille
+                          ? 1 + static_cast<int>(rng() % kNumClasses)
+                          : -1;
+      for (int c = 0; c < kNumClassesWithBackground; ++c) {
+        float logit = normal(rng) * 1.5f - 6.0f;
+        if (c == hot) logit += 8.0f;
+        const float score = 1.0f / (1.0f + std::exp(-logit));
+        const int index = i * kNumClassesWithBackground + c;
+        quantized_scores[index] = static_cast<uint8_t>(
+            std::lround(std::min(255.0f, score / kScoreScale)));
+        scores[index] =
+            dequantized_scores ? quantized_scores[index] * kScoreScale : score;
+      }
+    }
+
+    flexbuffers::Builder fbb;
+    fbb.Map([&]() {
+      fbb.Int("max_detections", kMaxDetections);
+      fbb.Int("max_classes_per_detection", 1);
+      fbb.Int("detections_per_class", 100);
+      fbb.Bool("use_regular_nms", regular_nms);
+      fbb.Float("nms_score_threshold", 0.5f);
+      fbb.Float("nms_iou_threshold", 0.6f);
+      fbb.Int("num_classes", kNumClasses);
+      fbb.Float("y_scale", 10.0f);
+      fbb.Float("x_scale", 10.0f);
+      fbb.Float("h_scale", 5.0f);
+      fbb.Float("w_scale", 5.0f);
+    });
+    fbb.Finish();
+    options = fbb.GetBuffer();
+  }
+};
+
+struct Detections {
+  float boxes[kMaxDetections * 4];
+  float classes[kMaxDetections];
+  float scores[kMaxDetections];
+  float count;
+  double micros_per_call;
+};
+
+// Runs `registration` on the case `iterations` times and returns the last
+// outputs with the mean time per call.
+Detections Run(const TfLiteRegistration_V1& registration,
+               const SsdCase& ssd, bool quantized_scores, int iterations) {
+  using tflite::testing::CreateQuantizedTensor;
+  using tflite::testing::CreateTensor;
+  using tflite::testing::IntArrayFromInts;
+  int box_dims[] = {3, 1, ssd.num_anchors, 4};
+  int score_dims[] = {3, 1, ssd.num_anchors, kNumClassesWithBackground};
+  int anchor_dims[] = {2, ssd.num_anchors, 4};
+  int output_box_dims[] = {3, 1, kMaxDetections, 4};
+  int output_dims[] = {2, 1, kMaxDetections};
+  int count_dims[] = {1, 1};
+  int inputs[] = {3, 0, 1, 2};
+  int outputs[] = {4, 3, 4, 5, 6};
+
+  Detections result = {};
+  TfLiteTensor tensors[] = {
+      CreateTensor(ssd.boxes.data(), IntArrayFromInts(box_dims)),
+      quantized_scores
+          ? CreateQuantizedTensor(ssd.quantized_scores.data(),
+                                  IntArrayFromInts(score_dims), kScoreScale,
+                                  /*zero_point=*/0)
+          : CreateTensor(ssd.scores.data(), IntArrayFromInts(score_dims)),
+      CreateTensor(ssd.anchors.data(), IntArrayFromInts(anchor_dims)),
+      CreateTensor(result.boxes, IntArrayFromInts(output_box_dims)),
+      CreateTensor(result.classes, IntArrayFromInts(output_dims)),
+      CreateTensor(result.scores, IntArrayFromInts(output_dims)),
+      CreateTensor(&result.count, IntArrayFromInts(count_dims)),
+  };
+  // The baseline's scratch buffers take about 900 bytes per anchor with 91
+  // classes: the scores, a class-sized int buffer and max_detections-sized
+  // sort buffers.
+  const size_t arena_bytes =
+      256 * 1024 + static_cast<size_t>(ssd.num_anchors) * 3 *
+                       kNumClassesWithBackground * sizeof(float);
+  OpRunner runner(registration, tensors, IntArrayFromInts(inputs),
+                  IntArrayFromInts(outputs), arena_bytes);
+  TEST_ASSERT_TRUE(runner.InitAndPrepare(ssd.options));
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    TEST_ASSERT_TRUE(runner.Invoke());
+  }
+  result.micros_per_call = std::chrono::duration<double, std::micro>(
+                               std::chrono::steady_clock::now() - start)
+                               .count() /
+                           iterations;
+  return result;
+}
+
+// Classes and scores must match exactly. The boxes are decoded in float32
+// instead of double, so they may differ in the last bits.
+void CheckSameDetections(const Detections& expected, const Detections& actual) {
+  TEST_ASSERT_EQUAL_FLOAT(expected.count, actual.count);
+  const int count = static_cast<int>(expected.count);
+  TEST_ASSERT_EQUAL_MEMORY(expected.classes, actual.classes,
+                           count * sizeof(float));
+  TEST_ASSERT_EQUAL_MEMORY(expected.scores, actual.scores,
+                           count * sizeof(float));
+  for (int i = 0; i < count * 4; ++i) {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f * std::max(1.0f, std::fabs(expected.boxes[i])),
+                             expected.boxes[i], actual.boxes[i]);
+  }
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_float_scores_match_baseline() {
+  for (bool regular_nms : {false, true}) {
+    for (int confident_permille : {0, 20, 300}) {
+      for (int num_anchors : {1, 97, 1917}) {
+        const SsdCase ssd(num_anchors, confident_permille, regular_nms,
+                          /*dequantized_scores=*/false);
+        CheckSameDetections(
+            Run(*tflite::Register_DETECTION_POSTPROCESS_BASELINE(), ssd,
+                /*quantized_scores=*/false, 1),
+            Run(*tflite::Register_DETECTION_POSTPROCESS(), ssd,
+                /*quantized_scores=*/false, 1));
+      }
+    }
+  }
+}
+
+// The baseline only takes float scores, so it gets the dequantized values.
+void test_uint8_scores_match_baseline_on_dequantized_scores() {
+  for (bool regular_nms : {false, true}) {
+    for (int confident_permille : {20, 300}) {
+      const SsdCase ssd(1917, confident_permille, regular_nms,
+                        /*dequantized_scores=*/true);
+      CheckSameDetections(
+          Run(*tflite::Register_DETECTION_POSTPROCESS_BASELINE(), ssd,
+              /*quantized_scores=*/false, 1),
+          Run(*tflite::Register_DETECTION_POSTPROCESS(), ssd,
+              /*quantized_scores=*/true, 1));
+    }
+  }
+}
+
+void test_benchmark_against_baseline() {
+  for (bool regular_nms : {false, true}) {
+    for (int num_anchors : {1000, 5000, 20000}) {
+      const SsdCase ssd(num_anchors, /*confident_permille=*/20, regular_nms,
+                        /*dequantized_scores=*/false);
+      const int iterations = 100000 / num_anchors + 2;
+      const Detections baseline =
+          Run(*tflite::Register_DETECTION_POSTPROCESS_BASELINE(), ssd,
+              /*quantized_scores=*/false, iterations);
+      const Detections optimized =
+          Run(*tflite::Register_DETECTION_POSTPROCESS(), ssd,
+              /*quantized_scores=*/false, iterations);
+      CheckSameDetections(baseline, optimized);
+      TEST_ASSERT_EQUAL_FLOAT(kMaxDetections, optimized.count);
+      char line[128];
+      snprintf(line, sizeof(line),
+               "%s NMS, %d anchors: baseline %.0f us, optimized %.0f us "
+               "(%.1fx)",
+               regular_nms ? "regular" : "fast", num_anchors,
+               baseline.micros_per_call, optimized.micros_per_call,
+               baseline.micros_per_call / optimized.micros_per_call);
+      TEST_MESSAGE(line);
+    }
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_float_scores_match_baseline);
+  RUN_TEST(test_uint8_scores_match_baseline_on_dequantized_scores);
+  RUN_TEST(test_benchmark_against_baseline);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,234 @@
+// Microfrontend FftRadix4Real (fft_radix4.h) against the kiss_fftr it
+// replaced (kiss_fft_int16.h, FIXED_POINT=16): every bin bit-exact at 256
+// and 512 points (frames of up to 16 and 32 ms of 16 kHz audio; the default
+// 25 ms window is padded to 512), on random full-scale and small frames and on
+// edge inputs (zeros, int16 extremes, impulses, DC, Nyquist, square waves);
+// plus random frames at every other power of two from 4 to 8192 and a
+// timing comparison at 256 and 512.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_radix4.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/kiss_fft_int16.h"
+
+namespace {
+
+std::mt19937 rng(34);
+
+// Both transforms set up for one size, with their scratch.
+class FftPair {
+ public:
+  explicit FftPair(size_t fft_size)
+      : fft_size_(fft_size),
+        radix4_scratch_(FftRadix4ScratchSize(fft_size)),
+        radix4_output_(fft_size / 2 + 1),
+        kiss_output_(fft_size / 2 + 1) {
+    TEST_ASSERT_TRUE(radix4_scratch_.size() > 0);
+    TEST_ASSERT_EQUAL(1, FftRadix4Init(fft_size, radix4_scratch_.data(),
+                                       radix4_scratch_.size()));
+    size_t kiss_size = 0;
+    kissfft_fixed16::kiss_fftr_alloc(fft_size, 0, nullptr, &kiss_size);
+    kiss_scratch_.resize(kiss_size);
+    TEST_ASSERT_NOT_NULL(kissfft_fixed16::kiss_fftr_alloc(
+        fft_size, 0, kiss_scratch_.data(), &kiss_size));
+  }
+
+  void RunRadix4(const int16_t* input) {
+    FftRadix4Real(radix4_scratch_.data(), input, radix4_output_.data());
+  }
+
+  void RunKiss(const int16_t* input) {
+    kissfft_fixed16::kiss_fftr(
+        reinterpret_cast<kissfft_fixed16::kiss_fftr_cfg>(kiss_scratch_.data()),
+        input, kiss_output_.data());
+  }
+
+  // Runs both on `input` and fails on the first bin that differs.
+  void Check(const std::vector<int16_t>& input, const char* name) {
+    TEST_ASSERT_EQUAL(fft_size_, input.size());
+    RunRadix4(input.data());
+    RunKiss(input.data());
+    for (size_t bin = 0; bin <= fft_size_ / 2; ++bin) {
+      if (radix4_output_[bin].real != kiss_output_[bin].r ||
+          radix4_output_[bin].imag != kiss_output_[bin].i) {
+        char message[160];
+        snprintf(message, sizeof(message),
+                 "%u points, %s, bin %u: radix-4 (%d, %d), kiss_fftr (%d, %d)",
+                 static_cast<unsigned>(fft_size_), name,
+                 static_cast<unsigned>(bin), radix4_output_[bin].real,
+                 radix4_output_[bin].imag, kiss_output_[bin].r,
+                 kiss_output_[bin].i);
+        TEST_FAIL_MESSAGE(message);
+      }
+    }
+  }
+
+ private:
+  const size_t fft_size_;
+  std::vector<uint8_t> radix4_scratch_;
+  std::vector<uint8_t> kiss_scratch_;
+  std::vector<complex_int16_t> radix4_output_;
+  std::vector<kissfft_fixed16::kiss_fft_cpx> kiss_output_;
+};
+
+std::vector<int16_t> Frame(size_t size,
+                           const std::function<int(size_t)>& sample) {
+  std::vector<int16_t> frame(size);
+  for (size_t i = 0; i < size; ++i) {
+    frame[i] = static_cast<int16_t>(sample(i));
+  }
+  return frame;
+}
+
+std::vector<int16_t> RandomFrame(size_t size, int amplitude) {
+  std::uniform_int_distribution<int> value(-amplitude - 1, amplitude);
+  return Frame(size, [&](size_t) { return value(rng); });
+}
+
+// The frontend's input: a windowed frame scaled up by input_scale_shift,
+// here a sum of two tones at 16 kHz under a Hann window.
+std::vector<int16_t> WindowedTones(size_t size, float amplitude) {
+  return Frame(size, [&](size_t i) {
+    const float t = static_cast<float>(i) / 16000.0f;
+    const float window =
+        0.5f - 0.5f * std::cos(2 * 3.14159265f * i / (size - 1));
+    return static_cast<int>(
+        amplitude * window *
+        (0.6f * std::sin(2 * 3.14159265f * 440.0f * t) +
+         0.4f * std::sin(2 * 3.14159265f * 3150.0f * t)));
+  });
+}
+
+void CheckEdgeInputs(size_t size) {
+  FftPair fft(size);
+  fft.Check(Frame(size, [](size_t) { return 0; }), "zeros");
+  fft.Check(Frame(size, [](size_t) { return 32767; }), "all 32767");
+  fft.Check(Frame(size, [](size_t) { return -32768; }), "all -32768");
+  fft.Check(Frame(size, [](size_t i) { return i % 2 ? -32768 : 32767; }),
+            "Nyquist, full scale");
+  fft.Check(Frame(size, [](size_t i) { return i % 2 ? -1 : 1; }),
+            "Nyquist, +-1");
+  fft.Check(Frame(size, [](size_t i) { return i == 0 ? 32767 : 0; }),
+            "impulse at 0");
+  fft.Check(Frame(size, [](size_t i) { return i == 0 ? -32768 : 0; }),
+            "negative impulse at 0");
+  fft.Check(Frame(size, [&](size_t i) { return i == size - 1 ? 32767 : 0; }),
+            "impulse at the end");
+  fft.Check(Frame(size, [](size_t i) { return i == 1 ? 1 : 0; }),
+            "unit impulse at 1");
+  fft.Check(Frame(size, [](size_t) { return 1; }), "DC 1");
+  fft.Check(Frame(size, [](size_t i) { return (i / 4) % 2 ? -32768 : 32767; }),
+            "square wave, period 8");
+  fft.Check(Frame(size, [&](size_t i) { return i < size / 2 ? 32767 : -32768; }),
+            "step");
+  fft.Check(Frame(size,
+                  [&](size_t i) {
+                    return static_cast<int>(i * 65535 / (size - 1)) - 32768;
+                  }),
+            "full-scale ramp");
+  fft.Check(WindowedTones(size, 32767.0f), "windowed tones, full scale");
+  fft.Check(WindowedTones(size, 300.0f), "windowed tones, quiet");
+}
+
+double MicrosPerTransform(FftPair& fft, const std::vector<int16_t>& input,
+                          bool radix4) {
+  const int kIterations = 200000;
+  const auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < kIterations; ++n) {
+    if (radix4) {
+      fft.RunRadix4(input.data());
+    } else {
+      fft.RunKiss(input.data());
+    }
+  }
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         kIterations;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_256_matches_kiss_fftr() {
+  CheckEdgeInputs(256);
+  FftPair fft(256);
+  for (int trial = 0; trial < 2000; ++trial) {
+    fft.Check(RandomFrame(256, 32767), "random full scale");
+    fft.Check(RandomFrame(256, 1 + trial % 64), "random small");
+  }
+}
+
+void test_512_matches_kiss_fftr() {
+  CheckEdgeInputs(512);
+  FftPair fft(512);
+  for (int trial = 0; trial < 2000; ++trial) {
+    fft.Check(RandomFrame(512, 32767), "random full scale");
+    fft.Check(RandomFrame(512, 1 + trial % 64), "random small");
+  }
+}
+
+// Odd and even log2(fft_size / 2), i.e. with and without the radix-2 stage.
+void test_other_sizes_match_kiss_fftr() {
+  for (size_t size = 4; size <= 8192; size *= 2) {
+    if (size == 256 || size == 512) continue;
+    FftPair fft(size);
+    for (int trial = 0; trial < 50; ++trial) {
+      fft.Check(RandomFrame(size, 32767), "random full scale");
+    }
+    fft.Check(Frame(size, [](size_t i) { return i % 2 ? -32768 : 32767; }),
+              "Nyquist, full scale");
+  }
+  TEST_ASSERT_EQUAL(0, FftRadix4ScratchSize(2));
+  TEST_ASSERT_EQUAL(0, FftRadix4ScratchSize(400));
+}
+
+void test_benchmark_against_kiss_fftr() {
+  for (size_t size : {256u, 512u}) {
+    FftPair fft(size);
+    const std::vector<int16_t> input = WindowedTones(size, 20000.0f);
+    // Alternate and keep the best of three, so drift hits both sides.
+    double kiss_us = 1e9;
+    double radix4_us = 1e9;
+    for (int round = 0; round < 3; ++round) {
+      kiss_us = std::min(kiss_us, MicrosPerTransform(fft, input, false));
+      radix4_us = std::min(radix4_us, MicrosPerTransform(fft, input, true));
+    }
+    char line[128];
+    snprintf(line, sizeof(line),
+             "fft %u: kiss_fftr %.2f us, radix-4 %.2f us (%.2fx)",
+             static_cast<unsigned>(size), kiss_us, radix4_us,
+             kiss_us / radix4_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_256_matches_kiss_fftr);
+  RUN_TEST(test_512_matches_kiss_fftr);
+  RUN_TEST(test_other_sizes_match_kiss_fftr);
+  RUN_TEST(test_benchmark_against_kiss_fftr);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
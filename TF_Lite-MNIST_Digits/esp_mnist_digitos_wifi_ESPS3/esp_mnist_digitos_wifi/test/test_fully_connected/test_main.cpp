@@ -0,0 +1,298 @@
+// optimized_integer_ops::FullyConnected, used by esp_nn/fully_connected.cc
+// when ESP_NN is off, against reference_integer_ops::FullyConnected, plus a
+// timing comparison on classifier-head shapes. The float
+// optimized_ops::FullyConnected is checked against
+// reference_ops::FullyConnected within a rounding bound, since tflite-lib
+// builds it with -Ofast, and timed on the sine model's three layers.
+#include <unity.h>
+
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/optimized/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+
+namespace {
+
+std::mt19937 rng(26);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+void FillRandom(std::vector<int8_t>& values) {
+  for (int8_t& value : values) value = static_cast<int8_t>(RandomInt(-128, 127));
+}
+
+struct FullyConnectedCase {
+  int batches;
+  int accum_depth;
+  int output_depth;
+  tflite::FullyConnectedParams params;
+  std::vector<int8_t> input;
+  std::vector<int8_t> filter;
+  std::vector<int32_t> bias;
+  std::vector<int32_t> effective_bias;
+
+  FullyConnectedCase(int batches, int accum_depth, int output_depth)
+      : batches(batches),
+        accum_depth(accum_depth),
+        output_depth(output_depth),
+        params(),
+        input(batches * accum_depth),
+        filter(output_depth * accum_depth),
+        bias(output_depth),
+        effective_bias(output_depth) {
+    FillRandom(input);
+    FillRandom(filter);
+    for (int32_t& value : bias) value = RandomInt(-40000, 40000);
+    params.input_offset = RandomInt(-127, 128);
+    params.weights_offset = 0;
+    params.output_offset = RandomInt(-128, 127);
+    params.output_multiplier = RandomInt(1 << 30, 0x7fffffff);
+    params.output_shift = RandomInt(-12, 1);
+    params.quantized_activation_min = RandomInt(-128, 0);
+    params.quantized_activation_max = RandomInt(0, 127);
+    tflite::optimized_integer_ops::FullyConnectedPrecomputeBias(
+        filter.data(), bias.data(), params.input_offset, output_depth,
+        accum_depth, effective_bias.data());
+  }
+
+  void RunReference(int8_t* output) const {
+    const int input_dims[] = {batches, accum_depth};
+    const int filter_dims[] = {output_depth, accum_depth};
+    const int bias_dims[] = {output_depth};
+    const int output_dims[] = {batches, output_depth};
+    tflite::reference_integer_ops::FullyConnected(
+        params, tflite::RuntimeShape(2, input_dims), input.data(),
+        tflite::RuntimeShape(2, filter_dims), filter.data(),
+        tflite::RuntimeShape(1, bias_dims), bias.data(),
+        tflite::RuntimeShape(2, output_dims), output);
+  }
+
+  void RunOptimized(int8_t* output) const {
+    const int input_dims[] = {batches, accum_depth};
+    const int filter_dims[] = {output_depth, accum_depth};
+    const int output_dims[] = {batches, output_depth};
+    tflite::optimized_integer_ops::FullyConnected(
+        params, effective_bias.data(), tflite::RuntimeShape(2, input_dims),
+        input.data(), tflite::RuntimeShape(2, filter_dims), filter.data(),
+        tflite::RuntimeShape(2, output_dims), output);
+  }
+};
+
+struct FloatFullyConnectedCase {
+  int batches;
+  int accum_depth;
+  int output_depth;
+  tflite::FullyConnectedParams params;
+  std::vector<float> input;
+  std::vector<float> filter;
+  std::vector<float> bias;
+
+  FloatFullyConnectedCase(int batches, int accum_depth, int output_depth,
+                          float activation_min, float activation_max)
+      : batches(batches),
+        accum_depth(accum_depth),
+        output_depth(output_depth),
+        params(),
+        input(batches * accum_depth),
+        filter(output_depth * accum_depth),
+        bias(output_depth) {
+    std::uniform_real_distribution<float> values(-2.0f, 2.0f);
+    for (float& value : input) value = values(rng);
+    for (float& value : filter) value = values(rng);
+    for (float& value : bias) value = values(rng);
+    params.float_activation_min = activation_min;
+    params.float_activation_max = activation_max;
+  }
+
+  void RunReference(float* output) const {
+    const int input_dims[] = {batches, accum_depth};
+    const int filter_dims[] = {output_depth, accum_depth};
+    const int bias_dims[] = {output_depth};
+    const int output_dims[] = {batches, output_depth};
+    tflite::reference_ops::FullyConnected(
+        params, tflite::RuntimeShape(2, input_dims), input.data(),
+        tflite::RuntimeShape(2, filter_dims), filter.data(),
+        tflite::RuntimeShape(1, bias_dims), bias.data(),
+        tflite::RuntimeShape(2, output_dims), output);
+  }
+
+  void RunOptimized(float* output) const {
+    const int input_dims[] = {batches, accum_depth};
+    const int filter_dims[] = {output_depth, accum_depth};
+    const int bias_dims[] = {output_depth};
+    const int output_dims[] = {batches, output_depth};
+    tflite::optimized_ops::FullyConnected(
+        params, tflite::RuntimeShape(2, input_dims), input.data(),
+        tflite::RuntimeShape(2, filter_dims), filter.data(),
+        tflite::RuntimeShape(1, bias_dims), bias.data(),
+        tflite::RuntimeShape(2, output_dims), output);
+  }
+
+  // Error bound for a sum of accum_depth + 1 terms rounded in any order:
+  // (n + 1) * FLT_EPSILON times the sum of their magnitudes.
+  float Tolerance(int batch, int out_c) const {
+    float magnitude = std::fabs(bias[out_c]);
+    for (int d = 0; d < accum_depth; ++d) {
+      magnitude += std::fabs(input[batch * accum_depth + d] *
+                             filter[out_c * accum_depth + d]);
+    }
+    return (accum_depth + 2) * FLT_EPSILON * magnitude;
+  }
+};
+
+double MicrosPerCall(int iterations, void (*body)(const FullyConnectedCase&,
+                                                  int8_t*),
+                     const FullyConnectedCase& fc, int8_t* output) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) body(fc, output);
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Odd depths exercise the 1-row tail after the 4-row blocks and the single
+// batch row after the 2-row blocks.
+void test_matches_reference_on_random_shapes() {
+  for (int trial = 0; trial < 300; ++trial) {
+    FullyConnectedCase fc(RandomInt(1, 5), RandomInt(1, 300),
+                          RandomInt(1, 23));
+    std::vector<int8_t> expected(fc.batches * fc.output_depth);
+    std::vector<int8_t> actual(expected.size());
+    fc.RunReference(expected.data());
+    fc.RunOptimized(actual.data());
+    TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(),
+                                 expected.size());
+  }
+}
+
+void test_matches_reference_on_classifier_heads() {
+  const int shapes[][3] = {{1, 4096, 128}, {1, 1280, 10}, {4, 1024, 64}};
+  for (const auto& shape : shapes) {
+    FullyConnectedCase fc(shape[0], shape[1], shape[2]);
+    std::vector<int8_t> expected(fc.batches * fc.output_depth);
+    std::vector<int8_t> actual(expected.size());
+    fc.RunReference(expected.data());
+    fc.RunOptimized(actual.data());
+    TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(),
+                                 expected.size());
+  }
+}
+
+// No activation, ReLU and ReLU6 ranges; odd sizes hit the row and batch
+// tails as in the int8 test.
+void test_float_matches_reference_within_rounding() {
+  const float ranges[][2] = {
+      {-FLT_MAX, FLT_MAX}, {0.0f, FLT_MAX}, {0.0f, 6.0f}, {-1.0f, 1.0f}};
+  for (int trial = 0; trial < 300; ++trial) {
+    const float* range = ranges[trial % 4];
+    FloatFullyConnectedCase fc(RandomInt(1, 5), RandomInt(1, 300),
+                               RandomInt(1, 23), range[0], range[1]);
+    std::vector<float> expected(fc.batches * fc.output_depth);
+    std::vector<float> actual(expected.size());
+    fc.RunReference(expected.data());
+    fc.RunOptimized(actual.data());
+    for (int b = 0; b < fc.batches; ++b) {
+      for (int c = 0; c < fc.output_depth; ++c) {
+        const int i = b * fc.output_depth + c;
+        TEST_ASSERT_FLOAT_WITHIN(fc.Tolerance(b, c), expected[i], actual[i]);
+        TEST_ASSERT_TRUE(actual[i] >= range[0] && actual[i] <= range[1]);
+      }
+    }
+  }
+}
+
+// The sine model: 1 -> 50, 50 -> 50 and 50 -> 1, each Invoke() one angle.
+// inferirSenoLote() still runs one Invoke() per angle, so this per-angle
+// cost is the same through /seno and /seno_lote.
+void test_float_benchmark_on_sine_layers() {
+  const int shapes[][2] = {{1, 50}, {50, 50}, {50, 1}};
+  std::vector<FloatFullyConnectedCase> layers;
+  for (const auto& shape : shapes) {
+    layers.emplace_back(1, shape[0], shape[1], -FLT_MAX, FLT_MAX);
+  }
+  std::vector<float> output(50);
+  const int angles = 200000;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < angles; ++i) {
+    for (const FloatFullyConnectedCase& fc : layers) {
+      fc.RunReference(output.data());
+    }
+  }
+  const auto middle = std::chrono::steady_clock::now();
+  for (int i = 0; i < angles; ++i) {
+    for (const FloatFullyConnectedCase& fc : layers) {
+      fc.RunOptimized(output.data());
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double reference_us =
+      std::chrono::duration<double, std::micro>(middle - start).count() /
+      angles;
+  const double optimized_us =
+      std::chrono::duration<double, std::micro>(end - middle).count() / angles;
+  char line[128];
+  snprintf(line, sizeof(line),
+           "Sine FC layers per angle: reference %.3f us, optimized %.3f us "
+           "(%.2fx)",
+           reference_us, optimized_us, reference_us / optimized_us);
+  TEST_MESSAGE(line);
+}
+
+void test_benchmark_against_reference() {
+  const int shapes[][3] = {
+      {1, 4096, 128}, {1, 1280, 10}, {1, 128, 10}, {4, 1024, 64}};
+  for (const auto& shape : shapes) {
+    FullyConnectedCase fc(shape[0], shape[1], shape[2]);
+    std::vector<int8_t> output(fc.batches * fc.output_depth);
+    const int iterations = 20000000 / (shape[0] * shape[1] * shape[2]) + 1;
+    const double reference_us = MicrosPerCall(
+        iterations,
+        [](const FullyConnectedCase& c, int8_t* out) { c.RunReference(out); },
+        fc, output.data());
+    const double optimized_us = MicrosPerCall(
+        iterations,
+        [](const FullyConnectedCase& c, int8_t* out) { c.RunOptimized(out); },
+        fc, output.data());
+    char line[128];
+    snprintf(line, sizeof(line),
+             "FC %dx%d->%d: reference %.1f us, optimized %.1f us (%.2fx)",
+             shape[0], shape[1], shape[2], reference_us, optimized_us,
+             reference_us / optimized_us);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_reference_on_random_shapes);
+  RUN_TEST(test_matches_reference_on_classifier_heads);
+  RUN_TEST(test_benchmark_against_reference);
+  RUN_TEST(test_float_matches_reference_within_rounding);
+  RUN_TEST(test_float_benchmark_on_sine_layers);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,280 @@
+// InferenceQueue sozinha, sem rede nem modelo: acquire() devolve -1 com
+// todos os slots em uso e take() bloqueia com a fila vazia; os slots saem
+// de take() na ordem de submit(), inclusive quando a fila dá a volta;
+// release() antes do complete() só libera o slot quando a inferência
+// acaba. Por fim, uma tarefa de rede e uma de inferência em std::thread
+// trocam milhares de requisições, com slots abandonados no meio, e os
+// resultados e as estatísticas têm que fechar.
+#include <unity.h>
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "inference_queue.h"
+
+namespace {
+
+std::mt19937 rng(44);
+
+// Espera take() numa std::thread para ver se ele bloqueia.
+class Consumer {
+ public:
+  explicit Consumer(InferenceQueue& queue)
+      : slot_(-1), thread_([this, &queue] { slot_ = queue.take(); }) {}
+
+  ~Consumer() {
+    if (thread_.joinable()) thread_.join();
+  }
+
+  bool waiting() const { return slot_.load() == -1; }
+
+  int join() {
+    thread_.join();
+    return slot_;
+  }
+
+ private:
+  std::atomic<int> slot_;
+  std::thread thread_;
+};
+
+void pause() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Slots de 0 a N-1; o N+1-ésimo acquire() dá -1 até alguém liberar um, e
+// o número de slots fica entre 1 e kMaxSlots.
+void test_full_and_empty() {
+  InferenceQueue queue(3);
+  TEST_ASSERT_EQUAL(0, queue.acquire());
+  TEST_ASSERT_EQUAL(1, queue.acquire());
+  TEST_ASSERT_EQUAL(2, queue.acquire());
+  TEST_ASSERT_EQUAL(-1, queue.acquire());
+  queue.reject();
+  queue.release(1);
+  TEST_ASSERT_EQUAL(1, queue.acquire());
+  TEST_ASSERT_EQUAL(-1, queue.acquire());
+  queue.reject();
+
+  InferenceQueue::Stats stats = queue.stats();
+  TEST_ASSERT_EQUAL(3, stats.slots);
+  TEST_ASSERT_EQUAL(0, stats.depth);
+  TEST_ASSERT_EQUAL(0, stats.submitted);
+  TEST_ASSERT_EQUAL(2, stats.rejected);
+
+  TEST_ASSERT_EQUAL(1, InferenceQueue(0).stats().slots);
+  TEST_ASSERT_EQUAL(1, InferenceQueue(-4).stats().slots);
+  TEST_ASSERT_EQUAL(InferenceQueue::kMaxSlots,
+                    InferenceQueue(InferenceQueue::kMaxSlots + 1).stats().slots);
+  InferenceQueue single(1);
+  TEST_ASSERT_EQUAL(0, single.acquire());
+  TEST_ASSERT_EQUAL(-1, single.acquire());
+}
+
+// take() com a fila vazia espera o próximo submit(); slots só preenchidos
+// (acquire() sem submit()) não contam.
+void test_take_blocks_until_submit() {
+  InferenceQueue queue(2);
+  const int filling = queue.acquire();
+  const int slot = queue.acquire();
+  Consumer consumer(queue);
+  pause();
+  TEST_ASSERT_TRUE(consumer.waiting());
+  queue.submit(slot);
+  TEST_ASSERT_EQUAL(slot, consumer.join());
+  TEST_ASSERT_FALSE(queue.done(slot));
+  TEST_ASSERT_FALSE(queue.done(filling));
+  queue.complete(slot);
+  TEST_ASSERT_TRUE(queue.done(slot));
+
+  Consumer second(queue);
+  pause();
+  TEST_ASSERT_TRUE(second.waiting());
+  queue.submit(filling);
+  TEST_ASSERT_EQUAL(filling, second.join());
+}
+
+// A ordem de take() é a de submit(), não a dos slots, por várias voltas
+// do anel com a fila parcialmente cheia.
+void test_fifo_order() {
+  const int kSlots = 5;
+  InferenceQueue queue(kSlots);
+  for (int round = 0; round < 200; ++round) {
+    std::vector<int> slots;
+    const int count = 1 + static_cast<int>(rng() % kSlots);
+    for (int i = 0; i < count; ++i) slots.push_back(queue.acquire());
+    TEST_ASSERT_EQUAL(count, static_cast<int>(std::count_if(
+                                 slots.begin(), slots.end(),
+                                 [](int slot) { return slot >= 0; })));
+    std::shuffle(slots.begin(), slots.end(), rng);
+    for (int slot : slots) queue.submit(slot);
+    TEST_ASSERT_EQUAL(count, queue.stats().depth);
+    for (int slot : slots) {
+      TEST_ASSERT_EQUAL(slot, queue.take());
+      queue.complete(slot);
+      TEST_ASSERT_TRUE(queue.done(slot));
+      queue.release(slot);
+    }
+  }
+  const InferenceQueue::Stats stats = queue.stats();
+  TEST_ASSERT_EQUAL(0, stats.depth);
+  TEST_ASSERT_EQUAL(stats.submitted, stats.completed);
+  TEST_ASSERT_TRUE(stats.max_depth <= kSlots);
+}
+
+// release() depois de done() libera na hora; release() com o slot na fila
+// ou rodando (conexão fechada no meio) só libera no complete(), e o slot
+// não fica marcado como pronto para o próximo dono.
+void test_release_before_complete() {
+  InferenceQueue queue(2);
+  const int running = queue.acquire();
+  const int queued = queue.acquire();
+  queue.submit(running);
+  queue.submit(queued);
+  TEST_ASSERT_EQUAL(running, queue.take());
+
+  queue.release(running);
+  queue.release(queued);
+  TEST_ASSERT_EQUAL(-1, queue.acquire());
+
+  queue.complete(running);
+  TEST_ASSERT_FALSE(queue.done(running));
+  TEST_ASSERT_EQUAL(running, queue.acquire());
+  TEST_ASSERT_EQUAL(-1, queue.acquire());
+
+  // O slot abandonado na fila ainda sai em take() e roda até o fim.
+  TEST_ASSERT_EQUAL(queued, queue.take());
+  queue.complete(queued);
+  TEST_ASSERT_FALSE(queue.done(queued));
+  TEST_ASSERT_EQUAL(queued, queue.acquire());
+
+  // Um slot reaproveitado não herda o abandono do dono anterior.
+  queue.submit(queued);
+  TEST_ASSERT_EQUAL(queued, queue.take());
+  queue.complete(queued);
+  TEST_ASSERT_TRUE(queue.done(queued));
+  queue.release(queued);
+  queue.release(running);
+  TEST_ASSERT_EQUAL(0, queue.stats().depth);
+}
+
+// Uma tarefa de rede com várias requisições em andamento e uma de
+// inferência, como nas aplicações: cada resultado corresponde à entrada
+// do próprio slot, abandonos não vazam slots e as estatísticas fecham.
+void test_two_thread_stress() {
+  const int kSlots = 4;
+  const int kRequests = 20000;
+  const int kStop = -1;
+  InferenceQueue queue(kSlots);
+  int input[kSlots];
+  int output[kSlots];
+
+  std::thread inference([&] {
+    for (;;) {
+      const int slot = queue.take();
+      const int value = input[slot];
+      if (value != kStop) output[slot] = value * 3 + 1;
+      queue.complete(slot);
+      if (value == kStop) return;
+    }
+  });
+
+  std::mt19937 producer_rng(rng());
+  std::vector<int> in_flight;
+  std::vector<int> request_of(kSlots, -1);
+  int sent = 0;
+  int answered = 0;
+  int abandoned = 0;
+  int rejected = 0;
+  while (sent < kRequests || !in_flight.empty()) {
+    if (sent < kRequests) {
+      const int slot = queue.acquire();
+      if (slot < 0) {
+        // A aplicação responderia 503; aqui o cliente tenta de novo.
+        queue.reject();
+        rejected++;
+        std::this_thread::yield();
+      } else {
+        TEST_ASSERT_EQUAL(-1, request_of[slot]);
+        input[slot] = sent;
+        request_of[slot] = sent++;
+        queue.submit(slot);
+        in_flight.push_back(slot);
+      }
+    }
+    for (size_t i = 0; i < in_flight.size();) {
+      const int slot = in_flight[i];
+      const bool give_up = producer_rng() % 64 == 0;
+      if (queue.done(slot)) {
+        TEST_ASSERT_EQUAL(request_of[slot] * 3 + 1, output[slot]);
+        answered++;
+      } else if (give_up) {
+        abandoned++;
+      } else {
+        ++i;
+        continue;
+      }
+      request_of[slot] = -1;
+      queue.release(slot);
+      in_flight.erase(in_flight.begin() + i);
+    }
+  }
+
+  // Os abandonados ainda na fila terminam antes da parada.
+  int stop = -1;
+  while ((stop = queue.acquire()) < 0) std::this_thread::yield();
+  input[stop] = kStop;
+  queue.submit(stop);
+  inference.join();
+  TEST_ASSERT_TRUE(queue.done(stop));
+  queue.release(stop);
+
+  const InferenceQueue::Stats stats = queue.stats();
+  TEST_ASSERT_EQUAL(kRequests, answered + abandoned);
+  TEST_ASSERT_EQUAL(kRequests + 1, stats.submitted);
+  TEST_ASSERT_EQUAL(kRequests + 1, stats.completed);
+  TEST_ASSERT_EQUAL(rejected, stats.rejected);
+  TEST_ASSERT_EQUAL(0, stats.depth);
+  TEST_ASSERT_TRUE(stats.max_depth >= 1 && stats.max_depth <= kSlots);
+  for (int i = 0; i < kSlots; ++i) {
+    TEST_ASSERT_TRUE(queue.acquire() >= 0);
+  }
+  TEST_ASSERT_EQUAL(-1, queue.acquire());
+
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%d requisições: %d respondidas, %d abandonadas, %d recusadas, "
+           "profundidade máxima %d",
+           kRequests, answered, abandoned, rejected, stats.max_depth);
+  TEST_MESSAGE(line);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_and_empty);
+  RUN_TEST(test_take_blocks_until_submit);
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_release_before_complete);
+  RUN_TEST(test_two_thread_stress);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,227 @@
+// InputQuantizer: a tabela contra InputQuantizer::quantize() (a conta em
+// float por pixel do preprocess_image antigo) com a normalização, a escala
+// e o zero point do tensor de entrada de cada aplicação, e o apply() por
+// palavras contra uma busca escalar na tabela, em todas as combinações de
+// alinhamento de entrada e saída, com todos os tamanhos de 0 a 3.072 bytes
+// (uma imagem 32x32x3) e com uma imagem 96x96x3, no mesmo buffer e em
+// buffers separados.
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "input_quantizer.h"
+
+namespace {
+
+std::mt19937 rng(46);
+
+struct InputParams {
+  const char* name;
+  InputQuantizer::Normalization normalization;
+  float scale;
+  int32_t zero_point;
+};
+
+// Lidos do tensor de entrada dos .tflite em src/.
+const InputParams kApps[] = {
+    {"cifar10_simple_int8", InputQuantizer::kUnitRange, 0.00392156886f, -128},
+    {"mnist_cnn_small_int8", InputQuantizer::kUnitRange, 0.00392156886f, -128},
+    {"cifar10_mobilenetv2_finetuned_int8", InputQuantizer::kSymmetricRange,
+     0.00784313772f, -1},
+};
+
+const size_t kSmallImage = 32 * 32 * 3;
+const size_t kLargeImage = 96 * 96 * 3;
+// Bytes de guarda depois da saída, que o apply() não pode tocar.
+const size_t kGuard = 8;
+
+void expect_table(const InputQuantizer& quantizer, const InputParams& params) {
+  for (int pixel = 0; pixel < 256; ++pixel) {
+    const int8_t expected = InputQuantizer::quantize(
+        pixel, params.normalization, params.scale, params.zero_point);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(expected, quantizer[pixel], params.name);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(expected, quantizer.table()[pixel],
+                                   params.name);
+  }
+}
+
+// Confere apply() com a entrada em `input_offset` e a saída em
+// `output_offset` de buffers alinhados a 4 bytes, para `count` bytes.
+void expect_apply(const InputQuantizer& quantizer,
+                  const std::vector<uint8_t>& pixels, size_t input_offset,
+                  size_t output_offset, size_t count) {
+  static std::vector<uint32_t> input_words;
+  static std::vector<uint32_t> output_words;
+  input_words.assign((kLargeImage + 16) / 4, 0);
+  output_words.assign((kLargeImage + 16 + kGuard) / 4, 0x5a5a5a5a);
+  uint8_t* input = reinterpret_cast<uint8_t*>(input_words.data()) + input_offset;
+  int8_t* output = reinterpret_cast<int8_t*>(output_words.data()) + output_offset;
+  memcpy(input, pixels.data(), count);
+
+  quantizer.apply(input, output, count);
+  for (size_t i = 0; i < count; ++i) {
+    if (output[i] != quantizer[pixels[i]]) {
+      char message[96];
+      snprintf(message, sizeof(message),
+               "entrada +%u, saída +%u, %u bytes, índice %u",
+               static_cast<unsigned>(input_offset),
+               static_cast<unsigned>(output_offset),
+               static_cast<unsigned>(count), static_cast<unsigned>(i));
+      TEST_FAIL_MESSAGE(message);
+    }
+  }
+  for (size_t i = count; i < count + kGuard; ++i) {
+    TEST_ASSERT_EQUAL_INT8(0x5a, output[i]);
+  }
+  // A entrada não muda quando os buffers são separados.
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(pixels.data(), input, count);
+}
+
+// O mesmo, no buffer único das aplicações: os pixels chegam em `data` e
+// saem quantizados no lugar.
+void expect_apply_in_place(const InputQuantizer& quantizer,
+                           const std::vector<uint8_t>& pixels, size_t offset,
+                           size_t count) {
+  static std::vector<uint32_t> words;
+  words.assign((kLargeImage + 16 + kGuard) / 4, 0x5a5a5a5a);
+  int8_t* data = reinterpret_cast<int8_t*>(words.data()) + offset;
+  memcpy(data, pixels.data(), count);
+
+  quantizer.apply(data, count);
+  for (size_t i = 0; i < count; ++i) {
+    if (data[i] != quantizer[pixels[i]]) {
+      char message[96];
+      snprintf(message, sizeof(message), "no lugar +%u, %u bytes, índice %u",
+               static_cast<unsigned>(offset), static_cast<unsigned>(count),
+               static_cast<unsigned>(i));
+      TEST_FAIL_MESSAGE(message);
+    }
+  }
+  for (size_t i = count; i < count + kGuard; ++i) {
+    TEST_ASSERT_EQUAL_INT8(0x5a, data[i]);
+  }
+}
+
+std::vector<uint8_t> random_pixels(size_t size) {
+  std::vector<uint8_t> pixels(size);
+  for (uint8_t& pixel : pixels) pixel = static_cast<uint8_t>(rng() & 0xff);
+  return pixels;
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// A tabela de cada aplicação é igual à conta em float pixel a pixel, e
+// também com escalas e zero points aleatórios (inclusive os que saturam).
+void test_table_matches_quantize() {
+  InputQuantizer quantizer;
+  for (const InputParams& params : kApps) {
+    quantizer.build(params.normalization, params.scale, params.zero_point);
+    expect_table(quantizer, params);
+  }
+  // Os dois modelos de 1/255 e -128 levam o pixel p ao int8 p - 128.
+  quantizer.build(kApps[0].normalization, kApps[0].scale, kApps[0].zero_point);
+  for (int pixel = 0; pixel < 256; ++pixel) {
+    TEST_ASSERT_EQUAL_INT8(pixel - 128, quantizer[pixel]);
+  }
+
+  std::uniform_real_distribution<float> scale(0.001f, 0.05f);
+  std::uniform_int_distribution<int32_t> zero_point(-128, 127);
+  for (int trial = 0; trial < 200; ++trial) {
+    const InputParams params = {
+        "aleatório",
+        trial % 2 == 0 ? InputQuantizer::kUnitRange
+                       : InputQuantizer::kSymmetricRange,
+        scale(rng), zero_point(rng)};
+    quantizer.build(params.normalization, params.scale, params.zero_point);
+    expect_table(quantizer, params);
+  }
+}
+
+// apply() por palavras igual à busca escalar para as 16 combinações de
+// alinhamento de entrada e saída (as que não se alinham juntas caem no
+// laço escalar) e para cada tamanho de 0 a 3.072 bytes, mais a imagem de
+// 96x96x3; no lugar, os 4 alinhamentos.
+void test_apply_matches_scalar_lookup() {
+  InputQuantizer quantizer;
+  quantizer.build(kApps[2].normalization, kApps[2].scale, kApps[2].zero_point);
+  const std::vector<uint8_t> pixels = random_pixels(kLargeImage);
+  for (size_t input_offset = 0; input_offset < 4; ++input_offset) {
+    for (size_t output_offset = 0; output_offset < 4; ++output_offset) {
+      for (size_t count = 0; count <= kSmallImage; ++count) {
+        expect_apply(quantizer, pixels, input_offset, output_offset, count);
+      }
+      expect_apply(quantizer, pixels, input_offset, output_offset, kLargeImage);
+    }
+    for (size_t count = 0; count <= kSmallImage; ++count) {
+      expect_apply_in_place(quantizer, pixels, input_offset, count);
+    }
+    expect_apply_in_place(quantizer, pixels, input_offset, kLargeImage);
+  }
+}
+
+void test_benchmark_apply() {
+  InputQuantizer quantizer;
+  quantizer.build(kApps[0].normalization, kApps[0].scale, kApps[0].zero_point);
+  const std::vector<uint8_t> pixels = random_pixels(kLargeImage);
+  std::vector<int8_t> output(kLargeImage);
+  const int kIterations = 2000;
+
+  volatile int8_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < kIterations; ++n) {
+    for (size_t i = 0; i < kLargeImage; ++i) {
+      output[i] = InputQuantizer::quantize(pixels[i], kApps[0].normalization,
+                                           kApps[0].scale, kApps[0].zero_point);
+    }
+    sink = output[n % kLargeImage];
+  }
+  const double float_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          kIterations;
+
+  start = std::chrono::steady_clock::now();
+  for (int n = 0; n < kIterations; ++n) {
+    quantizer.apply(pixels.data(), output.data(), kLargeImage);
+    sink = output[n % kLargeImage];
+  }
+  const double table_us = std::chrono::duration<double, std::micro>(
+                              std::chrono::steady_clock::now() - start)
+                              .count() /
+                          kIterations;
+  (void)sink;
+
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%u pixels: float por pixel %.1f us, apply %.1f us (%.1fx)",
+           static_cast<unsigned>(kLargeImage), float_us, table_us,
+           float_us / table_us);
+  TEST_MESSAGE(line);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_matches_quantize);
+  RUN_TEST(test_apply_matches_scalar_lookup);
+  RUN_TEST(test_benchmark_apply);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,332 @@
+// Packed int4 filters (int4_weights.h): the nibble helpers against every
+// byte value and against tensor_utils::UnpackDenseInt4IntoInt8, and
+// ConvPerChannelInt4, DepthwiseConvPerChannelInt4 and FullyConnectedInt4
+// against the int8 reference kernels run on the same filter unpacked to int8
+// values in [-8, 7]. Covers rows that start on an odd nibble, grouped
+// convolutions, depth multipliers, padding, strides, dilation and clamped
+// activations.
+#include <unity.h>
+
+#include <cstdio>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int4_weights.h"
+#include "tensorflow/lite/kernels/internal/portable_tensor_utils.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+
+namespace {
+
+std::mt19937 rng(37);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// Random int4 values, stored one per int8.
+std::vector<int8_t> RandomInt4Values(int count) {
+  std::vector<int8_t> values(count);
+  for (int8_t& value : values) value = static_cast<int8_t>(RandomInt(-8, 7));
+  return values;
+}
+
+// Two values per byte over the flattened tensor, the even element in the low
+// nibble, as pack_int4_weights.py writes them.
+std::vector<int8_t> PackInt4(const std::vector<int8_t>& values) {
+  std::vector<int8_t> packed((values.size() + 1) / 2, 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    const int nibble = values[i] & 0xf;
+    packed[i / 2] = static_cast<int8_t>(packed[i / 2] |
+                                        (i % 2 ? nibble << 4 : nibble));
+  }
+  return packed;
+}
+
+std::vector<int8_t> RandomInt8(int count) {
+  std::vector<int8_t> values(count);
+  for (int8_t& value : values) {
+    value = static_cast<int8_t>(RandomInt(-128, 127));
+  }
+  return values;
+}
+
+std::vector<int32_t> RandomBias(int count) {
+  std::vector<int32_t> bias(count);
+  for (int32_t& value : bias) value = RandomInt(-20000, 20000);
+  return bias;
+}
+
+// Per-channel requantization with a small gain, so outputs spread over the
+// int8 range instead of saturating.
+struct ChannelScales {
+  std::vector<int32_t> multiplier;
+  std::vector<int32_t> shift;
+
+  explicit ChannelScales(int channels) : multiplier(channels), shift(channels) {
+    for (int c = 0; c < channels; ++c) {
+      multiplier[c] = RandomInt(1 << 30, 0x7fffffff);
+      shift[c] = RandomInt(-11, -6);
+    }
+  }
+};
+
+template <typename Params>
+void RandomActivationRange(Params& params) {
+  params.quantized_activation_min = RandomInt(0, 3) == 0 ? RandomInt(-128, 0)
+                                                         : -128;
+  params.quantized_activation_max = RandomInt(0, 3) == 0 ? RandomInt(0, 127)
+                                                         : 127;
+}
+
+tflite::RuntimeShape Shape(std::initializer_list<int32_t> dims) {
+  return tflite::RuntimeShape(static_cast<int>(dims.size()), dims.begin());
+}
+
+int OutputSize(int input_size, int filter_size, int stride, int dilation,
+               int padding) {
+  const int effective = (filter_size - 1) * dilation + 1;
+  return (input_size + 2 * padding - effective) / stride + 1;
+}
+
+void ExpectSame(const std::vector<int8_t>& expected,
+                const std::vector<int8_t>& actual, const char* name,
+                int trial) {
+  char message[64];
+  snprintf(message, sizeof(message), "%s, trial %d", name, trial);
+  TEST_ASSERT_EQUAL_INT8_ARRAY_MESSAGE(expected.data(), actual.data(),
+                                       expected.size(), message);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Sign extension of both nibbles of every byte, and Int4At over odd and
+// even lengths against the library's own unpacking.
+void test_nibbles_match_unpack() {
+  for (int byte = 0; byte < 256; ++byte) {
+    const int8_t packed = static_cast<int8_t>(byte);
+    const int low = byte & 0xf;
+    const int high = byte >> 4;
+    TEST_ASSERT_EQUAL(low >= 8 ? low - 16 : low,
+                      tflite::optimized_integer_ops::Int4Low(packed));
+    TEST_ASSERT_EQUAL(high >= 8 ? high - 16 : high,
+                      tflite::optimized_integer_ops::Int4High(packed));
+  }
+  for (int count : {1, 2, 7, 8, 63, 64, 1001}) {
+    const std::vector<int8_t> values = RandomInt4Values(count);
+    const std::vector<int8_t> packed = PackInt4(values);
+    std::vector<int8_t> unpacked(count);
+    tflite::tensor_utils::UnpackDenseInt4IntoInt8(packed.data(), count,
+                                                  unpacked.data());
+    TEST_ASSERT_EQUAL_INT8_ARRAY(values.data(), unpacked.data(), count);
+    for (int i = 0; i < count; ++i) {
+      TEST_ASSERT_EQUAL(
+          values[i], tflite::optimized_integer_ops::Int4At(packed.data(), i));
+    }
+  }
+}
+
+// DotInt4 over every start parity and length, against the sum over the
+// unpacked values.
+void test_dot_matches_unpacked() {
+  const std::vector<int8_t> values = RandomInt4Values(300);
+  const std::vector<int8_t> packed = PackInt4(values);
+  const std::vector<int8_t> input = RandomInt8(300);
+  for (int trial = 0; trial < 2000; ++trial) {
+    const int start = RandomInt(0, 299);
+    const int count = RandomInt(0, 300 - start);
+    const int32_t input_offset = RandomInt(-127, 128);
+    int32_t expected = 0;
+    for (int i = 0; i < count; ++i) {
+      expected += values[start + i] * (input[i] + input_offset);
+    }
+    TEST_ASSERT_EQUAL(expected, tflite::optimized_integer_ops::DotInt4(
+                                    input.data(), input_offset, packed.data(),
+                                    start, count));
+  }
+}
+
+void test_conv_matches_reference() {
+  for (int trial = 0; trial < 300; ++trial) {
+    const int batches = RandomInt(1, 2);
+    const int groups = RandomInt(0, 3) == 0 ? 2 : 1;
+    const int filter_input_depth = RandomInt(1, 9);
+    const int input_depth = filter_input_depth * groups;
+    const int output_depth = groups * RandomInt(1, 12);
+    const int filter_height = RandomInt(1, 3);
+    const int filter_width = RandomInt(1, 3);
+    const int stride = RandomInt(1, 2);
+    const int dilation = RandomInt(0, 3) == 0 ? 2 : 1;
+    const int pad_height = RandomInt(0, filter_height - 1);
+    const int pad_width = RandomInt(0, filter_width - 1);
+    const int input_height = RandomInt(filter_height * dilation, 9);
+    const int input_width = RandomInt(filter_width * dilation, 9);
+    const int output_height = OutputSize(input_height, filter_height, stride,
+                                         dilation, pad_height);
+    const int output_width =
+        OutputSize(input_width, filter_width, stride, dilation, pad_width);
+
+    const tflite::RuntimeShape input_shape =
+        Shape({batches, input_height, input_width, input_depth});
+    const tflite::RuntimeShape filter_shape =
+        Shape({output_depth, filter_height, filter_width, filter_input_depth});
+    const tflite::RuntimeShape bias_shape = Shape({output_depth});
+    const tflite::RuntimeShape output_shape =
+        Shape({batches, output_height, output_width, output_depth});
+
+    tflite::ConvParams params = {};
+    params.padding_values.height = pad_height;
+    params.padding_values.width = pad_width;
+    params.stride_height = stride;
+    params.stride_width = stride;
+    params.dilation_height_factor = dilation;
+    params.dilation_width_factor = dilation;
+    params.input_offset = RandomInt(-127, 128);
+    params.output_offset = RandomInt(-128, 127);
+    RandomActivationRange(params);
+    const ChannelScales scales(output_depth);
+
+    const std::vector<int8_t> input = RandomInt8(input_shape.FlatSize());
+    const std::vector<int8_t> filter =
+        RandomInt4Values(filter_shape.FlatSize());
+    const std::vector<int8_t> packed = PackInt4(filter);
+    const std::vector<int32_t> bias = RandomBias(output_depth);
+    std::vector<int8_t> expected(output_shape.FlatSize());
+    std::vector<int8_t> actual(output_shape.FlatSize());
+    tflite::reference_integer_ops::ConvPerChannel(
+        params, scales.multiplier.data(), scales.shift.data(), input_shape,
+        input.data(), filter_shape, filter.data(), bias_shape, bias.data(),
+        output_shape, expected.data());
+    tflite::optimized_integer_ops::ConvPerChannelInt4(
+        params, scales.multiplier.data(), scales.shift.data(), input_shape,
+        input.data(), filter_shape, packed.data(), bias_shape, bias.data(),
+        output_shape, actual.data());
+    ExpectSame(expected, actual, "conv", trial);
+  }
+}
+
+void test_depthwise_matches_reference() {
+  for (int trial = 0; trial < 300; ++trial) {
+    const int input_depth = RandomInt(1, 13);
+    const int depth_multiplier = RandomInt(1, 3);
+    const int output_depth = input_depth * depth_multiplier;
+    const int filter_height = RandomInt(1, 3);
+    const int filter_width = RandomInt(1, 3);
+    const int stride = RandomInt(1, 2);
+    const int dilation = RandomInt(0, 3) == 0 ? 2 : 1;
+    const int pad_height = RandomInt(0, filter_height - 1);
+    const int pad_width = RandomInt(0, filter_width - 1);
+    const int input_height = RandomInt(filter_height * dilation, 9);
+    const int input_width = RandomInt(filter_width * dilation, 9);
+    const int output_height = OutputSize(input_height, filter_height, stride,
+                                         dilation, pad_height);
+    const int output_width =
+        OutputSize(input_width, filter_width, stride, dilation, pad_width);
+
+    const tflite::RuntimeShape input_shape =
+        Shape({1, input_height, input_width, input_depth});
+    const tflite::RuntimeShape filter_shape =
+        Shape({1, filter_height, filter_width, output_depth});
+    const tflite::RuntimeShape bias_shape = Shape({output_depth});
+    const tflite::RuntimeShape output_shape =
+        Shape({1, output_height, output_width, output_depth});
+
+    tflite::DepthwiseParams params = {};
+    params.padding_values.height = pad_height;
+    params.padding_values.width = pad_width;
+    params.stride_height = stride;
+    params.stride_width = stride;
+    params.dilation_height_factor = dilation;
+    params.dilation_width_factor = dilation;
+    params.depth_multiplier = depth_multiplier;
+    params.input_offset = RandomInt(-127, 128);
+    params.output_offset = RandomInt(-128, 127);
+    RandomActivationRange(params);
+    const ChannelScales scales(output_depth);
+
+    const std::vector<int8_t> input = RandomInt8(input_shape.FlatSize());
+    const std::vector<int8_t> filter =
+        RandomInt4Values(filter_shape.FlatSize());
+    const std::vector<int8_t> packed = PackInt4(filter);
+    const std::vector<int32_t> bias = RandomBias(output_depth);
+    std::vector<int32_t> acc_buffer(output_depth);
+    std::vector<int8_t> expected(output_shape.FlatSize());
+    std::vector<int8_t> actual(output_shape.FlatSize());
+    tflite::reference_integer_ops::DepthwiseConvPerChannel(
+        params, scales.multiplier.data(), scales.shift.data(), input_shape,
+        input.data(), filter_shape, filter.data(), bias_shape, bias.data(),
+        output_shape, expected.data());
+    tflite::optimized_integer_ops::DepthwiseConvPerChannelInt4(
+        params, scales.multiplier.data(), scales.shift.data(), input_shape,
+        input.data(), filter_shape, packed.data(), bias_shape, bias.data(),
+        output_shape, actual.data(), acc_buffer.data());
+    ExpectSame(expected, actual, "depthwise", trial);
+  }
+}
+
+// Odd accumulation depths put every other row on an odd nibble.
+void test_fully_connected_matches_reference() {
+  for (int trial = 0; trial < 300; ++trial) {
+    const int batches = RandomInt(1, 3);
+    const int accum_depth = RandomInt(1, 200);
+    const int output_depth = RandomInt(1, 40);
+    const tflite::RuntimeShape input_shape = Shape({batches, accum_depth});
+    const tflite::RuntimeShape filter_shape =
+        Shape({output_depth, accum_depth});
+    const tflite::RuntimeShape bias_shape = Shape({output_depth});
+    const tflite::RuntimeShape output_shape = Shape({batches, output_depth});
+
+    tflite::FullyConnectedParams params = {};
+    params.input_offset = RandomInt(-127, 128);
+    params.weights_offset = 0;
+    params.output_offset = RandomInt(-128, 127);
+    params.output_multiplier = RandomInt(1 << 30, 0x7fffffff);
+    params.output_shift = RandomInt(-11, -6);
+    RandomActivationRange(params);
+
+    const std::vector<int8_t> input = RandomInt8(input_shape.FlatSize());
+    const std::vector<int8_t> filter =
+        RandomInt4Values(filter_shape.FlatSize());
+    const std::vector<int8_t> packed = PackInt4(filter);
+    const std::vector<int32_t> bias = RandomBias(output_depth);
+    std::vector<int32_t> effective_bias(output_depth);
+    tflite::optimized_integer_ops::FullyConnectedPrecomputeBiasInt4(
+        packed.data(), bias.data(), params.input_offset, output_depth,
+        accum_depth, effective_bias.data());
+    std::vector<int8_t> expected(output_shape.FlatSize());
+    std::vector<int8_t> actual(output_shape.FlatSize());
+    tflite::reference_integer_ops::FullyConnected(
+        params, input_shape, input.data(), filter_shape, filter.data(),
+        bias_shape, bias.data(), output_shape, expected.data());
+    tflite::optimized_integer_ops::FullyConnectedInt4(
+        params, effective_bias.data(), input_shape, input.data(), filter_shape,
+        packed.data(), output_shape, actual.data());
+    ExpectSame(expected, actual, "fully connected", trial);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_nibbles_match_unpack);
+  RUN_TEST(test_dot_matches_unpacked);
+  RUN_TEST(test_conv_matches_reference);
+  RUN_TEST(test_depthwise_matches_reference);
+  RUN_TEST(test_fully_connected_matches_reference);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,293 @@
+// ServerMetrics::write() lido de volta como o Prometheus leria o formato de
+// texto: cada família com # HELP e # TYPE antes das amostras; os
+// _bucket{le=...} de cada etapa cumulativos, em ordem crescente de le e
+// terminando em +Inf igual ao _count; _sum em segundos. Os valores são
+// conferidos contra contagens feitas à parte das mesmas durações, com
+// durações exatamente nos limites dos baldes (le é "menor ou igual").
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "server_metrics.h"
+
+namespace {
+
+std::mt19937 rng(50);
+
+const char* const kStages[ServerMetrics::kStageCount] = {
+    "receive", "parse", "queue", "preprocess", "invoke", "postprocess", "send",
+};
+
+const char* const kOutcomes[ServerMetrics::kOutcomeCount] = {
+    "ok", "error", "rejected", "failed",
+};
+
+// O corpo de /metrics: amostras por série ("nome{labels}") e, por família,
+// o tipo e se o # HELP veio antes do # TYPE.
+struct Exposition {
+  std::map<std::string, std::string> samples;
+  std::vector<std::string> series;  // na ordem em que aparecem
+  std::map<std::string, std::string> types;
+  std::map<std::string, bool> helped;
+};
+
+// A família de uma série: o nome sem labels e, nos histogramas, sem o
+// sufixo _bucket, _sum ou _count.
+std::string family_of(const std::string& series,
+                      const std::map<std::string, std::string>& types) {
+  const std::string name = series.substr(0, series.find('{'));
+  if (types.count(name)) return name;
+  for (const char* suffix : {"_bucket", "_sum", "_count"}) {
+    const size_t length = strlen(suffix);
+    if (name.size() > length &&
+        name.compare(name.size() - length, length, suffix) == 0) {
+      const std::string base = name.substr(0, name.size() - length);
+      if (types.count(base) && types.at(base) == "histogram") return base;
+    }
+  }
+  return "";
+}
+
+Exposition parse(const ServerMetrics& metrics,
+                 void (*extra)(ResponseWriter&) = nullptr) {
+  static char buffer[16384];
+  ResponseWriter out(buffer, sizeof(buffer));
+  metrics.write(out);
+  if (extra != nullptr) extra(out);
+  TEST_ASSERT_FALSE(out.overflow());
+  out.finish(200, "text/plain; version=0.0.4", false);
+  const std::string response(out.data(), out.size());
+  const size_t body_start = response.find("\r\n\r\n");
+  TEST_ASSERT_TRUE(body_start != std::string::npos);
+  const std::string body = response.substr(body_start + 4);
+  TEST_ASSERT_EQUAL('\n', body.back());
+
+  Exposition exposition;
+  size_t line_start = 0;
+  while (line_start < body.size()) {
+    const size_t line_end = body.find('\n', line_start);
+    const std::string line = body.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+    TEST_ASSERT_FALSE_MESSAGE(line.empty(), "linha vazia");
+    if (line.compare(0, 7, "# HELP ") == 0) {
+      const std::string name = line.substr(7, line.find(' ', 7) - 7);
+      TEST_ASSERT_FALSE_MESSAGE(exposition.helped[name], line.c_str());
+      exposition.helped[name] = true;
+    } else if (line.compare(0, 7, "# TYPE ") == 0) {
+      const size_t space = line.find(' ', 7);
+      const std::string name = line.substr(7, space - 7);
+      TEST_ASSERT_TRUE_MESSAGE(exposition.helped[name], line.c_str());
+      TEST_ASSERT_EQUAL_MESSAGE(0, exposition.types.count(name), line.c_str());
+      exposition.types[name] = line.substr(space + 1);
+    } else {
+      TEST_ASSERT_NOT_EQUAL('#', line[0]);
+      const size_t space = line.rfind(' ');
+      const std::string series = line.substr(0, space);
+      TEST_ASSERT_FALSE_MESSAGE(family_of(series, exposition.types).empty(),
+                                line.c_str());
+      TEST_ASSERT_EQUAL_MESSAGE(0, exposition.samples.count(series),
+                                line.c_str());
+      exposition.samples[series] = line.substr(space + 1);
+      exposition.series.push_back(series);
+    }
+  }
+  return exposition;
+}
+
+std::string stage_series(const char* suffix, const char* stage,
+                         const char* le = nullptr) {
+  std::string series = std::string("classifier_stage_seconds") + suffix +
+                       "{stage=\"" + stage + "\"";
+  if (le != nullptr) series += std::string(",le=\"") + le + "\"";
+  return series + "}";
+}
+
+// Microssegundos no formato de _sum: segundos com seis casas.
+std::string seconds(uint64_t us) {
+  char text[32];
+  snprintf(text, sizeof(text), "%llu.%06llu",
+           static_cast<unsigned long long>(us / 1000000),
+           static_cast<unsigned long long>(us % 1000000));
+  return text;
+}
+
+// Confere o histograma de `stage` contra as durações registradas.
+void expect_histogram(const Exposition& exposition, int stage,
+                      const std::vector<uint32_t>& durations) {
+  const char* name = kStages[stage];
+  uint64_t sum_us = 0;
+  for (uint32_t duration : durations) sum_us += duration;
+
+  // Os baldes na ordem: le crescente, terminando em +Inf.
+  const std::string prefix = std::string(
+      "classifier_stage_seconds_bucket{stage=\"") + name + "\",";
+  std::vector<std::string> buckets;
+  for (const std::string& series : exposition.series) {
+    if (series.compare(0, prefix.size(), prefix) == 0) {
+      buckets.push_back(series);
+    }
+  }
+  TEST_ASSERT_EQUAL(ServerMetrics::kBuckets + 1, buckets.size());
+  unsigned long previous = 0;
+  for (int b = 0; b <= ServerMetrics::kBuckets; ++b) {
+    const size_t le_start = buckets[b].find("le=\"") + 4;
+    const std::string le =
+        buckets[b].substr(le_start, buckets[b].find('"', le_start) - le_start);
+    unsigned long expected = 0;
+    if (b < ServerMetrics::kBuckets) {
+      const uint32_t bound = ServerMetrics::kBucketBoundsUs[b];
+      TEST_ASSERT_EQUAL_FLOAT(bound / 1e6f, strtof(le.c_str(), nullptr));
+      for (uint32_t duration : durations) expected += duration <= bound;
+    } else {
+      TEST_ASSERT_EQUAL_STRING("+Inf", le.c_str());
+      expected = durations.size();
+    }
+    const unsigned long cumulative =
+        strtoul(exposition.samples.at(buckets[b]).c_str(), nullptr, 10);
+    TEST_ASSERT_EQUAL_MESSAGE(expected, cumulative, buckets[b].c_str());
+    TEST_ASSERT_TRUE(cumulative >= previous);
+    previous = cumulative;
+  }
+  TEST_ASSERT_EQUAL_STRING(
+      std::to_string(durations.size()).c_str(),
+      exposition.samples.at(stage_series("_count", name)).c_str());
+  TEST_ASSERT_EQUAL_STRING(
+      exposition.samples.at(stage_series("_bucket", name, "+Inf")).c_str(),
+      exposition.samples.at(stage_series("_count", name)).c_str());
+  TEST_ASSERT_EQUAL_STRING(
+      seconds(sum_us).c_str(),
+      exposition.samples.at(stage_series("_sum", name)).c_str());
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Sem nada registrado: as duas famílias com # HELP e # TYPE, todos os
+// baldes, _sum e _count em zero.
+void test_empty_exposition() {
+  ServerMetrics metrics;
+  const Exposition exposition = parse(metrics);
+  TEST_ASSERT_EQUAL(2, exposition.types.size());
+  TEST_ASSERT_EQUAL_STRING("counter",
+                           exposition.types.at("classifier_requests_total").c_str());
+  TEST_ASSERT_EQUAL_STRING("histogram",
+                           exposition.types.at("classifier_stage_seconds").c_str());
+  for (int s = 0; s < ServerMetrics::kStageCount; ++s) {
+    expect_histogram(exposition, s, {});
+  }
+  for (const char* outcome : kOutcomes) {
+    TEST_ASSERT_EQUAL_STRING(
+        "0", exposition.samples
+                 .at(std::string("classifier_requests_total{outcome=\"") +
+                     outcome + "\"}")
+                 .c_str());
+  }
+  TEST_ASSERT_EQUAL(ServerMetrics::kOutcomeCount +
+                        ServerMetrics::kStageCount *
+                            (ServerMetrics::kBuckets + 1 + 2),
+                    exposition.series.size());
+}
+
+// Durações nos limites, logo acima deles, zero, acima do último limite
+// (só +Inf) e o máximo de 32 bits, que no _sum passa de 2^32 µs.
+void test_bucket_bounds_are_inclusive() {
+  ServerMetrics metrics;
+  std::vector<uint32_t> durations = {0, UINT32_MAX, UINT32_MAX};
+  for (uint32_t bound : ServerMetrics::kBucketBoundsUs) {
+    durations.push_back(bound);
+    durations.push_back(bound + 1);
+    durations.push_back(bound - 1);
+  }
+  for (uint32_t duration : durations) {
+    metrics.record(ServerMetrics::kInvoke, duration);
+  }
+  const Exposition exposition = parse(metrics);
+  expect_histogram(exposition, ServerMetrics::kInvoke, durations);
+  for (int s = 0; s < ServerMetrics::kStageCount; ++s) {
+    if (s != ServerMetrics::kInvoke) expect_histogram(exposition, s, {});
+  }
+}
+
+// Milhares de durações aleatórias em todas as etapas e requisições em
+// todos os resultados; etapas e resultados fora do enum são ignorados.
+void test_random_durations_and_outcomes() {
+  ServerMetrics metrics;
+  std::vector<uint32_t> durations[ServerMetrics::kStageCount];
+  unsigned long requests[ServerMetrics::kOutcomeCount] = {};
+  for (int i = 0; i < 20000; ++i) {
+    const int stage = rng() % ServerMetrics::kStageCount;
+    // Log-uniforme de 1 µs a ~17 s, para cair em todos os baldes.
+    const uint32_t duration = static_cast<uint32_t>(rng() >> (rng() % 32)) /
+                              (1u << 8);
+    metrics.record(static_cast<ServerMetrics::Stage>(stage), duration);
+    durations[stage].push_back(duration);
+    const int outcome = rng() % ServerMetrics::kOutcomeCount;
+    metrics.count_request(static_cast<ServerMetrics::Outcome>(outcome));
+    requests[outcome]++;
+  }
+  metrics.record(ServerMetrics::kStageCount, 123);
+  metrics.record(static_cast<ServerMetrics::Stage>(-1), 123);
+  metrics.count_request(ServerMetrics::kOutcomeCount);
+
+  const Exposition exposition = parse(metrics);
+  for (int s = 0; s < ServerMetrics::kStageCount; ++s) {
+    expect_histogram(exposition, s, durations[s]);
+  }
+  for (int o = 0; o < ServerMetrics::kOutcomeCount; ++o) {
+    TEST_ASSERT_EQUAL_STRING(
+        std::to_string(requests[o]).c_str(),
+        exposition.samples
+            .at(std::string("classifier_requests_total{outcome=\"") +
+                kOutcomes[o] + "\"}")
+            .c_str());
+  }
+}
+
+// write_metric() acrescenta uma família avulsa com # HELP, # TYPE e uma
+// amostra sem labels, que convive com as do write().
+void test_write_metric() {
+  ServerMetrics metrics;
+  const Exposition exposition = parse(metrics, [](ResponseWriter& out) {
+    ServerMetrics::write_metric(out, "classifier_arena_used_bytes", "gauge",
+                                "Bytes da tensor arena em uso.", 83200);
+    ServerMetrics::write_metric(out, "classifier_cache_hits_total", "counter",
+                                "Acertos do cache de resultados.", 0);
+  });
+  TEST_ASSERT_EQUAL_STRING("gauge",
+                           exposition.types.at("classifier_arena_used_bytes").c_str());
+  TEST_ASSERT_EQUAL_STRING(
+      "83200", exposition.samples.at("classifier_arena_used_bytes").c_str());
+  TEST_ASSERT_EQUAL_STRING("counter",
+                           exposition.types.at("classifier_cache_hits_total").c_str());
+  TEST_ASSERT_EQUAL_STRING(
+      "0", exposition.samples.at("classifier_cache_hits_total").c_str());
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_exposition);
+  RUN_TEST(test_bucket_bounds_are_inclusive);
+  RUN_TEST(test_random_durations_and_outcomes);
+  RUN_TEST(test_write_metric);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,499 @@
+// Block-sparse int8 filters (micro/sparse_weights.h, 1x4 and 1x16 blocks
+// along the last dimension): tensor_utils'
+// SparseMatrixBatchVectorMultiplyAccumulate1x4 and 1x16 against dense
+// products of the same pruned matrices, per tensor and per channel; and
+// CONV_2D and FULLY_CONNECTED models with sparse filters against the same
+// models with the pruned filters stored dense, from no block to every block
+// pruned, with Int32, Uint16 and Uint8 index vectors. DEPTHWISE_CONV_2D must
+// refuse a sparse filter in Prepare.
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/portable_tensor_utils.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+std::mt19937 rng(38);
+
+constexpr size_t kArenaSize = 512 * 1024;
+constexpr float kInputScale = 0.05f;
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+// A rows x row_length int8 matrix with whole blocks pruned: the dense
+// matrix with zeros, and the nonzero blocks with their CSR segments and
+// block indices.
+struct BlockSparse {
+  int block_size;
+  std::vector<int8_t> dense;
+  std::vector<int8_t> values;
+  std::vector<int32_t> segments;
+  std::vector<int32_t> indices;
+};
+
+// Keeps each block with probability `keep`.
+BlockSparse MakeBlockSparse(int rows, int row_length, int block_size,
+                            double keep) {
+  BlockSparse matrix;
+  matrix.block_size = block_size;
+  matrix.dense.assign(rows * row_length, 0);
+  matrix.segments.push_back(0);
+  std::bernoulli_distribution kept(keep);
+  for (int row = 0; row < rows; ++row) {
+    for (int block = 0; block < row_length / block_size; ++block) {
+      if (!kept(rng)) continue;
+      matrix.indices.push_back(block);
+      for (int i = 0; i < block_size; ++i) {
+        const int8_t value = static_cast<int8_t>(RandomInt(-127, 127));
+        matrix.dense[row * row_length + block * block_size + i] = value;
+        matrix.values.push_back(value);
+      }
+    }
+    matrix.segments.push_back(static_cast<int32_t>(matrix.indices.size()));
+  }
+  return matrix;
+}
+
+// One conv or fully-connected layer; shapes as in TFLite (NHWC input, OHWI
+// or [1, H, W, O] depthwise filter, or [batches, depth] input with an
+// [O, depth] filter).
+struct LayerCase {
+  tflite::BuiltinOperator op;
+  std::vector<int32_t> input_shape;
+  std::vector<int32_t> filter_shape;
+  tflite::Padding padding;
+  int stride;
+};
+
+int ElementCount(const std::vector<int32_t>& shape) {
+  int count = 1;
+  for (int32_t dim : shape) count *= dim;
+  return count;
+}
+
+std::vector<int32_t> OutputShape(const LayerCase& layer) {
+  if (layer.op == tflite::BuiltinOperator_FULLY_CONNECTED) {
+    return {layer.input_shape[0], layer.filter_shape[0]};
+  }
+  auto size = [&](int input_size, int filter_size) {
+    return layer.padding == tflite::Padding_SAME
+               ? (input_size + layer.stride - 1) / layer.stride
+               : (input_size - filter_size + layer.stride) / layer.stride;
+  };
+  return {layer.input_shape[0],
+          size(layer.input_shape[1], layer.filter_shape[1]),
+          size(layer.input_shape[2], layer.filter_shape[2]),
+          layer.op == tflite::BuiltinOperator_CONV_2D ? layer.filter_shape[0]
+                                                      : layer.filter_shape[3]};
+}
+
+// Segments or indices as `type`, or as the next wider type if a value does
+// not fit, as the converter does; `type` is updated to the one used.
+flatbuffers::Offset<void> IndexVector(flatbuffers::FlatBufferBuilder& fbb,
+                                      tflite::SparseIndexVector& type,
+                                      const std::vector<int32_t>& values) {
+  const int32_t max_value =
+      values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+  if (type == tflite::SparseIndexVector_Uint8Vector && max_value > UINT8_MAX) {
+    type = tflite::SparseIndexVector_Uint16Vector;
+  }
+  if (type == tflite::SparseIndexVector_Uint16Vector &&
+      max_value > UINT16_MAX) {
+    type = tflite::SparseIndexVector_Int32Vector;
+  }
+  switch (type) {
+    case tflite::SparseIndexVector_Uint8Vector: {
+      const std::vector<uint8_t> narrow(values.begin(), values.end());
+      return tflite::CreateUint8VectorDirect(fbb, &narrow).Union();
+    }
+    case tflite::SparseIndexVector_Uint16Vector: {
+      const std::vector<uint16_t> narrow(values.begin(), values.end());
+      return tflite::CreateUint16VectorDirect(fbb, &narrow).Union();
+    }
+    default:
+      return tflite::CreateInt32VectorDirect(fbb, &values).Union();
+  }
+}
+
+// The layer as a one-op model. With `index_type` NONE the filter is stored
+// dense; otherwise only its nonzero blocks, with sparsity parameters using
+// that index vector type.
+std::vector<uint8_t> BuildModel(const LayerCase& layer,
+                                const BlockSparse& filter,
+                                tflite::SparseIndexVector index_type) {
+  using flatbuffers::Offset;
+  // This flatbuffers has no implicit default allocator.
+  flatbuffers::DefaultAllocator allocator;
+  flatbuffers::FlatBufferBuilder fbb(1024, &allocator);
+  std::mt19937 model_rng(ElementCount(layer.filter_shape));
+
+  const bool fully_connected =
+      layer.op == tflite::BuiltinOperator_FULLY_CONNECTED;
+  const bool depthwise = layer.op == tflite::BuiltinOperator_DEPTHWISE_CONV_2D;
+  const std::vector<int32_t> output_shape = OutputShape(layer);
+  const int channels = output_shape.back();
+  const int accum_depth =
+      ElementCount(layer.filter_shape) /
+      (depthwise ? channels : layer.filter_shape[0]);
+
+  // Fully connected filters are per-tensor in TFLM, convolutions per channel.
+  std::vector<float> filter_scales(fully_connected ? 1 : channels);
+  for (size_t i = 0; i < filter_scales.size(); ++i) {
+    filter_scales[i] = 0.002f + 0.0004f * (i % 7);
+  }
+  std::vector<float> bias_scales(channels);
+  for (int i = 0; i < channels; ++i) {
+    bias_scales[i] = kInputScale * filter_scales[i % filter_scales.size()];
+  }
+  const float output_scale =
+      kInputScale * 0.003f * 40.0f * std::sqrt(static_cast<float>(accum_depth));
+
+  std::vector<int32_t> bias(channels);
+  for (int32_t& value : bias) {
+    value = static_cast<int32_t>(model_rng() % 20001) - 10000;
+  }
+  const bool sparse = index_type != tflite::SparseIndexVector_NONE;
+  const std::vector<int8_t>& stored = sparse ? filter.values : filter.dense;
+  const std::vector<uint8_t> filter_bytes(stored.begin(), stored.end());
+  const std::vector<Offset<tflite::Buffer>> buffers = {
+      tflite::CreateBuffer(fbb),
+      tflite::CreateBufferDirect(fbb, &filter_bytes),
+      tflite::CreateBuffer(
+          fbb, fbb.CreateVector(reinterpret_cast<const uint8_t*>(bias.data()),
+                                bias.size() * sizeof(int32_t))),
+  };
+
+  Offset<tflite::SparsityParameters> sparsity = 0;
+  if (sparse) {
+    const int rank = static_cast<int>(layer.filter_shape.size());
+    std::vector<int32_t> traversal_order(rank + 1);
+    for (int d = 0; d <= rank; ++d) traversal_order[d] = d;
+    const std::vector<int32_t> block_map = {rank - 1};
+    std::vector<Offset<tflite::DimensionMetadata>> dim_metadata;
+    for (int d = 0; d < rank - 1; ++d) {
+      dim_metadata.push_back(tflite::CreateDimensionMetadata(
+          fbb, tflite::DimensionType_DENSE, layer.filter_shape[d]));
+    }
+    tflite::SparseIndexVector segments_type = index_type;
+    tflite::SparseIndexVector indices_type = index_type;
+    const Offset<void> segments =
+        IndexVector(fbb, segments_type, filter.segments);
+    const Offset<void> indices = IndexVector(fbb, indices_type, filter.indices);
+    dim_metadata.push_back(tflite::CreateDimensionMetadata(
+        fbb, tflite::DimensionType_SPARSE_CSR, 0, segments_type, segments,
+        indices_type, indices));
+    dim_metadata.push_back(tflite::CreateDimensionMetadata(
+        fbb, tflite::DimensionType_DENSE, filter.block_size));
+    sparsity = tflite::CreateSparsityParametersDirect(fbb, &traversal_order,
+                                                      &block_map, &dim_metadata);
+  }
+
+  auto quantization = [&](const std::vector<float>& scale, int64_t zero_point,
+                          int quantized_dimension) {
+    const std::vector<int64_t> zero_points(scale.size(), zero_point);
+    return tflite::CreateQuantizationParametersDirect(
+        fbb, nullptr, nullptr, &scale, &zero_points,
+        tflite::QuantizationDetails_NONE, 0, quantized_dimension);
+  };
+  const std::vector<int32_t> bias_shape = {channels};
+  const std::vector<Offset<tflite::Tensor>> tensors = {
+      tflite::CreateTensorDirect(fbb, &layer.input_shape,
+                                 tflite::TensorType_INT8, 0, "input",
+                                 quantization({kInputScale}, -7, 0)),
+      tflite::CreateTensorDirect(
+          fbb, &layer.filter_shape, tflite::TensorType_INT8, 1, "filter",
+          quantization(filter_scales, 0, depthwise ? 3 : 0), false, sparsity),
+      tflite::CreateTensorDirect(fbb, &bias_shape, tflite::TensorType_INT32,
+                                 2, "bias", quantization(bias_scales, 0, 0)),
+      tflite::CreateTensorDirect(fbb, &output_shape, tflite::TensorType_INT8,
+                                 0, "output",
+                                 quantization({output_scale}, 5, 0)),
+  };
+
+  Offset<void> options;
+  tflite::BuiltinOptions options_type;
+  if (fully_connected) {
+    options_type = tflite::BuiltinOptions_FullyConnectedOptions;
+    options = tflite::CreateFullyConnectedOptions(fbb).Union();
+  } else if (depthwise) {
+    options_type = tflite::BuiltinOptions_DepthwiseConv2DOptions;
+    options = tflite::CreateDepthwiseConv2DOptions(
+                  fbb, layer.padding, layer.stride, layer.stride,
+                  channels / layer.input_shape[3])
+                  .Union();
+  } else {
+    options_type = tflite::BuiltinOptions_Conv2DOptions;
+    options = tflite::CreateConv2DOptions(fbb, layer.padding, layer.stride,
+                                          layer.stride)
+                  .Union();
+  }
+  const std::vector<Offset<tflite::OperatorCode>> operator_codes = {
+      tflite::CreateOperatorCode(fbb, static_cast<int8_t>(layer.op), 0, 1,
+                                 layer.op)};
+  const std::vector<int32_t> op_inputs = {0, 1, 2};
+  const std::vector<int32_t> op_outputs = {3};
+  const std::vector<Offset<tflite::Operator>> operators = {
+      tflite::CreateOperatorDirect(fbb, 0, &op_inputs, &op_outputs,
+                                   options_type, options)};
+  const std::vector<int32_t> graph_inputs = {0};
+  const std::vector<int32_t> graph_outputs = {3};
+  const std::vector<Offset<tflite::SubGraph>> subgraphs = {
+      tflite::CreateSubGraphDirect(fbb, &tensors, &graph_inputs,
+                                   &graph_outputs, &operators)};
+  fbb.Finish(tflite::CreateModelDirect(fbb, TFLITE_SCHEMA_VERSION,
+                                       &operator_codes, &subgraphs, nullptr,
+                                       &buffers));
+  return std::vector<uint8_t>(fbb.GetBufferPointer(),
+                              fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+// A one-op model with its own arena.
+class Layer {
+ public:
+  explicit Layer(const std::vector<uint8_t>& model)
+      : model_(model),
+        arena_(kArenaSize),
+        interpreter_(tflite::GetModel(model_.data()), resolver(),
+                     arena_.data(), arena_.size()) {}
+
+  TfLiteStatus AllocateTensors() { return interpreter_.AllocateTensors(); }
+
+  const int8_t* Invoke(const std::vector<int8_t>& input) {
+    memcpy(interpreter_.input(0)->data.int8, input.data(), input.size());
+    TEST_ASSERT_EQUAL(kTfLiteOk, interpreter_.Invoke());
+    return interpreter_.output(0)->data.int8;
+  }
+
+  size_t output_size() { return interpreter_.output(0)->bytes; }
+
+ private:
+  const tflite::MicroOpResolver& resolver() {
+    resolver_.AddConv2D();
+    resolver_.AddDepthwiseConv2D();
+    resolver_.AddFullyConnected();
+    return resolver_;
+  }
+
+  const std::vector<uint8_t> model_;
+  std::vector<uint8_t> arena_;
+  tflite::MicroMutableOpResolver<3> resolver_;
+  tflite::MicroInterpreter interpreter_;
+};
+
+const tflite::SparseIndexVector kIndexTypes[] = {
+    tflite::SparseIndexVector_Int32Vector,
+    tflite::SparseIndexVector_Uint16Vector,
+    tflite::SparseIndexVector_Uint8Vector};
+
+// Runs `layer` with its filter pruned to each density, sparse and dense, on
+// a few random inputs. The sparse rows are the filter's last dimension.
+void CheckMatchesDense(const LayerCase& layer, int block_size) {
+  const int row_length = layer.filter_shape.back();
+  const int rows = ElementCount(layer.filter_shape) / row_length;
+  for (double keep : {1.0, 0.75, 0.5, 0.1, 0.0}) {
+    const BlockSparse filter =
+        MakeBlockSparse(rows, row_length, block_size, keep);
+    Layer dense(BuildModel(layer, filter, tflite::SparseIndexVector_NONE));
+    TEST_ASSERT_EQUAL(kTfLiteOk, dense.AllocateTensors());
+    for (tflite::SparseIndexVector index_type : kIndexTypes) {
+      Layer sparse(BuildModel(layer, filter, index_type));
+      TEST_ASSERT_EQUAL(kTfLiteOk, sparse.AllocateTensors());
+      TEST_ASSERT_EQUAL(dense.output_size(), sparse.output_size());
+      std::vector<int8_t> input(ElementCount(layer.input_shape));
+      for (int trial = 0; trial < 2; ++trial) {
+        for (int8_t& value : input) {
+          value = static_cast<int8_t>(RandomInt(-128, 127));
+        }
+        const std::vector<int8_t> expected(
+            dense.Invoke(input), dense.Invoke(input) + dense.output_size());
+        const int8_t* actual = sparse.Invoke(input);
+        char message[96];
+        snprintf(message, sizeof(message), "1x%d blocks, %.0f%% kept, %s",
+                 block_size, keep * 100,
+                 tflite::EnumNameSparseIndexVector(index_type));
+        TEST_ASSERT_EQUAL_INT8_ARRAY_MESSAGE(expected.data(), actual,
+                                             expected.size(), message);
+      }
+    }
+  }
+}
+
+// The int8 tensor_utils sparse product of one case, and the same product
+// over the dense matrix: reference_integer_ops::FullyConnected per tensor,
+// a plain loop with the same rounding per channel.
+void CheckTensorUtils(int block_size, int batches, int rows, int cols,
+                      double keep, bool per_channel) {
+  const BlockSparse matrix = MakeBlockSparse(rows, cols, block_size, keep);
+  std::vector<int8_t> vector(batches * cols);
+  for (int8_t& value : vector) value = static_cast<int8_t>(RandomInt(-128, 127));
+  std::vector<int32_t> bias(rows);
+  for (int32_t& value : bias) value = RandomInt(-20000, 20000);
+  const int32_t input_offset = RandomInt(-127, 128);
+  const int32_t output_offset = RandomInt(-128, 127);
+  const int32_t output_multiplier = RandomInt(1 << 30, 0x7fffffff);
+  const int32_t output_shift = RandomInt(-11, -6);
+  std::vector<int32_t> channel_multiplier(rows);
+  std::vector<int32_t> channel_shift(rows);
+  for (int r = 0; r < rows; ++r) {
+    channel_multiplier[r] = RandomInt(1 << 30, 0x7fffffff);
+    channel_shift[r] = RandomInt(-11, -6);
+  }
+  const int32_t activation_min = RandomInt(0, 1) ? -128 : RandomInt(-128, 0);
+  const int32_t activation_max = RandomInt(0, 1) ? 127 : RandomInt(0, 127);
+
+  std::vector<int8_t> expected(batches * rows);
+  if (per_channel) {
+    for (int b = 0; b < batches; ++b) {
+      for (int r = 0; r < rows; ++r) {
+        int32_t acc = bias[r];
+        for (int c = 0; c < cols; ++c) {
+          acc += matrix.dense[r * cols + c] *
+                 (vector[b * cols + c] + input_offset);
+        }
+        acc = tflite::MultiplyByQuantizedMultiplier(acc, channel_multiplier[r],
+                                                    channel_shift[r]) +
+              output_offset;
+        expected[b * rows + r] = static_cast<int8_t>(
+            std::min(std::max(acc, activation_min), activation_max));
+      }
+    }
+  } else {
+    tflite::FullyConnectedParams params = {};
+    params.input_offset = input_offset;
+    params.output_offset = output_offset;
+    params.output_multiplier = output_multiplier;
+    params.output_shift = output_shift;
+    params.quantized_activation_min = activation_min;
+    params.quantized_activation_max = activation_max;
+    const int input_dims[] = {batches, cols};
+    const int filter_dims[] = {rows, cols};
+    const int bias_dims[] = {rows};
+    const int output_dims[] = {batches, rows};
+    tflite::reference_integer_ops::FullyConnected(
+        params, tflite::RuntimeShape(2, input_dims), vector.data(),
+        tflite::RuntimeShape(2, filter_dims), matrix.dense.data(),
+        tflite::RuntimeShape(1, bias_dims), bias.data(),
+        tflite::RuntimeShape(2, output_dims), expected.data());
+  }
+
+  std::vector<int8_t> actual(batches * rows);
+  const int32_t* scale = per_channel ? channel_multiplier.data() : nullptr;
+  const int32_t* shift = per_channel ? channel_shift.data() : nullptr;
+  if (block_size == 4) {
+    tflite::tensor_utils::SparseMatrixBatchVectorMultiplyAccumulate1x4(
+        matrix.values.data(), matrix.segments.data(), matrix.indices.data(),
+        rows, cols, vector.data(), bias.data(), batches, input_offset,
+        output_multiplier, output_shift, scale, shift, output_offset,
+        activation_min, activation_max, actual.data());
+  } else {
+    tflite::tensor_utils::SparseMatrixBatchVectorMultiplyAccumulate1x16(
+        matrix.values.data(), matrix.segments.data(), matrix.indices.data(),
+        rows, cols, vector.data(), bias.data(), batches, input_offset,
+        output_multiplier, output_shift, scale, shift, output_offset,
+        activation_min, activation_max, actual.data());
+  }
+  char message[96];
+  snprintf(message, sizeof(message), "1x%d, %dx%d, %d batches, %s",
+           block_size, rows, cols, batches,
+           per_channel ? "per channel" : "per tensor");
+  TEST_ASSERT_EQUAL_INT8_ARRAY_MESSAGE(expected.data(), actual.data(),
+                                       expected.size(), message);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_tensor_utils_matches_dense() {
+  for (int block_size : {4, 16}) {
+    for (int trial = 0; trial < 200; ++trial) {
+      const int batches = RandomInt(1, 3);
+      const int rows = RandomInt(1, 40);
+      const int cols = block_size * RandomInt(1, 20);
+      const double keep = RandomInt(0, 4) / 4.0;
+      CheckTensorUtils(block_size, batches, rows, cols, keep, trial % 2 == 0);
+    }
+  }
+}
+
+// One sparse row per output channel and filter tap, over the input depth.
+void test_conv_matches_dense() {
+  const LayerCase layers[] = {
+      {tflite::BuiltinOperator_CONV_2D, {1, 8, 8, 16}, {8, 3, 3, 16},
+       tflite::Padding_SAME, 1},
+      {tflite::BuiltinOperator_CONV_2D, {2, 9, 9, 32}, {12, 3, 3, 32},
+       tflite::Padding_VALID, 2},
+      {tflite::BuiltinOperator_CONV_2D, {1, 5, 5, 64}, {24, 1, 1, 64},
+       tflite::Padding_SAME, 1},
+  };
+  for (const LayerCase& layer : layers) {
+    CheckMatchesDense(layer, 4);
+    CheckMatchesDense(layer, 16);
+  }
+}
+
+void test_fully_connected_matches_dense() {
+  const LayerCase layers[] = {
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {1, 64}, {10, 64},
+       tflite::Padding_VALID, 1},
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {3, 256}, {40, 256},
+       tflite::Padding_VALID, 1},
+      {tflite::BuiltinOperator_FULLY_CONNECTED, {2, 1024}, {100, 1024},
+       tflite::Padding_VALID, 1},
+  };
+  for (const LayerCase& layer : layers) {
+    CheckMatchesDense(layer, 4);
+    CheckMatchesDense(layer, 16);
+  }
+}
+
+// Depthwise has no sparse path, so a sparse filter must fail Prepare instead
+// of its nonzero blocks being read as the dense filter.
+void test_depthwise_rejects_sparse_filter() {
+  const LayerCase layer = {tflite::BuiltinOperator_DEPTHWISE_CONV_2D,
+                           {1, 6, 6, 16},
+                           {1, 3, 3, 16},
+                           tflite::Padding_SAME,
+                           1};
+  const BlockSparse filter = MakeBlockSparse(9, 16, 4, 0.5);
+  Layer dense(BuildModel(layer, filter, tflite::SparseIndexVector_NONE));
+  TEST_ASSERT_EQUAL(kTfLiteOk, dense.AllocateTensors());
+  Layer sparse(
+      BuildModel(layer, filter, tflite::SparseIndexVector_Int32Vector));
+  TEST_ASSERT_NOT_EQUAL(kTfLiteOk, sparse.AllocateTensors());
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tensor_utils_matches_dense);
+  RUN_TEST(test_conv_matches_dense);
+  RUN_TEST(test_fully_connected_matches_dense);
+  RUN_TEST(test_depthwise_rejects_sparse_filter);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
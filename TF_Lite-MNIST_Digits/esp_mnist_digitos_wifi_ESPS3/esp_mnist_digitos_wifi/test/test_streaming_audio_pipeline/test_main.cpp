@@ -0,0 +1,356 @@
+// StreamingAudioPipeline on a 16 kHz mono WAV, with the MNIST int8 model
+// standing in for a keyword model: its 28x28 input is read as 28 slices of 28
+// filterbank channels, and a stride of 2 slices is 20 ms of audio. None of
+// the apps ships an audio model, so this project, which has the smallest
+// one, carries the test.
+//
+// The windows the pipeline feeds the model are checked against a single
+// frontend run over the whole file, and the benchmark compares streaming
+// with recomputing the whole window at every stride. The WAV is synthesized
+// in memory; on the host, STREAMING_AUDIO_WAV can name a real file instead.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../../src/mnist_model_data.h"
+#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/streaming_audio_pipeline.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kNumChannels = 28;
+constexpr int kNumSlices = 28;
+constexpr int kStrideSlices = 2;
+constexpr int kStepSamples = kSampleRate / 100;       // 10 ms, the default
+constexpr int kWindowSamples = kSampleRate * 25 / 1000;  // 25 ms, the default
+constexpr int kChunkSamples = 512;  // 32 ms, a typical I2S DMA buffer
+constexpr int kTensorArenaSize = 80 * 1024;
+
+alignas(16) uint8_t arena[kTensorArenaSize];
+alignas(16) uint8_t reference_arena[kTensorArenaSize];
+uint8_t features[kNumSlices * kNumChannels];
+
+void AppendLittleEndian(std::vector<uint8_t>& out, uint32_t value,
+                        int bytes) {
+  for (int i = 0; i < bytes; ++i) out.push_back((value >> (8 * i)) & 0xff);
+}
+
+// A 16-bit mono WAV: noise, with 300 ms tone bursts every 700 ms so the
+// noise reduction and gain control see both speech-like and quiet stretches.
+std::vector<uint8_t> MakeWav(int seconds) {
+  const uint32_t num_samples = seconds * kSampleRate;
+  std::vector<uint8_t> wav;
+  wav.insert(wav.end(), {'R', 'I', 'F', 'F'});
+  AppendLittleEndian(wav, 36 + 2 * num_samples, 4);
+  wav.insert(wav.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+  AppendLittleEndian(wav, 16, 4);
+  AppendLittleEndian(wav, 1, 2);  // PCM
+  AppendLittleEndian(wav, 1, 2);  // mono
+  AppendLittleEndian(wav, kSampleRate, 4);
+  AppendLittleEndian(wav, 2 * kSampleRate, 4);
+  AppendLittleEndian(wav, 2, 2);
+  AppendLittleEndian(wav, 16, 2);
+  wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+  AppendLittleEndian(wav, 2 * num_samples, 4);
+  std::mt19937 rng(33);
+  std::normal_distribution<float> noise(0.0f, 300.0f);
+  for (uint32_t i = 0; i < num_samples; ++i) {
+    float sample = noise(rng);
+    if (i % (kSampleRate * 7 / 10) < kSampleRate * 3 / 10) {
+      const float t = static_cast<float>(i) / kSampleRate;
+      sample += 6000.0f * std::sin(2 * 3.14159265f * 440.0f * t) +
+                3000.0f * std::sin(2 * 3.14159265f * 1250.0f * t);
+    }
+    const int32_t value = static_cast<int32_t>(
+        std::max(-32768.0f, std::min(32767.0f, sample)));
+    AppendLittleEndian(wav, static_cast<uint16_t>(value), 2);
+  }
+  return wav;
+}
+
+std::vector<uint8_t> LoadWav(int seconds) {
+#ifndef ARDUINO
+  const char* path = getenv("STREAMING_AUDIO_WAV");
+  if (path != nullptr) {
+    FILE* file = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    std::vector<uint8_t> wav;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      wav.insert(wav.end(), buffer, buffer + read);
+    }
+    fclose(file);
+    return wav;
+  }
+#endif
+  return MakeWav(seconds);
+}
+
+uint32_t ReadLittleEndian(const uint8_t* data, int bytes) {
+  uint32_t value = 0;
+  for (int i = bytes - 1; i >= 0; --i) value = (value << 8) | data[i];
+  return value;
+}
+
+// The samples of the data chunk, after checking the format is 16-bit mono at
+// kSampleRate.
+std::vector<int16_t> WavSamples(const std::vector<uint8_t>& wav) {
+  TEST_ASSERT_TRUE(wav.size() >= 12 && memcmp(wav.data(), "RIFF", 4) == 0 &&
+                   memcmp(wav.data() + 8, "WAVE", 4) == 0);
+  size_t pos = 12;
+  bool format_ok = false;
+  while (pos + 8 <= wav.size()) {
+    const uint32_t size = ReadLittleEndian(&wav[pos + 4], 4);
+    const uint8_t* body = &wav[pos + 8];
+    if (memcmp(&wav[pos], "fmt ", 4) == 0) {
+      format_ok = ReadLittleEndian(body, 2) == 1 &&
+                  ReadLittleEndian(body + 2, 2) == 1 &&
+                  ReadLittleEndian(body + 4, 4) == kSampleRate &&
+                  ReadLittleEndian(body + 14, 2) == 16;
+    } else if (memcmp(&wav[pos], "data", 4) == 0) {
+      TEST_ASSERT_TRUE_MESSAGE(format_ok, "WAV must be 16-bit mono 16 kHz");
+      const size_t bytes = std::min<size_t>(size, wav.size() - pos - 8);
+      std::vector<int16_t> samples(bytes / 2);
+      for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = static_cast<int16_t>(ReadLittleEndian(body + 2 * i, 2));
+      }
+      return samples;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  TEST_FAIL_MESSAGE("WAV has no data chunk");
+  return {};
+}
+
+FrontendConfig MakeConfig() {
+  FrontendConfig config;
+  FrontendFillConfigWithDefaults(&config);
+  config.filterbank.num_channels = kNumChannels;
+  return config;
+}
+
+// The pipeline's quantization of one frontend slice into the input tensor.
+void QuantizeSlice(const FrontendOutput& output, const TfLiteTensor* input,
+                   int8_t* slice) {
+  const float multiplier = tflite::kDefaultFrontendFeatureScale /
+                           input->params.scale;
+  for (int c = 0; c < kNumChannels; ++c) {
+    const int32_t value =
+        static_cast<int32_t>(output.values[c] * multiplier + 0.5f) +
+        input->params.zero_point;
+    slice[c] = static_cast<int8_t>(std::min(127, std::max(-128, value)));
+  }
+}
+
+class Model {
+ public:
+  explicit Model(uint8_t* arena)
+      : interpreter_(tflite::GetModel(mnist_cnn_small_int8_tflite), resolver_,
+                     arena, kTensorArenaSize) {
+    TEST_ASSERT_EQUAL(kTfLiteOk, interpreter_.AllocateTensors());
+    TEST_ASSERT_EQUAL(kTfLiteInt8, interpreter_.input(0)->type);
+    TEST_ASSERT_EQUAL(kNumSlices * kNumChannels,
+                      interpreter_.input(0)->bytes);
+  }
+
+  tflite::MicroInterpreter* interpreter() { return &interpreter_; }
+
+  std::vector<int8_t> Output() {
+    const TfLiteTensor* output = interpreter_.output(0);
+    return std::vector<int8_t>(output->data.int8,
+                               output->data.int8 + output->bytes);
+  }
+
+ private:
+  tflite::AllOpsResolver resolver_;
+  tflite::MicroInterpreter interpreter_;
+};
+
+double NowMicros() {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Every invocation sees the last kNumSlices slices of one frontend run over
+// the whole audio, however the audio is chunked.
+void test_windows_match_a_single_frontend_run() {
+  const std::vector<int16_t> samples = WavSamples(MakeWav(3));
+  const FrontendConfig config = MakeConfig();
+
+  Model reference(reference_arena);
+  TfLiteTensor* reference_input = reference.interpreter()->input(0);
+  std::vector<int8_t> slices;
+  FrontendState state;
+  TEST_ASSERT_TRUE(FrontendPopulateState(&config, &state, kSampleRate));
+  for (size_t pos = 0; pos < samples.size();) {
+    size_t read;
+    const FrontendOutput output = FrontendProcessSamples(
+        &state, samples.data() + pos, samples.size() - pos, &read);
+    pos += read;
+    if (output.values == nullptr) continue;
+    slices.resize(slices.size() + kNumChannels);
+    QuantizeSlice(output, reference_input,
+                  slices.data() + slices.size() - kNumChannels);
+  }
+  FrontendFreeStateContents(&state);
+  const int num_slices = slices.size() / kNumChannels;
+
+  Model model(arena);
+  tflite::StreamingAudioPipeline pipeline(model.interpreter(), kStrideSlices);
+  TEST_ASSERT_EQUAL(kTfLiteOk, pipeline.Init(config, kSampleRate, features,
+                                             sizeof(features)));
+  std::mt19937 rng(3);
+  int invocations = 0;
+  for (size_t pos = 0; pos < samples.size();) {
+    const size_t chunk = std::min<size_t>(
+        std::uniform_int_distribution<int>(1, 700)(rng), samples.size() - pos);
+    size_t read;
+    bool invoked;
+    TEST_ASSERT_EQUAL(kTfLiteOk, pipeline.ProcessSamples(samples.data() + pos,
+                                                         chunk, &read,
+                                                         &invoked));
+    pos += read;
+    if (!invoked) continue;
+    const int end_slice = kNumSlices + invocations * kStrideSlices;
+    memcpy(reference_input->data.int8,
+           slices.data() + (end_slice - kNumSlices) * kNumChannels,
+           kNumSlices * kNumChannels);
+    TEST_ASSERT_EQUAL(kTfLiteOk, reference.interpreter()->Invoke());
+    const std::vector<int8_t> expected = reference.Output();
+    const std::vector<int8_t> actual = model.Output();
+    TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(),
+                                 expected.size());
+    ++invocations;
+  }
+  TEST_ASSERT_EQUAL((num_slices - kNumSlices) / kStrideSlices + 1,
+                    invocations);
+  TEST_ASSERT_EQUAL(num_slices, pipeline.stats().slices_generated);
+  TEST_ASSERT_EQUAL(invocations, pipeline.stats().invocations);
+}
+
+void test_rejects_a_short_feature_buffer() {
+  Model model(arena);
+  tflite::StreamingAudioPipeline pipeline(model.interpreter(), kStrideSlices);
+  TEST_ASSERT_EQUAL(kTfLiteError, pipeline.Init(MakeConfig(), kSampleRate,
+                                                features,
+                                                sizeof(features) - 1));
+}
+
+// 60 s of audio in kChunkSamples chunks. Recomputing resets the frontend and
+// runs it over the kNumSlices slices of audio before every invocation.
+void test_benchmark_against_recompute_per_stride() {
+  const std::vector<int16_t> samples = WavSamples(LoadWav(60));
+  const double audio_us = 1e6 * samples.size() / kSampleRate;
+  const FrontendConfig config = MakeConfig();
+  Model model(arena);
+
+  tflite::StreamingAudioPipeline pipeline(model.interpreter(), kStrideSlices);
+  TEST_ASSERT_EQUAL(kTfLiteOk, pipeline.Init(config, kSampleRate, features,
+                                             sizeof(features)));
+  int64_t max_latency_us = 0;
+  for (size_t pos = 0; pos < samples.size();) {
+    size_t left = std::min<size_t>(kChunkSamples, samples.size() - pos);
+    while (left > 0) {
+      size_t read;
+      bool invoked;
+      TEST_ASSERT_EQUAL(kTfLiteOk,
+                        pipeline.ProcessSamples(samples.data() + pos, left,
+                                                &read, &invoked));
+      if (invoked) {
+        max_latency_us =
+            std::max(max_latency_us, pipeline.stats().last_latency_us);
+      }
+      pos += read;
+      left -= read;
+    }
+  }
+  const tflite::StreamingAudioPipelineStats& stats = pipeline.stats();
+
+  TfLiteTensor* input = model.interpreter()->input(0);
+  FrontendState state;
+  TEST_ASSERT_TRUE(FrontendPopulateState(&config, &state, kSampleRate));
+  const size_t window_samples =
+      (kNumSlices - 1) * kStepSamples + kWindowSamples;
+  double frontend_us = 0;
+  double invoke_us = 0;
+  int invocations = 0;
+  for (size_t end = window_samples; end <= samples.size();
+       end += kStrideSlices * kStepSamples) {
+    const double start = NowMicros();
+    FrontendReset(&state);
+    int slice = 0;
+    for (size_t pos = end - window_samples; pos < end;) {
+      size_t read;
+      const FrontendOutput output = FrontendProcessSamples(
+          &state, samples.data() + pos, end - pos, &read);
+      pos += read;
+      if (output.values == nullptr) continue;
+      QuantizeSlice(output, input, input->data.int8 + slice * kNumChannels);
+      ++slice;
+    }
+    const double invoke_start = NowMicros();
+    TEST_ASSERT_EQUAL(kTfLiteOk, model.interpreter()->Invoke());
+    invoke_us += NowMicros() - invoke_start;
+    frontend_us += invoke_start - start;
+    ++invocations;
+  }
+  FrontendFreeStateContents(&state);
+
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%.0f s of audio, %d invokes: streaming frontend %.1f ms, invoke "
+           "%.1f ms, RTF %.4f",
+           audio_us / 1e6, static_cast<int>(stats.invocations),
+           stats.frontend_time_us / 1e3, stats.invoke_time_us / 1e3,
+           pipeline.RealTimeFactor());
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line),
+           "streaming latency: mean %.0f us, max %lld us per stride",
+           static_cast<double>(stats.frontend_time_us +
+                               stats.invoke_time_us) /
+               stats.invocations,
+           static_cast<long long>(max_latency_us));
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line),
+           "recompute per stride, %d invokes: frontend %.1f ms, invoke %.1f "
+           "ms, RTF %.4f",
+           invocations, frontend_us / 1e3, invoke_us / 1e3,
+           (frontend_us + invoke_us) / audio_us);
+  TEST_MESSAGE(line);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_windows_match_a_single_frontend_run);
+  RUN_TEST(test_rejects_a_short_feature_buffer);
+  RUN_TEST(test_benchmark_against_recompute_per_stride);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -16,7 +16,7 @@ limitations under the License.
 
 #include <string.h>
 
-#include "tensorflow/lite/experimental/microfrontend/lib/kiss_fft_int16.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_radix4.h"
 
 void FftCompute(struct FftState* state, const int16_t* input,
                 int input_scale_shift) {
@@ -36,10 +36,7 @@ void FftCompute(struct FftState* state, const int16_t* input,
   }
 
   // Apply the FFT.
-  kissfft_fixed16::kiss_fftr(
-      reinterpret_cast<kissfft_fixed16::kiss_fftr_cfg>(state->scratch),
-      state->input,
-      reinterpret_cast<kissfft_fixed16::kiss_fft_cpx*>(state->output));
+  FftRadix4Real(state->scratch, state->input, state->output);
 }
 
 void FftInit(struct FftState* state) {
@@ -0,0 +1,286 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_radix4.h"
+
+#include <math.h>
+
+namespace {
+
+// Scratch layout: this header, the radix-4 stage twiddles, the real split
+// twiddles, then the load order.
+struct FftRadix4Plan {
+  // Length of the complex transform, fft_size / 2.
+  int32_t num_complex;
+  // Radix of the first stage, 2 when log2(num_complex) is odd, else 4.
+  int32_t first_radix;
+  // For each radix-4 stage after the first and each k = 1..m-1: the twiddles
+  // of butterfly inputs 1, 2 and 3.
+  const complex_int16_t* stage_twiddles;
+  // num_complex / 2 twiddles for splitting the real transform.
+  const complex_int16_t* split_twiddles;
+  // Complex input index read into each position of the first stage.
+  const uint16_t* load_order;
+};
+
+size_t AlignUp(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+int FirstRadix(size_t num_complex) {
+  int log2 = 0;
+  while ((static_cast<size_t>(1) << log2) < num_complex) {
+    ++log2;
+  }
+  return (log2 & 1) ? 2 : 4;
+}
+
+size_t NumStageTwiddles(size_t num_complex, int first_radix) {
+  size_t count = 0;
+  for (size_t m = first_radix; m < num_complex; m *= 4) {
+    count += 3 * (m - 1);
+  }
+  return count;
+}
+
+// Same rounding as kf_cexp with FIXED_POINT=16.
+complex_int16_t Twiddle(double phase) {
+  complex_int16_t twiddle;
+  twiddle.real = static_cast<int16_t>(floor(.5 + 32767 * cos(phase)));
+  twiddle.imag = static_cast<int16_t>(floor(.5 + 32767 * sin(phase)));
+  return twiddle;
+}
+
+complex_int16_t FftTwiddle(size_t index, size_t num_complex) {
+  const double pi =
+      3.141592653589793238462643383279502884197169399375105820974944;
+  return Twiddle(-2 * pi * index / num_complex);
+}
+
+// The arithmetic below mirrors the kissfft FIXED_POINT=16 macros: products
+// are rounded with (x + 2^14) >> 15 and every intermediate is stored as
+// int16, including the wrap-around on overflow.
+inline int16_t Round15(int32_t x) {
+  return static_cast<int16_t>((x + (1 << 14)) >> 15);
+}
+
+// C_FIXDIV(c, 4) and C_FIXDIV(c, 2): multiply by 32767 / div.
+inline complex_int16_t Div4(complex_int16_t c) {
+  complex_int16_t result;
+  result.real = Round15(static_cast<int32_t>(c.real) * 8191);
+  result.imag = Round15(static_cast<int32_t>(c.imag) * 8191);
+  return result;
+}
+
+inline complex_int16_t Div2(complex_int16_t c) {
+  complex_int16_t result;
+  result.real = Round15(static_cast<int32_t>(c.real) * 16383);
+  result.imag = Round15(static_cast<int32_t>(c.imag) * 16383);
+  return result;
+}
+
+inline complex_int16_t Mul(complex_int16_t a, complex_int16_t b) {
+  complex_int16_t result;
+  result.real = Round15(static_cast<int32_t>(a.real) * b.real -
+                        static_cast<int32_t>(a.imag) * b.imag);
+  result.imag = Round15(static_cast<int32_t>(a.real) * b.imag +
+                        static_cast<int32_t>(a.imag) * b.real);
+  return result;
+}
+
+inline complex_int16_t Add(complex_int16_t a, complex_int16_t b) {
+  complex_int16_t result;
+  result.real = static_cast<int16_t>(a.real + b.real);
+  result.imag = static_cast<int16_t>(a.imag + b.imag);
+  return result;
+}
+
+inline complex_int16_t Sub(complex_int16_t a, complex_int16_t b) {
+  complex_int16_t result;
+  result.real = static_cast<int16_t>(a.real - b.real);
+  result.imag = static_cast<int16_t>(a.imag - b.imag);
+  return result;
+}
+
+// Forward radix-4 butterfly of kf_bfly4, taking input 0 already scaled and
+// inputs 1 to 3 already scaled and multiplied by their twiddles.
+inline void Butterfly4(complex_int16_t x0, complex_int16_t x1,
+                       complex_int16_t x2, complex_int16_t x3,
+                       complex_int16_t* out, size_t m) {
+  const complex_int16_t diff02 = Sub(x0, x2);
+  const complex_int16_t sum02 = Add(x0, x2);
+  const complex_int16_t sum13 = Add(x1, x3);
+  const complex_int16_t diff13 = Sub(x1, x3);
+  out[0] = Add(sum02, sum13);
+  out[2 * m] = Sub(sum02, sum13);
+  out[m].real = static_cast<int16_t>(diff02.real + diff13.imag);
+  out[m].imag = static_cast<int16_t>(diff02.imag - diff13.real);
+  out[3 * m].real = static_cast<int16_t>(diff02.real - diff13.imag);
+  out[3 * m].imag = static_cast<int16_t>(diff02.imag + diff13.real);
+}
+
+// Length 1 sub-transforms, so every twiddle is the identity.
+void FirstStage(const FftRadix4Plan& plan, const complex_int16_t* input,
+                complex_int16_t* out) {
+  const uint16_t* load_order = plan.load_order;
+  const int32_t num_complex = plan.num_complex;
+  if (plan.first_radix == 2) {
+    for (int32_t i = 0; i < num_complex; i += 2) {
+      const complex_int16_t x0 = Div2(input[load_order[i]]);
+      const complex_int16_t x1 = Div2(input[load_order[i + 1]]);
+      out[i + 1] = Sub(x0, x1);
+      out[i] = Add(x0, x1);
+    }
+  } else {
+    for (int32_t i = 0; i < num_complex; i += 4) {
+      Butterfly4(Div4(input[load_order[i]]), Div4(input[load_order[i + 1]]),
+                 Div4(input[load_order[i + 2]]),
+                 Div4(input[load_order[i + 3]]), out + i, 1);
+    }
+  }
+}
+
+// Combines num_complex / (4 * m) groups of four length m transforms.
+void Radix4Stage(const complex_int16_t* twiddles, size_t m,
+                 size_t num_complex, complex_int16_t* data) {
+  for (complex_int16_t* group = data; group < data + num_complex;
+       group += 4 * m) {
+    // With |x| <= 8191 after Div4, multiplying by the k = 0 twiddle
+    // (32767, 0) rounds back to x.
+    Butterfly4(Div4(group[0]), Div4(group[m]), Div4(group[2 * m]),
+               Div4(group[3 * m]), group, m);
+    const complex_int16_t* twiddle = twiddles;
+    for (size_t k = 1; k < m; ++k) {
+      complex_int16_t* out = group + k;
+      Butterfly4(Div4(out[0]), Mul(Div4(out[m]), twiddle[0]),
+                 Mul(Div4(out[2 * m]), twiddle[1]),
+                 Mul(Div4(out[3 * m]), twiddle[2]), out, m);
+      twiddle += 3;
+    }
+  }
+}
+
+// The split of kiss_fftr, done in place: bins k and num_complex - k only
+// depend on the complex results at the same two indices.
+void SplitRealSpectrum(const FftRadix4Plan& plan, complex_int16_t* data) {
+  const int32_t num_complex = plan.num_complex;
+  const complex_int16_t dc = Div2(data[0]);
+  data[0].real = static_cast<int16_t>(dc.real + dc.imag);
+  data[0].imag = 0;
+  data[num_complex].real = static_cast<int16_t>(dc.real - dc.imag);
+  data[num_complex].imag = 0;
+  for (int32_t k = 1; k <= num_complex / 2; ++k) {
+    const complex_int16_t fpk = Div2(data[k]);
+    complex_int16_t fpnk = data[num_complex - k];
+    fpnk.imag = static_cast<int16_t>(-fpnk.imag);
+    fpnk = Div2(fpnk);
+    const complex_int16_t f1k = Add(fpk, fpnk);
+    const complex_int16_t tw = Mul(Sub(fpk, fpnk), plan.split_twiddles[k - 1]);
+    data[k].real = static_cast<int16_t>((f1k.real + tw.real) >> 1);
+    data[k].imag = static_cast<int16_t>((f1k.imag + tw.imag) >> 1);
+    complex_int16_t* mirror = data + num_complex - k;
+    mirror->real = static_cast<int16_t>((f1k.real - tw.real) >> 1);
+    mirror->imag = static_cast<int16_t>((tw.imag - f1k.imag) >> 1);
+  }
+}
+
+}  // namespace
+
+size_t FftRadix4ScratchSize(size_t fft_size) {
+  if (fft_size < 4 || (fft_size & (fft_size - 1)) != 0 ||
+      fft_size / 2 > 65536) {
+    return 0;
+  }
+  const size_t num_complex = fft_size / 2;
+  const int first_radix = FirstRadix(num_complex);
+  return AlignUp(sizeof(FftRadix4Plan)) +
+         AlignUp((NumStageTwiddles(num_complex, first_radix) +
+                  num_complex / 2) *
+                 sizeof(complex_int16_t)) +
+         num_complex * sizeof(uint16_t);
+}
+
+int FftRadix4Init(size_t fft_size, void* scratch, size_t scratch_size) {
+  const size_t needed = FftRadix4ScratchSize(fft_size);
+  if (needed == 0 || scratch_size < needed) {
+    return 0;
+  }
+  const size_t num_complex = fft_size / 2;
+  const int first_radix = FirstRadix(num_complex);
+  const size_t num_stage_twiddles =
+      NumStageTwiddles(num_complex, first_radix);
+
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(scratch);
+  FftRadix4Plan* plan = reinterpret_cast<FftRadix4Plan*>(bytes);
+  complex_int16_t* stage_twiddles = reinterpret_cast<complex_int16_t*>(
+      bytes + AlignUp(sizeof(FftRadix4Plan)));
+  complex_int16_t* split_twiddles = stage_twiddles + num_stage_twiddles;
+  uint16_t* load_order = reinterpret_cast<uint16_t*>(
+      bytes + AlignUp(sizeof(FftRadix4Plan)) +
+      AlignUp((num_stage_twiddles + num_complex / 2) *
+              sizeof(complex_int16_t)));
+
+  plan->num_complex = static_cast<int32_t>(num_complex);
+  plan->first_radix = first_radix;
+  plan->stage_twiddles = stage_twiddles;
+  plan->split_twiddles = split_twiddles;
+  plan->load_order = load_order;
+
+  // Stage combining groups of length m reads twiddle k * num_complex / (4m).
+  complex_int16_t* twiddle = stage_twiddles;
+  for (size_t m = first_radix; m < num_complex; m *= 4) {
+    const size_t stride = num_complex / (4 * m);
+    for (size_t k = 1; k < m; ++k) {
+      *twiddle++ = FftTwiddle(k * stride, num_complex);
+      *twiddle++ = FftTwiddle(2 * k * stride, num_complex);
+      *twiddle++ = FftTwiddle(3 * k * stride, num_complex);
+    }
+  }
+
+  for (size_t i = 0; i < num_complex / 2; ++i) {
+    const double fraction = static_cast<double>(i + 1) / num_complex + .5;
+    split_twiddles[i] = Twiddle(-3.14159265358979323846264338327 * fraction);
+  }
+
+  // Radices from the last stage to the first, i.e. the order in which kissfft
+  // decimates the input: 4, 4, ..., 4 and then first_radix. Input index n,
+  // written in those digits, lands at the position with the digits weighted
+  // by the matching sub-transform lengths.
+  for (size_t n = 0; n < num_complex; ++n) {
+    size_t remaining = n;
+    size_t length = num_complex;
+    size_t position = 0;
+    while (length > 1) {
+      const size_t radix =
+          (length == static_cast<size_t>(first_radix)) ? first_radix : 4;
+      length /= radix;
+      position += (remaining % radix) * length;
+      remaining /= radix;
+    }
+    load_order[position] = static_cast<uint16_t>(n);
+  }
+  return 1;
+}
+
+void FftRadix4Real(const void* scratch, const int16_t* input,
+                   struct complex_int16_t* output) {
+  const FftRadix4Plan& plan =
+      *reinterpret_cast<const FftRadix4Plan*>(scratch);
+  const size_t num_complex = plan.num_complex;
+  FirstStage(plan, reinterpret_cast<const complex_int16_t*>(input), output);
+  const complex_int16_t* twiddles = plan.stage_twiddles;
+  for (size_t m = plan.first_radix; m < num_complex; m *= 4) {
+    Radix4Stage(twiddles, m, num_complex, output);
+    twiddles += 3 * (m - 1);
+  }
+  SplitRealSpectrum(plan, output);
+}
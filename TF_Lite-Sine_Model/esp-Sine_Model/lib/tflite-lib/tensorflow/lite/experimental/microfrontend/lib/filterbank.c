@@ -37,29 +37,51 @@ void FilterbankConvertFftComplexToEnergy(struct FilterbankState* state,
 void FilterbankAccumulateChannels(struct FilterbankState* state,
                                   const int32_t* energy) {
   uint64_t* work = state->work;
-  uint64_t weight_accumulator = 0;
-  uint64_t unweight_accumulator = 0;
+  // Unweighted sum of the previous band.
+  uint64_t carry = 0;
 
-  const int16_t* channel_frequency_starts = state->channel_frequency_starts;
-  const int16_t* channel_weight_starts = state->channel_weight_starts;
-  const int16_t* channel_widths = state->channel_widths;
+  // Bands are contiguous, so weights, unweights and energies are all read
+  // sequentially from start_index. Energies are squared magnitudes of 16 bit
+  // values, never negative, and weights are non-negative: each product is a
+  // single 32x32->64 bit multiply.
+  const int16_t* band_starts = state->band_starts;
+  const uint32_t* magnitudes = (const uint32_t*)energy + state->start_index;
+  const uint16_t* weights = (const uint16_t*)state->weights;
+  const uint16_t* unweights = (const uint16_t*)state->unweights;
 
-  int num_channels_plus_1 = state->num_channels + 1;
+  const int num_channels_plus_1 = state->num_channels + 1;
   int i;
-  for (i = 0; i < num_channels_plus_1; ++i) {
-    const int32_t* magnitudes = energy + *channel_frequency_starts++;
-    const int16_t* weights = state->weights + *channel_weight_starts;
-    const int16_t* unweights = state->unweights + *channel_weight_starts++;
-    const int width = *channel_widths++;
-    int j;
-    for (j = 0; j < width; ++j) {
-      weight_accumulator += *weights++ * ((uint64_t)*magnitudes);
-      unweight_accumulator += *unweights++ * ((uint64_t)*magnitudes);
-      ++magnitudes;
+  if (state->unweights_are_complement) {
+    for (i = 0; i < num_channels_plus_1; ++i) {
+      const int width = band_starts[i + 1] - band_starts[i];
+      uint64_t weight_accumulator = 0;
+      uint64_t energy_accumulator = 0;
+      int j;
+      for (j = 0; j < width; ++j) {
+        weight_accumulator += (uint64_t)weights[j] * magnitudes[j];
+        energy_accumulator += magnitudes[j];
+      }
+      weights += width;
+      magnitudes += width;
+      *work++ = carry + weight_accumulator;
+      carry = (energy_accumulator << kFilterbankBits) - weight_accumulator;
+    }
+  } else {
+    for (i = 0; i < num_channels_plus_1; ++i) {
+      const int width = band_starts[i + 1] - band_starts[i];
+      uint64_t weight_accumulator = 0;
+      uint64_t unweight_accumulator = 0;
+      int j;
+      for (j = 0; j < width; ++j) {
+        weight_accumulator += (uint64_t)weights[j] * magnitudes[j];
+        unweight_accumulator += (uint64_t)unweights[j] * magnitudes[j];
+      }
+      weights += width;
+      unweights += width;
+      magnitudes += width;
+      *work++ = carry + weight_accumulator;
+      carry = unweight_accumulator;
     }
-    *work++ = weight_accumulator;
-    weight_accumulator = unweight_accumulator;
-    unweight_accumulator = 0;
   }
 }
 
@@ -26,15 +26,24 @@ limitations under the License.
 extern "C" {
 #endif
 
+// The energy bins in [start_index, end_index) are split into num_channels + 1
+// contiguous bands, band i being [band_starts[i], band_starts[i + 1]). Each bin
+// has one weight and one unweight, stored contiguously from start_index, and
+// work[i] accumulates band i with the weights plus band i - 1 with the
+// unweights.
 struct FilterbankState {
   int num_channels;
   int start_index;
   int end_index;
-  int16_t* channel_frequency_starts;
-  int16_t* channel_weight_starts;
-  int16_t* channel_widths;
+  // num_channels + 2 entries.
+  int16_t* band_starts;
+  // end_index - start_index entries each.
   int16_t* weights;
   int16_t* unweights;
+  // Set when weights[j] + unweights[j] == 1 << kFilterbankBits for every bin:
+  // the unweighted sum of a band then follows from its weighted sum and its
+  // plain energy sum, saving one multiply per bin.
+  int unweights_are_complement;
   uint64_t* work;
 };
 
@@ -46,6 +55,12 @@ void FilterbankConvertFftComplexToEnergy(struct FilterbankState* state,
 
 // Computes the mel-scale filterbank on the given energy array. Output is cached
 // internally - to fetch it, you need to call FilterbankSqrt.
+//
+// The energies are read as the uint32_t squared magnitudes they are. Earlier
+// versions sign-extended them, so an energy of 2^31 or more (only 2^31 itself
+// comes out of FilterbankConvertFftComplexToEnergy, for -32768 + -32768i)
+// wrapped around in the 64-bit channel sums. Those channels now get the
+// correct sums; below 2^31 the output is unchanged bit for bit.
 void FilterbankAccumulateChannels(struct FilterbankState* state,
                                   const int32_t* energy);
 
@@ -0,0 +1,425 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_INT16_ACTIVATIONS_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_INT16_ACTIVATIONS_H_
+
+#include <algorithm>
+#include <limits>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_integer_ops {
+
+// Kernels for int16 activations with int8 weights (16x8). The reference
+// kernels accumulate every product in 64 bits. An int16 x int8 product is at
+// most 2^22 in magnitude, so up to kInt16x8MaxInt32Products of them can be
+// summed in 32 bits; the kernels here do that and only widen the partial
+// sums, which gives the same results as the reference.
+constexpr int kInt16x8MaxInt32Products = 511;
+
+// acc += sum_i input[i] * filter[i], for an int32 bias. The sum wraps like
+// the reference kernel with an int32 accumulator.
+inline void AccumulateDot16x8(const int16_t* input, const int8_t* filter,
+                              int count, int32_t* acc) {
+  int32_t sum = 0;
+  for (int i = 0; i < count; ++i) {
+    sum += input[i] * filter[i];
+  }
+  *acc += sum;
+}
+
+// acc += sum_i input[i] * filter[i], for an int64 bias.
+inline void AccumulateDot16x8(const int16_t* input, const int8_t* filter,
+                              int count, int64_t* acc) {
+  while (count > 0) {
+    const int chunk = std::min(count, kInt16x8MaxInt32Products);
+    int32_t sum = 0;
+    for (int i = 0; i < chunk; ++i) {
+      sum += input[i] * filter[i];
+    }
+    *acc += sum;
+    input += chunk;
+    filter += chunk;
+    count -= chunk;
+  }
+}
+
+template <typename AccumScalar>
+inline int16_t Requantize16x8(AccumScalar acc, int32_t multiplier,
+                              int32_t shift, int32_t output_offset,
+                              int32_t activation_min,
+                              int32_t activation_max) {
+  int32_t scaled = MultiplyByQuantizedMultiplier(acc, multiplier, shift);
+  scaled += output_offset;
+  scaled = std::max(scaled, activation_min);
+  scaled = std::min(scaled, activation_max);
+  return static_cast<int16_t>(scaled);
+}
+
+// reference_integer_ops::ConvPerChannel for int16 activations, with an int32
+// or int64 bias. Like the reference, input and output offsets are ignored.
+template <typename AccumScalar>
+inline void ConvPerChannel16x8(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int16_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const AccumScalar* bias_data, const RuntimeShape& output_shape,
+    int16_t* output_data) {
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = input_shape.Dims(3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int filter_input_depth = filter_shape.Dims(3);
+  const int groups = input_depth / filter_input_depth;
+  TFLITE_DCHECK_EQ(input_depth % filter_input_depth, 0);
+  const int filters_per_group = output_depth / groups;
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int filter_row_length =
+      filter_height * filter_width * filter_input_depth;
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+        int16_t* output_pixel =
+            output_data + Offset(output_shape, batch, out_y, out_x, 0);
+        for (int out_channel = 0; out_channel < output_depth; ++out_channel) {
+          const int group = out_channel / filters_per_group;
+          const int8_t* filter_row =
+              filter_data + out_channel * filter_row_length;
+          AccumScalar acc = 0;
+          for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+            const int in_y = in_y_origin + dilation_height_factor * filter_y;
+            if (in_y < 0 || in_y >= input_height) {
+              continue;
+            }
+            for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+              const int in_x = in_x_origin + dilation_width_factor * filter_x;
+              if (in_x < 0 || in_x >= input_width) {
+                continue;
+              }
+              AccumulateDot16x8(
+                  input_data + Offset(input_shape, batch, in_y, in_x,
+                                      group * filter_input_depth),
+                  filter_row + (filter_y * filter_width + filter_x) *
+                                   filter_input_depth,
+                  filter_input_depth, &acc);
+            }
+          }
+          if (bias_data) {
+            acc += bias_data[out_channel];
+          }
+          output_pixel[out_channel] = Requantize16x8(
+              acc, output_multiplier[out_channel], output_shift[out_channel],
+              0, output_activation_min, output_activation_max);
+        }
+      }
+    }
+  }
+}
+
+// True when DepthwiseConvPerChannel16x8 can keep its per-channel sums in 32
+// bits for this filter.
+inline bool DepthwiseConv16x8Supported(const RuntimeShape& filter_shape) {
+  return filter_shape.Dims(1) * filter_shape.Dims(2) <=
+         kInt16x8MaxInt32Products;
+}
+
+// reference_integer_ops::DepthwiseConvPerChannel for int16 activations. Each
+// filter tap is applied to the whole pixel at once into `acc_buffer`
+// (output_depth values), which DepthwiseConv16x8Supported keeps within int32.
+inline void DepthwiseConvPerChannel16x8(
+    const DepthwiseParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int16_t* input_data, const RuntimeShape& filter_shape,
+    const int8_t* filter_data, const RuntimeShape& bias_shape,
+    const int64_t* bias_data, const RuntimeShape& output_shape,
+    int16_t* output_data, int32_t* acc_buffer) {
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int depth_multiplier = params.depth_multiplier;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK(DepthwiseConv16x8Supported(filter_shape));
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int output_depth = MatchingDim(filter_shape, 3, output_shape, 3);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = input_shape.Dims(3);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  TFLITE_DCHECK_EQ(output_depth, input_depth * depth_multiplier);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin = (out_y * stride_height) - pad_height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin = (out_x * stride_width) - pad_width;
+        std::fill(acc_buffer, acc_buffer + output_depth, 0);
+        for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+          const int in_y = in_y_origin + dilation_height_factor * filter_y;
+          if (in_y < 0 || in_y >= input_height) {
+            continue;
+          }
+          for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+            const int in_x = in_x_origin + dilation_width_factor * filter_x;
+            if (in_x < 0 || in_x >= input_width) {
+              continue;
+            }
+            const int16_t* input_pixel =
+                input_data + Offset(input_shape, batch, in_y, in_x, 0);
+            const int8_t* filter_tap =
+                filter_data + (filter_y * filter_width + filter_x) *
+                                  output_depth;
+            if (depth_multiplier == 1) {
+              for (int c = 0; c < output_depth; ++c) {
+                acc_buffer[c] += filter_tap[c] * input_pixel[c];
+              }
+            } else {
+              for (int c = 0; c < output_depth; ++c) {
+                acc_buffer[c] +=
+                    filter_tap[c] * input_pixel[c / depth_multiplier];
+              }
+            }
+          }
+        }
+        int16_t* output_pixel =
+            output_data + Offset(output_shape, batch, out_y, out_x, 0);
+        for (int c = 0; c < output_depth; ++c) {
+          int64_t acc = acc_buffer[c];
+          if (bias_data) {
+            acc += bias_data[c];
+          }
+          output_pixel[c] = Requantize16x8(
+              acc, output_multiplier[c], output_shift[c], 0,
+              output_activation_min, output_activation_max);
+        }
+      }
+    }
+  }
+}
+
+// Computes kRows outputs of one batch row, sharing each input load between
+// the rows and widening the partial sums every kInt16x8MaxInt32Products
+// products.
+template <int kRows>
+inline void FullyConnected16x8Block(const FullyConnectedParams& params,
+                                    const int16_t* input_data,
+                                    const int8_t* filter_data,
+                                    const int64_t* bias_data, int accum_depth,
+                                    int16_t* output_data) {
+  int64_t acc[kRows];
+  for (int r = 0; r < kRows; ++r) {
+    acc[r] = bias_data ? bias_data[r] : 0;
+  }
+  for (int start = 0; start < accum_depth;
+       start += kInt16x8MaxInt32Products) {
+    const int end = std::min(accum_depth, start + kInt16x8MaxInt32Products);
+    int32_t sum[kRows] = {};
+    for (int d = start; d < end; ++d) {
+      const int32_t input_val = input_data[d];
+      for (int r = 0; r < kRows; ++r) {
+        sum[r] += filter_data[r * accum_depth + d] * input_val;
+      }
+    }
+    for (int r = 0; r < kRows; ++r) {
+      acc[r] += sum[r];
+    }
+  }
+  for (int r = 0; r < kRows; ++r) {
+    output_data[r] = Requantize16x8(
+        acc[r], params.output_multiplier, params.output_shift,
+        params.output_offset, params.quantized_activation_min,
+        params.quantized_activation_max);
+  }
+}
+
+// reference_integer_ops::FullyConnected for int16 activations with an int64
+// bias. params.input_offset and params.weights_offset must be zero, as the
+// 16x8 quantization scheme requires.
+inline void FullyConnected16x8(const FullyConnectedParams& params,
+                               const RuntimeShape& input_shape,
+                               const int16_t* input_data,
+                               const RuntimeShape& filter_shape,
+                               const int8_t* filter_data,
+                               const int64_t* bias_data,
+                               const RuntimeShape& output_shape,
+                               int16_t* output_data) {
+  TFLITE_DCHECK_EQ(params.input_offset, 0);
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  TFLITE_DCHECK_GE(filter_shape.DimensionsCount(), 2);
+  TFLITE_DCHECK_GE(output_shape.DimensionsCount(), 1);
+  TFLITE_DCHECK_LE(params.quantized_activation_min,
+                   params.quantized_activation_max);
+  const int filter_dim_count = filter_shape.DimensionsCount();
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_LE(output_depth, filter_shape.Dims(filter_dim_count - 2));
+  const int accum_depth = filter_shape.Dims(filter_dim_count - 1);
+  constexpr int kRows = 4;
+
+  for (int b = 0; b < batches; ++b) {
+    const int16_t* input_row = input_data + b * accum_depth;
+    int16_t* output_row = output_data + b * output_depth;
+    int out_c = 0;
+    for (; out_c + kRows <= output_depth; out_c += kRows) {
+      FullyConnected16x8Block<kRows>(
+          params, input_row, filter_data + out_c * accum_depth,
+          bias_data ? bias_data + out_c : nullptr, accum_depth,
+          output_row + out_c);
+    }
+    for (; out_c < output_depth; ++out_c) {
+      FullyConnected16x8Block<1>(
+          params, input_row, filter_data + out_c * accum_depth,
+          bias_data ? bias_data + out_c : nullptr, accum_depth,
+          output_row + out_c);
+    }
+  }
+}
+
+// Largest difference to the row maximum for which reference_ops::SoftmaxInt16
+// saturates its exp() LUT input to -32768. Computed once per op so that
+// SoftmaxInt16 can skip the rescaling of those elements.
+inline int32_t SoftmaxInt16SaturatedDiff(const SoftmaxParams& params) {
+  // The rescaled difference is monotonic in the difference, so bisect for the
+  // largest one that still saturates.
+  int32_t low = -65536;
+  int32_t high = 0;
+  while (high - low > 1) {
+    const int32_t mid = low + (high - low) / 2;
+    if (MultiplyByQuantizedMultiplier(mid, params.input_multiplier,
+                                      params.input_left_shift) +
+            32767 <=
+        -32768) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// reference_ops::SoftmaxInt16 with the exp of saturated differences taken
+// from the LUT once and the final rescale done in 32 bits, which cannot
+// overflow for outputs in [0, 32767]. `saturated_diff` comes from
+// SoftmaxInt16SaturatedDiff.
+inline void SoftmaxInt16(const SoftmaxParams& params, int32_t saturated_diff,
+                         const RuntimeShape& input_shape,
+                         const int16_t* input_data,
+                         const RuntimeShape& output_shape,
+                         int16_t* output_data) {
+  const int trailing_dim = input_shape.DimensionsCount() - 1;
+  const int outer_size =
+      MatchingFlatSizeSkipDim(input_shape, trailing_dim, output_shape);
+  const int depth =
+      MatchingDim(input_shape, trailing_dim, output_shape, trailing_dim);
+  const int16_t saturated_exp = LUTLookup(
+      static_cast<int16_t>(std::numeric_limits<int16_t>::min()),
+      params.exp_lut);
+
+  for (int i = 0; i < outer_size; ++i) {
+    const int16_t* input_row = input_data + i * depth;
+    int16_t* output_row = output_data + i * depth;
+    const int16_t max_in_row = *std::max_element(input_row, input_row + depth);
+
+    // The exp values are cached in the output row, as in the reference.
+    int32_t sum_of_exps = 0;
+    for (int c = 0; c < depth; ++c) {
+      const int32_t input_diff = input_row[c] - max_in_row;
+      int16_t exp_value = saturated_exp;
+      if (input_diff > saturated_diff) {
+        const int32_t sym_scaled_diff =
+            MultiplyByQuantizedMultiplier(input_diff, params.input_multiplier,
+                                          params.input_left_shift) +
+            32767;
+        exp_value = LUTLookup(
+            static_cast<int16_t>(std::min(
+                std::max(sym_scaled_diff, static_cast<int32_t>(-32768)),
+                static_cast<int32_t>(32767))),
+            params.exp_lut);
+      }
+      output_row[c] = exp_value;
+      sum_of_exps += exp_value;
+    }
+
+    const uint8_t headroom_plus_one =
+        CountLeadingZeros(static_cast<uint32_t>(sum_of_exps));
+    const int32_t shifted_sum =
+        ((static_cast<int64_t>(sum_of_exps) << (headroom_plus_one - 1)) +
+         (1 << 13)) >>
+        14;
+    const int32_t sym_shifted_sum = shifted_sum + (-((1 << 15) + (1 << 16)));
+    const int16_t reciprocal_scale_Q015 = LUTLookup(
+        static_cast<int16_t>(
+            std::min(std::max(sym_shifted_sum, static_cast<int32_t>(-32768)),
+                     static_cast<int32_t>(32767))),
+        params.one_over_one_plus_x_lut);
+
+    const int right_shift = 31 - headroom_plus_one;
+    const int32_t round = 1 << (right_shift - 1);
+    for (int c = 0; c < depth; ++c) {
+      const int32_t result =
+          (output_row[c] * reciprocal_scale_Q015 + round) >> right_shift;
+      output_row[c] = static_cast<int16_t>(
+          std::min(std::max(result, static_cast<int32_t>(0)),
+                   static_cast<int32_t>(32767)));
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_INT16_ACTIVATIONS_H_
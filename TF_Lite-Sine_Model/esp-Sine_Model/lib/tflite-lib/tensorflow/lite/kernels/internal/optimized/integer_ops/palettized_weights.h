@@ -0,0 +1,281 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_PALETTIZED_WEIGHTS_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_PALETTIZED_WEIGHTS_H_
+
+#include <algorithm>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/requantize.h"
+
+namespace tflite {
+
+// Int8 weights stored as a palette of 1 << index_bits values plus one packed
+// index per weight. The weights are viewed as num_rows rows (the output
+// channels, dimension 0 of a conv or fully-connected filter) of row_length
+// values. Indices are packed LSB first and every row starts on a byte
+// boundary, so any range of rows can be decoded on its own.
+struct PalettizedWeightsParams {
+  // palette_channels x (1 << index_bits) values; nullptr for plain weights.
+  const int8_t* palette;
+  // 1 for a palette shared by all rows, num_rows for one palette per row.
+  int palette_channels;
+  int index_bits;
+  int num_rows;
+  int row_length;
+  int row_bytes;
+};
+
+namespace optimized_integer_ops {
+
+// Bytes of decoded weights kept in scratch at a time. Every row is decoded
+// once per invocation whatever the tile size, so this only bounds the
+// scratch buffer.
+constexpr int kPalettizedWeightsTileBytes = 2048;
+
+inline int PalettizedWeightsRowBytes(int row_length, int index_bits) {
+  return (row_length * index_bits + 7) / 8;
+}
+
+// Number of rows decoded per tile, rounded to whole fully-connected row
+// blocks when there are enough rows.
+inline int PalettizedWeightsTileRows(const PalettizedWeightsParams& weights) {
+  int tile_rows = std::max(1, kPalettizedWeightsTileBytes /
+                                  std::max(1, weights.row_length));
+  tile_rows = std::min(tile_rows, weights.num_rows);
+  if (tile_rows >= kFullyConnectedRowBlock) {
+    tile_rows -= tile_rows % kFullyConnectedRowBlock;
+  }
+  return tile_rows;
+}
+
+// Decodes rows [first_row, first_row + num_rows) of `packed` into
+// num_rows x row_length int8 values.
+inline void DecodePalettizedRows(const PalettizedWeightsParams& weights,
+                                 const uint8_t* packed, int first_row,
+                                 int num_rows, int8_t* decoded) {
+  const int row_length = weights.row_length;
+  const int index_bits = weights.index_bits;
+  const int palette_size = 1 << index_bits;
+  const uint32_t index_mask = palette_size - 1;
+  for (int row = first_row; row < first_row + num_rows; ++row) {
+    const int8_t* palette =
+        weights.palette +
+        (weights.palette_channels == 1 ? 0 : row * palette_size);
+    const uint8_t* src = packed + row * weights.row_bytes;
+    int i = 0;
+    if (index_bits == 4) {
+      for (; i + 2 <= row_length; i += 2) {
+        const uint8_t pair = *src++;
+        decoded[i] = palette[pair & 0xf];
+        decoded[i + 1] = palette[pair >> 4];
+      }
+      if (i < row_length) {
+        decoded[i] = palette[*src & 0xf];
+      }
+    } else if (index_bits == 8) {
+      for (; i < row_length; ++i) {
+        decoded[i] = palette[src[i]];
+      }
+    } else {
+      // At most 7 bits are left over before a refill, so one byte always
+      // completes the next index.
+      uint32_t bit_buffer = 0;
+      int buffered_bits = 0;
+      for (; i < row_length; ++i) {
+        if (buffered_bits < index_bits) {
+          bit_buffer |= static_cast<uint32_t>(*src++) << buffered_bits;
+          buffered_bits += 8;
+        }
+        decoded[i] = palette[bit_buffer & index_mask];
+        bit_buffer >>= index_bits;
+        buffered_bits -= index_bits;
+      }
+    }
+    decoded += row_length;
+  }
+}
+
+// Same arithmetic as reference_integer_ops::ConvPerChannel, with the filter
+// given as palettized weights. Output channels are processed tile_rows at a
+// time: each tile is decoded into `tile` (tile_rows x row_length values) and
+// then swept over the whole output, so the packed filter is read once per
+// invocation and only one tile of int8 weights is ever resident.
+inline void ConvPerChannelPalettized(
+    const ConvParams& params, const int32_t* output_multiplier,
+    const int32_t* output_shift, const RuntimeShape& input_shape,
+    const int8_t* input_data, const RuntimeShape& filter_shape,
+    const PalettizedWeightsParams& weights, const uint8_t* packed_filter,
+    const RuntimeShape& bias_shape, const int32_t* bias_data,
+    const RuntimeShape& output_shape, int8_t* output_data, int8_t* tile,
+    int tile_rows) {
+  const int32_t input_offset = params.input_offset;
+  const int stride_width = params.stride_width;
+  const int stride_height = params.stride_height;
+  const int dilation_width_factor = params.dilation_width_factor;
+  const int dilation_height_factor = params.dilation_height_factor;
+  const int pad_width = params.padding_values.width;
+  const int pad_height = params.padding_values.height;
+  const int32_t output_offset = params.output_offset;
+  const int32_t output_activation_min = params.quantized_activation_min;
+  const int32_t output_activation_max = params.quantized_activation_max;
+
+  TFLITE_DCHECK_LE(output_activation_min, output_activation_max);
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_depth = input_shape.Dims(3);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  if (bias_data) {
+    TFLITE_DCHECK_EQ(bias_shape.FlatSize(), output_depth);
+  }
+  TFLITE_DCHECK_EQ(weights.num_rows, output_depth);
+
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int filter_height = filter_shape.Dims(1);
+  const int filter_width = filter_shape.Dims(2);
+  const int filter_input_depth = filter_shape.Dims(3);
+  const int groups = input_depth / filter_input_depth;
+  TFLITE_DCHECK_EQ(input_depth % filter_input_depth, 0);
+  const int filters_per_group = output_depth / groups;
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int row_length = weights.row_length;
+  TFLITE_DCHECK_EQ(row_length, filter_height * filter_width *
+                                   filter_input_depth);
+
+  for (int first_channel = 0; first_channel < output_depth;
+       first_channel += tile_rows) {
+    const int num_channels = std::min(tile_rows, output_depth - first_channel);
+    DecodePalettizedRows(weights, packed_filter, first_channel, num_channels,
+                         tile);
+    for (int batch = 0; batch < batches; ++batch) {
+      for (int out_y = 0; out_y < output_height; ++out_y) {
+        const int in_y_origin = (out_y * stride_height) - pad_height;
+        for (int out_x = 0; out_x < output_width; ++out_x) {
+          const int in_x_origin = (out_x * stride_width) - pad_width;
+          int8_t* output_pixel =
+              output_data + Offset(output_shape, batch, out_y, out_x, 0);
+          for (int first_c = 0; first_c < num_channels;
+               first_c += kRequantizeBlockSize) {
+            const int block_channels =
+                std::min(kRequantizeBlockSize, num_channels - first_c);
+            int32_t acc[kRequantizeBlockSize];
+            for (int c = 0; c < block_channels; ++c) {
+              const int group =
+                  (first_channel + first_c + c) / filters_per_group;
+              const int8_t* filter_row = tile + (first_c + c) * row_length;
+              acc[c] = 0;
+              for (int filter_y = 0; filter_y < filter_height; ++filter_y) {
+                const int in_y =
+                    in_y_origin + dilation_height_factor * filter_y;
+                if (in_y < 0 || in_y >= input_height) {
+                  continue;
+                }
+                for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+                  const int in_x =
+                      in_x_origin + dilation_width_factor * filter_x;
+                  if (in_x < 0 || in_x >= input_width) {
+                    continue;
+                  }
+                  const int8_t* input_ptr =
+                      input_data + Offset(input_shape, batch, in_y, in_x,
+                                          group * filter_input_depth);
+                  const int8_t* filter_ptr =
+                      filter_row + (filter_y * filter_width + filter_x) *
+                                       filter_input_depth;
+                  for (int in_channel = 0; in_channel < filter_input_depth;
+                       ++in_channel) {
+                    acc[c] += filter_ptr[in_channel] *
+                              (input_ptr[in_channel] + input_offset);
+                  }
+                }
+              }
+            }
+            const int out_channel = first_channel + first_c;
+            RequantizeRowPerChannel(
+                acc, bias_data ? bias_data + out_channel : nullptr,
+                output_multiplier + out_channel, output_shift + out_channel,
+                output_offset, output_activation_min, output_activation_max,
+                block_channels, output_pixel + out_channel);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Computes the FullyConnectedPrecomputeBias result for palettized weights,
+// decoding one row at a time into `row` (row_length values).
+inline void FullyConnectedPrecomputeBiasPalettized(
+    const PalettizedWeightsParams& weights, const uint8_t* packed_filter,
+    const int32_t* bias_data, int32_t input_offset, int8_t* row,
+    int32_t* effective_bias) {
+  for (int out_c = 0; out_c < weights.num_rows; ++out_c) {
+    DecodePalettizedRows(weights, packed_filter, out_c, 1, row);
+    FullyConnectedPrecomputeBias(row,
+                                 bias_data ? bias_data + out_c : nullptr,
+                                 input_offset, 1, weights.row_length,
+                                 effective_bias + out_c);
+  }
+}
+
+// optimized_integer_ops::FullyConnected with palettized weights: rows are
+// decoded tile_rows at a time into `tile` and each tile is applied to every
+// batch before the next one is decoded.
+inline void FullyConnectedPalettized(const FullyConnectedParams& params,
+                                     const int32_t* effective_bias,
+                                     const RuntimeShape& input_shape,
+                                     const int8_t* input_data,
+                                     const PalettizedWeightsParams& weights,
+                                     const uint8_t* packed_filter,
+                                     const RuntimeShape& output_shape,
+                                     int8_t* output_data, int8_t* tile,
+                                     int tile_rows) {
+  TFLITE_DCHECK_EQ(params.weights_offset, 0);
+  TFLITE_DCHECK_GE(output_shape.DimensionsCount(), 1);
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = output_shape.Dims(output_dim_count - 1);
+  TFLITE_DCHECK_LE(output_depth, weights.num_rows);
+  const int accum_depth = weights.row_length;
+
+  for (int first_row = 0; first_row < output_depth; first_row += tile_rows) {
+    const int num_rows = std::min(tile_rows, output_depth - first_row);
+    DecodePalettizedRows(weights, packed_filter, first_row, num_rows, tile);
+    int b = 0;
+    for (; b + kFullyConnectedBatchBlock <= batches;
+         b += kFullyConnectedBatchBlock) {
+      FullyConnectedBatchRows<kFullyConnectedBatchBlock>(
+          params, effective_bias + first_row, input_data + b * accum_depth,
+          tile, accum_depth, num_rows, output_depth,
+          output_data + b * output_depth + first_row);
+    }
+    for (; b < batches; ++b) {
+      FullyConnectedBatchRows<1>(
+          params, effective_bias + first_row, input_data + b * accum_depth,
+          tile, accum_depth, num_rows, output_depth,
+          output_data + b * output_depth + first_row);
+    }
+  }
+}
+
+}  // namespace optimized_integer_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_INTEGER_OPS_PALETTIZED_WEIGHTS_H_
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/add.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/add.h"
@@ -99,6 +100,25 @@ TfLiteStatus AddPrepare(TfLiteContext* context, TfLiteNode* node) {
   TF_LITE_ENSURE_STATUS(
       CalculateOpDataAdd(context, params, input1, input2, output, data));
 
+  data->input_tables = nullptr;
+  if (output->type == kTfLiteInt8 &&
+      NumElements(output) >=
+          optimized_integer_ops::kScaledInputTableMinElements) {
+    int32_t* input1_table = static_cast<int32_t*>(
+        context->AllocatePersistentBuffer(
+            context, optimized_integer_ops::kScaledInputTablesBytes));
+    TF_LITE_ENSURE(context, input1_table != nullptr);
+    int32_t* input2_table =
+        input1_table + optimized_integer_ops::kScaledInputTableSize;
+    optimized_integer_ops::PopulateScaledInputTable(
+        data->input1_offset, data->input1_multiplier, data->input1_shift,
+        data->left_shift, input1_table);
+    optimized_integer_ops::PopulateScaledInputTable(
+        data->input2_offset, data->input2_multiplier, data->input2_shift,
+        data->left_shift, input2_table);
+    data->input_tables = input1_table;
+  }
+
   if (output->type == kTfLiteInt32) {
     // Only support int32 unquantized add for now.
     TF_LITE_ENSURE_EQ(context, input1->quantization.type,
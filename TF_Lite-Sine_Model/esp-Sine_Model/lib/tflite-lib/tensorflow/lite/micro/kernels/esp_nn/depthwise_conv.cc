@@ -18,6 +18,11 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int16_activations.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int4_weights.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/palettized_weights.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/sparse_weights.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/depthwiseconv_float.h"
 #include "tensorflow/lite/kernels/internal/reference/depthwiseconv_uint8.h"
@@ -41,6 +46,9 @@ namespace {
 
 struct NodeData {
   OpDataConv op_data;
+  // Per-channel accumulators for an int4 filter or int16 input,
+  // output_depth int32 values. -1 if not needed.
+  int acc_buffer_idx;
 #if ESP_NN
   int buffer_idx;
 #endif
@@ -199,7 +207,7 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
           context, num_channels * sizeof(int32_t)));
 
   // All per-channel quantized tensors need valid zero point and scale arrays.
-  if (input->type == kTfLiteInt8) {
+  if (input->type == kTfLiteInt8 || input->type == kTfLiteInt16) {
     TF_LITE_ENSURE_EQ(context, filter->quantization.type,
                       kTfLiteAffineQuantization);
 
@@ -222,6 +230,36 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
       context, node, params, input_width, input_height, filter_width,
       filter_height, output_width, output_height, input->type, &data->op_data));
 
+  TF_LITE_ENSURE_MSG(
+      context,
+      input->type == filter->type ||
+          (input->type == kTfLiteInt8 && filter->type == kTfLiteInt4) ||
+          (input->type == kTfLiteInt16 && filter->type == kTfLiteInt8),
+      "Hybrid models are not supported on TFLite Micro.");
+  // Only CONV_2D and FULLY_CONNECTED decode palettized and block-sparse
+  // filters; read as dense int8 here, the packed indices or the nonzero
+  // blocks would silently give wrong outputs.
+  PalettizedWeightsParams palettized_filter;
+  TF_LITE_ENSURE_STATUS(micro_context->GetInputPalettizedWeights(
+      node, kConvWeightsTensor, &palettized_filter));
+  TF_LITE_ENSURE_MSG(context, palettized_filter.palette == nullptr,
+                     "Palettized filters are not supported by "
+                     "DEPTHWISE_CONV_2D.");
+  BlockSparseWeightsParams sparse_filter;
+  TF_LITE_ENSURE_STATUS(micro_context->GetInputBlockSparseWeights(
+      node, kConvWeightsTensor, &sparse_filter));
+  TF_LITE_ENSURE_MSG(context, sparse_filter.segments == nullptr,
+                     "Sparse filters are not supported by DEPTHWISE_CONV_2D.");
+  data->acc_buffer_idx = -1;
+  if (filter->type == kTfLiteInt4 ||
+      (input->type == kTfLiteInt16 &&
+       optimized_integer_ops::DepthwiseConv16x8Supported(
+           GetTensorShape(filter)))) {
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, output->dims->data[3] * sizeof(int32_t),
+        &data->acc_buffer_idx));
+  }
+
 #if ESP_NN
   if (input->type == kTfLiteInt8) {
     data_dims_t input_dims =  {
@@ -294,11 +332,28 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
           tflite::micro::GetTensorData<float>(output));
       break;
     case kTfLiteInt8:
+      if (filter->type == kTfLiteInt4) {
+        optimized_integer_ops::DepthwiseConvPerChannelInt4(
+            DepthwiseConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int8_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetTensorData<int32_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int8_t>(output),
+            static_cast<int32_t*>(
+                context->GetScratchBuffer(context, data.acc_buffer_idx)));
+        break;
+      }
 #if ESP_NN
       EvalQuantizedPerChannel(context, node, params, data, input, filter, bias,
                               output);
 #else
-      reference_integer_ops::DepthwiseConvPerChannel(
+      optimized_integer_ops::DepthwiseConvPerChannel(
           DepthwiseConvParamsQuantized(params, data.op_data),
           data.op_data.per_channel_output_multiplier,
           data.op_data.per_channel_output_shift,
@@ -312,6 +367,37 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
           tflite::micro::GetTensorData<int8_t>(output));
 #endif
       break;
+    case kTfLiteInt16:
+      if (data.acc_buffer_idx >= 0) {
+        optimized_integer_ops::DepthwiseConvPerChannel16x8(
+            DepthwiseConvParamsQuantized(params, data.op_data),
+            data.op_data.per_channel_output_multiplier,
+            data.op_data.per_channel_output_shift,
+            tflite::micro::GetTensorShape(input),
+            tflite::micro::GetTensorData<int16_t>(input),
+            tflite::micro::GetTensorShape(filter),
+            tflite::micro::GetTensorData<int8_t>(filter),
+            tflite::micro::GetTensorShape(bias),
+            tflite::micro::GetOptionalTensorData<int64_t>(bias),
+            tflite::micro::GetTensorShape(output),
+            tflite::micro::GetTensorData<int16_t>(output),
+            static_cast<int32_t*>(
+                context->GetScratchBuffer(context, data.acc_buffer_idx)));
+        break;
+      }
+      reference_integer_ops::DepthwiseConvPerChannel(
+          DepthwiseConvParamsQuantized(params, data.op_data),
+          data.op_data.per_channel_output_multiplier,
+          data.op_data.per_channel_output_shift,
+          tflite::micro::GetTensorShape(input),
+          tflite::micro::GetTensorData<int16_t>(input),
+          tflite::micro::GetTensorShape(filter),
+          tflite::micro::GetTensorData<int8_t>(filter),
+          tflite::micro::GetTensorShape(bias),
+          tflite::micro::GetOptionalTensorData<int64_t>(bias),
+          tflite::micro::GetTensorShape(output),
+          tflite::micro::GetTensorData<int16_t>(output));
+      break;
     case kTfLiteUInt8:
       //EvalQuantized(context, node, params, &data, input, filter, bias, output);
       reference_ops::DepthwiseConv(
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/reduce.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/integer_ops/mean.h"
 #include "tensorflow/lite/kernels/internal/reference/reduce.h"
@@ -136,6 +137,22 @@ void ResolveAxis(const int* axis_data, int axis_count,
   op_params->axis_count = axis_count;
 }
 
+// True when the reduction axes form one contiguous run (e.g. H,W of an NHWC
+// tensor, or the last axis), so the optimized_integer_ops reduce kernels can
+// handle it.
+bool GetContiguousReduceShape(
+    const TfLiteEvalTensor* input, const TfLiteEvalTensor* axis,
+    optimized_integer_ops::ContiguousReduceShape* shape) {
+  const int num_axis = static_cast<int>(ElementCount(*axis->dims));
+  if (num_axis > kMaxNumberOfAxis) {
+    return false;
+  }
+  int resolved_axis[kMaxNumberOfAxis];
+  return optimized_integer_ops::GetContiguousReduceShape(
+      input->dims->data, input->dims->size,
+      tflite::micro::GetTensorData<int>(axis), num_axis, resolved_axis, shape);
+}
+
 template <typename T>
 TfLiteStatus QuantizedMeanOrSum(TfLiteContext* context, TfLiteNode* node,
                                 int* temp_index, int* resolved_axis,
@@ -147,6 +164,16 @@ TfLiteStatus QuantizedMeanOrSum(TfLiteContext* context, TfLiteNode* node,
   TfLiteReducerParams* params =
       static_cast<TfLiteReducerParams*>(node->builtin_data);
 
+  optimized_integer_ops::ContiguousReduceShape shape;
+  if (std::is_same<T, int8_t>::value &&
+      GetContiguousReduceShape(input, axis, &shape)) {
+    optimized_integer_ops::QuantizedMeanOrSum(
+        shape, tflite::micro::GetTensorData<int8_t>(input), op_data->input_zp,
+        op_data->multiplier, op_data->shift, op_data->output_zp, compute_sum,
+        tflite::micro::GetTensorData<int8_t>(output), temp_sum);
+    return kTfLiteOk;
+  }
+
   bool result = reference_ops::QuantizedMeanOrSumExtraArgs<T, int32_t>(
       tflite::micro::GetTensorData<T>(input), op_data->input_zp,
       op_data->input_scale, &input->dims->data[0], input->dims->size,
@@ -268,6 +295,15 @@ TfLiteStatus EvalMaxHelper(TfLiteContext* context, TfLiteNode* node,
       TF_LITE_ENSURE_EQ(context, static_cast<double>(op_data->input_scale),
                         static_cast<double>(op_data->output_scale));
       TF_LITE_ENSURE_EQ(context, op_data->input_zp, op_data->output_zp);
+      {
+        optimized_integer_ops::ContiguousReduceShape shape;
+        if (GetContiguousReduceShape(input, axis, &shape)) {
+          optimized_integer_ops::ReduceMax(
+              shape, tflite::micro::GetTensorData<int8_t>(input),
+              tflite::micro::GetTensorData<int8_t>(output));
+          break;
+        }
+      }
       TF_LITE_ENSURE(
           context,
           reference_ops::ReduceGeneric<int8_t>(
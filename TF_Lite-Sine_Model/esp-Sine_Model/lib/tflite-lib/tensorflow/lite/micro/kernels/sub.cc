@@ -18,6 +18,7 @@ limitations under the License.
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
 #include "tensorflow/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/lite/kernels/internal/reference/add.h"
 #include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
@@ -63,6 +64,38 @@ void EvalSub(TfLiteContext* context, TfLiteNode* node, TfLiteSubParams* params,
   }
 }
 
+namespace {
+
+// Int8 Sub through the shared binary-elementwise engine, with both inputs
+// rescaled via the lookup tables SubPrepare filled. Returns false when
+// SubPrepare did not build the tables or the shapes need the generic
+// broadcast.
+bool EvalSubInt8Optimized(const OpDataSub* data,
+                          const ArithmeticParams& op_params,
+                          bool need_broadcast, const TfLiteEvalTensor* input1,
+                          const TfLiteEvalTensor* input2,
+                          TfLiteEvalTensor* output) {
+  if (data->input_tables == nullptr ||
+      !optimized_integer_ops::BinaryElementwiseSupported(op_params,
+                                                         need_broadcast)) {
+    return false;
+  }
+  const int32_t* input1_table = data->input_tables;
+  const int32_t* input2_table =
+      input1_table + optimized_integer_ops::kScaledInputTableSize;
+  optimized_integer_ops::BinaryElementwise(
+      op_params, need_broadcast, tflite::micro::GetTensorShape(input1),
+      tflite::micro::GetTensorData<int8_t>(input1),
+      tflite::micro::GetTensorShape(input2),
+      tflite::micro::GetTensorData<int8_t>(input2),
+      tflite::micro::GetTensorShape(output),
+      tflite::micro::GetTensorData<int8_t>(output),
+      optimized_integer_ops::SubOp(op_params, input1_table, input2_table));
+  return true;
+}
+
+}  // namespace
+
 TfLiteStatus EvalSubQuantized(TfLiteContext* context, TfLiteNode* node,
                               TfLiteSubParams* params, const OpDataSub* data,
                               const TfLiteEvalTensor* input1,
@@ -87,6 +120,10 @@ TfLiteStatus EvalSubQuantized(TfLiteContext* context, TfLiteNode* node,
 
   switch (output->type) {
     case kTfLiteInt8: {
+      if (EvalSubInt8Optimized(data, op_params, need_broadcast, input1, input2,
+                               output)) {
+        break;
+      }
       if (need_broadcast) {
         tflite::reference_ops::BroadcastQuantSubSlow(
             op_params, tflite::micro::GetTensorShape(input1),
@@ -21,6 +21,8 @@ limitations under the License.
 
 #include "tensorflow/lite/kernels/internal/compatibility.h"
 #include "tensorflow/lite/micro/micro_log.h"
+#include "tensorflow/lite/micro/palettized_weights.h"
+#include "tensorflow/lite/micro/sparse_weights.h"
 
 namespace tflite {
 MicroContext::MicroContext(MicroAllocator* allocator, const Model* model,
@@ -98,6 +100,31 @@ TfLiteTensor* MicroContext::AllocateTempIntermediateTensor(
   return AllocateTempTfLiteTensor(tensor_index);
 }
 
+TfLiteStatus MicroContext::GetInputPalettizedWeights(
+    const TfLiteNode* node, int index, PalettizedWeightsParams* params) {
+  params->palette = nullptr;
+  const int tensor_index =
+      GetTensorIndex(index, node->inputs->size, node->inputs->data);
+  if (model_ == nullptr || tensor_index < 0) {
+    return kTfLiteOk;
+  }
+  return GetPalettizedWeightsParams(model_, graph_.GetCurrentSubgraphIndex(),
+                                    tensor_index, params);
+}
+
+TfLiteStatus MicroContext::GetInputBlockSparseWeights(
+    const TfLiteNode* node, int index, BlockSparseWeightsParams* params) {
+  params->segments = nullptr;
+  const int tensor_index =
+      GetTensorIndex(index, node->inputs->size, node->inputs->data);
+  if (model_ == nullptr || tensor_index < 0) {
+    return kTfLiteOk;
+  }
+  return GetBlockSparseWeightsParams(this, model_,
+                                     graph_.GetCurrentSubgraphIndex(),
+                                     tensor_index, params);
+}
+
 void MicroContext::DeallocateTempTfLiteTensor(TfLiteTensor* tensor) {
   return allocator_.DeallocateTempTfLiteTensor(tensor);
 }
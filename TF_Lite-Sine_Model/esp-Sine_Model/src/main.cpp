@@ -19,7 +19,7 @@ WebServer server(80);
 // ───────── TensorFlow Lite Micro ──────────────────────────────────────────────
 #include "tensorflow/lite/micro/micro_log.h"
 #include "tensorflow/lite/micro/tflite_bridge/micro_error_reporter.h"
-#include "tensorflow/lite/micro/all_ops_resolver.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/schema/schema_generated.h"
 
@@ -33,13 +33,19 @@ WebServer server(80);
 constexpr int   kTensorArenaSize = 12 * 1024;   // 12 kB
 static   uint8_t tensor_arena[kTensorArenaSize];
 
+// ───────── Lote / benchmark ──────────────────────────────────────────────────
+constexpr int   kMaxLote         = 360;         // máx. de ângulos em /seno_lote
+constexpr int   kAngulosBenchmark = 1000;
+
 // ───────── Variáveis globais ─────────────────────────────────────────────────
 namespace {
   tflite::MicroErrorReporter micro_error_reporter;
   tflite::ErrorReporter*     error_reporter = &micro_error_reporter;
 
   const tflite::Model*       model          = nullptr;
-  tflite::AllOpsResolver     resolver;                  // todas as ops
+  // Só as ops do MLP (FC + TANH) e, para a versão INT8, QUANTIZE/DEQUANTIZE.
+  // Evita registrar e procurar entre todas as ops do AllOpsResolver.
+  tflite::MicroMutableOpResolver<4> resolver;
   tflite::MicroInterpreter*  interpreter     = nullptr;
 
   TfLiteTensor*              input          = nullptr;
@@ -93,6 +99,19 @@ float inferirSeno(float x) {
   return y;
 }
 
+// Avalia n ângulos (rad) em sequência, gravando o seno em y.
+// O TFLM não permite redimensionar o batch depois do AllocateTensors(), então
+// cada ângulo ainda é um Invoke(); o ganho vem de pular o overhead HTTP por
+// ângulo. Para um Invoke() único com N ângulos, converta o modelo com
+// batch = N no notebook. Retorna quantos ângulos foram calculados.
+int inferirSenoLote(const float* x, float* y, int n) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = inferirSeno(x[i]);
+    if (isnan(y[i])) return i;
+  }
+  return n;
+}
+
 // ═════════════════════════════════════════════════════════════════════════════
 // HANDLERS DA API
 // ═════════════════════════════════════════════════════════════════════════════
@@ -134,6 +153,62 @@ void handleSeno() {
   server.send(200, "application/json", resposta);
 }
 
+// Handler para calcular vários senos: /seno_lote?inicio=0&fim=360&passo=15
+void handleSenoLote() {
+  if (!server.hasArg("inicio") || !server.hasArg("fim") || !server.hasArg("passo")) {
+    server.send(400, "application/json", "{\"erro\":\"Parâmetros 'inicio', 'fim' e 'passo' são obrigatórios\"}");
+    return;
+  }
+
+  float inicio = server.arg("inicio").toFloat();
+  float fim    = server.arg("fim").toFloat();
+  float passo  = server.arg("passo").toFloat();
+
+  // NaN falha todas as comparações, então é recusado aqui junto com o infinito
+  if (!isfinite(inicio) || !isfinite(fim) || !isfinite(passo) ||
+      passo <= 0.0f || fim < inicio) {
+    server.send(400, "application/json", "{\"erro\":\"Intervalo inválido\"}");
+    return;
+  }
+
+  // O limite é conferido ainda em float: com um passo minúsculo a divisão
+  // não cabe num int e a conversão seria indefinida
+  const float passos = (fim - inicio) / passo;
+  if (!(passos < kMaxLote)) {
+    server.send(400, "application/json", "{\"erro\":\"Máximo de " + String(kMaxLote) + " ângulos por lote\"}");
+    return;
+  }
+  int n = static_cast<int>(passos) + 1;
+
+  static float angulos_rad[kMaxLote];
+  static float senos[kMaxLote];
+  for (int i = 0; i < n; ++i) {
+    angulos_rad[i] = ((inicio + i * passo) * M_PI) / 180.0;
+  }
+
+  unsigned long t0 = micros();
+  int calculados = inferirSenoLote(angulos_rad, senos, n);
+  unsigned long dt = micros() - t0;
+
+  if (calculados != n) {
+    server.send(500, "application/json", "{\"erro\":\"Erro na inferência do modelo\"}");
+    return;
+  }
+
+  Serial.printf("Lote de %d ângulos em %lu us\n", n, dt);
+
+  String resposta;
+  resposta.reserve(32 + n * 12);
+  resposta = "{\"tempo_us\":" + String(dt) + ",\"seno\":[";
+  for (int i = 0; i < n; ++i) {
+    if (i > 0) resposta += ",";
+    resposta += String(senos[i], 6);
+  }
+  resposta += "]}";
+
+  server.send(200, "application/json", resposta);
+}
+
 // Handler para página de ajuda
 void handleRoot() {
   String html = "<html><body>";
@@ -143,6 +218,8 @@ void handleRoot() {
   html += "<p>Exemplo: <a href='/seno?angulo=30'>/seno?angulo=30</a></p>";
   html += "<p>Exemplo: <a href='/seno?angulo=45'>/seno?angulo=45</a></p>";
   html += "<p>Exemplo: <a href='/seno?angulo=90'>/seno?angulo=90</a></p>";
+  html += "<p><strong>GET /seno_lote?inicio=A&amp;fim=B&amp;passo=P</strong></p>";
+  html += "<p>Exemplo: <a href='/seno_lote?inicio=0&fim=360&passo=15'>/seno_lote?inicio=0&amp;fim=360&amp;passo=15</a></p>";
   html += "</body></html>";
   
   server.send(200, "text/html", html);
@@ -179,6 +256,42 @@ void testeInicialInferencia() {
   Serial.println("Teste inicial concluído!\n");
 }
 
+// ═════════════════════════════════════════════════════════════════════════════
+// BENCHMARK: ângulos por segundo
+// ═════════════════════════════════════════════════════════════════════════════
+void benchmarkInferencia() {
+  static float x[kAngulosBenchmark];
+  static float y[kAngulosBenchmark];
+  for (int i = 0; i < kAngulosBenchmark; ++i) {
+    x[i] = (2.0f * M_PI * i) / kAngulosBenchmark;
+  }
+
+  // Um inferirSeno() por ângulo, como em /seno, e o lote, como em
+  // /seno_lote: o lote também faz um Invoke() por ângulo, então os dois
+  // tempos por ângulo devem ficar iguais; o ganho do lote é só o HTTP.
+  unsigned long t0 = micros();
+  int calculados = 0;
+  for (int i = 0; i < kAngulosBenchmark; ++i) {
+    y[i] = inferirSeno(x[i]);
+    if (!isnan(y[i])) calculados++;
+  }
+  unsigned long dt_um = micros() - t0;
+
+  t0 = micros();
+  calculados += inferirSenoLote(x, y, kAngulosBenchmark);
+  unsigned long dt_lote = micros() - t0;
+
+  if (calculados != 2 * kAngulosBenchmark || dt_um == 0 || dt_lote == 0) {
+    Serial.println("Benchmark falhou.");
+    return;
+  }
+
+  Serial.printf("Benchmark, %d ângulos: um a um %.1f us/ângulo, lote %.1f us/ângulo (%.0f ângulos/s)\n\n",
+                kAngulosBenchmark, (float)dt_um / kAngulosBenchmark,
+                (float)dt_lote / kAngulosBenchmark,
+                kAngulosBenchmark * 1e6f / dt_lote);
+}
+
 // ═════════════════════════════════════════════════════════════════════════════
 // SETUP
 // ═════════════════════════════════════════════════════════════════════════════
@@ -186,6 +299,12 @@ void setup() {
   Serial.begin(115200);
   delay(200);
 
+  // 0) Registra as ops usadas pelo modelo
+  resolver.AddFullyConnected();
+  resolver.AddTanh();
+  resolver.AddQuantize();
+  resolver.AddDequantize();
+
   // 1) Carrega o modelo da flash
   model = tflite::GetModel(modelo_seno_tflite);
   if (model->version() != TFLITE_SCHEMA_VERSION) {
@@ -240,15 +359,18 @@ void setup() {
   // Configura rotas da API
   server.on("/", handleRoot);
   server.on("/seno", handleSeno);
+  server.on("/seno_lote", handleSenoLote);
   server.onNotFound(handleNotFound);
   
   // Executa teste inicial de inferência
   testeInicialInferencia();
+  benchmarkInferencia();
 
   // Inicia servidor
   server.begin();
   Serial.println("Servidor HTTP iniciado!");
   Serial.println("Use: GET /seno?angulo=VALOR");
+  Serial.println("     GET /seno_lote?inicio=A&fim=B&passo=P");
   Serial.println("Exemplo: http://" + WiFi.localIP().toString() + "/seno?angulo=30");
 }
 
@@ -31,6 +31,29 @@ def testar_seno(angulo):
         print(f"✗ Erro de conexão: {e}")
         return None
 
+def testar_seno_lote(inicio, fim, passo):
+    """Calcula o seno de vários ângulos em uma única requisição"""
+    try:
+        url = f"{BASE_URL}/seno_lote"
+        params = {"inicio": inicio, "fim": fim, "passo": passo}
+
+        print(f"Testando lote de {inicio}° a {fim}° (passo {passo}°)...")
+        response = requests.get(url, params=params, timeout=10)
+
+        if response.status_code == 200:
+            data = response.json()
+            n = len(data['seno'])
+            print(f"✓ {n} ângulos em {data['tempo_us']} us no ESP32 "
+                  f"({n * 1e6 / max(data['tempo_us'], 1):.0f} ângulos/s)")
+            return data
+        else:
+            print(f"✗ Erro HTTP {response.status_code}: {response.text}")
+            return None
+
+    except requests.exceptions.RequestException as e:
+        print(f"✗ Erro de conexão: {e}")
+        return None
+
 def main():
     print("=== Teste da API ESP32 - Cálculo de Seno ===\n")
     
@@ -49,5 +72,8 @@ def main():
     
     print(f"Teste concluído: {sucessos}/{len(angulos_teste)} sucessos")
 
+    print()
+    testar_seno_lote(0, 360, 15)
+
 if __name__ == "__main__":
     main()
\ No newline at end of file
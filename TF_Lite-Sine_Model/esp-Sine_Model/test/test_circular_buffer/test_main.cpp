@@ -0,0 +1,522 @@
+// micro CircularBuffer against the in-place shift it replaced, kept in
+// baseline_circular_buffer.cpp: the window the output eval tensor points at
+// after every invocation that returns kTfLiteOk, for strides 1 to 3, and a
+// keyword-spotting style graph (CIRCULAR_BUFFER feeding a strided CONV_2D)
+// run on microfrontend features of synthetic 16 kHz audio, whose outputs
+// must match the shift's on every run. The graph is also the benchmark:
+// per 10 ms slice, the frontend, each op and the whole Invoke.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "flatbuffers/flexbuffers.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "tensorflow/lite/micro/arena_allocator/single_arena_buffer_allocator.h"
+#include "tensorflow/lite/micro/fake_micro_context.h"
+#include "tensorflow/lite/micro/kernels/circular_buffer.h"
+#include "tensorflow/lite/micro/micro_context.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/micro/micro_profiler_interface.h"
+#include "tensorflow/lite/micro/mock_micro_graph.h"
+#include "tensorflow/lite/micro/test_helpers.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+TfLiteRegistration_V1* Register_CIRCULAR_BUFFER();
+TfLiteRegistration_V1* Register_CIRCULAR_BUFFER_BASELINE();
+}  // namespace tflite
+
+namespace {
+
+constexpr int kZeroPoint = -128;
+
+// FakeMicroContext allocates a new temp eval tensor on every GetEvalTensor
+// call, which runs out of arena over thousands of invocations. The
+// interpreter's eval tensors persist, so these do too.
+class EvalTensorContext : public tflite::FakeMicroContext {
+ public:
+  EvalTensorContext(TfLiteTensor* tensors,
+                    tflite::SingleArenaBufferAllocator* allocator,
+                    tflite::MicroGraph* graph)
+      : FakeMicroContext(tensors, allocator, graph) {
+    for (int i = 0; i < 2; ++i) {
+      eval_tensors_[i].data = tensors[i].data;
+      eval_tensors_[i].dims = tensors[i].dims;
+      eval_tensors_[i].type = tensors[i].type;
+    }
+  }
+
+  TfLiteEvalTensor* GetEvalTensor(int tensor_index) override {
+    return &eval_tensors_[tensor_index];
+  }
+
+ private:
+  TfLiteEvalTensor eval_tensors_[2];
+};
+
+// One CircularBuffer node with an input of `depth` int8 values and an output
+// of `num_slots` of them, wired the way KernelRunner does it.
+class CircularBufferRunner {
+ public:
+  CircularBufferRunner(const TfLiteRegistration_V1& registration,
+                       int num_slots, int depth, int cycles_max)
+      : registration_(registration),
+        input_(depth),
+        output_(num_slots * depth, kZeroPoint),
+        arena_(4096 + 2 * output_.size()),
+        allocator_(tflite::SingleArenaBufferAllocator::Create(arena_.data(),
+                                                              arena_.size())),
+        graph_(allocator_) {
+    input_dims_[0] = 4;
+    input_dims_[1] = 1;
+    input_dims_[2] = 1;
+    input_dims_[3] = 1;
+    input_dims_[4] = depth;
+    output_dims_[0] = 4;
+    output_dims_[1] = 1;
+    output_dims_[2] = num_slots;
+    output_dims_[3] = 1;
+    output_dims_[4] = depth;
+    tensors_[0] = tflite::testing::CreateQuantizedTensor(
+        input_.data(), tflite::testing::IntArrayFromInts(input_dims_), 1.0f,
+        kZeroPoint);
+    tensors_[1] = tflite::testing::CreateQuantizedTensor(
+        output_.data(), tflite::testing::IntArrayFromInts(output_dims_), 1.0f,
+        kZeroPoint);
+    micro_context_ = new (micro_context_storage_)
+        EvalTensorContext(tensors_, allocator_, &graph_);
+    context_.impl_ = static_cast<void*>(micro_context_);
+    context_.ReportError = tflite::MicroContextReportOpError;
+    context_.GetTensor = tflite::MicroContextGetTensor;
+    context_.GetEvalTensor = tflite::MicroContextGetEvalTensor;
+    context_.AllocatePersistentBuffer =
+        tflite::MicroContextAllocatePersistentBuffer;
+    node_.inputs = tflite::testing::IntArrayFromInts(inputs_array_);
+    node_.outputs = tflite::testing::IntArrayFromInts(outputs_array_);
+
+    flexbuffers::Builder fbb;
+    fbb.Map([&]() { fbb.Int("cycles_max", cycles_max); });
+    fbb.Finish();
+    const std::vector<uint8_t>& options = fbb.GetBuffer();
+    node_.user_data = registration_.init(
+        &context_, reinterpret_cast<const char*>(options.data()),
+        options.size());
+    TEST_ASSERT_EQUAL(kTfLiteOk, registration_.prepare(&context_, &node_));
+  }
+
+  CircularBufferRunner(const CircularBufferRunner&) = delete;
+  CircularBufferRunner& operator=(const CircularBufferRunner&) = delete;
+
+  // Returns true when the op returned kTfLiteOk, i.e. the rest of the graph
+  // would run and read the output.
+  bool Invoke() {
+    const TfLiteStatus status = registration_.invoke(&context_, &node_);
+    if (status != kTfLiteOk) {
+      TEST_ASSERT_EQUAL(tflite::kTfLiteAbort, status);
+    }
+    return status == kTfLiteOk;
+  }
+
+  std::vector<int8_t>& input() { return input_; }
+  const TfLiteEvalTensor* output_eval_tensor() {
+    return micro_context_->GetEvalTensor(1);
+  }
+
+ private:
+  const TfLiteRegistration_V1& registration_;
+  std::vector<int8_t> input_;
+  std::vector<int8_t> output_;
+  std::vector<uint8_t> arena_;
+  tflite::SingleArenaBufferAllocator* allocator_;
+  tflite::MockMicroGraph graph_;
+  int input_dims_[5];
+  int output_dims_[5];
+  int inputs_array_[2] = {1, 0};
+  int outputs_array_[2] = {1, 1};
+  TfLiteTensor tensors_[2];
+  alignas(EvalTensorContext) uint8_t
+      micro_context_storage_[sizeof(EvalTensorContext)];
+  EvalTensorContext* micro_context_;
+  TfLiteContext context_ = {};
+  TfLiteNode node_ = {};
+};
+
+void CheckWindows(const TfLiteRegistration_V1& registration, int num_slots,
+                  int depth, int cycles_max) {
+  CircularBufferRunner runner(registration, num_slots, depth, cycles_max);
+  std::vector<int8_t> expected(num_slots * depth, kZeroPoint);
+  std::mt19937 rng(num_slots * 100 + depth + cycles_max);
+  for (int i = 1; i <= 3 * num_slots + 7; ++i) {
+    for (int8_t& value : runner.input()) {
+      value = static_cast<int8_t>(rng());
+    }
+    expected.erase(expected.begin(), expected.begin() + depth);
+    expected.insert(expected.end(), runner.input().begin(),
+                    runner.input().end());
+    const bool ran = runner.Invoke();
+    TEST_ASSERT_EQUAL(i % cycles_max == 0, ran);
+    // Consumers read wherever the eval tensor points: the planned buffer for
+    // the shift, the ring for the current kernel.
+    if (ran) {
+      TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(),
+                                   runner.output_eval_tensor()->data.int8,
+                                   expected.size());
+    }
+  }
+}
+
+constexpr int kSampleRate = 16000;
+constexpr int kNumChannels = 40;
+constexpr int kFilters = 8;
+constexpr float kFeatureScale = 0.102f;  // 0..26 after the 1/25.6 scaling
+constexpr float kConvOutputScale = 0.5f;
+constexpr int kGraphArenaSize = 32 * 1024;
+
+// The shape of the first layers of a streaming keyword model: the
+// CIRCULAR_BUFFER accumulates `num_slots` feature slices and releases every
+// `cycles_max` slices a CONV_2D of `filter_height` slices with `stride`.
+struct KwsShape {
+  int num_slots;
+  int cycles_max;
+  int filter_height;
+  int stride;
+};
+
+// A 16-bit mono stream at kSampleRate: noise, with 300 ms tone bursts every
+// 700 ms, as in the MNIST project's streaming audio test.
+std::vector<int16_t> MakeAudio(int seconds) {
+  std::mt19937 rng(32);
+  std::normal_distribution<float> noise(0.0f, 300.0f);
+  std::vector<int16_t> samples(seconds * kSampleRate);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    float sample = noise(rng);
+    if (i % (kSampleRate * 7 / 10) < kSampleRate * 3 / 10) {
+      const float t = static_cast<float>(i) / kSampleRate;
+      sample += 6000.0f * std::sin(2 * 3.14159265f * 440.0f * t) +
+                3000.0f * std::sin(2 * 3.14159265f * 1250.0f * t);
+    }
+    samples[i] = static_cast<int16_t>(
+        std::max(-32768.0f, std::min(32767.0f, sample)));
+  }
+  return samples;
+}
+
+// Runs the microfrontend over `samples` and returns its slices quantized to
+// the graph input, and the frontend time per slice in `us_per_slice`.
+std::vector<int8_t> FrontendFeatures(const std::vector<int16_t>& samples,
+                                     double* us_per_slice) {
+  FrontendConfig config;
+  FrontendFillConfigWithDefaults(&config);
+  config.filterbank.num_channels = kNumChannels;
+  FrontendState state;
+  TEST_ASSERT_EQUAL(1, FrontendPopulateState(&config, &state, kSampleRate));
+
+  std::vector<int8_t> features;
+  const int16_t* audio = samples.data();
+  size_t remaining = samples.size();
+  int slices = 0;
+  const auto start = std::chrono::steady_clock::now();
+  while (remaining > 0) {
+    size_t read = 0;
+    const FrontendOutput output =
+        FrontendProcessSamples(&state, audio, remaining, &read);
+    audio += read;
+    remaining -= read;
+    if (output.values == nullptr) continue;
+    TEST_ASSERT_EQUAL(kNumChannels, output.size);
+    for (size_t i = 0; i < output.size; ++i) {
+      const int32_t value = static_cast<int32_t>(
+          lroundf(output.values[i] / 25.6f / kFeatureScale) + kZeroPoint);
+      features.push_back(static_cast<int8_t>(
+          std::max<int32_t>(-128, std::min<int32_t>(127, value))));
+    }
+    ++slices;
+  }
+  *us_per_slice = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count() /
+                  slices;
+  FrontendFreeStateContents(&state);
+  return features;
+}
+
+// input [1, 1, 1, 40] -> CIRCULAR_BUFFER -> [1, num_slots, 1, 40] ->
+// CONV_2D (VALID, per-channel int8 filter, int32 bias) -> [1, rows, 1, 8].
+std::vector<uint8_t> BuildKwsModel(const KwsShape& shape) {
+  using flatbuffers::Offset;
+  // This flatbuffers has no implicit default allocator.
+  flatbuffers::DefaultAllocator allocator;
+  flatbuffers::FlatBufferBuilder fbb(1024, &allocator);
+  std::mt19937 rng(shape.num_slots);
+
+  std::vector<uint8_t> filter(kFilters * shape.filter_height * kNumChannels);
+  for (uint8_t& value : filter) value = static_cast<uint8_t>(rng());
+  std::vector<int32_t> bias(kFilters);
+  for (int32_t& value : bias) value = static_cast<int32_t>(rng() % 4001) - 2000;
+  const std::vector<Offset<tflite::Buffer>> buffers = {
+      tflite::CreateBuffer(fbb),
+      tflite::CreateBufferDirect(fbb, &filter),
+      tflite::CreateBuffer(
+          fbb, fbb.CreateVector(reinterpret_cast<const uint8_t*>(bias.data()),
+                                bias.size() * sizeof(int32_t))),
+  };
+
+  auto quantization = [&](const std::vector<float>& scale,
+                          int64_t zero_point) {
+    const std::vector<int64_t> zero_points(scale.size(), zero_point);
+    return tflite::CreateQuantizationParametersDirect(fbb, nullptr, nullptr,
+                                                      &scale, &zero_points);
+  };
+  std::vector<float> filter_scales(kFilters);
+  for (int i = 0; i < kFilters; ++i) filter_scales[i] = 0.002f + 0.0005f * i;
+  std::vector<float> bias_scales(kFilters);
+  for (int i = 0; i < kFilters; ++i) {
+    bias_scales[i] = kFeatureScale * filter_scales[i];
+  }
+  const int rows = (shape.num_slots - shape.filter_height) / shape.stride + 1;
+  const std::vector<int32_t> input_shape = {1, 1, 1, kNumChannels};
+  const std::vector<int32_t> window_shape = {1, shape.num_slots, 1,
+                                             kNumChannels};
+  const std::vector<int32_t> filter_shape = {kFilters, shape.filter_height, 1,
+                                             kNumChannels};
+  const std::vector<int32_t> bias_shape = {kFilters};
+  const std::vector<int32_t> output_shape = {1, rows, 1, kFilters};
+  const std::vector<Offset<tflite::Tensor>> tensors = {
+      tflite::CreateTensorDirect(fbb, &input_shape, tflite::TensorType_INT8, 0,
+                                 "features",
+                                 quantization({kFeatureScale}, kZeroPoint)),
+      tflite::CreateTensorDirect(fbb, &window_shape, tflite::TensorType_INT8,
+                                 0, "window",
+                                 quantization({kFeatureScale}, kZeroPoint)),
+      tflite::CreateTensorDirect(fbb, &filter_shape, tflite::TensorType_INT8,
+                                 1, "filter", quantization(filter_scales, 0)),
+      tflite::CreateTensorDirect(fbb, &bias_shape, tflite::TensorType_INT32, 2,
+                                 "bias", quantization(bias_scales, 0)),
+      tflite::CreateTensorDirect(fbb, &output_shape, tflite::TensorType_INT8,
+                                 0, "conv",
+                                 quantization({kConvOutputScale}, 0)),
+  };
+
+  flexbuffers::Builder options;
+  options.Map([&]() { options.Int("cycles_max", shape.cycles_max); });
+  options.Finish();
+  const std::vector<Offset<tflite::OperatorCode>> operator_codes = {
+      tflite::CreateOperatorCodeDirect(fbb, tflite::BuiltinOperator_CUSTOM,
+                                       "CIRCULAR_BUFFER", 1,
+                                       tflite::BuiltinOperator_CUSTOM),
+      tflite::CreateOperatorCode(fbb, tflite::BuiltinOperator_CONV_2D, 0, 1,
+                                 tflite::BuiltinOperator_CONV_2D),
+  };
+  const std::vector<int32_t> buffer_inputs = {0};
+  const std::vector<int32_t> buffer_outputs = {1};
+  const std::vector<int32_t> conv_inputs = {1, 2, 3};
+  const std::vector<int32_t> conv_outputs = {4};
+  const std::vector<Offset<tflite::Operator>> operators = {
+      tflite::CreateOperatorDirect(fbb, 0, &buffer_inputs, &buffer_outputs,
+                                   tflite::BuiltinOptions_NONE, 0,
+                                   &options.GetBuffer()),
+      tflite::CreateOperatorDirect(
+          fbb, 1, &conv_inputs, &conv_outputs,
+          tflite::BuiltinOptions_Conv2DOptions,
+          tflite::CreateConv2DOptions(fbb, tflite::Padding_VALID, 1,
+                                      shape.stride)
+              .Union()),
+  };
+  const std::vector<int32_t> graph_inputs = {0};
+  const std::vector<int32_t> graph_outputs = {4};
+  const std::vector<Offset<tflite::SubGraph>> subgraphs = {
+      tflite::CreateSubGraphDirect(fbb, &tensors, &graph_inputs,
+                                   &graph_outputs, &operators)};
+  fbb.Finish(tflite::CreateModelDirect(fbb, TFLITE_SCHEMA_VERSION,
+                                       &operator_codes, &subgraphs, nullptr,
+                                       &buffers));
+  return std::vector<uint8_t>(fbb.GetBufferPointer(),
+                              fbb.GetBufferPointer() + fbb.GetSize());
+}
+
+// Time spent in each op, keyed by the tag MicroGraph passes: the op name.
+class OpTimer : public tflite::MicroProfilerInterface {
+ public:
+  uint32_t BeginEvent(const char* tag) override {
+    tag_ = tag;
+    start_ = std::chrono::steady_clock::now();
+    return 0;
+  }
+
+  void EndEvent(uint32_t) override {
+    const double ns = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - start_)
+                          .count();
+    if (strcmp(tag_, "CIRCULAR_BUFFER") == 0) {
+      buffer_ns += ns;
+    } else {
+      conv_ns += ns;
+    }
+  }
+
+  double buffer_ns = 0;
+  double conv_ns = 0;
+
+ private:
+  const char* tag_ = "";
+  std::chrono::steady_clock::time_point start_;
+};
+
+// The KWS graph with CIRCULAR_BUFFER resolved to `registration`.
+class KwsGraph {
+ public:
+  KwsGraph(const std::vector<uint8_t>& model,
+           TfLiteRegistration_V1* registration)
+      : arena_(new uint8_t[kGraphArenaSize + 16]),
+        interpreter_(tflite::GetModel(model.data()), resolver(registration),
+                     Align16(arena_), kGraphArenaSize, nullptr, &timer_) {
+    TEST_ASSERT_EQUAL(kTfLiteOk, interpreter_.AllocateTensors());
+  }
+
+  ~KwsGraph() { delete[] arena_; }
+
+  KwsGraph(const KwsGraph&) = delete;
+  KwsGraph& operator=(const KwsGraph&) = delete;
+
+  // Feeds one slice; returns true when the convolution ran.
+  bool Invoke(const int8_t* slice) {
+    memcpy(interpreter_.input(0)->data.int8, slice, kNumChannels);
+    const TfLiteStatus status = interpreter_.Invoke();
+    if (status != kTfLiteOk) {
+      TEST_ASSERT_EQUAL(tflite::kTfLiteAbort, status);
+    }
+    return status == kTfLiteOk;
+  }
+
+  const TfLiteTensor* output() { return interpreter_.output(0); }
+  OpTimer& timer() { return timer_; }
+
+ private:
+  static uint8_t* Align16(uint8_t* p) {
+    return p + ((16 - reinterpret_cast<uintptr_t>(p) % 16) % 16);
+  }
+
+  const tflite::MicroOpResolver& resolver(
+      TfLiteRegistration_V1* registration) {
+    resolver_.AddCustom("CIRCULAR_BUFFER", registration);
+    resolver_.AddConv2D();
+    return resolver_;
+  }
+
+  uint8_t* arena_;
+  tflite::MicroMutableOpResolver<2> resolver_;
+  OpTimer timer_;
+  tflite::MicroInterpreter interpreter_;
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_window_matches_shift() {
+  const int shapes[][2] = {{49, 40}, {25, 96}, {5, 96}, {3, 1}, {1, 7}};
+  for (const auto& shape : shapes) {
+    for (int cycles_max = 1; cycles_max <= 3; ++cycles_max) {
+      CheckWindows(*tflite::Register_CIRCULAR_BUFFER_BASELINE(), shape[0],
+                   shape[1], cycles_max);
+      CheckWindows(*tflite::Register_CIRCULAR_BUFFER(), shape[0], shape[1],
+                   cycles_max);
+    }
+  }
+}
+
+// A 49 slice window released every 2 slices into a 10x1 convolution with
+// stride 2, and a 25 slice window that runs every slice (cycles_max 1, as
+// Prepare resolves it for the 25 slot buffers) into a 5x1 one. Once the
+// window is full, every run of the convolution must give the same outputs
+// with the ring as with the shift; before that the shift's window still
+// holds whatever was in its planned buffer, the ring's the zero point. The
+// timings are per 10 ms slice, over several passes of the audio.
+void test_kws_graph_matches_shift() {
+  double frontend_us = 0;
+  const std::vector<int8_t> features =
+      FrontendFeatures(MakeAudio(10), &frontend_us);
+  const int num_slices = static_cast<int>(features.size()) / kNumChannels;
+  const KwsShape shapes[] = {{49, 2, 10, 2}, {25, 1, 5, 1}};
+  for (const KwsShape& shape : shapes) {
+    const std::vector<uint8_t> model = BuildKwsModel(shape);
+    KwsGraph shift(model, tflite::Register_CIRCULAR_BUFFER_BASELINE());
+    KwsGraph ring(model, tflite::Register_CIRCULAR_BUFFER());
+    const size_t output_size = shift.output()->bytes;
+    int runs = 0;
+    for (int i = 0; i < num_slices; ++i) {
+      const int8_t* slice = &features[i * kNumChannels];
+      const bool ran = shift.Invoke(slice);
+      TEST_ASSERT_EQUAL(ran, ring.Invoke(slice));
+      if (!ran || i < shape.num_slots - 1) continue;
+      TEST_ASSERT_EQUAL_INT8_ARRAY(shift.output()->data.int8,
+                                   ring.output()->data.int8, output_size);
+      ++runs;
+    }
+    TEST_ASSERT_GREATER_THAN(
+        num_slices / shape.cycles_max - shape.num_slots, runs);
+
+    // Alternate the two graphs by pass so drift in the machine hits both.
+    const int kPasses = 20;
+    double shift_us = 0;
+    double ring_us = 0;
+    shift.timer() = OpTimer();
+    ring.timer() = OpTimer();
+    for (int pass = 0; pass < kPasses; ++pass) {
+      for (KwsGraph* graph : {&shift, &ring}) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_slices; ++i) {
+          graph->Invoke(&features[i * kNumChannels]);
+        }
+        (graph == &shift ? shift_us : ring_us) +=
+            std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+      }
+    }
+    const double slices = static_cast<double>(kPasses) * num_slices;
+    char line[128];
+    snprintf(line, sizeof(line),
+             "KWS %dx%d, cycles_max %d: frontend %.2f us/slice, %d conv runs",
+             shape.num_slots, kNumChannels, shape.cycles_max, frontend_us,
+             runs);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line),
+             "  shift: buffer %.1f ns, conv %.2f us, Invoke %.2f us per slice",
+             shift.timer().buffer_ns / slices,
+             shift.timer().conv_ns / slices / 1000, shift_us / slices);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line),
+             "  ring:  buffer %.1f ns, conv %.2f us, Invoke %.2f us per slice",
+             ring.timer().buffer_ns / slices,
+             ring.timer().conv_ns / slices / 1000, ring_us / slices);
+    TEST_MESSAGE(line);
+  }
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_window_matches_shift);
+  RUN_TEST(test_kws_graph_matches_shift);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,668 @@
+// The 16x8 kernels of optimized_integer_ops (int16_activations.h), used by
+// esp_nn/{conv,depthwise_conv,fully_connected,softmax}.cc for int16
+// activations, and the int16 AddInt16Op of binary_elementwise.h used by
+// esp_nn/add.cc, against the reference_integer_ops / reference_ops
+// kernels, plus a timing comparison on MobileNetV2-like shapes. Inputs at
+// the int16 and int8 extremes check that the int32 partial sums widen
+// before they can overflow.
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <initializer_list>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/binary_elementwise.h"
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/int16_activations.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/add.h"
+#include "tensorflow/lite/kernels/internal/reference/process_broadcast_shapes.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/softmax.h"
+
+namespace {
+
+std::mt19937 rng(39);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+tflite::RuntimeShape Shape(std::initializer_list<int32_t> dims) {
+  return tflite::RuntimeShape(dims.size(), dims.begin());
+}
+
+// Random values, or only the extremes so that every product is +-2^22.
+template <typename T>
+void FillRandom(std::vector<T>& values, bool extremes) {
+  for (T& value : values) {
+    value = extremes ? (RandomInt(0, 1) ? std::numeric_limits<T>::min()
+                                        : std::numeric_limits<T>::max())
+                     : static_cast<T>(
+                           RandomInt(std::numeric_limits<T>::min(),
+                                     std::numeric_limits<T>::max()));
+  }
+}
+
+// Per-channel multipliers that scale an accumulator of `products` products
+// into a range where both clamps and unclamped outputs occur.
+void FillRequantization(int channels, int products, std::vector<int32_t>& mult,
+                        std::vector<int32_t>& shift) {
+  mult.resize(channels);
+  shift.resize(channels);
+  const int bits = static_cast<int>(std::ceil(std::log2(products + 1)));
+  for (int c = 0; c < channels; ++c) {
+    mult[c] = RandomInt(1 << 30, std::numeric_limits<int32_t>::max());
+    shift[c] = RandomInt(-bits - 10, -bits - 4);
+  }
+}
+
+void RandomActivationRange(int32_t* activation_min, int32_t* activation_max) {
+  *activation_min = RandomInt(0, 3) ? -32768 : RandomInt(-32768, 0);
+  *activation_max = RandomInt(0, 3) ? 32767 : RandomInt(0, 32767);
+}
+
+struct ConvCase {
+  int batches, input_height, input_width, input_depth;
+  int filter_height, filter_width, output_depth;
+  int output_height, output_width;
+  tflite::ConvParams params;
+  std::vector<int16_t> input;
+  std::vector<int8_t> filter;
+  std::vector<int64_t> bias;
+  std::vector<int32_t> bias32;
+  std::vector<int32_t> multiplier;
+  std::vector<int32_t> shift;
+
+  ConvCase(int batches, int height, int width, int input_depth,
+           int filter_height, int filter_width, int output_depth, int stride,
+           int dilation, bool same_padding, bool extremes)
+      : batches(batches),
+        input_height(height),
+        input_width(width),
+        input_depth(input_depth),
+        filter_height(filter_height),
+        filter_width(filter_width),
+        output_depth(output_depth),
+        params(),
+        input(batches * height * width * input_depth),
+        filter(output_depth * filter_height * filter_width * input_depth),
+        bias(output_depth),
+        bias32(output_depth) {
+    FillRandom(input, extremes);
+    FillRandom(filter, extremes);
+    for (int c = 0; c < output_depth; ++c) {
+      bias32[c] = RandomInt(-(1 << 20), 1 << 20);
+      bias[c] = bias32[c] * static_cast<int64_t>(RandomInt(1, 64));
+    }
+    FillRequantization(output_depth,
+                       filter_height * filter_width * input_depth, multiplier,
+                       shift);
+    const int effective_height = (filter_height - 1) * dilation + 1;
+    const int effective_width = (filter_width - 1) * dilation + 1;
+    output_height = same_padding ? (height + stride - 1) / stride
+                                 : (height - effective_height) / stride + 1;
+    output_width = same_padding ? (width + stride - 1) / stride
+                                : (width - effective_width) / stride + 1;
+    params.stride_height = params.stride_width = stride;
+    params.dilation_height_factor = params.dilation_width_factor = dilation;
+    params.padding_values.height =
+        same_padding ? std::max(0, ((output_height - 1) * stride +
+                                    effective_height - height) /
+                                       2)
+                     : 0;
+    params.padding_values.width =
+        same_padding ? std::max(0, ((output_width - 1) * stride +
+                                    effective_width - width) /
+                                       2)
+                     : 0;
+    RandomActivationRange(&params.quantized_activation_min,
+                          &params.quantized_activation_max);
+  }
+
+  int OutputSize() const {
+    return batches * output_height * output_width * output_depth;
+  }
+
+  tflite::RuntimeShape InputShape() const {
+    return Shape({batches, input_height, input_width, input_depth});
+  }
+  tflite::RuntimeShape FilterShape() const {
+    return Shape({output_depth, filter_height, filter_width, input_depth});
+  }
+  tflite::RuntimeShape OutputShape() const {
+    return Shape({batches, output_height, output_width, output_depth});
+  }
+
+  template <typename AccumScalar>
+  void RunReference(const AccumScalar* bias_data, int16_t* output) const {
+    tflite::reference_integer_ops::ConvPerChannel(
+        params, multiplier.data(), shift.data(), InputShape(), input.data(),
+        FilterShape(), filter.data(), Shape({output_depth}),
+        bias_data, OutputShape(), output);
+  }
+
+  template <typename AccumScalar>
+  void RunOptimized(const AccumScalar* bias_data, int16_t* output) const {
+    tflite::optimized_integer_ops::ConvPerChannel16x8(
+        params, multiplier.data(), shift.data(), InputShape(), input.data(),
+        FilterShape(), filter.data(), Shape({output_depth}),
+        bias_data, OutputShape(), output);
+  }
+};
+
+struct DepthwiseCase {
+  int batches, input_height, input_width, input_depth, depth_multiplier;
+  int filter_height, filter_width;
+  int output_height, output_width;
+  tflite::DepthwiseParams params;
+  std::vector<int16_t> input;
+  std::vector<int8_t> filter;
+  std::vector<int64_t> bias;
+  std::vector<int32_t> multiplier;
+  std::vector<int32_t> shift;
+  mutable std::vector<int32_t> acc_buffer;
+
+  DepthwiseCase(int batches, int height, int width, int input_depth,
+                int depth_multiplier, int filter_height, int filter_width,
+                int stride, int dilation, bool same_padding, bool extremes)
+      : batches(batches),
+        input_height(height),
+        input_width(width),
+        input_depth(input_depth),
+        depth_multiplier(depth_multiplier),
+        filter_height(filter_height),
+        filter_width(filter_width),
+        params(),
+        input(batches * height * width * input_depth),
+        filter(filter_height * filter_width * OutputDepth()),
+        bias(OutputDepth()),
+        acc_buffer(OutputDepth()) {
+    FillRandom(input, extremes);
+    FillRandom(filter, extremes);
+    for (int64_t& value : bias) {
+      value = static_cast<int64_t>(RandomInt(-(1 << 20), 1 << 20)) * 64;
+    }
+    FillRequantization(OutputDepth(), filter_height * filter_width,
+                       multiplier, shift);
+    const int effective_height = (filter_height - 1) * dilation + 1;
+    const int effective_width = (filter_width - 1) * dilation + 1;
+    output_height = same_padding ? (height + stride - 1) / stride
+                                 : (height - effective_height) / stride + 1;
+    output_width = same_padding ? (width + stride - 1) / stride
+                                : (width - effective_width) / stride + 1;
+    params.stride_height = params.stride_width = stride;
+    params.dilation_height_factor = params.dilation_width_factor = dilation;
+    params.depth_multiplier = depth_multiplier;
+    params.padding_values.height =
+        same_padding ? std::max(0, ((output_height - 1) * stride +
+                                    effective_height - height) /
+                                       2)
+                     : 0;
+    params.padding_values.width =
+        same_padding ? std::max(0, ((output_width - 1) * stride +
+                                    effective_width - width) /
+                                       2)
+                     : 0;
+    RandomActivationRange(&params.quantized_activation_min,
+                          &params.quantized_activation_max);
+  }
+
+  int OutputDepth() const { return input_depth * depth_multiplier; }
+  int OutputSize() const {
+    return batches * output_height * output_width * OutputDepth();
+  }
+
+  tflite::RuntimeShape InputShape() const {
+    return Shape({batches, input_height, input_width, input_depth});
+  }
+  tflite::RuntimeShape FilterShape() const {
+    return Shape({1, filter_height, filter_width, OutputDepth()});
+  }
+  tflite::RuntimeShape OutputShape() const {
+    return Shape({batches, output_height, output_width, OutputDepth()});
+  }
+
+  void RunReference(int16_t* output) const {
+    tflite::reference_integer_ops::DepthwiseConvPerChannel(
+        params, multiplier.data(), shift.data(), InputShape(), input.data(),
+        FilterShape(), filter.data(), Shape({OutputDepth()}),
+        bias.data(), OutputShape(), output);
+  }
+
+  void RunOptimized(int16_t* output) const {
+    tflite::optimized_integer_ops::DepthwiseConvPerChannel16x8(
+        params, multiplier.data(), shift.data(), InputShape(), input.data(),
+        FilterShape(), filter.data(), Shape({OutputDepth()}),
+        bias.data(), OutputShape(), output, acc_buffer.data());
+  }
+};
+
+struct FullyConnectedCase {
+  int batches, accum_depth, output_depth;
+  tflite::FullyConnectedParams params;
+  std::vector<int16_t> input;
+  std::vector<int8_t> filter;
+  std::vector<int64_t> bias;
+
+  FullyConnectedCase(int batches, int accum_depth, int output_depth,
+                     bool extremes)
+      : batches(batches),
+        accum_depth(accum_depth),
+        output_depth(output_depth),
+        params(),
+        input(batches * accum_depth),
+        filter(output_depth * accum_depth),
+        bias(output_depth) {
+    FillRandom(input, extremes);
+    FillRandom(filter, extremes);
+    for (int64_t& value : bias) {
+      value = static_cast<int64_t>(RandomInt(-(1 << 20), 1 << 20)) * 64;
+    }
+    std::vector<int32_t> multiplier, shift;
+    FillRequantization(1, accum_depth, multiplier, shift);
+    params.input_offset = 0;
+    params.weights_offset = 0;
+    params.output_offset = 0;
+    params.output_multiplier = multiplier[0];
+    params.output_shift = shift[0];
+    RandomActivationRange(&params.quantized_activation_min,
+                          &params.quantized_activation_max);
+  }
+
+  void RunReference(int16_t* output) const {
+    tflite::reference_integer_ops::FullyConnected(
+        params, Shape({batches, accum_depth}), input.data(),
+        Shape({output_depth, accum_depth}), filter.data(),
+        Shape({output_depth}), bias.data(),
+        Shape({batches, output_depth}), output);
+  }
+
+  void RunOptimized(int16_t* output) const {
+    tflite::optimized_integer_ops::FullyConnected16x8(
+        params, Shape({batches, accum_depth}), input.data(),
+        Shape({output_depth, accum_depth}), filter.data(),
+        bias.data(), Shape({batches, output_depth}), output);
+  }
+};
+
+// SoftmaxParams as softmax_common.cc computes them for an int16 input of
+// the given scale and beta.
+struct SoftmaxCase {
+  int rows, depth;
+  tflite::SoftmaxParams params;
+  int32_t saturated_diff;
+  std::vector<int16_t> exp_lut;
+  std::vector<int16_t> one_over_one_plus_x_lut;
+  std::vector<int16_t> input;
+
+  SoftmaxCase(int rows, int depth, float input_scale, float beta)
+      : rows(rows),
+        depth(depth),
+        params(),
+        exp_lut(tflite::LUTSize<int16_t>()),
+        one_over_one_plus_x_lut(tflite::LUTSize<int16_t>()),
+        input(rows * depth) {
+    const int32_t range = std::numeric_limits<int16_t>::max() -
+                          std::numeric_limits<int16_t>::min();
+    tflite::LUTPopulate<int16_t>(
+        10.0f / range, std::numeric_limits<int16_t>::max(), 2.0f / range, 0,
+        [](float value) { return std::exp(value); }, exp_lut.data());
+    tflite::LUTPopulate<int16_t>(
+        1.0f / range, std::numeric_limits<int16_t>::min(), 2.0f / range, 0,
+        [](float value) { return 1.0f / (1.0f + value); },
+        one_over_one_plus_x_lut.data());
+    params.exp_lut = exp_lut.data();
+    params.one_over_one_plus_x_lut = one_over_one_plus_x_lut.data();
+    int input_left_shift;
+    tflite::QuantizeMultiplier(static_cast<double>(input_scale) * beta /
+                                   (10.0 / 65535.0),
+                               &params.input_multiplier, &input_left_shift);
+    params.input_left_shift = input_left_shift;
+    saturated_diff =
+        tflite::optimized_integer_ops::SoftmaxInt16SaturatedDiff(params);
+    FillRandom(input, /*extremes=*/false);
+  }
+
+  void RunReference(int16_t* output) const {
+    tflite::reference_ops::SoftmaxInt16(
+        params, Shape({rows, depth}), input.data(),
+        Shape({rows, depth}), output);
+  }
+
+  void RunOptimized(int16_t* output) const {
+    tflite::optimized_integer_ops::SoftmaxInt16(
+        params, saturated_diff, Shape({rows, depth}),
+        input.data(), Shape({rows, depth}), output);
+  }
+};
+
+// ArithmeticParams as CalculateOpDataAdd computes them for int16 tensors
+// of the given scales (zero points are 0 for int16), and the dispatch of
+// EvalAddQuantized: BinaryElementwise with AddInt16Op when the shapes allow
+// it, against BroadcastAdd4DSlow or the general-scale Add the kernel used
+// before.
+struct AddCase {
+  std::vector<int32_t> input1_dims, input2_dims, output_dims;
+  tflite::ArithmeticParams params;
+  bool need_broadcast;
+  std::vector<int16_t> input1;
+  std::vector<int16_t> input2;
+
+  AddCase(const std::vector<int32_t>& input1_dims,
+          const std::vector<int32_t>& input2_dims, float input1_scale,
+          float input2_scale, float output_scale, bool extremes)
+      : input1_dims(input1_dims),
+        input2_dims(input2_dims),
+        output_dims(input1_dims.size()),
+        params(),
+        input1(FlatSize(input1_dims)),
+        input2(FlatSize(input2_dims)) {
+    for (size_t i = 0; i < output_dims.size(); ++i) {
+      output_dims[i] = std::max(input1_dims[i], input2_dims[i]);
+    }
+    FillRandom(input1, extremes);
+    FillRandom(input2, extremes);
+    params.left_shift = 15;
+    const double twice_max_input_scale =
+        2 * static_cast<double>(std::max(input1_scale, input2_scale));
+    tflite::QuantizeMultiplierSmallerThanOneExp(
+        input1_scale / twice_max_input_scale, &params.input1_multiplier,
+        &params.input1_shift);
+    tflite::QuantizeMultiplierSmallerThanOneExp(
+        input2_scale / twice_max_input_scale, &params.input2_multiplier,
+        &params.input2_shift);
+    tflite::QuantizeMultiplierSmallerThanOneExp(
+        twice_max_input_scale / ((1 << params.left_shift) * output_scale),
+        &params.output_multiplier, &params.output_shift);
+    params.input1_offset = 0;
+    params.input2_offset = 0;
+    params.output_offset = 0;
+    RandomActivationRange(&params.quantized_activation_min,
+                          &params.quantized_activation_max);
+    need_broadcast = tflite::reference_ops::ProcessBroadcastShapes(
+        Input1Shape(), Input2Shape(), &params);
+  }
+
+  static int FlatSize(const std::vector<int32_t>& dims) {
+    int size = 1;
+    for (int32_t dim : dims) size *= dim;
+    return size;
+  }
+
+  tflite::RuntimeShape Input1Shape() const {
+    return tflite::RuntimeShape(input1_dims.size(), input1_dims.data());
+  }
+  tflite::RuntimeShape Input2Shape() const {
+    return tflite::RuntimeShape(input2_dims.size(), input2_dims.data());
+  }
+  tflite::RuntimeShape OutputShape() const {
+    return tflite::RuntimeShape(output_dims.size(), output_dims.data());
+  }
+  int OutputSize() const { return FlatSize(output_dims); }
+
+  bool Supported() const {
+    return tflite::optimized_integer_ops::BinaryElementwiseSupported(
+        params, need_broadcast);
+  }
+
+  void RunReference(int16_t* output) const {
+    if (need_broadcast) {
+      tflite::reference_ops::BroadcastAdd4DSlow(
+          params, Input1Shape(), input1.data(), Input2Shape(), input2.data(),
+          OutputShape(), output);
+    } else {
+      tflite::reference_ops::Add(params, Input1Shape(), input1.data(),
+                                 Input2Shape(), input2.data(), OutputShape(),
+                                 output, /*pot_scale=*/false);
+    }
+  }
+
+  void RunOptimized(int16_t* output) const {
+    tflite::optimized_integer_ops::BinaryElementwise(
+        params, need_broadcast, Input1Shape(), input1.data(), Input2Shape(),
+        input2.data(), OutputShape(), output,
+        tflite::optimized_integer_ops::AddInt16Op(params));
+  }
+};
+
+template <typename Case>
+void CheckCase(const Case& op, int size) {
+  std::vector<int16_t> expected(size);
+  std::vector<int16_t> actual(size);
+  op.RunReference(expected.data());
+  op.RunOptimized(actual.data());
+  TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), actual.data(), size);
+}
+
+template <typename Case>
+double MicrosPerCall(const Case& op, bool optimized, int16_t* output) {
+  const int iterations = 20;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    if (optimized) {
+      op.RunOptimized(output);
+    } else {
+      op.RunReference(output);
+    }
+  }
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         iterations;
+}
+
+template <typename Case>
+void ReportTiming(const char* name, const Case& op, int size) {
+  std::vector<int16_t> output(size);
+  const double reference_us = MicrosPerCall(op, false, output.data());
+  const double optimized_us = MicrosPerCall(op, true, output.data());
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%s: reference %.1f us, optimized %.1f us (%.2fx)", name,
+           reference_us, optimized_us, reference_us / optimized_us);
+  TEST_MESSAGE(line);
+}
+
+// Adapts ConvCase to the RunReference/RunOptimized(int16_t*) interface.
+struct Conv64 {
+  const ConvCase& conv;
+  void RunReference(int16_t* output) const {
+    conv.RunReference(conv.bias.data(), output);
+  }
+  void RunOptimized(int16_t* output) const {
+    conv.RunOptimized(conv.bias.data(), output);
+  }
+};
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+// Odd depths, strides, dilation and SAME/VALID padding, with both the int64
+// bias of 16x8 models and the int32 bias the kernel also accepts.
+void test_conv_matches_reference() {
+  for (int trial = 0; trial < 200; ++trial) {
+    const int dilation = RandomInt(1, 2);
+    const int filter_size = RandomInt(1, 3);
+    const bool same_padding = RandomInt(0, 1);
+    const int min_size = same_padding ? 1 : (filter_size - 1) * dilation + 1;
+    const ConvCase conv(RandomInt(1, 2), RandomInt(min_size, min_size + 6),
+                        RandomInt(min_size, min_size + 6), RandomInt(1, 40),
+                        filter_size, filter_size, RandomInt(1, 17),
+                        RandomInt(1, 2), dilation, same_padding,
+                        /*extremes=*/trial % 4 == 0);
+    CheckCase(Conv64{conv}, conv.OutputSize());
+
+    std::vector<int16_t> expected(conv.OutputSize());
+    std::vector<int16_t> actual(conv.OutputSize());
+    conv.RunReference(conv.bias32.data(), expected.data());
+    conv.RunOptimized(conv.bias32.data(), actual.data());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected.data(), actual.data(),
+                                  expected.size());
+  }
+}
+
+// Input depths past kInt16x8MaxInt32Products, all products at +-2^22, so a
+// sum kept in int32 across the chunk boundary would overflow.
+void test_conv_widens_long_rows() {
+  const int depths[] = {
+      tflite::optimized_integer_ops::kInt16x8MaxInt32Products,
+      tflite::optimized_integer_ops::kInt16x8MaxInt32Products + 1, 1100};
+  for (int depth : depths) {
+    const ConvCase conv(1, 3, 3, depth, 1, 1, 5, 1, 1, false,
+                        /*extremes=*/true);
+    CheckCase(Conv64{conv}, conv.OutputSize());
+  }
+}
+
+void test_depthwise_matches_reference() {
+  for (int trial = 0; trial < 200; ++trial) {
+    const int dilation = RandomInt(1, 2);
+    const int filter_size = RandomInt(1, 5);
+    const bool same_padding = RandomInt(0, 1);
+    const int min_size = same_padding ? 1 : (filter_size - 1) * dilation + 1;
+    const DepthwiseCase depthwise(
+        RandomInt(1, 2), RandomInt(min_size, min_size + 6),
+        RandomInt(min_size, min_size + 6), RandomInt(1, 37),
+        trial % 2 ? 1 : RandomInt(2, 3), filter_size, filter_size,
+        RandomInt(1, 2), dilation, same_padding, /*extremes=*/trial % 4 == 0);
+    CheckCase(depthwise, depthwise.OutputSize());
+  }
+}
+
+// The largest filter DepthwiseConv16x8Supported accepts, with every product
+// at +-2^22.
+void test_depthwise_largest_supported_filter() {
+  const tflite::RuntimeShape too_large = Shape({1, 16, 32, 8});
+  TEST_ASSERT_FALSE(
+      tflite::optimized_integer_ops::DepthwiseConv16x8Supported(too_large));
+  const DepthwiseCase depthwise(1, 25, 20, 3, 1, 21, 20, 1, 1, true,
+                                /*extremes=*/true);
+  TEST_ASSERT_TRUE(tflite::optimized_integer_ops::DepthwiseConv16x8Supported(
+      depthwise.FilterShape()));
+  CheckCase(depthwise, depthwise.OutputSize());
+}
+
+// Output depths that leave 1 to 3 rows after the 4-row blocks, and accum
+// depths across the chunk boundary.
+void test_fully_connected_matches_reference() {
+  for (int trial = 0; trial < 200; ++trial) {
+    const FullyConnectedCase fc(RandomInt(1, 3), RandomInt(1, 1200),
+                                RandomInt(1, 23),
+                                /*extremes=*/trial % 4 == 0);
+    CheckCase(fc, fc.batches * fc.output_depth);
+  }
+}
+
+// Input scales from ones where no difference saturates the exp LUT to ones
+// where almost all do.
+void test_softmax_matches_reference() {
+  const float scales[] = {1.0f / 32768, 10.0f / 32768, 1e-3f, 0.01f, 0.1f};
+  for (float scale : scales) {
+    for (int trial = 0; trial < 20; ++trial) {
+      const SoftmaxCase softmax(RandomInt(1, 4), RandomInt(1, 1001), scale,
+                                trial % 2 ? 1.0f : 0.5f);
+      CheckCase(softmax, softmax.rows * softmax.depth);
+    }
+  }
+}
+
+// Same shapes, and 4D broadcasts where either input is the broadcast one,
+// along inner (y4 > 1) and innermost (a scalar per run) dimensions, with
+// unequal input scales so both rescalings differ.
+void test_add_matches_reference() {
+  const float scales[] = {1.0f / 32768, 3e-4f, 1e-3f, 0.02f};
+  int broadcast_cases = 0;
+  int scalar_runs = 0;
+  for (int trial = 0; trial < 400; ++trial) {
+    std::vector<int32_t> output_dims = {RandomInt(1, 3), RandomInt(1, 6),
+                                        RandomInt(1, 6), RandomInt(1, 40)};
+    std::vector<int32_t> input1_dims = output_dims;
+    std::vector<int32_t> input2_dims = output_dims;
+    if (trial % 4 != 0) {
+      // Each dimension of one input collapses to 1 with probability 1/2.
+      std::vector<int32_t>& broadcast =
+          RandomInt(0, 1) ? input1_dims : input2_dims;
+      for (int32_t& dim : broadcast) {
+        if (RandomInt(0, 1)) dim = 1;
+      }
+    }
+    const AddCase add(input1_dims, input2_dims, scales[RandomInt(0, 3)],
+                      scales[RandomInt(0, 3)], scales[RandomInt(0, 3)] * 2,
+                      /*extremes=*/trial % 5 == 0);
+    if (!add.Supported()) continue;
+    if (add.need_broadcast) {
+      ++broadcast_cases;
+      if (add.params.broadcast_shape[4] == 1) ++scalar_runs;
+    }
+    CheckCase(add, add.OutputSize());
+  }
+  TEST_ASSERT_GREATER_THAN(100, broadcast_cases);
+  TEST_ASSERT_GREATER_THAN(10, scalar_runs);
+
+  // MobileNetV2-style residual with a per-channel second input, both ways.
+  const AddCase per_channel({1, 8, 8, 96}, {1, 1, 1, 96}, 3e-4f, 1e-3f,
+                            1e-3f, false);
+  TEST_ASSERT_TRUE(per_channel.need_broadcast);
+  CheckCase(per_channel, per_channel.OutputSize());
+  const AddCase swapped({1, 1, 1, 96}, {1, 8, 8, 96}, 1e-3f, 3e-4f, 1e-3f,
+                        true);
+  CheckCase(swapped, swapped.OutputSize());
+  const AddCase scalar({1, 8, 8, 96}, {1, 1, 1, 1}, 3e-4f, 1e-3f, 1e-3f,
+                       false);
+  CheckCase(scalar, scalar.OutputSize());
+}
+
+void test_benchmark_against_reference() {
+  const ConvCase conv(1, 16, 16, 32, 3, 3, 32, 1, 1, true, false);
+  ReportTiming("Conv 16x16x32 3x3->32", Conv64{conv}, conv.OutputSize());
+  const ConvCase pointwise(1, 16, 16, 96, 1, 1, 24, 1, 1, false, false);
+  ReportTiming("Conv 16x16x96 1x1->24", Conv64{pointwise},
+               pointwise.OutputSize());
+  const DepthwiseCase depthwise(1, 16, 16, 96, 1, 3, 3, 1, 1, true, false);
+  ReportTiming("Depthwise 16x16x96 3x3", depthwise, depthwise.OutputSize());
+  const FullyConnectedCase fc(1, 1280, 10, false);
+  ReportTiming("FC 1x1280->10", fc, fc.output_depth);
+  const FullyConnectedCase fc_wide(1, 1024, 128, false);
+  ReportTiming("FC 1x1024->128", fc_wide, fc_wide.output_depth);
+  const SoftmaxCase softmax(1, 1000, 0.01f, 1.0f);
+  ReportTiming("Softmax 1x1000", softmax, softmax.depth);
+  const AddCase add({1, 16, 16, 96}, {1, 16, 16, 96}, 3e-4f, 1e-3f, 1e-3f,
+                    false);
+  ReportTiming("Add 16x16x96", add, add.OutputSize());
+  const AddCase broadcast({1, 16, 16, 96}, {1, 1, 1, 96}, 3e-4f, 1e-3f,
+                          1e-3f, false);
+  ReportTiming("Add 16x16x96 + 1x1x96", broadcast, broadcast.OutputSize());
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_conv_matches_reference);
+  RUN_TEST(test_conv_widens_long_rows);
+  RUN_TEST(test_depthwise_matches_reference);
+  RUN_TEST(test_depthwise_largest_supported_filter);
+  RUN_TEST(test_fully_connected_matches_reference);
+  RUN_TEST(test_softmax_matches_reference);
+  RUN_TEST(test_add_matches_reference);
+  RUN_TEST(test_benchmark_against_reference);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif
@@ -0,0 +1,201 @@
+// optimized_integer_ops Mean/Sum/ReduceMax over contiguous axes, used by
+// reduce_common.cc for int8, against the reference_ops N-D reductions that
+// reduce_common.cc falls back to, plus a timing comparison on the
+// MobileNetV2 head. reference_integer_ops::Mean is an empty header in this
+// copy of TFLM, so reference_ops::QuantizedMeanOrSum is the int8 reference.
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "tensorflow/lite/kernels/internal/optimized/integer_ops/reduce.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/reduce.h"
+
+namespace {
+
+std::mt19937 rng(30);
+
+int RandomInt(int low, int high) {
+  return std::uniform_int_distribution<int>(low, high)(rng);
+}
+
+struct ReduceCase {
+  std::vector<int> input_dims;
+  std::vector<int> axis;
+  std::vector<int> output_dims;  // keep_dims layout
+  std::vector<int8_t> input;
+  int32_t input_zero_point;
+  int32_t output_zero_point;
+  int32_t multiplier;
+  int shift;
+
+  ReduceCase(std::vector<int> dims, std::vector<int> reduce_axis)
+      : input_dims(dims), axis(reduce_axis), output_dims(dims) {
+    int size = 1;
+    for (int dim : input_dims) size *= dim;
+    for (int a : axis) output_dims[a < 0 ? a + dims.size() : a] = 1;
+    input.resize(size);
+    for (int8_t& value : input) {
+      value = static_cast<int8_t>(RandomInt(-128, 127));
+    }
+    input_zero_point = RandomInt(-128, 127);
+    output_zero_point = RandomInt(-128, 127);
+    const double real_multiplier =
+        std::uniform_real_distribution<double>(0.05, 4.0)(rng);
+    tflite::QuantizeMultiplier(real_multiplier, &multiplier, &shift);
+  }
+
+  int OutputSize() const {
+    int size = 1;
+    for (int dim : output_dims) size *= dim;
+    return size;
+  }
+
+  void RunReference(bool compute_sum, int8_t* output) const {
+    std::vector<int> temp_index(input_dims.size());
+    std::vector<int> resolved_axis(axis.size());
+    std::vector<int32_t> temp_sum(OutputSize());
+    const bool ok =
+        tflite::reference_ops::QuantizedMeanOrSum<int8_t, int32_t>(
+            input.data(), input_zero_point, input_dims.data(),
+            input_dims.size(), output, multiplier, shift, output_zero_point,
+            output_dims.data(), output_dims.size(), axis.data(), axis.size(),
+            /*keep_dims=*/true, temp_index.data(), resolved_axis.data(),
+            temp_sum.data(), compute_sum);
+    TEST_ASSERT_TRUE(ok);
+  }
+
+  void RunReferenceMax(int8_t* output) const {
+    std::vector<int> temp_index(input_dims.size());
+    std::vector<int> resolved_axis(axis.size());
+    const bool ok = tflite::reference_ops::ReduceGeneric<int8_t>(
+        input.data(), input_dims.data(), input_dims.size(), output,
+        output_dims.data(), output_dims.size(), axis.data(), axis.size(),
+        /*keep_dims=*/true, temp_index.data(), resolved_axis.data(),
+        std::numeric_limits<int8_t>::lowest(),
+        [](const int8_t current, const int8_t in) -> int8_t {
+          return in > current ? in : current;
+        });
+    TEST_ASSERT_TRUE(ok);
+  }
+
+  tflite::optimized_integer_ops::ContiguousReduceShape Shape() const {
+    tflite::optimized_integer_ops::ContiguousReduceShape shape = {};
+    std::vector<int> resolved_axis(axis.size());
+    TEST_ASSERT_TRUE(tflite::optimized_integer_ops::GetContiguousReduceShape(
+        input_dims.data(), input_dims.size(), axis.data(), axis.size(),
+        resolved_axis.data(), &shape));
+    return shape;
+  }
+
+  void RunOptimized(bool compute_sum, int8_t* output) const {
+    const tflite::optimized_integer_ops::ContiguousReduceShape shape = Shape();
+    std::vector<int32_t> sums(shape.inner);
+    tflite::optimized_integer_ops::QuantizedMeanOrSum(
+        shape, input.data(), input_zero_point, multiplier, shift,
+        output_zero_point, compute_sum, output, sums.data());
+  }
+
+  void RunOptimizedMax(int8_t* output) const {
+    tflite::optimized_integer_ops::ReduceMax(Shape(), input.data(), output);
+  }
+};
+
+void CheckCase(const ReduceCase& reduce) {
+  const int size = reduce.OutputSize();
+  std::vector<int8_t> expected(size);
+  std::vector<int8_t> actual(size);
+  for (bool compute_sum : {false, true}) {
+    reduce.RunReference(compute_sum, expected.data());
+    reduce.RunOptimized(compute_sum, actual.data());
+    TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), size);
+  }
+  reduce.RunReferenceMax(expected.data());
+  reduce.RunOptimizedMax(actual.data());
+  TEST_ASSERT_EQUAL_INT8_ARRAY(expected.data(), actual.data(), size);
+}
+
+}  // namespace
+
+void setUp() {}
+void tearDown() {}
+
+void test_mean_over_mobilenet_head() {
+  for (int trial = 0; trial < 20; ++trial) {
+    CheckCase(ReduceCase({1, 3, 3, 1280}, {1, 2}));
+  }
+}
+
+// Odd sizes on every axis, with the run of reduced axes at the front, in the
+// middle and at the end, so inner == 1 and outer == 1 are both covered.
+void test_matches_reference_on_odd_shapes() {
+  const struct {
+    std::vector<int> dims;
+    std::vector<int> axis;
+  } cases[] = {
+      {{1, 7, 5, 3}, {1, 2}},     {{3, 5, 7, 13}, {1, 2}},
+      {{2, 1, 1, 33}, {1, 2}},    {{1, 13, 11, 1}, {1, 2}},
+      {{3, 5, 7, 13}, {3}},       {{2, 3, 17}, {-1}},
+      {{5, 9, 3}, {0}},           {{3, 5, 7, 13}, {0, 1, 2}},
+      {{4, 6, 7, 5}, {2, 1}},     {{3, 5, 7, 13}, {0, 1, 2, 3}},
+      {{1, 1, 1, 1}, {1, 2}},     {{257, 3}, {0}},
+  };
+  for (const auto& c : cases) {
+    for (int trial = 0; trial < 10; ++trial) {
+      CheckCase(ReduceCase(c.dims, c.axis));
+    }
+  }
+}
+
+void test_benchmark_against_reference() {
+  const ReduceCase reduce({1, 3, 3, 1280}, {1, 2});
+  std::vector<int8_t> output(reduce.OutputSize());
+  const int iterations = 2000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    reduce.RunReference(/*compute_sum=*/false, output.data());
+  }
+  const double reference_us =
+      std::chrono::duration<double, std::micro>(
+          std::chrono::steady_clock::now() - start)
+          .count() /
+      iterations;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    reduce.RunOptimized(/*compute_sum=*/false, output.data());
+  }
+  const double optimized_us =
+      std::chrono::duration<double, std::micro>(
+          std::chrono::steady_clock::now() - start)
+          .count() /
+      iterations;
+  char line[128];
+  snprintf(line, sizeof(line),
+           "Mean 1x3x3x1280 over H,W: reference %.1f us, optimized %.1f us "
+           "(%.1fx)",
+           reference_us, optimized_us, reference_us / optimized_us);
+  TEST_MESSAGE(line);
+}
+
+int run_tests() {
+  UNITY_BEGIN();
+  RUN_TEST(test_mean_over_mobilenet_head);
+  RUN_TEST(test_matches_reference_on_odd_shapes);
+  RUN_TEST(test_benchmark_against_reference);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup() {
+  delay(2000);
+  run_tests();
+}
+void loop() {}
+#else
+int main() { return run_tests(); }
+#endif